@@ -1,12 +1,18 @@
 #ifndef AKINATOR_H
 #define AKINATOR_H
 
+#include "Speech.h"
 #include "Tree.h"
+#include "TreeJournal.h"
 
 struct Akinator_t {
     Tree_t* tree;
 
     char* base_path;
+
+    TreeJournal_t journal;
+
+    Speech_t* speech;           // NULL - silent: only the console game speaks
 };
 
 Akinator_t* AkinatorCtor();
@@ -14,4 +20,17 @@ void        AkinatorDtor( Akinator_t** akinator );
 
 void AkinatorGame( Akinator_t* akinator );
 
+// `new_object` goes under `leaf`, told apart from it by `new_question`; journaled first
+Node_t*      AkinatorAddObject( Akinator_t* akinator, Node_t* leaf, const char* new_question, const char* new_object, bool object_is_left );
+TreeStatus_t AkinatorSaveBase( Akinator_t* akinator );
+
+// Pre-renders what the game says at the top `levels` levels of the tree into the speech cache
+int AkinatorWarmUpSpeech( Akinator_t* akinator, size_t levels );
+
+// Draws the whole base into `svg_path` with the built-in layout or with Graphviz, and tells
+// how long it took: the two side by side on bases of any size
+int AkinatorRenderBase( const char* source_path, const char* svg_path, bool use_dot );
+
+int AkinatorConvertBase( const char* source_path, const char* target_path, BaseFormat_t target_format );
+
 #endif
\ No newline at end of file
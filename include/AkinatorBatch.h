@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef AKINATORBATCH_H
+#define AKINATORBATCH_H
+
+// A worker claims this many query lines at a time and formats their results into its own
+// buffer, so threads share nothing but the read-only tree and one counter
+const size_t BATCH_CHUNK_LINES = 256;
+
+const size_t BATCH_MAX_THREADS = 256;
+
+// Query file: one query per line, fields separated by tabs, empty lines and lines starting
+// with '#' are skipped:
+//     define   <TAB> object
+//     compare  <TAB> object <TAB> object
+//     classify <TAB> answers ('y' / 'n' from the root, e.g. "yny")
+// Results are JSON lines in query order, each carrying the line number of its query.
+int AkinatorBatch( const char* base_path, const char* queries_path, const char* results_path, size_t threads );
+
+#endif//AKINATORBATCH_H
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef AKINATORBENCH_H
+#define AKINATORBENCH_H
+
+// Set by mk-akinator-bench.sh, so results of different commits can be told apart
+#ifndef AKINATOR_REVISION
+    #define AKINATOR_REVISION "unknown"
+#endif
+
+const size_t BENCH_DEFAULT_REPEATS = 5;
+const size_t BENCH_MAX_REPEATS     = 1000;
+
+// Lookups and comparisons timed per repeat, over objects drawn from the base
+const size_t BENCH_QUERIES = 100000;
+
+enum BenchShape_t {
+    BENCH_BALANCED = 0,
+    BENCH_RANDOM   = 1,     // every question splits its objects at a uniformly random point
+    BENCH_CHAIN    = 2      // every question tells one object from all the others
+};
+
+// Writes a text base of `nodes` nodes (one more if even: every question has two answers) with
+// Cyrillic questions and unique object names. The same seed gives the same file byte for byte.
+int AkinatorGenerateBase( const char* base_path, BenchShape_t shape, size_t nodes, uint64_t seed );
+
+// Times loading, saving, object search, comparison, teardown and DOT output on `base_path`
+// `repeats` times each. Every operation is one JSON line appended to `results_path` ("-" -
+// stdout); a table goes to stdout as well when the results go to a file.
+int AkinatorBench( const char* base_path, const char* results_path, size_t repeats );
+
+// Stress readers: at most this many descend at once, the rest of the RCU slots stay free
+const size_t STRESS_MAX_READERS = 128;
+
+// `readers` threads descend the tree at random and one more walks all of it on the task pool,
+// while the calling thread makes `inserts` TreeSplitLeaf calls. Every leaf seen must be whole.
+// Returns 0 when no reader saw a half-built node and no node was lost. Meant for the TSan build.
+int AkinatorRcuStress( size_t readers, size_t inserts );
+
+#endif//AKINATORBENCH_H
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef AKINATORSERVER_H
+#define AKINATORSERVER_H
+
+#include <sys/socket.h>
+
+// Longest protocol line, '\n' included; a session sending a longer one is closed
+const size_t SERVER_MAX_LINE = 1024;
+
+const int SERVER_LISTEN_BACKLOG = 512;
+const int SERVER_MAX_EVENTS     = 256;     // epoll events taken per wakeup
+
+const size_t LOAD_TEST_MAX_CONNECTIONS = 1024;
+
+// ADDRESS is a TCP port on 127.0.0.1 if it is all digits, a Unix socket path otherwise
+//
+// One thread, one epoll loop: every session plays on the same in-memory tree, so an object
+// taught in one session is guessed in the next round of any other. Learned objects go to
+// the journal at once; the base and the play statistics are saved on SIGINT / SIGTERM.
+//
+// Line protocol, UTF-8, fields separated by tabs. Client to server:
+//     PLAY                              a round of the game
+//     DEFINE  <TAB> object              the object's traits
+//     COMPARE <TAB> object <TAB> object
+//     QUIT
+// Server to client:
+//     READY                             waits for one of the commands above
+//     QUESTION <TAB> text               answer Y, N, Y? (probably), N? (probably not), ? (don't know)
+//     GUESS    <TAB> object             answer Y or N
+//     WON                               the guess was right
+//     LOST     <TAB> reason             no more guesses, nothing to learn from
+//     TEACH    <TAB> object             the last guess was wrong: answer
+//                                           TEACH <TAB> object <TAB> question <TAB> Y|N
+//                                       (Y if the question is true for the new object) or SKIP
+//     LEARNED
+//     TRAITS   <TAB> object { <TAB> +question | -question }
+//     COMMON / FIRST / SECOND <TAB> ... the same traits split at the fork of two objects
+//     ERROR    <TAB> message            the line was not accepted, the server waits for another
+//     BYE
+int AkinatorServe( const char* address );
+
+// Plays SESSIONS short games over CONNECTIONS parallel connections with random answers and
+// reports sessions per second and answer latency; never teaches the server anything
+int AkinatorLoadTest( const char* address, size_t sessions, size_t connections );
+
+// sockaddr_un or sockaddr_in for ADDRESS, see above; returns the length, 0 if it is no address
+size_t ServerParseAddress( const char* address, struct sockaddr_storage* socket_address );
+
+#endif//AKINATORSERVER_H
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef COMPACTTREE_H
+#define COMPACTTREE_H
+
+struct Node_t;
+
+// Slot 0 is the root and never anyone's child
+const uint32_t COMPACT_NONE = 0;
+
+// New slots go to the end of the array until they make up this share of it, then the
+// whole tree is laid out again
+const uint32_t COMPACT_RELAYOUT_SHARE = 8;
+
+// A quarter of a cache line, against 48 bytes of Node_t plus a pointer chase for the value
+struct CompactNode_t {
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;
+    uint32_t text;              // offset of the NUL-terminated value in CompactTree_t::text
+};
+
+// Read-only copy of a tree in van Emde Boas order: the top half of the levels first, then
+// every subtree hanging below it, each laid out the same way, so a root-to-leaf descent
+// touches O(log_B n) cache lines for any line size B. Values are copied alongside in the
+// same order. Built on first use; TreeSplitLeaf patches it in place and appends, and a
+// relayout happens once appended slots pass 1 / COMPACT_RELAYOUT_SHARE of the tree.
+struct CompactTree_t {
+    bool built;
+
+    CompactNode_t* nodes;
+    Node_t**       origin;      // pointer-tree node of every slot, for changes through Tree_t
+    uint32_t       count;
+    uint32_t       capacity;
+    uint32_t       appended;
+
+    char*  text;
+    size_t text_size;
+    size_t text_capacity;
+};
+
+void CompactTreeCtor( CompactTree_t* compact );
+void CompactTreeDtor( CompactTree_t* compact );
+
+void CompactTreeBuild( CompactTree_t* compact, Node_t* root );
+void CompactTreeSplitLeaf( CompactTree_t* compact, const Node_t* leaf, Node_t* copy );
+bool CompactTreeNeedsRelayout( const CompactTree_t* compact );
+
+inline const char* CompactTreeValue( const CompactTree_t* compact, uint32_t slot ) {
+    return compact->text + compact->nodes[ slot ].text;
+}
+
+inline bool CompactTreeIsLeaf( const CompactTree_t* compact, uint32_t slot ) {
+    return compact->nodes[ slot ].left == COMPACT_NONE && compact->nodes[ slot ].right == COMPACT_NONE;
+}
+
+#endif//COMPACTTREE_H
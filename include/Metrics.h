@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <time.h>
+
+enum MetricCounter_t {
+    COUNTER_PARSE_BYTES   = 0,
+    COUNTER_PARSE_NODES   = 1,
+    COUNTER_SEARCHES      = 2,      // lookups of an object by name
+    COUNTER_SEARCH_PROBES = 3,      // slots of the index they looked at
+    COUNTER_PATHS         = 4,      // paths read off parent links: comparisons, definitions
+    COUNTER_PATH_NODES    = 5,
+    COUNTER_SAVE_BYTES    = 6,
+
+    COUNTER_COUNT
+};
+
+enum MetricTimer_t {
+    TIMER_LOAD        = 0,
+    TIMER_SAVE        = 1,
+    TIMER_DUMP        = 2,          // writing the log and DOT, not the layout
+    TIMER_RENDER      = 3,          // one picture laid out, on a render worker
+    TIMER_SPEECH_WAIT = 4,          // an utterance due to play still being synthesized
+
+    TIMER_COUNT
+};
+
+enum MetricsFormat_t {
+    METRICS_OFF   = 0,
+    METRICS_TEXT  = 1,
+    METRICS_JSON  = 2
+};
+
+// Every thread counts into a block of its own, so a count is a load and a store to memory no
+// other thread writes: no locked instruction and no shared cache line on the hot paths.
+// Blocks outlive their threads, MetricsReport sums them. Relaxed atomics only let the report
+// read them while other threads still count.
+struct MetricsBlock_t {
+    uint64_t counters[ COUNTER_COUNT ];
+
+    uint64_t timer_calls[ TIMER_COUNT ];
+    uint64_t timer_ns[ TIMER_COUNT ];
+    uint64_t timer_max_ns[ TIMER_COUNT ];
+
+    MetricsBlock_t* next;
+};
+
+// __thread rather than thread_local: a constant-initialized pointer needs no per-access TLS wrapper call
+extern __thread MetricsBlock_t* metrics_block;
+
+MetricsBlock_t* MetricsRegister();
+
+inline void MetricsAdd( uint64_t* field, uint64_t value ) {
+    __atomic_store_n( field, __atomic_load_n( field, __ATOMIC_RELAXED ) + value, __ATOMIC_RELAXED );
+}
+
+inline void MetricsCount( MetricCounter_t counter, uint64_t value ) {
+    MetricsBlock_t* block = metrics_block ? metrics_block : MetricsRegister();
+
+    MetricsAdd( &( block->counters[ counter ] ), value );
+}
+
+// One more of `events`, `value` more of `amount`: a lookup and its probes, a path and its nodes
+inline void MetricsEvent( MetricCounter_t events, MetricCounter_t amount, uint64_t value ) {
+    MetricsBlock_t* block = metrics_block ? metrics_block : MetricsRegister();
+
+    MetricsAdd( &( block->counters[ events ] ), 1 );
+    MetricsAdd( &( block->counters[ amount ] ), value );
+}
+
+inline uint64_t MetricsStart() {
+    struct timespec now = {};
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ull + ( uint64_t ) now.tv_nsec;
+}
+
+// The same clock in seconds, for the modes that print their own timings
+inline double MonotonicSeconds() {
+    return ( double ) MetricsStart() * 1e-9;
+}
+
+void MetricsStop( MetricTimer_t timer, uint64_t start );
+
+// Sums the blocks of all threads so far
+void MetricsReport( FILE* stream, MetricsFormat_t format );
+
+#endif//METRICS_H
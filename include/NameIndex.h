@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include "StringPool.h"
+
+struct Node_t;
+
+// Below this many entries new names are kept unsorted and scanned by every query
+const size_t NAME_INDEX_MIN_TAIL = 1024;
+
+// Names a fuzzy query visits at a limit over 1 before the limit drops to 1. Every visit is a
+// few cache misses on a large index, and a distance-2 walk over millions of names visits
+// thousands of them: the budget keeps a query around a millisecond.
+const size_t NAME_FUZZY_MAX_VISITS = 1024;
+
+struct NameEntry_t {
+    uint64_t    head;       // first 8 bytes of `key`, big endian: most comparisons stop here
+    const char* key;        // case-folded name
+    Node_t*     leaf;       // NULL - removed, dropped on the next merge
+};
+
+// Leaf names in case-folded byte order, which is code point order. The sorted array is an
+// implicit trie: a prefix is a range found by binary search, and the fuzzy search walks it
+// depth first, sharing edit distance rows between neighbours with a common prefix.
+// Built on the first query; until then inserts and removals are not tracked.
+struct NameIndex_t {
+    bool built;
+
+    NameEntry_t* entries;
+    size_t       sorted;        // entries[ 0, sorted ) are in order, the rest is the tail
+    size_t       count;
+    size_t       capacity;
+    size_t       removed;
+
+    StringChunk_t* chunks;      // keys of the sorted part in order, folded copies of tail names
+
+    char*  fold_buffer;
+    size_t fold_capacity;
+};
+
+struct NameMatch_t {
+    Node_t*  leaf;
+    uint32_t distance;
+};
+
+void NameIndexCtor( NameIndex_t* index );
+void NameIndexDtor( NameIndex_t* index );
+
+void NameIndexBuild( NameIndex_t* index, Node_t* root, size_t leaves );
+void NameIndexInsert( NameIndex_t* index, Node_t* leaf );
+void NameIndexRemove( NameIndex_t* index, const Node_t* node );
+void NameIndexReplace( NameIndex_t* index, const Node_t* old, Node_t* node );
+
+size_t NameIndexComplete( NameIndex_t* index, const char* prefix,
+                          NameMatch_t* matches, size_t max_matches );
+size_t NameIndexFuzzy( NameIndex_t* index, const char* name, uint32_t max_distance,
+                       NameMatch_t* matches, size_t max_matches );
+
+#endif//NAMEINDEX_H
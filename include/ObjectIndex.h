@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef OBJECTINDEX_H
+#define OBJECTINDEX_H
+
+struct Node_t;
+
+// Leaves of a tree by case-folded name (see Utf8NextFolded). Open addressing with linear
+// probing; leaves with equal names all stay in the table, the one indexed first is found.
+struct ObjectIndex_t {
+    Node_t**  slot_nodes;       // NULL - empty slot
+    uint32_t* slot_hashes;
+    size_t    capacity;
+    size_t    count;
+
+    bool built;                 // until then inserts and removals are skipped, see TreeObjectIndex
+};
+
+void ObjectIndexCtor( ObjectIndex_t* index );
+void ObjectIndexDtor( ObjectIndex_t* index );
+
+void    ObjectIndexBuild( ObjectIndex_t* index, Node_t* root );
+void    ObjectIndexInsert( ObjectIndex_t* index, Node_t* leaf );
+void    ObjectIndexRemove( ObjectIndex_t* index, const Node_t* node );
+void    ObjectIndexReplace( ObjectIndex_t* index, const Node_t* old, Node_t* node );
+Node_t* ObjectIndexFind( const ObjectIndex_t* index, const char* name );
+
+#endif//OBJECTINDEX_H
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef SPEECH_H
+#define SPEECH_H
+
+#include <pthread.h>
+#include <sys/types.h>
+
+// Utterances known to the threads: the queued ones and guesses at what comes next
+const size_t SPEECH_CLIPS = 16;
+
+// Utterances waiting to be played; a full queue drops the oldest
+const size_t SPEECH_QUEUE = 8;
+
+const char* const SPEECH_CACHE_DIRECTORY = "speech-cache";
+
+// Past this size the least recently used files go until the cache is 3/4 of it
+const uint64_t SPEECH_CACHE_LIMIT = 64ull * 1024 * 1024;
+
+struct SpeechClip_t {
+    char*    text;              // NULL - a free clip
+    uint64_t key;               // cache file name, see SpeechCacheKey
+    uint64_t used;              // request clock, the least recently asked clip goes first
+    bool     ready;             // in the cache
+    bool     failed;
+    bool     busy;              // being rendered or played, never evicted
+};
+
+// Speech off the game loop. SpeechSay queues an utterance and returns at once; a synthesizer
+// thread renders texts with espeak into WAV files of the cache, queued ones first and
+// prefetched ones after, and a player thread plays them with aplay. Both are spawned without
+// a shell, and the text reaches espeak through its stdin, never as an argument.
+//
+// The cache outlives the process: a text said before is played from its file at once.
+struct Speech_t {
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+    pthread_t       synthesizer;
+    pthread_t       player;
+
+    SpeechClip_t clips[ SPEECH_CLIPS ];
+    uint64_t     clock;
+
+    char*  queue[ SPEECH_QUEUE ];
+    size_t queue_start;
+    size_t queue_size;
+
+    char*    directory;
+    uint64_t cache_size;        // bytes of finished files
+    bool     trimming;
+
+    uint64_t generation;        // bumps on SpeechCancel: whatever plays is stale
+    pid_t    playing;           // aplay of the current utterance, 0 - silence
+    bool     unavailable;       // espeak or aplay is missing, requests are dropped
+    bool     stopping;
+};
+
+// `directory` is created if needed
+Speech_t* SpeechCtor( const char* directory );
+void      SpeechDtor( Speech_t** speech );
+
+void SpeechSay( Speech_t* speech, const char* text );
+
+// Renders `text` ahead, so saying it later starts at once
+void SpeechPrefetch( Speech_t* speech, const char* text );
+
+// Drops the queue and stops the utterance playing: the player has answered already
+void SpeechCancel( Speech_t* speech );
+
+// Renders `text` into the cache on the calling thread, from any thread; false if the
+// synthesizer failed or is missing
+bool SpeechRender( Speech_t* speech, const char* text );
+
+// Hash of the text and of everything else the synthesizer is given: a change of voice
+// renders everything anew
+uint64_t SpeechCacheKey( const char* text );
+
+#endif//SPEECH_H
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+const size_t STRING_CHUNK_SIZE = 64 * 1024;
+
+struct StringChunk_t {
+    StringChunk_t* next;
+
+    char*  data;
+    size_t used;
+    size_t capacity;
+};
+
+// Every node value lives here or in storage owned by the same tree (the base buffer),
+// once per distinct text: equal values are equal pointers. Interned strings are shared
+// and must never be modified.
+struct StringPool_t {
+    StringChunk_t* chunks;
+
+    char**    slot_strings;     // open addressing, NULL - empty slot
+    uint32_t* slot_hashes;
+    size_t    capacity;
+    size_t    count;
+
+    size_t stored_bytes;    // copied into chunks
+    size_t shared_bytes;    // referenced in place
+
+    char*  table;           // shared as a whole, hashed only when the pool is first searched
+    size_t table_size;
+};
+
+void StringPoolCtor( StringPool_t* pool );
+void StringPoolDtor( StringPool_t* pool );
+
+void  StringPoolReserve( StringPool_t* pool, size_t count );
+
+char* StringPoolIntern( StringPool_t* pool, const char* string, size_t length );
+char* StringPoolInternInPlace( StringPool_t* pool, char* string, size_t length );
+char* StringPoolFind( StringPool_t* pool, const char* string, size_t length );
+
+// '\0'-terminated strings, each one distinct, living as long as the pool: every one of them
+// is interned as it is, at no cost until the first StringPoolIntern / StringPoolFind
+void StringPoolShareTable( StringPool_t* pool, char* table, size_t table_size );
+
+#endif//STRINGPOOL_H
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <pthread.h>
+
+#include <atomic>
+
+// Per-worker deque size; a spawn into a full deque fails and the caller runs the work itself
+const size_t TASK_DEQUE_CAPACITY = 4096;
+
+const size_t TASK_POOL_MAX_THREADS = 256;
+
+// Intrusive task header: embed it first in the caller's task, which owns the memory.
+// `worker` is the index of the thread running it, for per-worker state.
+struct Task_t {
+    void (*run)( Task_t* task, size_t worker );
+};
+
+// Chase-Lev deque: the owner pushes and pops at `bottom`, thieves take from `top`
+struct alignas( 64 ) TaskWorker_t {
+    std::atomic<int64_t> top;
+    std::atomic<int64_t> bottom;
+    std::atomic<Task_t*> tasks[ TASK_DEQUE_CAPACITY ];
+
+    uint64_t random;            // victim choice when stealing
+};
+
+// Fork-join pool: TaskPoolRun executes a task and everything it spawns, the calling thread
+// is worker 0. Helper threads sleep between runs; runs from different threads are serialized.
+struct TaskPool_t {
+    size_t        threads;
+    TaskWorker_t* workers;
+    pthread_t*    handles;
+
+    std::atomic<size_t> pending;        // spawned and not finished in the current run
+    std::atomic<size_t> searching;      // workers out of work, looking for some to steal
+
+    pthread_mutex_t run_lock;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    pthread_cond_t  done;
+    uint64_t        generation;
+    size_t          active;             // helpers still inside the current run
+    bool            stopping;
+};
+
+TaskPool_t* TaskPoolCtor( size_t threads );
+void        TaskPoolDtor( TaskPool_t** pool );
+
+// Created on first use with AKINATOR_THREADS threads, or one per online CPU
+TaskPool_t* TaskPoolShared();
+
+void TaskPoolRun( TaskPool_t* pool, Task_t* task );
+bool TaskPoolSpawn( TaskPool_t* pool, size_t worker, Task_t* task );
+
+// True when another worker is idle and would steal work pushed by `worker` now
+bool TaskPoolHungry( TaskPool_t* pool, size_t worker );
+
+#endif//TASKPOOL_H
@@ -3,6 +3,13 @@
 #ifndef TREE_H
 #define TREE_H
 
+#include "StringPool.h"
+#include "ObjectIndex.h"
+#include "NameIndex.h"
+#include "CompactTree.h"
+#include "TreeRcu.h"
+#include "TreeRender.h"
+
 #ifdef _LINUX
 #include <linux/limits.h>
 const size_t MAX_LEN_PATH = PATH_MAX;
@@ -19,46 +26,170 @@ struct Node_t {
     Node_t* left;
 
     Node_t* parent;
+
+    // Skew-binary jump pointer: an ancestor whose depth depends only on `depth`, so level
+    // ancestors and common ancestors are found in O(log depth) steps (see NodeLink)
+    Node_t*  jump;
+    uint32_t depth;
+    uint32_t slot;              // place in Tree_t::compact while that is built
+    uint32_t leaves;            // objects in the subtree, the writer's: see TreeDumpAround
+
+    // Play telemetry, see TreeTelemetry.h
+    uint32_t visits;            // games that reached the node
+    uint32_t guessed;           // games that ended here with a right guess
+    uint32_t missed;            // games that ended here with a wrong one
+};
+
+const size_t NODE_SLAB_SIZE = 4096;
+
+struct NodeSlab_t {
+    NodeSlab_t* next;
+
+    Node_t* nodes;
+    size_t  used;
+    size_t  capacity;
+};
+
+// Every node of a tree comes from here; freed nodes (value == NULL) are chained through `right`
+struct NodeArena_t {
+    NodeSlab_t* slabs;
+    Node_t*     free_list;
+    size_t      live;
+};
+
+enum BaseFormat_t {
+    BASE_TEXT   = 0,
+    BASE_BINARY = 1
 };
 
 struct Tree_t {
     Node_t* root;
 
+    NodeArena_t  arena;
+    StringPool_t strings;
+    ObjectIndex_t objects;
+    NameIndex_t   names;
+    CompactTree_t compact;
+
+    // Readers in other threads walk `root`, `left` and `right` while TreeSplitLeaf inserts, see
+    // NodeLeft. The indexes, the compact copy and the arena belong to the writer.
+    TreeRcu_t rcu;
+
     char* buffer;
     char* current_position;
     off_t buffer_size;
+    bool  buffer_is_mapped;
 
-    #ifdef _DEBUG
-        struct Log_t {
-            FILE* log_file;
-            char* log_path;
-            char* img_log_path;
-        } logging;
+    BaseFormat_t base_format;
+
+    // The HTML log and its pictures, all of it made by the first dump: see TreeLogFile
+    struct Log_t {
+        FILE* log_file;
+        char* log_path;
+        char* img_log_path;
+    } logging;
+
+    size_t image_number;
+
+    // TreeDump renders in the background and not at all if the picture would not change
+    TreeRender_t* render;   // started by the first dump
+    uint64_t      image_hash;
+    size_t        last_image;   // picture of the last dump, valid with `has_image`
+    bool          has_image;
+    bool          image_svg;    // false - only the DOT file, Graphviz is missing
+};
 
-        size_t image_number;
-    #endif
+// Whole-tree walks, see TreeWalk.h
+struct TreeStats_t {
+    size_t nodes;
+    size_t objects;
+    size_t max_depth;
+    size_t object_depth_sum;    // questions asked to reach every object once
+    size_t text_bytes;
 };
 
+// Below this many nodes saving stays a sequential, streaming walk
+const size_t TREE_PARALLEL_MIN_NODES = 1 << 16;
+
+// Above this many nodes DOT text is streamed on one thread: the parallel walk keeps all of it
+// until the drain, about a kilobyte a node
+const size_t TREE_DOT_PARALLEL_MAX_NODES = 1 << 18;
+
 enum TreeStatus_t {
     SUCCESS = 0,
     FAIL    = 1
 };
 
+enum TreeLoadMode_t {
+    LOAD_READ = 0,
+    LOAD_MMAP = 1
+};
+
 enum DirectionType {
     RIGHT = 0,
     LEFT  = 1
 };
 
 Tree_t*      TreeCtor();
-TreeStatus_t TreeDtor( Tree_t** tree, void ( *clean_function ) ( char* value, Tree_t* tree ) );
+TreeStatus_t TreeDtor( Tree_t** tree );
+
+TreeStatus_t TreeSaveToFile( const Tree_t* tree, const char* filename );
+TreeStatus_t TreeReadFromFile( Tree_t* tree, const char* filename, TreeLoadMode_t mode );
+TreeStatus_t TreeReadFromStream( Tree_t* tree, int fd, const char* source_name );
+
+Node_t* NodeCreate( Tree_t* tree, const TreeData_t field, Node_t* parent );
+void    NodeFree( Tree_t* tree, Node_t* node );
+void    TreeReserveNodes( Tree_t* tree, size_t count );
+// Frees at once: only for trees no other thread reads
+TreeStatus_t NodeDelete( Node_t* node, Tree_t* tree );
+
+// Copy-update: the question, the object and a copy of `leaf` are built off to the side and
+// published with one store, `leaf` itself is retired unchanged. The copy is the question's
+// child on the side opposite the object.
+Node_t*      TreeSplitLeaf( Tree_t* tree, Node_t* leaf, const char* question, const char* object, bool object_is_left );
+
+// Links as a reader in a TreeRcuReadBegin section sees them: a subtree published by
+// TreeSplitLeaf is seen whole, with every field written, or not at all
+inline Node_t* NodeLeft( const Node_t* node ) {
+    return __atomic_load_n( &( node->left ), __ATOMIC_ACQUIRE );
+}
 
-void TreeSaveToFile( const Tree_t* tree, const char* filename );
-void TreeReadFromFile( Tree_t* tree );
+inline Node_t* NodeRight( const Node_t* node ) {
+    return __atomic_load_n( &( node->right ), __ATOMIC_ACQUIRE );
+}
 
-Node_t* NodeCreate( const TreeData_t field, Node_t* parent );
-TreeStatus_t NodeDelete( Node_t* node, Tree_t* tree, void ( *clean_function ) ( char* value, Tree_t* tree ) );
+inline Node_t* TreeRoot( const Tree_t* tree ) {
+    return __atomic_load_n( &( tree->root ), __ATOMIC_ACQUIRE );
+}
+
+void          NodeLink( Node_t* node );
+const Node_t* NodeAncestorAtDepth( const Node_t* node, size_t depth );
+const Node_t* NodeCommonAncestor( const Node_t* first, const Node_t* second );
+size_t        NodePathFrom( const Node_t* ancestor, const Node_t* node, const Node_t** path );
+
+Node_t* TreeFirstLeaf( Node_t* node );
+Node_t* TreeNextLeaf( Node_t* root, Node_t* leaf );
+
+const ObjectIndex_t* TreeObjectIndex( Tree_t* tree );
+NameIndex_t*         TreeNameIndex( Tree_t* tree );
+const CompactTree_t* TreeCompactTree( Tree_t* tree );
+
+void          TreeCollectStats( const Tree_t* tree, TreeStats_t* stats );
+const Node_t* TreeFindLeaf( const Tree_t* tree, bool ( *match )( const Node_t* leaf, void* argument ), void* argument );
+
+// "dump/index.html", created with "dump/images" on the first call
+FILE* TreeLogFile( Tree_t* tree );
 
 void TreeDump( Tree_t* tree, const char* format_string, ... );
-void NodeGraphicDump( const Node_t* node, const char* image_path_name, ... );
+
+// Only the neighbourhood of `focus`: its ancestors up to the root and `levels` levels below
+// it. Subtrees hanging off the window are folded into one box with their object count, so a
+// dump costs O(depth + 2^levels) whatever the size of the tree.
+void TreeDumpAround( Tree_t* tree, const Node_t* focus, size_t levels, const char* format_string, ... );
+
+// Writes the DOT file and has `render` lay it out into "<file>.svg"; NULL - on this thread
+void NodeGraphicDump( TreeRender_t* render, const Node_t* node, const char* image_path_name, ... );
+// The DOT file only, nothing is laid out
+void NodeDotWrite( const Node_t* node, const char* dot_path );
 
 #endif//TREE_H
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREEBEAM_H
+#define TREEBEAM_H
+
+#include "Tree.h"
+
+// Candidates kept between questions: the lightest go first, so one question costs
+// O(BEAM_WIDTH^2) however large the tree is
+const size_t BEAM_WIDTH = 64;
+
+// Candidates lighter than this share of the frontier are dropped
+const double BEAM_MIN_SHARE = 1e-4;
+
+// Wrong guesses in one round before giving up
+const size_t BEAM_MAX_GUESSES = 3;
+
+// Share of the "yes" branch after an answer; firm answers cut the other branch off
+const double BEAM_YES          = 1.0;
+const double BEAM_PROBABLY     = 0.8;
+const double BEAM_DONT_KNOW    = 0.5;
+const double BEAM_PROBABLY_NOT = 0.2;
+const double BEAM_NO           = 0.0;
+
+// A subtree of the compact tree the object may be in
+struct BeamEntry_t {
+    uint32_t    slot;
+    bool        certain;        // reached by firm answers only
+    const char* question;       // interned text of the question, NULL for an object
+    double      weight;
+};
+
+struct BeamAnswer_t {
+    const char* question;       // interned value, shared by every node asking the same
+    double      yes_share;
+};
+
+// Weighted frontier of one round. Answering a question splits every candidate that asks
+// it; a candidate not asking it is halved, as either answer is as likely for it.
+// Children split their parent's weight in proportion to the games played through them.
+struct Beam_t {
+    const CompactTree_t* compact;
+
+    BeamEntry_t* entries;
+    size_t       size;
+
+    BeamAnswer_t* answers;      // answers so far, the same text is not asked twice
+    size_t        answer_count;
+    size_t        answer_capacity;
+
+    bool counting;              // answers count visits; false in copies, which only look ahead
+};
+
+void BeamCtor( Beam_t* beam, const CompactTree_t* compact );
+void BeamDtor( Beam_t* beam );
+// A copy does not count visits: answers tried on it were never given
+void BeamCopy( Beam_t* copy, const Beam_t* beam );
+
+bool   BeamNextQuestion( Beam_t* beam, uint32_t* question );
+void   BeamAnswer( Beam_t* beam, uint32_t question, double yes_share );
+size_t BeamBestGuess( const Beam_t* beam );
+void   BeamDrop( Beam_t* beam, size_t entry );
+
+// A candidate object split by TreeSplitLeaf since keeps its slot, now holding the new
+// question: its entry becomes that question with both objects under it
+void   BeamRefresh( Beam_t* beam );
+
+#endif//TREEBEAM_H
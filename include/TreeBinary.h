@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREEBINARY_H
+#define TREEBINARY_H
+
+#include "Tree.h"
+
+const char     BINARY_BASE_MAGIC[ 4 ] = { 'A', 'K', 'N', 'B' };
+const uint32_t BINARY_BASE_VERSION    = 1;
+
+const uint32_t BINARY_NODE_HAS_LEFT = 0x80000000u;  // left child, if any, is always the next node
+const uint32_t BINARY_NODE_NIL      = 0x7FFFFFFFu;  // no right child
+
+// Layout: header, `node_count` nodes in preorder, string table of '\0'-terminated values.
+// All fields are in host byte order.
+struct BinaryBaseHeader_t {
+    char     magic[ 4 ];
+    uint32_t version;
+    uint32_t node_count;
+    uint32_t reserved;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct BinaryBaseNode_t {
+    uint32_t value;     // offset in the string table
+    uint32_t right;     // BINARY_NODE_HAS_LEFT | index of the right child or BINARY_NODE_NIL
+};
+
+bool         BinaryBaseDetect( const char* buffer, off_t size );
+TreeStatus_t TreeReadFromBinary( Tree_t* tree, const char* source_name );
+TreeStatus_t TreeSaveToBinaryFile( const Tree_t* tree, const char* filename );
+
+#endif//TREEBINARY_H
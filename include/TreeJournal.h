@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREEJOURNAL_H
+#define TREEJOURNAL_H
+
+#include "Tree.h"
+
+const char     JOURNAL_MAGIC[ 4 ] = { 'A', 'K', 'N', 'J' };
+const uint32_t JOURNAL_VERSION    = 1;
+
+// The journal is folded into the base once it outgrows max( JOURNAL_MIN_COMPACT_SIZE, base / 4 ),
+// so rewriting the base costs O(1) amortized per record
+const off_t JOURNAL_MIN_COMPACT_SIZE = 64 * 1024;
+
+// Identifies the exact base file the records were made against. A journal whose base was
+// rewritten since (compaction, save, manual edit) no longer applies and is dropped.
+struct JournalHeader_t {
+    char     magic[ 4 ];
+    uint32_t version;
+    uint64_t base_device;
+    uint64_t base_inode;
+    uint64_t base_size;
+    int64_t  base_mtime_ns;
+};
+
+// A record is { uint32_t payload size, uint32_t crc32 of the payload } followed by the payload:
+// JournalRecord_t, `depth` path bits from the root (1 - left), question and object text.
+struct JournalRecord_t {
+    uint32_t depth;
+    uint32_t question_length;
+    uint32_t object_length;
+    uint8_t  object_is_left;
+    uint8_t  reserved[ 3 ];
+};
+
+struct TreeJournal_t {
+    char* path;
+    int   fd;                   // -1 until the first record of a fresh journal
+
+    JournalHeader_t base;       // the base file as it was loaded
+
+    off_t  size;
+    off_t  session_start;       // records after it were made by this process
+    size_t replayed;
+};
+
+TreeStatus_t TreeJournalOpen( TreeJournal_t* journal, Tree_t* tree, const char* base_path );
+void         TreeJournalClose( TreeJournal_t* journal );
+
+TreeStatus_t TreeJournalAppend( TreeJournal_t* journal, const Node_t* leaf,
+                                const char* question, const char* object, bool object_is_left );
+
+bool         TreeJournalNeedsCompaction( const TreeJournal_t* journal );
+TreeStatus_t TreeJournalCompact( TreeJournal_t* journal, const Tree_t* tree, const char* base_path );
+void         TreeJournalRollback( TreeJournal_t* journal );
+
+#endif//TREEJOURNAL_H
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREEPARSER_H
+#define TREEPARSER_H
+
+#include "Tree.h"
+
+const size_t TREE_PARSER_CHUNK_SIZE = 64 * 1024;
+
+enum ParserState_t {
+    PARSE_CHILD       = 0,  // '(' or nil
+    PARSE_NIL         = 1,  // rest of "nil"
+    PARSE_VALUE_START = 2,  // optional "value" after '('
+    PARSE_VALUE       = 3,  // inside "value"
+    PARSE_CLOSE       = 4,  // ')' after both children
+    PARSE_END         = 5   // only spaces after the root
+};
+
+struct TreeParser_t {
+    Tree_t* tree;
+    const char* source_name;
+
+    Node_t* root;
+    Node_t* current;            // innermost node whose ')' has not been read yet
+    ParserState_t state;
+
+    uint64_t* slots;            // one bit per open level: 0 - left child is read now, 1 - right
+    size_t    slots_capacity;   // in 64-bit words
+    size_t    depth;
+
+    char*       value_start;    // value lying in the current in-place chunk
+    char*       value;          // value split between chunks
+    size_t      value_length;
+    size_t      value_capacity;
+
+    size_t nil_matched;
+    size_t nil_next;            // offset where the next letter of "nil" must be
+
+    uint32_t* tokens;           // offsets of structural symbols in the current window
+    bool      in_string;
+
+    size_t line;
+    size_t column;
+    size_t consumed;
+
+    bool        error;
+    const char* error_message;
+    int         error_symbol;
+};
+
+TreeParser_t* TreeParserCtor( Tree_t* tree, const char* source_name );
+void          TreeParserDtor( TreeParser_t** parser );
+
+TreeStatus_t TreeParserFeed( TreeParser_t* parser, char* chunk, size_t length, bool in_place );
+TreeStatus_t TreeParserFinish( TreeParser_t* parser );
+
+#endif//TREEPARSER_H
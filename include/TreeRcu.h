@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREERCU_H
+#define TREERCU_H
+
+#include <pthread.h>
+
+struct Node_t;
+
+// Threads that may be inside read-side sections at once
+const size_t RCU_MAX_READERS = 256;
+
+// A node retired in epoch e is freed once the epoch reaches e + 2: by then every reader has
+// left the sections that could have reached it
+const size_t RCU_EPOCHS = 3;
+
+struct alignas( 64 ) RcuReader_t {
+    uint64_t epoch;             // the epoch seen on entering a section, 0 - outside any
+    uint32_t claimed;
+};
+
+struct RcuRetired_t {
+    Node_t** nodes;
+    size_t   count;
+    size_t   capacity;
+};
+
+// Epoch-based reclamation for the pointer tree. Readers never wait: entering a section is
+// one store and one fence into their own cache line. Writers serialize on `writer`, publish
+// finished nodes with one release store and retire the nodes they unlinked; each write tries
+// to move the epoch on, which frees what was retired two epochs ago.
+struct TreeRcu_t {
+    uint64_t     epoch;
+    RcuReader_t* readers;       // RCU_MAX_READERS slots
+
+    pthread_mutex_t writer;
+
+    RcuRetired_t retired[ RCU_EPOCHS ];
+};
+
+void TreeRcuCtor( TreeRcu_t* rcu );
+void TreeRcuDtor( TreeRcu_t* rcu );
+
+// A slot per reading thread, kept for as many sections as it likes
+size_t TreeRcuRegisterReader( const TreeRcu_t* rcu );
+void   TreeRcuUnregisterReader( const TreeRcu_t* rcu, size_t reader );
+
+// Nodes reached inside a section stay valid until it ends; links are read with NodeLeft,
+// NodeRight and TreeRoot. Sections do not nest.
+inline void TreeRcuReadBegin( const TreeRcu_t* rcu, size_t reader ) {
+    __atomic_store_n( &( rcu->readers[ reader ].epoch ), __atomic_load_n( &( rcu->epoch ), __ATOMIC_RELAXED ), __ATOMIC_RELEASE );
+
+    // The announcement is seen by a writer before this reader reads a link it may unlink
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+}
+
+inline void TreeRcuReadEnd( const TreeRcu_t* rcu, size_t reader ) {
+    __atomic_store_n( &( rcu->readers[ reader ].epoch ), 0, __ATOMIC_RELEASE );
+}
+
+void TreeRcuWriteBegin( TreeRcu_t* rcu );
+void TreeRcuWriteEnd( TreeRcu_t* rcu );
+
+// Writer only: `node` is unlinked already, readers inside may still hold it
+void   TreeRcuRetire( TreeRcu_t* rcu, Node_t* node );
+
+// Writer only: moves the epoch on if every reader inside has seen the current one, and
+// returns the nodes no reader can hold any more; the caller frees them before the next call
+size_t TreeRcuCollect( TreeRcu_t* rcu, Node_t*** reclaimable );
+
+#endif//TREERCU_H
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREERENDER_H
+#define TREERENDER_H
+
+#include <pthread.h>
+
+struct TreeSvgLayout_t;
+
+// Layouts running at once: `dot` on a large tree takes a core and a lot of memory
+const size_t TREE_RENDER_MAX_WORKERS = 4;
+
+struct TreeRenderJob_t {
+    char*            dot_path;  // laid out by `dot`
+    TreeSvgLayout_t* layout;    // laid out already, only written; both NULL - only opened
+    char*            svg_path;  // NULL - a free place
+    bool             open;      // shown once rendered
+};
+
+// Tree pictures off the game loop. TreeRenderQueue takes a DOT file already written and
+// returns at once; workers spawn `dot` on queued files in order, several at a time, without
+// a shell. If `dot` is missing DOT files are dropped, TreeRenderHasDot tells the caller to
+// queue layouts of TreeSvg instead. Without workers everything is done on the caller's thread.
+struct TreeRender_t {
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+
+    pthread_t* workers;
+    size_t     worker_count;
+
+    TreeRenderJob_t* queue;
+    size_t           queue_start;
+    size_t           queue_size;
+    size_t           queue_capacity;
+
+    TreeRenderJob_t* running;   // one per worker
+
+    bool dot_missing;
+    bool stopping;
+};
+
+// `workers` = 0 - one per online CPU, up to TREE_RENDER_MAX_WORKERS
+TreeRender_t* TreeRenderCtor( size_t workers );
+
+// Finishes what is queued first: every dump in the log gets its picture
+void TreeRenderDtor( TreeRender_t** render );
+
+void TreeRenderQueue( TreeRender_t* render, const char* dot_path, const char* svg_path );
+
+// Takes `layout` over and frees it once written
+void TreeRenderQueueLayout( TreeRender_t* render, TreeSvgLayout_t* layout, const char* svg_path );
+
+bool TreeRenderHasDot( TreeRender_t* render );
+
+// Opens the picture in the desktop's viewer once it is rendered, without waiting for it;
+// false if there is no such picture and none is coming
+bool TreeRenderOpen( TreeRender_t* render, const char* svg_path );
+
+// Blocks until nothing is queued or being rendered
+void TreeRenderWait( TreeRender_t* render );
+
+#endif//TREERENDER_H
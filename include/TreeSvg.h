@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREESVG_H
+#define TREESVG_H
+
+#include "Tree.h"
+
+// From this many nodes TreeDump lays the tree out itself: `dot` takes minutes on such trees
+const size_t TREE_SVG_MIN_NODES = 2000;
+
+// Boxes as the DOT dump draws them: the value over a "Да" cell and a "Нет" cell, the edge to
+// each child leaves from its cell
+const int64_t TREE_SVG_CHAR_WIDTH   = 8;
+const int64_t TREE_SVG_MIN_WIDTH    = 64;
+const int64_t TREE_SVG_HEADER       = 20;
+const int64_t TREE_SVG_ROW          = 18;
+const int64_t TREE_SVG_LEVEL_HEIGHT = 80;
+const int64_t TREE_SVG_GAP          = 12;       // between neighbouring boxes of a level
+const int64_t TREE_SVG_MARGIN       = 8;
+
+// A tree laid out and copied: written on any thread while the tree itself changes. Nodes are
+// numbered in preorder, so a parent comes before its children.
+struct TreeSvgLayout_t {
+    size_t count;
+    size_t capacity;
+
+    int32_t*  left;             // -1 - no child
+    int32_t*  right;
+    uint32_t* depth;
+    int64_t*  width;            // even, so a box is centred on a whole pixel
+    int64_t*  x;                // centre of the box
+    size_t*   label;            // offset in `text`
+
+    char*  text;                // every value with its '\0'
+    size_t text_size;
+    size_t text_capacity;
+
+    int64_t image_width;
+    int64_t image_height;
+};
+
+// Reingold-Tilford layout in O(nodes): subtrees are pushed apart along their contours only,
+// and threads from the bottom of a shallower subtree keep the contours walkable. Neither
+// pass recurses, any depth is fine.
+TreeSvgLayout_t* TreeSvgLayoutCtor( const Node_t* root );
+void             TreeSvgLayoutDtor( TreeSvgLayout_t** layout );
+
+// Streams the picture, one box and its edges at a time
+TreeStatus_t TreeSvgWrite( const TreeSvgLayout_t* layout, const char* svg_path );
+
+#endif//TREESVG_H
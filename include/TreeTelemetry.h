@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREETELEMETRY_H
+#define TREETELEMETRY_H
+
+#include "Tree.h"
+
+const char     TELEMETRY_MAGIC[ 4 ] = { 'A', 'K', 'N', 'S' };
+const uint32_t TELEMETRY_VERSION    = 1;
+
+const size_t TELEMETRY_TOP_SIZE       = 10;    // entries in each "most often" list of the report
+const size_t TELEMETRY_HISTOGRAM_ROWS = 16;
+const size_t TELEMETRY_PATH_SHOWN     = 8;     // questions of a hot path printed before "..."
+
+// `<base>.stats`: the header, then one record per node in preorder, the order both base
+// writers use. Written right after the base itself and bound to that exact file, like the
+// journal: counters of a base rewritten since do not fit its nodes and are dropped.
+struct TelemetryHeader_t {
+    char     magic[ 4 ];
+    uint32_t version;
+    uint64_t node_count;
+    uint64_t base_device;
+    uint64_t base_inode;
+    uint64_t base_size;
+    int64_t  base_mtime_ns;
+};
+
+struct TelemetryRecord_t {
+    uint32_t visits;
+    uint32_t guessed;
+    uint32_t missed;
+};
+
+// Relaxed atomic adds on plain fields: Node_t stays a memset-able C struct, and concurrent
+// sessions may count the same nodes. One uncontended add per answer costs nothing next to I/O.
+inline void NodeCountVisit( Node_t* node ) {
+    __atomic_fetch_add( &( node->visits ), 1u, __ATOMIC_RELAXED );
+}
+
+inline void NodeCountGuess( Node_t* node, bool guessed ) {
+    __atomic_fetch_add( guessed ? &( node->guessed ) : &( node->missed ), 1u, __ATOMIC_RELAXED );
+}
+
+// A missing, stale or unreadable file leaves the counters at zero and the game goes on;
+// returns true only when the counters came from a file matching the base
+bool         TreeTelemetryLoad( Tree_t* tree, const char* base_path );
+TreeStatus_t TreeTelemetrySave( const Tree_t* tree, const char* base_path );
+
+void TreeTelemetryReport( const Tree_t* tree, FILE* stream );
+
+#endif//TREETELEMETRY_H
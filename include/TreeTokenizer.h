@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREETOKENIZER_H
+#define TREETOKENIZER_H
+
+// Largest piece handed to TokenizeChunk, so a token array of this many entries is always enough
+const size_t TOKENIZER_WINDOW = 64 * 1024;
+
+enum TokenizerKind_t {
+    TOKENIZER_AUTO   = 0,
+    TOKENIZER_SCALAR = 1,
+    TOKENIZER_SSE2   = 2,
+    TOKENIZER_AVX2   = 3
+};
+
+// Writes the offsets of every non-space byte outside "..." and of both quotes of every
+// value, returns their number. `in_string` carries the quote state between calls.
+size_t TokenizeChunk( const char* chunk, size_t length, uint32_t* tokens, bool* in_string );
+
+void        TokenizerSelect( TokenizerKind_t kind );
+const char* TokenizerName();
+
+// Runs edge-case and random chunks, and the base at `base_path` if it is not NULL, through
+// every vector tokenizer this CPU has and the scalar one; 0 if all of them agree
+int TokenizerSelfCheck( const char* base_path );
+
+#endif//TREETOKENIZER_H
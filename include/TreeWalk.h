@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TREEWALK_H
+#define TREEWALK_H
+
+#include <stdarg.h>
+
+#include <atomic>
+
+#include "Tree.h"
+#include "TaskPool.h"
+
+// A task walks at least this many nodes before it offers part of its subtree to idle workers,
+// so subtrees below it are never split and the spawn overhead stays under 1 / TREE_WALK_CUTOFF
+const size_t TREE_WALK_CUTOFF = 4096;
+
+struct TreeWalk_t;
+struct TreeWalkTask_t;
+
+struct TreeWalkCursor_t {
+    TreeWalk_t*     walk;
+    size_t          worker;     // index for per-worker accumulators, < walk->pool->threads
+    TreeWalkTask_t* task;       // receives TreeWalkEmit output
+};
+
+// `enter` sees every node before its children (false stops the whole walk),
+// `leave` after them. Both run concurrently on different subtrees.
+typedef bool (*TreeWalkEnter_t)( TreeWalkCursor_t* cursor, const Node_t* node );
+typedef void (*TreeWalkLeave_t)( TreeWalkCursor_t* cursor, const Node_t* node );
+
+typedef void (*TreeWalkSink_t)( void* argument, const char* data, size_t length );
+
+// Preorder walk split into tasks of the pool. A task keeps its pending subtrees on an explicit
+// stack, so list-shaped trees of any depth are fine, and gives the topmost (largest) of them
+// away only when a worker is idle. With `ordered` the text emitted by the callbacks is kept
+// in preorder across tasks and read back with TreeWalkDrain.
+struct TreeWalk_t {
+    TreeWalkEnter_t enter;
+    TreeWalkLeave_t leave;      // NULL - not needed
+    void*           data;
+    bool            ordered;
+
+    TaskPool_t* pool;
+
+    const TreeRcu_t* rcu;       // NULL - nothing inserts into the tree during the walk
+
+    std::atomic<bool>            stopped;
+    std::atomic<TreeWalkTask_t*> tasks;     // every task of the walk, freed by TreeWalkFree
+    TreeWalkTask_t*              root_task;
+};
+
+void TreeWalkRun( TreeWalk_t* walk, const Node_t* root );
+
+void TreeWalkEmit( TreeWalkCursor_t* cursor, const char* data, size_t length );
+void TreeWalkPrintf( TreeWalkCursor_t* cursor, const char* format, ... ) __attribute__(( format( printf, 2, 3 ) ));
+void TreeWalkVPrintf( TreeWalkCursor_t* cursor, const char* format, va_list args ) __attribute__(( format( printf, 2, 0 ) ));
+
+void TreeWalkDrain( const TreeWalk_t* walk, TreeWalkSink_t sink, void* argument );
+void TreeWalkFree( TreeWalk_t* walk );
+
+#endif//TREEWALK_H
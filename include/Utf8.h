@@ -0,0 +1,19 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef UTF8_H
+#define UTF8_H
+
+// Decodes the next code point of `*text`, advances past it and returns it case-folded
+// (Latin, Latin-1 and Cyrillic capitals become small letters). Returns 0 at the end.
+// A byte that does not start a valid sequence is returned as is.
+uint32_t Utf8NextFolded( const char** text );
+
+// Folding keeps the length of every sequence, so `folded` needs strlen( text ) + 1 bytes.
+// Returns true if anything changed.
+bool     Utf8Fold( const char* text, char* folded );
+
+uint32_t Utf8FoldedHash( const char* text );
+bool     Utf8FoldedEqual( const char* first, const char* second );
+
+#endif//UTF8_H
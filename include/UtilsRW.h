@@ -1,4 +1,6 @@
+#include <stddef.h>
 #include <sys/stat.h>
+#include <sys/types.h>
 
 #ifndef UTILSRW_H
 #define UTILSRW_H
@@ -6,4 +8,38 @@
 int MakeDirectory( const char* path );
 off_t DetermineTheFileSize( const char* file_name );
 
-#endif
\ No newline at end of file
+char* MapFileToMemory( const char* file_name, off_t* file_size );
+void  UnmapFile( char* buffer, off_t file_size );
+
+int  WriteAll( int fd, const char* data, size_t size );
+int  OpenTemporaryFile( const char* file_name, char* temporary_name, size_t size );
+int  SyncDirectoryOf( const char* file_name );
+int  CommitTemporaryFile( int fd, const char* temporary_name, const char* file_name );
+void DiscardTemporaryFile( int fd, const char* temporary_name );
+
+// Text built up in memory and written out whole: batch results, server replies
+struct OutputBuffer_t {
+    char*  data;
+    size_t size;
+    size_t capacity;
+};
+
+const size_t OUTPUT_BUFFER_INITIAL_SIZE = 4096;
+
+void AppendBytes( OutputBuffer_t* output, const char* data, size_t length );
+void AppendText( OutputBuffer_t* output, const char* text );
+
+// JSON string: UTF-8 passes through, quotes, backslashes and control characters are escaped
+void AppendJsonString( OutputBuffer_t* output, const char* text );
+
+// In-place split on tabs, returns the number of fields; max_fields + 1 - there are more
+size_t SplitFields( char* line, char** fields, size_t max_fields );
+
+// Runs arguments[0] from PATH without a shell, -1 if it cannot be started; `input` and
+// `output` become its stdin and stdout, -1 - /dev/null, and its stderr is dropped
+pid_t SpawnProcess( const char* const* arguments, int input, int output );
+
+// Exit status of the child, -1 if a signal ended it; `options` - extra waitid flags
+int   WaitProcess( pid_t pid, int options );
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "CompactTree.h"
+#include "Tree.h"
+#include "DebugUtils.h"
+
+// Roots of the subtrees hanging below the part laid out so far, left to right
+struct LayoutFrontier_t {
+    Node_t** nodes;
+    size_t   size;
+    size_t   capacity;
+};
+
+void CompactTreeCtor( CompactTree_t* compact ) {
+    my_assert( compact, "Null pointer on `compact`" );
+
+    memset( compact, 0, sizeof( *compact ) );
+}
+
+void CompactTreeDtor( CompactTree_t* compact ) {
+    my_assert( compact, "Null pointer on `compact`" );
+
+    free( compact->nodes );
+    free( compact->origin );
+    free( compact->text );
+
+    memset( compact, 0, sizeof( *compact ) );
+}
+
+static void ReserveSlots( CompactTree_t* compact, size_t count ) {
+    if ( count <= compact->capacity )
+        return;
+
+    assert( count <= UINT32_MAX && "Too many nodes for 32-bit slots" );
+
+    size_t capacity = compact->capacity ? compact->capacity : 64;
+    while ( capacity < count )
+        capacity *= 2;
+    if ( capacity > UINT32_MAX )
+        capacity = UINT32_MAX;
+
+    compact->nodes  = ( CompactNode_t* ) realloc ( compact->nodes,  capacity * sizeof( CompactNode_t ) );
+    compact->origin = ( Node_t** )       realloc ( compact->origin, capacity * sizeof( Node_t* ) );
+    assert( compact->nodes && compact->origin && "Memory allocation error" );
+
+    compact->capacity = ( uint32_t ) capacity;
+}
+
+static uint32_t AppendValue( CompactTree_t* compact, const char* value ) {
+    if ( !value )
+        value = "";
+
+    size_t length = strlen( value ) + 1;
+
+    if ( compact->text_size + length > compact->text_capacity ) {
+        size_t capacity = compact->text_capacity ? compact->text_capacity : 4096;
+        while ( capacity < compact->text_size + length )
+            capacity *= 2;
+
+        compact->text = ( char* ) realloc ( compact->text, capacity );
+        assert( compact->text && "Memory allocation error" );
+        compact->text_capacity = capacity;
+    }
+
+    assert( compact->text_size <= UINT32_MAX && "Too much text for 32-bit offsets" );
+
+    uint32_t offset = ( uint32_t ) compact->text_size;
+
+    memcpy( compact->text + compact->text_size, value, length );
+    compact->text_size += length;
+
+    return offset;
+}
+
+static uint32_t PlaceNode( CompactTree_t* compact, Node_t* node ) {
+    uint32_t slot = compact->count++;
+
+    node->slot = slot;
+    compact->origin[ slot ] = node;
+    compact->nodes[ slot ].text = AppendValue( compact, node->value );
+
+    return slot;
+}
+
+static void PushFrontier( LayoutFrontier_t* frontier, Node_t* node ) {
+    if ( frontier->size == frontier->capacity ) {
+        frontier->capacity = frontier->capacity ? 2 * frontier->capacity : 64;
+        frontier->nodes    = ( Node_t** ) realloc ( frontier->nodes, frontier->capacity * sizeof( Node_t* ) );
+        assert( frontier->nodes && "Memory allocation error" );
+    }
+
+    frontier->nodes[ frontier->size++ ] = node;
+}
+
+// Lays out the first `levels` levels under `root` and leaves the roots below them on the
+// frontier. Recursion depth is log2 of the height, so list-shaped trees are fine.
+static void LayOut( CompactTree_t* compact, LayoutFrontier_t* frontier, Node_t* root, size_t levels ) {
+    if ( levels == 1 ) {
+        PlaceNode( compact, root );
+
+        if ( root->left )
+            PushFrontier( frontier, root->left );
+        if ( root->right )
+            PushFrontier( frontier, root->right );
+        return;
+    }
+
+    size_t top  = levels / 2;
+    size_t mark = frontier->size;
+
+    LayOut( compact, frontier, root, top );
+
+    size_t bottom_roots = frontier->size;
+    for ( size_t idx = mark; idx < bottom_roots; idx++ )
+        LayOut( compact, frontier, frontier->nodes[ idx ], levels - top );
+
+    // The roots below the bottom halves replace the ones just laid out
+    size_t below = frontier->size - bottom_roots;
+    memmove( frontier->nodes + mark, frontier->nodes + bottom_roots, below * sizeof( Node_t* ) );
+    frontier->size = mark + below;
+}
+
+// Preorder over the parent links: node count and height of the subtree
+static size_t MeasureSubtree( const Node_t* root, size_t* height ) {
+    const Node_t* node  = root;
+    size_t        count = 0;
+
+    *height = 0;
+
+    while ( node ) {
+        count++;
+        if ( node->depth - root->depth + 1 > *height )
+            *height = node->depth - root->depth + 1;
+
+        if ( node->left ) {
+            node = node->left;
+            continue;
+        }
+        if ( node->right ) {
+            node = node->right;
+            continue;
+        }
+
+        while ( node != root && ( node == node->parent->right || !node->parent->right ) )
+            node = node->parent;
+
+        node = ( node == root ) ? NULL : node->parent->right;
+    }
+
+    return count;
+}
+
+void CompactTreeBuild( CompactTree_t* compact, Node_t* root ) {
+    my_assert( compact, "Null pointer on `compact`" );
+
+    compact->count     = 0;
+    compact->appended  = 0;
+    compact->text_size = 0;
+    compact->built     = true;
+
+    if ( !root )
+        return;
+
+    size_t height = 0;
+    size_t count  = MeasureSubtree( root, &height );
+
+    ReserveSlots( compact, count );
+
+    LayoutFrontier_t frontier = {};
+    LayOut( compact, &frontier, root, height );
+    free( frontier.nodes );
+
+    // Links only once every node has its slot
+    for ( uint32_t slot = 0; slot < compact->count; slot++ ) {
+        const Node_t*  node    = compact->origin[ slot ];
+        CompactNode_t* compact_node = &( compact->nodes[ slot ] );
+
+        compact_node->left   = node->left  ? node->left->slot  : COMPACT_NONE;
+        compact_node->right  = node->right ? node->right->slot : COMPACT_NONE;
+        compact_node->parent = ( slot != 0 ) ? node->parent->slot : COMPACT_NONE;
+    }
+}
+
+// `leaf` was just replaced by a question over `copy`, its copy: the leaf's slot goes to the
+// question, so the descent to it stays where it was, and both children get new slots at the end
+void CompactTreeSplitLeaf( CompactTree_t* compact, const Node_t* leaf, Node_t* copy ) {
+    my_assert( compact && leaf && copy && copy->parent, "Null pointer on argument" );
+
+    if ( !compact->built )
+        return;
+
+    Node_t*  question  = copy->parent;
+    uint32_t slot      = leaf->slot;
+    uint32_t leaf_text = compact->nodes[ slot ].text;
+
+    ReserveSlots( compact, ( size_t ) compact->count + 2 );
+
+    question->slot = slot;
+    compact->origin[ slot ] = question;
+    compact->nodes[ slot ].text = AppendValue( compact, question->value );
+
+    Node_t* children[ 2 ] = { question->left, question->right };
+
+    for ( size_t idx = 0; idx < 2; idx++ ) {
+        Node_t*  child       = children[ idx ];
+        uint32_t child_slot  = compact->count++;
+
+        child->slot = child_slot;
+        compact->origin[ child_slot ] = child;
+
+        CompactNode_t* child_node = &( compact->nodes[ child_slot ] );
+        child_node->left   = COMPACT_NONE;
+        child_node->right  = COMPACT_NONE;
+        child_node->parent = slot;
+        child_node->text   = ( child == copy ) ? leaf_text : AppendValue( compact, child->value );
+    }
+
+    compact->nodes[ slot ].left  = question->left->slot;
+    compact->nodes[ slot ].right = question->right->slot;
+
+    compact->appended += 2;
+}
+
+bool CompactTreeNeedsRelayout( const CompactTree_t* compact ) {
+    my_assert( compact, "Null pointer on `compact`" );
+
+    return compact->appended > compact->count / COMPACT_RELAYOUT_SHARE;
+}
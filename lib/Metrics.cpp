@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "Metrics.h"
+
+static const char* const COUNTER_NAMES[ COUNTER_COUNT ] = {
+    "parse_bytes", "parse_nodes", "searches", "search_probes", "paths", "path_nodes", "save_bytes"
+};
+
+static const char* const TIMER_NAMES[ TIMER_COUNT ] = {
+    "load", "save", "dump", "render", "speech_wait"
+};
+
+static const char* const TIMER_TITLES[ TIMER_COUNT ] = {
+    "Загрузка базы", "Сохранение базы", "Дамп дерева", "Отрисовка дерева", "Ожидание речи"
+};
+
+__thread MetricsBlock_t* metrics_block = NULL;
+
+static pthread_mutex_t metrics_lock   = PTHREAD_MUTEX_INITIALIZER;
+static MetricsBlock_t* metrics_blocks = NULL;
+
+MetricsBlock_t* MetricsRegister() {
+    MetricsBlock_t* block = ( MetricsBlock_t* ) calloc ( 1, sizeof( *block ) );
+    assert( block && "Memory allocation error" );
+
+    pthread_mutex_lock( &metrics_lock );
+    block->next    = metrics_blocks;
+    metrics_blocks = block;
+    pthread_mutex_unlock( &metrics_lock );
+
+    metrics_block = block;
+
+    return block;
+}
+
+void MetricsStop( MetricTimer_t timer, uint64_t start ) {
+    uint64_t        elapsed = MetricsStart() - start;
+    MetricsBlock_t* block   = metrics_block ? metrics_block : MetricsRegister();
+
+    MetricsAdd( &( block->timer_calls[ timer ] ), 1 );
+    MetricsAdd( &( block->timer_ns[ timer ] ), elapsed );
+
+    if ( elapsed > __atomic_load_n( &( block->timer_max_ns[ timer ] ), __ATOMIC_RELAXED ) )
+        __atomic_store_n( &( block->timer_max_ns[ timer ] ), elapsed, __ATOMIC_RELAXED );
+}
+
+static void SumBlocks( MetricsBlock_t* total ) {
+    pthread_mutex_lock( &metrics_lock );
+
+    for ( const MetricsBlock_t* block = metrics_blocks; block; block = block->next ) {
+        for ( size_t idx = 0; idx < COUNTER_COUNT; idx++ )
+            total->counters[ idx ] += __atomic_load_n( &( block->counters[ idx ] ), __ATOMIC_RELAXED );
+
+        for ( size_t idx = 0; idx < TIMER_COUNT; idx++ ) {
+            total->timer_calls[ idx ] += __atomic_load_n( &( block->timer_calls[ idx ] ), __ATOMIC_RELAXED );
+            total->timer_ns[ idx ]    += __atomic_load_n( &( block->timer_ns[ idx ] ), __ATOMIC_RELAXED );
+
+            uint64_t max = __atomic_load_n( &( block->timer_max_ns[ idx ] ), __ATOMIC_RELAXED );
+            if ( max > total->timer_max_ns[ idx ] )
+                total->timer_max_ns[ idx ] = max;
+        }
+    }
+
+    pthread_mutex_unlock( &metrics_lock );
+}
+
+static double Mean( uint64_t sum, uint64_t count ) {
+    return count ? ( double ) sum / ( double ) count : 0.0;
+}
+
+static void ReportJson( FILE* stream, const MetricsBlock_t* total ) {
+    fprintf( stream, "{\"counters\":{" );
+
+    for ( size_t idx = 0; idx < COUNTER_COUNT; idx++ )
+        fprintf( stream, "%s\"%s\":%lu", idx ? "," : "", COUNTER_NAMES[ idx ], total->counters[ idx ] );
+
+    fprintf( stream, "},\"timers\":{" );
+
+    for ( size_t idx = 0; idx < TIMER_COUNT; idx++ ) {
+        fprintf( stream, "%s\"%s\":{\"calls\":%lu,\"total_ms\":%.3f,\"max_ms\":%.3f}",
+                 idx ? "," : "", TIMER_NAMES[ idx ], total->timer_calls[ idx ],
+                 ( double ) total->timer_ns[ idx ] * 1e-6, ( double ) total->timer_max_ns[ idx ] * 1e-6 );
+    }
+
+    fprintf( stream, "}}\n" );
+}
+
+static void ReportText( FILE* stream, const MetricsBlock_t* total ) {
+    const uint64_t* counters = total->counters;
+
+    fprintf( stream, "──────────── Статистика работы ────────────\n" );
+    fprintf( stream, "Разобрано: %lu байт, %lu узлов\n", counters[ COUNTER_PARSE_BYTES ], counters[ COUNTER_PARSE_NODES ] );
+    fprintf( stream, "Сохранено: %lu байт\n", counters[ COUNTER_SAVE_BYTES ] );
+    fprintf( stream, "Поисков по имени: %lu, проб на поиск: %.2f\n", counters[ COUNTER_SEARCHES ],
+             Mean( counters[ COUNTER_SEARCH_PROBES ], counters[ COUNTER_SEARCHES ] ) );
+    fprintf( stream, "Путей по дереву: %lu, узлов на путь: %.2f\n", counters[ COUNTER_PATHS ],
+             Mean( counters[ COUNTER_PATH_NODES ], counters[ COUNTER_PATHS ] ) );
+
+    for ( size_t idx = 0; idx < TIMER_COUNT; idx++ ) {
+        if ( total->timer_calls[ idx ] == 0 )
+            continue;
+
+        fprintf( stream, "%s: %lu раз, всего %.1f мс, в среднем %.2f мс, макс. %.1f мс\n",
+                 TIMER_TITLES[ idx ], total->timer_calls[ idx ], ( double ) total->timer_ns[ idx ] * 1e-6,
+                 Mean( total->timer_ns[ idx ], total->timer_calls[ idx ] ) * 1e-6,
+                 ( double ) total->timer_max_ns[ idx ] * 1e-6 );
+    }
+}
+
+void MetricsReport( FILE* stream, MetricsFormat_t format ) {
+    MetricsBlock_t total = {};
+    SumBlocks( &total );
+
+    if ( format == METRICS_JSON )
+        ReportJson( stream, &total );
+    else if ( format == METRICS_TEXT )
+        ReportText( stream, &total );
+}
@@ -0,0 +1,662 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "NameIndex.h"
+#include "Tree.h"
+#include "Utf8.h"
+#include "DebugUtils.h"
+
+void NameIndexCtor( NameIndex_t* index ) {
+    my_assert( index, "Null pointer on `index`" );
+
+    memset( index, 0, sizeof( *index ) );
+}
+
+static void FreeChunks( StringChunk_t* chunk ) {
+    while ( chunk ) {
+        StringChunk_t* next = chunk->next;
+        free( chunk->data );
+        free( chunk );
+        chunk = next;
+    }
+}
+
+void NameIndexDtor( NameIndex_t* index ) {
+    my_assert( index, "Null pointer on `index`" );
+
+    free( index->entries );
+    free( index->fold_buffer );
+
+    FreeChunks( index->chunks );
+
+    memset( index, 0, sizeof( *index ) );
+}
+
+static char* FoldIntoBuffer( NameIndex_t* index, const char* text, bool* changed ) {
+    size_t length = strlen( text );
+
+    if ( length + 1 > index->fold_capacity ) {
+        size_t new_capacity = index->fold_capacity ? index->fold_capacity : 256;
+        while ( new_capacity < length + 1 )
+            new_capacity *= 2;
+
+        char* new_buffer = ( char* ) realloc ( index->fold_buffer, new_capacity );
+        assert( new_buffer && "Memory allocation error" );
+
+        index->fold_buffer   = new_buffer;
+        index->fold_capacity = new_capacity;
+    }
+
+    bool folded = Utf8Fold( text, index->fold_buffer );
+    if ( changed ) {
+        *changed = folded;
+    }
+
+    return index->fold_buffer;
+}
+
+static const char* StoreKey( NameIndex_t* index, const char* key, size_t length ) {
+    StringChunk_t* chunk = index->chunks;
+
+    if ( !chunk || chunk->capacity - chunk->used < length + 1 ) {
+        chunk = ( StringChunk_t* ) calloc ( 1, sizeof( *chunk ) );
+        assert( chunk && "Memory allocation error" );
+
+        chunk->capacity = length + 1 > STRING_CHUNK_SIZE ? length + 1 : STRING_CHUNK_SIZE;
+        chunk->data     = ( char* ) calloc ( chunk->capacity, sizeof( char ) );
+        assert( chunk->data && "Memory allocation error" );
+
+        chunk->next   = index->chunks;
+        index->chunks = chunk;
+    }
+
+    char* stored = chunk->data + chunk->used;
+    memcpy( stored, key, length + 1 );
+    chunk->used += length + 1;
+
+    return stored;
+}
+
+// A value that is already folded is its own key until LayOutKeys copies it. Folded names are
+// not interned in the tree's pool: hashing every name again cost more than the whole sort.
+static const char* MakeKey( NameIndex_t* index, const char* value ) {
+    bool  changed = false;
+    char* folded  = FoldIntoBuffer( index, value, &changed );
+
+    return changed ? StoreKey( index, folded, strlen( folded ) ) : value;
+}
+
+static uint64_t KeyHead( const char* key ) {
+    uint64_t head = 0;
+
+    for ( size_t idx = 0; idx < sizeof( head ); idx++ ) {
+        head = ( head << 8 ) | ( unsigned char ) key[ idx ];
+        if ( key[ idx ] == '\0' ) {
+            head <<= 8 * ( sizeof( head ) - idx - 1 );
+            break;
+        }
+    }
+
+    return head;
+}
+
+static int CompareKeys( const NameEntry_t* first, const NameEntry_t* second ) {
+    if ( first->head != second->head )
+        return first->head < second->head ? -1 : 1;
+
+    return strcmp( first->key, second->key );
+}
+
+static void FillEntry( NameEntry_t* entry, const char* key, Node_t* leaf ) {
+    entry->head = KeyHead( key );
+    entry->key  = key;
+    entry->leaf = leaf;
+}
+
+static void Reserve( NameIndex_t* index, size_t count ) {
+    if ( index->count + count <= index->capacity )
+        return;
+
+    size_t new_capacity = index->capacity ? index->capacity : 1024;
+    while ( new_capacity < index->count + count )
+        new_capacity *= 2;
+
+    NameEntry_t* new_entries = ( NameEntry_t* ) realloc ( index->entries, new_capacity * sizeof( *new_entries ) );
+    assert( new_entries && "Memory allocation error" );
+
+    index->entries  = new_entries;
+    index->capacity = new_capacity;
+}
+
+// A head without '\0' means the keys go on past it
+static bool HeadIsFull( uint64_t head ) {
+    return ( head & 0xFF ) != 0;
+}
+
+// `head` of every entry holds its key bytes [ depth, depth + 8 ): entries are sorted by it
+// (LSD radix, skipping bytes equal in all of them; insertion sort for a few), then every run
+// of equal full heads is sorted by its next 8 bytes the same way. The key is read once per
+// entry and level instead of at every compare.
+static void SortByHead( NameEntry_t* entries, NameEntry_t* scratch, size_t count, size_t depth ) {
+    if ( count < 32 ) {
+        for ( size_t idx = 1; idx < count; idx++ ) {
+            NameEntry_t entry    = entries[ idx ];
+            size_t      position = idx;
+
+            while ( position > 0 && entries[ position - 1 ].head > entry.head ) {
+                entries[ position ] = entries[ position - 1 ];
+                position--;
+            }
+            entries[ position ] = entry;
+        }
+    }
+    else {
+        NameEntry_t* source = entries;
+        NameEntry_t* target = scratch;
+
+        for ( unsigned shift = 0; shift < 64; shift += 8 ) {
+            size_t positions[ 256 ] = {};
+
+            for ( size_t idx = 0; idx < count; idx++ )
+                positions[ ( source[ idx ].head >> shift ) & 0xFF ]++;
+
+            if ( positions[ ( source[0].head >> shift ) & 0xFF ] == count )
+                continue;
+
+            size_t total = 0;
+            for ( size_t digit = 0; digit < 256; digit++ ) {
+                size_t digit_count = positions[ digit ];
+                positions[ digit ] = total;
+                total += digit_count;
+            }
+
+            for ( size_t idx = 0; idx < count; idx++ )
+                target[ positions[ ( source[ idx ].head >> shift ) & 0xFF ]++ ] = source[ idx ];
+
+            NameEntry_t* swap = source;
+            source = target;
+            target = swap;
+        }
+
+        if ( source != entries ) {
+            memcpy( entries, source, count * sizeof( *entries ) );
+        }
+    }
+
+    size_t run = 0;
+    for ( size_t idx = 1; idx <= count; idx++ ) {
+        if ( idx < count && entries[ idx ].head == entries[ run ].head )
+            continue;
+
+        if ( idx - run > 1 && HeadIsFull( entries[ run ].head ) ) {
+            for ( size_t member = run; member < idx; member++ )
+                entries[ member ].head = KeyHead( entries[ member ].key + depth + sizeof( uint64_t ) );
+
+            SortByHead( entries + run, scratch, idx - run, depth + sizeof( uint64_t ) );
+
+            for ( size_t member = run; member < idx; member++ )
+                entries[ member ].head = KeyHead( entries[ member ].key + depth );
+        }
+        run = idx;
+    }
+}
+
+static void SortEntries( NameEntry_t* entries, size_t count ) {
+    if ( count < 2 )
+        return;
+
+    NameEntry_t* scratch = ( NameEntry_t* ) calloc ( count, sizeof( *scratch ) );
+    assert( scratch && "Memory allocation error" );
+
+    SortByHead( entries, scratch, count, 0 );
+
+    free( scratch );
+}
+
+// Copies the sorted keys one after another: the fuzzy walk then reads them sequentially
+// instead of jumping over the whole base for every entry
+static void LayOutKeys( NameIndex_t* index ) {
+    StringChunk_t* old_chunks = index->chunks;
+    index->chunks = NULL;
+
+    for ( size_t idx = 0; idx < index->sorted; idx++ ) {
+        NameEntry_t* entry = &( index->entries[ idx ] );
+        entry->key = StoreKey( index, entry->key, strlen( entry->key ) );
+    }
+
+    FreeChunks( old_chunks );
+}
+
+// Sorts the tail and merges it into the sorted part, dropping removed entries: O(count)
+static void Merge( NameIndex_t* index ) {
+    size_t tail_length = index->count - index->sorted;
+
+    SortEntries( index->entries + index->sorted, tail_length );
+
+    NameEntry_t* merged = ( NameEntry_t* ) calloc ( index->capacity, sizeof( *merged ) );
+    assert( merged && "Memory allocation error" );
+
+    size_t first  = 0,             first_end  = index->sorted;
+    size_t second = index->sorted, second_end = index->count;
+    size_t used   = 0;
+
+    while ( first < first_end || second < second_end ) {
+        const NameEntry_t* next = NULL;
+
+        if ( second == second_end ||
+             ( first < first_end && CompareKeys( &( index->entries[ first ] ), &( index->entries[ second ] ) ) <= 0 ) )
+            next = &( index->entries[ first++ ] );
+        else
+            next = &( index->entries[ second++ ] );
+
+        if ( next->leaf ) {
+            merged[ used++ ] = *next;
+        }
+    }
+
+    free( index->entries );
+
+    index->entries = merged;
+    index->sorted  = used;
+    index->count   = used;
+    index->removed = 0;
+
+    LayOutKeys( index );
+}
+
+// Leaves are taken in preorder, which is also the order of nodes and values in memory
+void NameIndexBuild( NameIndex_t* index, Node_t* root, size_t leaves ) {
+    my_assert( index, "Null pointer on `index`" );
+
+    index->count   = 0;
+    index->sorted  = 0;
+    index->removed = 0;
+
+    Reserve( index, leaves );
+
+    for ( Node_t* leaf = TreeFirstLeaf( root ); leaf; leaf = TreeNextLeaf( root, leaf ) ) {
+        if ( !leaf->value )
+            continue;
+
+        Reserve( index, 1 );
+        FillEntry( &( index->entries[ index->count++ ] ), MakeKey( index, leaf->value ), leaf );
+    }
+
+    SortEntries( index->entries, index->count );
+
+    index->sorted = index->count;
+    LayOutKeys( index );
+
+    index->built  = true;
+}
+
+void NameIndexInsert( NameIndex_t* index, Node_t* leaf ) {
+    my_assert( index, "Null pointer on `index`" );
+    my_assert( leaf && leaf->value, "Null pointer on `leaf` or its value" );
+
+    if ( !index->built )
+        return;
+
+    Reserve( index, 1 );
+
+    FillEntry( &( index->entries[ index->count++ ] ), MakeKey( index, leaf->value ), leaf );
+
+    if ( index->count - index->sorted > NAME_INDEX_MIN_TAIL ) {
+        Merge( index );
+    }
+}
+
+// strncmp( entry->key, prefix, length ) that looks at the key itself only past its head
+static int ComparePrefix( const NameEntry_t* entry, const char* prefix, uint64_t prefix_head, size_t length ) {
+    if ( length < sizeof( uint64_t ) ) {
+        uint64_t mask = ( length == 0 ) ? 0 : ~0ULL << ( 8 * ( sizeof( uint64_t ) - length ) );
+        uint64_t key  = entry->head & mask;
+        prefix_head  &= mask;
+
+        return ( key > prefix_head ) - ( key < prefix_head );
+    }
+
+    if ( entry->head != prefix_head )
+        return entry->head < prefix_head ? -1 : 1;
+
+    return strncmp( entry->key + sizeof( uint64_t ), prefix + sizeof( uint64_t ), length - sizeof( uint64_t ) );
+}
+
+// First entry in [ begin, end ) whose key is not less than `key` in its first `length` bytes
+static size_t LowerBound( const NameEntry_t* entries, size_t begin, size_t end, const char* key, size_t length ) {
+    uint64_t head = KeyHead( key );
+
+    while ( begin < end ) {
+        size_t middle = begin + ( end - begin ) / 2;
+
+        if ( ComparePrefix( &( entries[ middle ] ), key, head, length ) < 0 )
+            begin = middle + 1;
+        else
+            end = middle;
+    }
+
+    return begin;
+}
+
+// First entry in [ begin, end ) that does not start with the first `length` bytes of `key`.
+// Skipped ranges are mostly short, so it gallops from `begin` and bisects the last step.
+static size_t SkipPrefix( const NameEntry_t* entries, size_t begin, size_t end, const char* key, size_t length ) {
+    uint64_t head = KeyHead( key );
+
+    size_t step = 1;
+    while ( begin + step <= end && ComparePrefix( &( entries[ begin + step - 1 ] ), key, head, length ) <= 0 ) {
+        begin += step;
+        step  *= 2;
+    }
+
+    end = ( begin + step - 1 < end ) ? begin + step - 1 : end;
+
+    while ( begin < end ) {
+        size_t middle = begin + ( end - begin ) / 2;
+
+        if ( ComparePrefix( &( entries[ middle ] ), key, head, length ) <= 0 )
+            begin = middle + 1;
+        else
+            end = middle;
+    }
+
+    return begin;
+}
+
+// Entry of `node` itself, index->count if it has none
+static size_t FindEntry( NameIndex_t* index, const Node_t* node ) {
+    if ( !index->built || index->count == 0 || !node->value )
+        return index->count;
+
+    const char* key    = FoldIntoBuffer( index, node->value, NULL );
+    size_t      length = strlen( key ) + 1;
+
+    for ( size_t idx = LowerBound( index->entries, 0, index->sorted, key, length );
+          idx < index->sorted && strcmp( index->entries[ idx ].key, key ) == 0; idx++ ) {
+        if ( index->entries[ idx ].leaf == node )
+            return idx;
+    }
+
+    for ( size_t idx = index->sorted; idx < index->count; idx++ ) {
+        if ( index->entries[ idx ].leaf == node )
+            return idx;
+    }
+
+    return index->count;
+}
+
+void NameIndexRemove( NameIndex_t* index, const Node_t* node ) {
+    my_assert( index, "Null pointer on `index`" );
+    my_assert( node,  "Null pointer on `node`" );
+
+    size_t idx = FindEntry( index, node );
+
+    if ( idx < index->sorted ) {
+        index->entries[ idx ].leaf = NULL;
+        index->removed++;
+
+        if ( index->removed * 4 > index->count ) {
+            Merge( index );
+        }
+    }
+    else if ( idx < index->count ) {
+        index->entries[ idx ] = index->entries[ --( index->count ) ];
+    }
+}
+
+// `node` has the name of `old`, so the key and its place stay
+void NameIndexReplace( NameIndex_t* index, const Node_t* old, Node_t* node ) {
+    my_assert( index, "Null pointer on `index`" );
+    my_assert( old && node && old->value == node->value, "Bad replacement node" );
+
+    size_t idx = FindEntry( index, old );
+
+    if ( idx < index->count )
+        index->entries[ idx ].leaf = node;
+}
+
+static size_t AddCompletion( const NameEntry_t* entry, NameMatch_t* matches, size_t found, size_t max_matches ) {
+    if ( entry->leaf && found < max_matches ) {
+        matches[ found ].leaf     = entry->leaf;
+        matches[ found ].distance = 0;
+        found++;
+    }
+
+    return found;
+}
+
+// Names starting with `prefix` up to case, in name order (tail entries come last)
+size_t NameIndexComplete( NameIndex_t* index, const char* prefix, NameMatch_t* matches, size_t max_matches ) {
+    my_assert( index,  "Null pointer on `index`" );
+    my_assert( prefix, "Null pointer on `prefix`" );
+    my_assert( matches || max_matches == 0, "Null pointer on `matches`" );
+
+    const char* key    = FoldIntoBuffer( index, prefix, NULL );
+    uint64_t    head   = KeyHead( key );
+    size_t      length = strlen( key );
+    size_t      found  = 0;
+
+    for ( size_t idx = LowerBound( index->entries, 0, index->sorted, key, length );
+          idx < index->sorted && found < max_matches && ComparePrefix( &( index->entries[ idx ] ), key, head, length ) == 0; idx++ ) {
+        found = AddCompletion( &( index->entries[ idx ] ), matches, found, max_matches );
+    }
+
+    for ( size_t idx = index->sorted; idx < index->count && found < max_matches; idx++ ) {
+        if ( strncmp( index->entries[ idx ].key, key, length ) == 0 )
+            found = AddCompletion( &( index->entries[ idx ] ), matches, found, max_matches );
+    }
+
+    return found;
+}
+
+struct FuzzySearch_t {
+    uint32_t* query;
+    size_t    query_length;
+
+    uint32_t* rows;             // row `depth` is the edit distance of the first `depth` key code points
+    size_t*   offsets;          // to every query prefix; offsets[ depth ] is where they end in the key
+    size_t    depth_capacity;
+
+    uint32_t limit;
+    bool     done;
+    size_t   visits_left;       // names visited before `limit` drops to 1, see NAME_FUZZY_MAX_VISITS
+
+    NameMatch_t* matches;
+    size_t       max_matches;
+    size_t       found;
+};
+
+static uint32_t* Row( FuzzySearch_t* search, size_t depth ) {
+    return search->rows + depth * ( search->query_length + 1 );
+}
+
+static void EnsureDepth( FuzzySearch_t* search, size_t depth ) {
+    if ( depth < search->depth_capacity )
+        return;
+
+    size_t new_capacity = search->depth_capacity * 2;
+    while ( new_capacity <= depth )
+        new_capacity *= 2;
+
+    uint32_t* new_rows    = ( uint32_t* ) realloc ( search->rows, new_capacity * ( search->query_length + 1 ) * sizeof( uint32_t ) );
+    size_t*   new_offsets = ( size_t* )   realloc ( search->offsets, new_capacity * sizeof( size_t ) );
+    assert( new_rows && new_offsets && "Memory allocation error" );
+
+    search->rows           = new_rows;
+    search->offsets        = new_offsets;
+    search->depth_capacity = new_capacity;
+}
+
+// Fills row `depth` from row `depth - 1` for key code point `code`, returns its minimum.
+// Only the band | depth - idx | <= limit is computed, a cell outside of it is over the limit
+// anyway; the cells just past both ends are set over the limit for the next row to read.
+static uint32_t ComputeRow( FuzzySearch_t* search, size_t depth, uint32_t code ) {
+    const uint32_t* previous = Row( search, depth - 1 );
+    uint32_t*       current  = Row( search, depth );
+
+    uint32_t over  = search->limit + 1;
+    size_t   first = ( depth > search->limit ) ? depth - search->limit : 1;
+    size_t   last  = depth + search->limit < search->query_length ? depth + search->limit : search->query_length;
+
+    current[ first - 1 ] = ( first == 1 ) ? ( uint32_t ) depth : over;
+    uint32_t minimum = current[ first - 1 ];
+
+    for ( size_t idx = first; idx <= last; idx++ ) {
+        uint32_t replace = previous[ idx - 1 ] + ( search->query[ idx - 1 ] != code );
+        uint32_t remove  = previous[ idx ] + 1;
+        uint32_t insert  = current[ idx - 1 ] + 1;
+
+        uint32_t best = replace < remove ? replace : remove;
+        current[ idx ] = best < insert ? best : insert;
+
+        if ( current[ idx ] < minimum )
+            minimum = current[ idx ];
+    }
+
+    if ( last < search->query_length ) {
+        current[ last + 1 ] = over;
+    }
+
+    return minimum;
+}
+
+// Keeps the best `max_matches` by distance, earlier names first among equals. Once the list is
+// full only strictly closer names can get in, so the limit shrinks with it.
+static void AddMatch( FuzzySearch_t* search, Node_t* leaf, uint32_t distance ) {
+    size_t position = search->found;
+    while ( position > 0 && search->matches[ position - 1 ].distance > distance )
+        position--;
+
+    if ( position == search->max_matches )
+        return;
+
+    size_t last = ( search->found < search->max_matches ) ? search->found : search->max_matches - 1;
+    memmove( search->matches + position + 1, search->matches + position, ( last - position ) * sizeof( NameMatch_t ) );
+
+    search->matches[ position ].leaf     = leaf;
+    search->matches[ position ].distance = distance;
+
+    if ( search->found < search->max_matches )
+        search->found++;
+
+    if ( search->found == search->max_matches ) {
+        uint32_t worst = search->matches[ search->found - 1 ].distance;
+
+        if ( worst == 0 )
+            search->done = true;
+        else if ( worst - 1 < search->limit )
+            search->limit = worst - 1;
+    }
+}
+
+// Depth-first over [ begin, end ). When the entries are sorted, rows of the common prefix
+// with the previous key are reused and a prefix that cannot get within the limit is
+// skipped as a whole.
+static void WalkEntries( FuzzySearch_t* search, const NameEntry_t* entries, size_t begin, size_t end, bool sorted ) {
+    const char* previous = NULL;
+    size_t      valid    = 0;
+
+    size_t idx = begin;
+    while ( idx < end && !search->done ) {
+        const NameEntry_t* entry = &( entries[ idx ] );
+        if ( !entry->leaf ) {
+            idx++;
+            continue;
+        }
+
+        // Rows kept for the common prefix stay exact: a narrower band reads only cells of the wider one
+        if ( search->limit > 1 && search->visits_left-- == 0 )
+            search->limit = 1;
+
+        const char* key   = entry->key;
+        size_t      depth = 0;
+
+        if ( sorted && previous ) {
+            while ( depth < valid ) {
+                size_t start = search->offsets[ depth ];
+                size_t stop  = search->offsets[ depth + 1 ];
+
+                if ( strncmp( key + start, previous + start, stop - start ) != 0 )
+                    break;
+                depth++;
+            }
+        }
+
+        const char* position = key + search->offsets[ depth ];
+        bool        pruned   = false;
+
+        for ( uint32_t code = Utf8NextFolded( &position ); code != 0; code = Utf8NextFolded( &position ) ) {
+            depth++;
+            EnsureDepth( search, depth + 1 );
+            search->offsets[ depth ] = ( size_t ) ( position - key );
+
+            if ( ComputeRow( search, depth, code ) > search->limit ) {
+                pruned = true;
+                break;
+            }
+        }
+
+        previous = key;
+        valid    = depth;
+
+        if ( pruned ) {
+            idx = sorted ? SkipPrefix( entries, idx + 1, end, key, search->offsets[ depth ] ) : idx + 1;
+            continue;
+        }
+
+        // Outside the band the last cell of the row holds whatever an earlier key left there
+        uint32_t distance = ( depth + search->limit >= search->query_length && search->query_length + search->limit >= depth )
+                          ? Row( search, depth )[ search->query_length ] : search->limit + 1;
+        if ( distance <= search->limit ) {
+            AddMatch( search, entry->leaf, distance );
+        }
+
+        idx++;
+    }
+}
+
+// Names within `max_distance` edits (Levenshtein, in code points, up to case) of `name`,
+// closest first. Names within one edit are all found; farther ones only among those visited
+// before NAME_FUZZY_MAX_VISITS ran out, which on small bases is all of them.
+size_t NameIndexFuzzy( NameIndex_t* index, const char* name, uint32_t max_distance,
+                       NameMatch_t* matches, size_t max_matches ) {
+    my_assert( index, "Null pointer on `index`" );
+    my_assert( name,  "Null pointer on `name`" );
+    my_assert( matches || max_matches == 0, "Null pointer on `matches`" );
+
+    if ( max_matches == 0 || index->count == 0 )
+        return 0;
+
+    FuzzySearch_t search = {};
+
+    search.query = ( uint32_t* ) calloc ( strlen( name ) + 1, sizeof( uint32_t ) );
+    assert( search.query && "Memory allocation error" );
+
+    for ( uint32_t code = Utf8NextFolded( &name ); code != 0; code = Utf8NextFolded( &name ) )
+        search.query[ search.query_length++ ] = code;
+
+    search.depth_capacity = 64;
+    search.rows    = ( uint32_t* ) calloc ( search.depth_capacity * ( search.query_length + 1 ), sizeof( uint32_t ) );
+    search.offsets = ( size_t* )   calloc ( search.depth_capacity, sizeof( size_t ) );
+    assert( search.rows && search.offsets && "Memory allocation error" );
+
+    for ( size_t idx = 0; idx <= search.query_length; idx++ )
+        search.rows[ idx ] = ( uint32_t ) idx;
+
+    search.limit       = max_distance;
+    search.visits_left = NAME_FUZZY_MAX_VISITS;
+    search.matches     = matches;
+    search.max_matches = max_matches;
+
+    WalkEntries( &search, index->entries, 0, index->sorted, true );
+    WalkEntries( &search, index->entries, index->sorted, index->count, false );
+
+    free( search.query );
+    free( search.rows );
+    free( search.offsets );
+
+    return search.found;
+}
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "ObjectIndex.h"
+#include "Tree.h"
+#include "Utf8.h"
+#include "Metrics.h"
+#include "DebugUtils.h"
+
+const size_t INITIAL_SLOTS = 1024;
+
+void ObjectIndexCtor( ObjectIndex_t* index ) {
+    my_assert( index, "Null pointer on `index`" );
+
+    memset( index, 0, sizeof( *index ) );
+}
+
+void ObjectIndexDtor( ObjectIndex_t* index ) {
+    my_assert( index, "Null pointer on `index`" );
+
+    free( index->slot_nodes );
+    free( index->slot_hashes );
+
+    memset( index, 0, sizeof( *index ) );
+}
+
+static void Rehash( ObjectIndex_t* index, size_t new_capacity ) {
+    Node_t**  new_nodes  = ( Node_t** )  calloc ( new_capacity, sizeof( *new_nodes ) );
+    uint32_t* new_hashes = ( uint32_t* ) calloc ( new_capacity, sizeof( *new_hashes ) );
+    assert( new_nodes && new_hashes && "Memory allocation error" );
+
+    // Going from the start of a probe chain keeps equal names in the order they were inserted
+    size_t start = 0;
+    while ( start < index->capacity && index->slot_nodes[ start ] )
+        start++;
+
+    for ( size_t step = 0; step < index->capacity; step++ ) {
+        size_t idx = ( start + step ) & ( index->capacity - 1 );
+        if ( !index->slot_nodes[ idx ] )
+            continue;
+
+        size_t position = index->slot_hashes[ idx ] & ( new_capacity - 1 );
+        while ( new_nodes[ position ] )
+            position = ( position + 1 ) & ( new_capacity - 1 );
+
+        new_nodes[ position ]  = index->slot_nodes[ idx ];
+        new_hashes[ position ] = index->slot_hashes[ idx ];
+    }
+
+    free( index->slot_nodes );
+    free( index->slot_hashes );
+
+    index->slot_nodes  = new_nodes;
+    index->slot_hashes = new_hashes;
+    index->capacity    = new_capacity;
+}
+
+static void Reserve( ObjectIndex_t* index, size_t count ) {
+    size_t new_capacity = index->capacity ? index->capacity : INITIAL_SLOTS;
+    while ( ( index->count + count ) * 4 > new_capacity * 3 )
+        new_capacity *= 2;
+
+    if ( new_capacity != index->capacity ) {
+        Rehash( index, new_capacity );
+    }
+}
+
+static void InsertHashed( ObjectIndex_t* index, Node_t* leaf, uint32_t hash ) {
+    size_t mask     = index->capacity - 1;
+    size_t position = hash & mask;
+
+    while ( index->slot_nodes[ position ] )
+        position = ( position + 1 ) & mask;
+
+    index->slot_nodes[ position ]  = leaf;
+    index->slot_hashes[ position ] = hash;
+    index->count++;
+}
+
+void ObjectIndexInsert( ObjectIndex_t* index, Node_t* leaf ) {
+    my_assert( index, "Null pointer on `index`" );
+    my_assert( leaf && leaf->value, "Null pointer on `leaf` or its value" );
+
+    if ( !index->built )
+        return;
+
+    Reserve( index, 1 );
+    InsertHashed( index, leaf, Utf8FoldedHash( leaf->value ) );
+}
+
+// Leaves go in preorder, so the first of equal names is the one a tree walk meets first
+void ObjectIndexBuild( ObjectIndex_t* index, Node_t* root ) {
+    my_assert( index, "Null pointer on `index`" );
+
+    index->count = 0;
+    index->built = true;
+
+    if ( index->capacity ) {
+        memset( index->slot_nodes, 0, index->capacity * sizeof( *( index->slot_nodes ) ) );
+    }
+
+    for ( Node_t* leaf = TreeFirstLeaf( root ); leaf; leaf = TreeNextLeaf( root, leaf ) ) {
+        if ( leaf->value ) {
+            ObjectIndexInsert( index, leaf );
+        }
+    }
+}
+
+// Slot holding `node` itself, index->capacity if it is not indexed
+static size_t FindSlot( const ObjectIndex_t* index, const Node_t* node ) {
+    if ( !index->built || index->count == 0 || !node->value )
+        return index->capacity;
+
+    size_t mask     = index->capacity - 1;
+    size_t position = Utf8FoldedHash( node->value ) & mask;
+
+    while ( index->slot_nodes[ position ] && index->slot_nodes[ position ] != node )
+        position = ( position + 1 ) & mask;
+
+    return index->slot_nodes[ position ] ? position : index->capacity;
+}
+
+// Backward shift deletion: no tombstones, probe chains stay as if `node` was never inserted
+void ObjectIndexRemove( ObjectIndex_t* index, const Node_t* node ) {
+    my_assert( index, "Null pointer on `index`" );
+    my_assert( node,  "Null pointer on `node`" );
+
+    size_t position = FindSlot( index, node );
+    if ( position == index->capacity )
+        return;
+
+    size_t mask = index->capacity - 1;
+    size_t hole = position;
+    size_t next = ( hole + 1 ) & mask;
+
+    while ( index->slot_nodes[ next ] ) {
+        size_t home = index->slot_hashes[ next ] & mask;
+
+        // The entry may move into the hole unless its home lies cyclically in ( hole, next ]
+        if ( ( ( next - home ) & mask ) >= ( ( next - hole ) & mask ) ) {
+            index->slot_nodes[ hole ]  = index->slot_nodes[ next ];
+            index->slot_hashes[ hole ] = index->slot_hashes[ next ];
+            hole = next;
+        }
+
+        next = ( next + 1 ) & mask;
+    }
+
+    index->slot_nodes[ hole ]  = NULL;
+    index->slot_hashes[ hole ] = 0;
+    index->count--;
+}
+
+// `node` has the name of `old`, so it takes its slot and keeps the probe chain as it is
+void ObjectIndexReplace( ObjectIndex_t* index, const Node_t* old, Node_t* node ) {
+    my_assert( index, "Null pointer on `index`" );
+    my_assert( old && node && old->value == node->value, "Bad replacement node" );
+
+    size_t position = FindSlot( index, old );
+    if ( position != index->capacity )
+        index->slot_nodes[ position ] = node;
+}
+
+Node_t* ObjectIndexFind( const ObjectIndex_t* index, const char* name ) {
+    my_assert( index, "Null pointer on `index`" );
+    my_assert( name,  "Null pointer on `name`" );
+    my_assert( index->built, "Object index is searched before it is built" );
+
+    if ( index->count == 0 )
+        return NULL;
+
+    uint32_t hash     = Utf8FoldedHash( name );
+    size_t   mask     = index->capacity - 1;
+    size_t   position = hash & mask;
+    Node_t*  found    = NULL;
+    uint64_t probes   = 1;
+
+    while ( index->slot_nodes[ position ] ) {
+        Node_t* candidate = index->slot_nodes[ position ];
+
+        if ( index->slot_hashes[ position ] == hash && Utf8FoldedEqual( candidate->value, name ) ) {
+            found = candidate;
+            break;
+        }
+
+        position = ( position + 1 ) & mask;
+        probes++;
+    }
+
+    MetricsEvent( COUNTER_SEARCHES, COUNTER_SEARCH_PROBES, probes );
+
+    return found;
+}
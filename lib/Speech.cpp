@@ -0,0 +1,631 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <time.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Speech.h"
+#include "DebugUtils.h"
+#include "Metrics.h"
+#include "UtilsRW.h"
+
+const size_t SPEECH_MAX_ARGUMENTS = 16;
+
+// Temporary files this old are left over from a crash, not renders in progress
+const time_t SPEECH_STALE_SECONDS = 600;
+
+const size_t SPEECH_INITIAL_FILES = 256;
+
+// Everything but the text that changes the audio, part of the cache key
+static const char* const SYNTHESIZER_VOICE[] = { "-v", "ru", "-s", "100" };
+
+const size_t SYNTHESIZER_VOICE_SIZE = sizeof( SYNTHESIZER_VOICE ) / sizeof( SYNTHESIZER_VOICE[0] );
+
+struct CacheFile_t {
+    uint64_t        key;
+    struct timespec used;
+    uint64_t        size;
+};
+
+static uint64_t Fnv1a( uint64_t hash, const char* data, size_t size ) {
+    for ( size_t idx = 0; idx < size; idx++ ) {
+        hash ^= ( unsigned char ) data[ idx ];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+uint64_t SpeechCacheKey( const char* text ) {
+    my_assert( text, "Null pointer on `text`" );
+
+    // Every string with its '\0', so no two argument lists run together the same way
+    uint64_t hash = 14695981039346656037ull;
+
+    for ( size_t idx = 0; idx < SYNTHESIZER_VOICE_SIZE; idx++ )
+        hash = Fnv1a( hash, SYNTHESIZER_VOICE[ idx ], strlen( SYNTHESIZER_VOICE[ idx ] ) + 1 );
+
+    return Fnv1a( hash, text, strlen( text ) + 1 );
+}
+
+static void CachePath( const Speech_t* speech, uint64_t key, char* path, size_t size ) {
+    snprintf( path, size, "%s/%016" PRIx64 ".wav", speech->directory, key );
+}
+
+static int CompareOlderFirst( const void* first, const void* second ) {
+    const struct timespec* first_used  = &( ( const CacheFile_t* ) first )->used;
+    const struct timespec* second_used = &( ( const CacheFile_t* ) second )->used;
+
+    if ( first_used->tv_sec != second_used->tv_sec )
+        return ( first_used->tv_sec > second_used->tv_sec ) - ( first_used->tv_sec < second_used->tv_sec );
+
+    return ( first_used->tv_nsec > second_used->tv_nsec ) - ( first_used->tv_nsec < second_used->tv_nsec );
+}
+
+static bool IsProtected( const uint64_t* keys, size_t count, uint64_t key ) {
+    for ( size_t idx = 0; idx < count; idx++ ) {
+        if ( keys[ idx ] == key )
+            return true;
+    }
+
+    return false;
+}
+
+// Bytes in the cache once the least recently used files beyond 3/4 of the limit are gone;
+// a file's time of use is its mtime. `keys` - the clips the threads may play, kept.
+static uint64_t TrimCache( const Speech_t* speech, const uint64_t* keys, size_t key_count ) {
+    DIR* directory = opendir( speech->directory );
+    if ( !directory )
+        return 0;
+
+    size_t       capacity = SPEECH_INITIAL_FILES;
+    size_t       count    = 0;
+    CacheFile_t* files    = ( CacheFile_t* ) calloc ( capacity, sizeof( CacheFile_t ) );
+    assert( files && "Memory allocation error" );
+
+    uint64_t total = 0;
+    time_t   now   = time( NULL );
+    char     path[ PATH_MAX ] = {};
+
+    for ( struct dirent* entry = readdir( directory ); entry; entry = readdir( directory ) ) {
+        snprintf( path, sizeof( path ), "%s/%s", speech->directory, entry->d_name );
+
+        struct stat file = {};
+        if ( entry->d_name[0] == '.' || stat( path, &file ) == -1 || !S_ISREG( file.st_mode ) )
+            continue;
+
+        char*    end = NULL;
+        uint64_t key = strtoull( entry->d_name, &end, 16 );
+
+        if ( strcmp( end, ".wav" ) != 0 ) {
+            if ( strstr( entry->d_name, ".wav.tmp." ) && now - file.st_mtime > SPEECH_STALE_SECONDS )
+                unlink( path );
+            continue;
+        }
+
+        if ( count == capacity ) {
+            capacity *= 2;
+            files = ( CacheFile_t* ) realloc ( files, capacity * sizeof( CacheFile_t ) );
+            assert( files && "Memory allocation error" );
+        }
+
+        files[ count++ ] = { key, file.st_mtim, ( uint64_t ) file.st_size };
+        total += ( uint64_t ) file.st_size;
+    }
+
+    closedir( directory );
+
+    if ( total > SPEECH_CACHE_LIMIT ) {
+        qsort( files, count, sizeof( CacheFile_t ), CompareOlderFirst );
+
+        for ( size_t idx = 0; idx < count && total > SPEECH_CACHE_LIMIT / 4 * 3; idx++ ) {
+            if ( IsProtected( keys, key_count, files[ idx ].key ) )
+                continue;
+
+            CachePath( speech, files[ idx ].key, path, sizeof( path ) );
+
+            if ( unlink( path ) == 0 )
+                total -= files[ idx ].size;
+        }
+    }
+
+    free( files );
+
+    return total;
+}
+
+// One trim at a time, from whichever thread pushed the cache past the limit
+static void TrimIfFull( Speech_t* speech ) {
+    uint64_t keys[ SPEECH_CLIPS ] = {};
+    size_t   key_count = 0;
+
+    pthread_mutex_lock( &( speech->lock ) );
+
+    bool trim = speech->cache_size > SPEECH_CACHE_LIMIT && !speech->trimming;
+
+    if ( trim ) {
+        speech->trimming = true;
+
+        for ( size_t idx = 0; idx < SPEECH_CLIPS; idx++ ) {
+            if ( speech->clips[ idx ].text )
+                keys[ key_count++ ] = speech->clips[ idx ].key;
+        }
+    }
+
+    pthread_mutex_unlock( &( speech->lock ) );
+
+    if ( !trim )
+        return;
+
+    uint64_t total = TrimCache( speech, keys, key_count );
+
+    pthread_mutex_lock( &( speech->lock ) );
+    speech->cache_size = total;
+    speech->trimming   = false;
+    pthread_mutex_unlock( &( speech->lock ) );
+}
+
+// espeak's file output goes next to `path`, which then appears whole or not at all
+static bool RenderFile( Speech_t* speech, const char* text, const char* path, bool* missing ) {
+    char temporary[ PATH_MAX ] = {};
+    int  fd = OpenTemporaryFile( path, temporary, sizeof( temporary ) );
+    if ( fd == -1 )
+        return false;
+
+    close( fd );
+
+    int input[ 2 ] = { -1, -1 };
+    if ( pipe2( input, O_CLOEXEC ) == -1 ) {
+        unlink( temporary );
+        return false;
+    }
+
+    const char* arguments[ SPEECH_MAX_ARGUMENTS ] = { "espeak" };
+    size_t      count = 1;
+
+    for ( size_t idx = 0; idx < SYNTHESIZER_VOICE_SIZE; idx++ )
+        arguments[ count++ ] = SYNTHESIZER_VOICE[ idx ];
+
+    arguments[ count++ ] = "--stdin";
+    arguments[ count++ ] = "-w";
+    arguments[ count++ ] = temporary;
+
+    pid_t pid = SpawnProcess( arguments, input[ 0 ], -1 );
+    close( input[ 0 ] );
+
+    if ( pid == -1 ) {
+        *missing = true;
+        close( input[ 1 ] );
+        unlink( temporary );
+        return false;
+    }
+
+    // Far shorter than a pipe buffer, so this never waits for espeak to read
+    WriteAll( input[ 1 ], text, strlen( text ) );
+    close( input[ 1 ] );
+
+    struct stat file = {};
+
+    if ( WaitProcess( pid, 0 ) != 0 || stat( temporary, &file ) == -1 || file.st_size == 0 ||
+         rename( temporary, path ) == -1 ) {
+        unlink( temporary );
+        return false;
+    }
+
+    pthread_mutex_lock( &( speech->lock ) );
+    speech->cache_size += ( uint64_t ) file.st_size;
+    pthread_mutex_unlock( &( speech->lock ) );
+
+    TrimIfFull( speech );
+
+    return true;
+}
+
+// The cache file of `text`, rendered unless it is there already; false if espeak is missing
+// or failed
+static bool RenderToCache( Speech_t* speech, const char* text, uint64_t key, bool* missing ) {
+    char path[ PATH_MAX ] = {};
+    CachePath( speech, key, path, sizeof( path ) );
+
+    // A hit only needs its time of use moved on
+    if ( utimensat( AT_FDCWD, path, NULL, 0 ) == 0 )
+        return true;
+
+    return RenderFile( speech, text, path, missing );
+}
+
+static SpeechClip_t* FindClip( Speech_t* speech, const char* text ) {
+    for ( size_t idx = 0; idx < SPEECH_CLIPS; idx++ ) {
+        if ( speech->clips[ idx ].text && strcmp( speech->clips[ idx ].text, text ) == 0 )
+            return &( speech->clips[ idx ] );
+    }
+
+    return NULL;
+}
+
+static bool IsQueued( const Speech_t* speech, const char* text ) {
+    for ( size_t idx = 0; idx < speech->queue_size; idx++ ) {
+        if ( strcmp( speech->queue[ ( speech->queue_start + idx ) % SPEECH_QUEUE ], text ) == 0 )
+            return true;
+    }
+
+    return false;
+}
+
+// The clip of `text`, made the most recent; a new one takes a free slot or the least recent
+// clip nobody waits for. The queue and the two busy clips are fewer than SPEECH_CLIPS.
+static SpeechClip_t* RequestClip( Speech_t* speech, const char* text ) {
+    SpeechClip_t* clip = FindClip( speech, text );
+
+    if ( !clip ) {
+        for ( size_t idx = 0; idx < SPEECH_CLIPS; idx++ ) {
+            SpeechClip_t* candidate = &( speech->clips[ idx ] );
+
+            if ( candidate->text && ( candidate->busy || IsQueued( speech, candidate->text ) ) )
+                continue;
+
+            if ( !clip || !candidate->text || ( clip->text && candidate->used < clip->used ) )
+                clip = candidate;
+        }
+
+        assert( clip && "No clip to evict" );
+
+        free( clip->text );
+        memset( clip, 0, sizeof( *clip ) );
+
+        clip->text = strdup( text );
+        assert( clip->text && "Memory allocation error" );
+
+        clip->key = SpeechCacheKey( text );
+    }
+
+    clip->used = ++( speech->clock );
+
+    return clip;
+}
+
+// What is to be played soonest goes first, then the latest prefetch
+static SpeechClip_t* NextToSynthesize( Speech_t* speech ) {
+    for ( size_t idx = 0; idx < speech->queue_size; idx++ ) {
+        SpeechClip_t* clip = FindClip( speech, speech->queue[ ( speech->queue_start + idx ) % SPEECH_QUEUE ] );
+
+        if ( clip && !clip->ready && !clip->failed && !clip->busy )
+            return clip;
+    }
+
+    SpeechClip_t* latest = NULL;
+
+    for ( size_t idx = 0; idx < SPEECH_CLIPS; idx++ ) {
+        SpeechClip_t* clip = &( speech->clips[ idx ] );
+
+        if ( clip->text && !clip->ready && !clip->failed && !clip->busy && ( !latest || clip->used > latest->used ) )
+            latest = clip;
+    }
+
+    return latest;
+}
+
+static void DropQueue( Speech_t* speech ) {
+    for ( size_t idx = 0; idx < speech->queue_size; idx++ )
+        free( speech->queue[ ( speech->queue_start + idx ) % SPEECH_QUEUE ] );
+
+    speech->queue_start = 0;
+    speech->queue_size  = 0;
+}
+
+// Without espeak or aplay nothing is spoken, as with the old `system` call
+static void MakeUnavailable( Speech_t* speech ) {
+    speech->unavailable = true;
+    DropQueue( speech );
+
+    for ( size_t idx = 0; idx < SPEECH_CLIPS; idx++ )
+        speech->clips[ idx ].failed = true;
+}
+
+// Helpers leave signals to the game's thread; a killed aplay shows up as EPIPE, not SIGPIPE
+static void BlockSignals() {
+    sigset_t signals = {};
+    sigfillset( &signals );
+    pthread_sigmask( SIG_BLOCK, &signals, NULL );
+}
+
+static void* RunSynthesizer( void* argument ) {
+    Speech_t* speech = ( Speech_t* ) argument;
+
+    BlockSignals();
+
+    pthread_mutex_lock( &( speech->lock ) );
+
+    while ( true ) {
+        SpeechClip_t* clip = NULL;
+
+        while ( !speech->stopping && !( clip = NextToSynthesize( speech ) ) )
+            pthread_cond_wait( &( speech->changed ), &( speech->lock ) );
+
+        if ( speech->stopping )
+            break;
+
+        clip->busy = true;
+        char* text = strdup( clip->text );
+        assert( text && "Memory allocation error" );
+
+        pthread_mutex_unlock( &( speech->lock ) );
+
+        bool missing = false;
+        bool done    = RenderToCache( speech, text, clip->key, &missing );
+
+        pthread_mutex_lock( &( speech->lock ) );
+
+        clip->busy   = false;
+        clip->ready  = done;
+        clip->failed = !done;
+
+        if ( missing )
+            MakeUnavailable( speech );
+
+        free( text );
+        pthread_cond_broadcast( &( speech->changed ) );
+    }
+
+    pthread_mutex_unlock( &( speech->lock ) );
+
+    return NULL;
+}
+
+// Called and returns with the lock held; plays `clip` from its file unless SpeechCancel
+// comes first
+static void PlayClip( Speech_t* speech, SpeechClip_t* clip ) {
+    uint64_t generation = speech->generation;
+
+    char path[ PATH_MAX ] = {};
+    CachePath( speech, clip->key, path, sizeof( path ) );
+
+    clip->busy = true;
+    pthread_mutex_unlock( &( speech->lock ) );
+
+    const char* arguments[] = { "aplay", "-q", path, NULL };
+    pid_t       pid         = SpawnProcess( arguments, -1, -1 );
+
+    pthread_mutex_lock( &( speech->lock ) );
+
+    if ( pid == -1 ) {
+        clip->busy = false;
+        MakeUnavailable( speech );
+        return;
+    }
+
+    speech->playing = pid;
+    if ( speech->generation != generation )
+        kill( pid, SIGTERM );
+
+    pthread_mutex_unlock( &( speech->lock ) );
+
+    // Not reaped yet, so the pid cannot be reused while SpeechCancel may still send to it
+    WaitProcess( pid, WNOWAIT );
+
+    pthread_mutex_lock( &( speech->lock ) );
+    speech->playing = 0;
+    clip->busy      = false;
+    pthread_mutex_unlock( &( speech->lock ) );
+
+    WaitProcess( pid, 0 );
+
+    pthread_mutex_lock( &( speech->lock ) );
+}
+
+static bool HeadIsReady( Speech_t* speech ) {
+    if ( speech->queue_size == 0 )
+        return false;
+
+    const SpeechClip_t* clip = FindClip( speech, speech->queue[ speech->queue_start ] );
+
+    return !clip || clip->ready || clip->failed;
+}
+
+static void* RunPlayer( void* argument ) {
+    Speech_t* speech = ( Speech_t* ) argument;
+
+    BlockSignals();
+
+    pthread_mutex_lock( &( speech->lock ) );
+
+    while ( true ) {
+        uint64_t waiting = 0;   // since an utterance due to play turned out not synthesized yet
+
+        while ( !speech->stopping && !HeadIsReady( speech ) ) {
+            // A cancelled utterance is not waited for any longer
+            if ( speech->queue_size == 0 )
+                waiting = 0;
+            else if ( !waiting )
+                waiting = MetricsStart();
+
+            pthread_cond_wait( &( speech->changed ), &( speech->lock ) );
+        }
+
+        if ( speech->stopping )
+            break;
+
+        if ( waiting )
+            MetricsStop( TIMER_SPEECH_WAIT, waiting );
+
+        char* text = speech->queue[ speech->queue_start ];
+        speech->queue_start = ( speech->queue_start + 1 ) % SPEECH_QUEUE;
+        speech->queue_size--;
+
+        SpeechClip_t* clip = FindClip( speech, text );
+        free( text );
+
+        if ( clip && clip->ready )
+            PlayClip( speech, clip );
+
+        pthread_cond_broadcast( &( speech->changed ) );
+    }
+
+    pthread_mutex_unlock( &( speech->lock ) );
+
+    return NULL;
+}
+
+Speech_t* SpeechCtor( const char* directory ) {
+    my_assert( directory, "Null pointer on `directory`" );
+
+    Speech_t* speech = ( Speech_t* ) calloc ( 1, sizeof( *speech ) );
+    assert( speech && "Memory allocation error" );
+
+    pthread_mutex_init( &( speech->lock ), NULL );
+    pthread_cond_init( &( speech->changed ), NULL );
+
+    speech->directory = strdup( directory );
+    assert( speech->directory && "Memory allocation error" );
+
+    if ( MakeDirectory( directory ) == -1 ) {
+        fprintf( stderr, "Не удалось создать каталог \"%s\" для озвучки: %s\n", directory, strerror( errno ) );
+        speech->unavailable = true;
+        return speech;
+    }
+
+    // What earlier runs left, trimmed if the limit has gone down since
+    speech->cache_size = TrimCache( speech, NULL, 0 );
+
+    // No speech at all is better than speech that blocks the game
+    if ( pthread_create( &( speech->synthesizer ), NULL, RunSynthesizer, speech ) != 0 ) {
+        speech->unavailable = true;
+        return speech;
+    }
+
+    if ( pthread_create( &( speech->player ), NULL, RunPlayer, speech ) != 0 ) {
+        pthread_mutex_lock( &( speech->lock ) );
+        speech->stopping = true;
+        pthread_cond_broadcast( &( speech->changed ) );
+        pthread_mutex_unlock( &( speech->lock ) );
+
+        pthread_join( speech->synthesizer, NULL );
+
+        speech->stopping    = false;
+        speech->unavailable = true;
+        speech->synthesizer = 0;
+    }
+
+    return speech;
+}
+
+void SpeechDtor( Speech_t** speech ) {
+    my_assert( speech && *speech, "Null pointer on `speech`" );
+
+    Speech_t* self = *speech;
+
+    SpeechCancel( self );
+
+    pthread_mutex_lock( &( self->lock ) );
+    self->stopping = true;
+    pthread_cond_broadcast( &( self->changed ) );
+    pthread_mutex_unlock( &( self->lock ) );
+
+    if ( self->synthesizer ) pthread_join( self->synthesizer, NULL );
+    if ( self->player )      pthread_join( self->player, NULL );
+
+    DropQueue( self );
+
+    for ( size_t idx = 0; idx < SPEECH_CLIPS; idx++ )
+        free( self->clips[ idx ].text );
+
+    free( self->directory );
+
+    pthread_cond_destroy( &( self->changed ) );
+    pthread_mutex_destroy( &( self->lock ) );
+
+    free( self );
+    *speech = NULL;
+}
+
+void SpeechSay( Speech_t* speech, const char* text ) {
+    my_assert( speech, "Null pointer on `speech`" );
+
+    if ( !text || text[0] == '\0' )
+        return;
+
+    pthread_mutex_lock( &( speech->lock ) );
+
+    if ( !speech->unavailable ) {
+        if ( speech->queue_size == SPEECH_QUEUE ) {
+            free( speech->queue[ speech->queue_start ] );
+            speech->queue_start = ( speech->queue_start + 1 ) % SPEECH_QUEUE;
+            speech->queue_size--;
+        }
+
+        char* queued = strdup( text );
+        assert( queued && "Memory allocation error" );
+
+        speech->queue[ ( speech->queue_start + speech->queue_size ) % SPEECH_QUEUE ] = queued;
+        speech->queue_size++;
+
+        RequestClip( speech, text );
+        pthread_cond_broadcast( &( speech->changed ) );
+    }
+
+    pthread_mutex_unlock( &( speech->lock ) );
+}
+
+void SpeechPrefetch( Speech_t* speech, const char* text ) {
+    my_assert( speech, "Null pointer on `speech`" );
+
+    if ( !text || text[0] == '\0' )
+        return;
+
+    pthread_mutex_lock( &( speech->lock ) );
+
+    if ( !speech->unavailable ) {
+        RequestClip( speech, text );
+        pthread_cond_broadcast( &( speech->changed ) );
+    }
+
+    pthread_mutex_unlock( &( speech->lock ) );
+}
+
+void SpeechCancel( Speech_t* speech ) {
+    my_assert( speech, "Null pointer on `speech`" );
+
+    pthread_mutex_lock( &( speech->lock ) );
+
+    speech->generation++;
+    DropQueue( speech );
+
+    if ( speech->playing )
+        kill( speech->playing, SIGTERM );
+
+    pthread_cond_broadcast( &( speech->changed ) );
+    pthread_mutex_unlock( &( speech->lock ) );
+}
+
+bool SpeechRender( Speech_t* speech, const char* text ) {
+    my_assert( speech && text, "Null pointer on argument" );
+
+    pthread_mutex_lock( &( speech->lock ) );
+    bool unavailable = speech->unavailable;
+    pthread_mutex_unlock( &( speech->lock ) );
+
+    if ( unavailable || text[0] == '\0' )
+        return false;
+
+    bool missing = false;
+    bool done    = RenderToCache( speech, text, SpeechCacheKey( text ), &missing );
+
+    if ( missing ) {
+        pthread_mutex_lock( &( speech->lock ) );
+        MakeUnavailable( speech );
+        pthread_mutex_unlock( &( speech->lock ) );
+    }
+
+    return done;
+}
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "StringPool.h"
+#include "DebugUtils.h"
+
+const size_t INITIAL_SLOTS = 1024;
+
+void StringPoolCtor( StringPool_t* pool ) {
+    my_assert( pool, "Null pointer on `pool`" );
+
+    memset( pool, 0, sizeof( *pool ) );
+}
+
+void StringPoolDtor( StringPool_t* pool ) {
+    my_assert( pool, "Null pointer on `pool`" );
+
+    StringChunk_t* chunk = pool->chunks;
+    while ( chunk ) {
+        StringChunk_t* next = chunk->next;
+        free( chunk->data );
+        free( chunk );
+        chunk = next;
+    }
+
+    free( pool->slot_strings );
+    free( pool->slot_hashes );
+
+    memset( pool, 0, sizeof( *pool ) );
+}
+
+static uint32_t HashString( const char* string, size_t length ) {
+    uint32_t hash = 2166136261u;
+
+    for ( size_t idx = 0; idx < length; idx++ ) {
+        hash ^= ( unsigned char ) string[ idx ];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void Rehash( StringPool_t* pool, size_t new_capacity ) {
+    char**    new_strings = ( char** )    calloc ( new_capacity, sizeof( *new_strings ) );
+    uint32_t* new_hashes  = ( uint32_t* ) calloc ( new_capacity, sizeof( *new_hashes ) );
+    assert( new_strings && new_hashes && "Memory allocation error" );
+
+    for ( size_t idx = 0; idx < pool->capacity; idx++ ) {
+        if ( !pool->slot_strings[ idx ] )
+            continue;
+
+        size_t position = pool->slot_hashes[ idx ] & ( new_capacity - 1 );
+        while ( new_strings[ position ] )
+            position = ( position + 1 ) & ( new_capacity - 1 );
+
+        new_strings[ position ] = pool->slot_strings[ idx ];
+        new_hashes[ position ]  = pool->slot_hashes[ idx ];
+    }
+
+    free( pool->slot_strings );
+    free( pool->slot_hashes );
+
+    pool->slot_strings = new_strings;
+    pool->slot_hashes  = new_hashes;
+    pool->capacity     = new_capacity;
+}
+
+static size_t FindSlot( const StringPool_t* pool, const char* string, size_t length, uint32_t hash ) {
+    size_t mask     = pool->capacity - 1;
+    size_t position = hash & mask;
+
+    while ( pool->slot_strings[ position ] ) {
+        const char* candidate = pool->slot_strings[ position ];
+
+        // strncmp stops at the candidate's terminator: a shorter string with the same hash
+        // is not read past its end
+        if ( pool->slot_hashes[ position ] == hash &&
+             strncmp( candidate, string, length ) == 0 && candidate[ length ] == '\0' )
+            break;
+
+        position = ( position + 1 ) & mask;
+    }
+
+    return position;
+}
+
+void StringPoolReserve( StringPool_t* pool, size_t count ) {
+    my_assert( pool, "Null pointer on `pool`" );
+
+    size_t new_capacity = pool->capacity ? pool->capacity : INITIAL_SLOTS;
+    while ( ( pool->count + count ) * 4 > new_capacity * 3 )
+        new_capacity *= 2;
+
+    if ( new_capacity != pool->capacity ) {
+        Rehash( pool, new_capacity );
+    }
+}
+
+static char* StoreString( StringPool_t* pool, const char* string, size_t length ) {
+    StringChunk_t* chunk = pool->chunks;
+
+    if ( !chunk || chunk->capacity - chunk->used < length + 1 ) {
+        chunk = ( StringChunk_t* ) calloc ( 1, sizeof( *chunk ) );
+        assert( chunk && "Memory allocation error" );
+
+        chunk->capacity = length + 1 > STRING_CHUNK_SIZE ? length + 1 : STRING_CHUNK_SIZE;
+        chunk->data     = ( char* ) calloc ( chunk->capacity, sizeof( char ) );
+        assert( chunk->data && "Memory allocation error" );
+
+        chunk->next  = pool->chunks;
+        pool->chunks = chunk;
+    }
+
+    char* stored = chunk->data + chunk->used;
+    memcpy( stored, string, length );
+    stored[ length ] = '\0';
+
+    chunk->used        += length + 1;
+    pool->stored_bytes += length + 1;
+
+    return stored;
+}
+
+// Strings repeated in the table (no writer of ours makes them) stay apart from the first copy
+static void IndexTable( StringPool_t* pool ) {
+    char*  table      = pool->table;
+    size_t table_size = pool->table_size;
+
+    pool->table      = NULL;
+    pool->table_size = 0;
+
+    size_t string_count = 0;
+    for ( const char* end = table; ( end = ( const char* ) memchr( end, '\0', ( size_t ) ( table + table_size - end ) ) ); end++ )
+        string_count++;
+
+    StringPoolReserve( pool, string_count );
+
+    for ( char* string = table; string < table + table_size; ) {
+        size_t   length = strlen( string );
+        uint32_t hash   = HashString( string, length );
+        size_t   slot   = FindSlot( pool, string, length, hash );
+
+        if ( !pool->slot_strings[ slot ] ) {
+            pool->slot_strings[ slot ] = string;
+            pool->slot_hashes[ slot ]  = hash;
+            pool->count++;
+        }
+
+        string += length + 1;
+    }
+}
+
+void StringPoolShareTable( StringPool_t* pool, char* table, size_t table_size ) {
+    my_assert( pool,  "Null pointer on `pool`" );
+    my_assert( table, "Null pointer on `table`" );
+    my_assert( !pool->table, "The pool already shares a table" );
+
+    pool->table         = table;
+    pool->table_size    = table_size;
+    pool->shared_bytes += table_size;
+}
+
+// `in_place` is either NULL (copy the bytes) or `string` itself (reference it)
+static char* Intern( StringPool_t* pool, const char* string, size_t length, char* in_place ) {
+    my_assert( pool,   "Null pointer on `pool`" );
+    my_assert( string, "Null pointer on `string`" );
+
+    if ( pool->table ) {
+        IndexTable( pool );
+    }
+
+    // Load factor stays under 3/4
+    if ( ( pool->count + 1 ) * 4 > pool->capacity * 3 ) {
+        Rehash( pool, pool->capacity ? pool->capacity * 2 : INITIAL_SLOTS );
+    }
+
+    uint32_t hash = HashString( string, length );
+    size_t   slot = FindSlot( pool, string, length, hash );
+
+    if ( pool->slot_strings[ slot ] ) {
+        return pool->slot_strings[ slot ];
+    }
+
+    if ( in_place ) {
+        pool->slot_strings[ slot ] = in_place;
+        pool->shared_bytes += length + 1;
+    }
+    else {
+        pool->slot_strings[ slot ] = StoreString( pool, string, length );
+    }
+
+    pool->slot_hashes[ slot ] = hash;
+    pool->count++;
+
+    return pool->slot_strings[ slot ];
+}
+
+char* StringPoolIntern( StringPool_t* pool, const char* string, size_t length ) {
+    return Intern( pool, string, length, NULL );
+}
+
+// `string` must be '\0'-terminated at `length` and live as long as the pool
+char* StringPoolInternInPlace( StringPool_t* pool, char* string, size_t length ) {
+    return Intern( pool, string, length, string );
+}
+
+char* StringPoolFind( StringPool_t* pool, const char* string, size_t length ) {
+    my_assert( pool,   "Null pointer on `pool`" );
+    my_assert( string, "Null pointer on `string`" );
+
+    if ( pool->table ) {
+        IndexTable( pool );
+    }
+
+    if ( pool->count == 0 ) {
+        return NULL;
+    }
+
+    return pool->slot_strings[ FindSlot( pool, string, length, HashString( string, length ) ) ];
+}
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "TaskPool.h"
+#include "DebugUtils.h"
+
+const int64_t TASK_DEQUE_MASK = ( int64_t ) TASK_DEQUE_CAPACITY - 1;
+
+static_assert( ( TASK_DEQUE_CAPACITY & ( TASK_DEQUE_CAPACITY - 1 ) ) == 0, "Deque capacity must be a power of two" );
+
+// Chase-Lev with the C11 orderings of Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient
+// Work-Stealing for Weak Memory Models"; fixed capacity, so no buffer swapping
+static bool DequePush( TaskWorker_t* worker, Task_t* task ) {
+    int64_t bottom = worker->bottom.load( std::memory_order_relaxed );
+    int64_t top    = worker->top.load( std::memory_order_acquire );
+
+    if ( bottom - top >= ( int64_t ) TASK_DEQUE_CAPACITY )
+        return false;
+
+    // A release store instead of the paper's release fence: the same ordering, and visible to TSan
+    worker->tasks[ bottom & TASK_DEQUE_MASK ].store( task, std::memory_order_relaxed );
+    worker->bottom.store( bottom + 1, std::memory_order_release );
+
+    return true;
+}
+
+static Task_t* DequePop( TaskWorker_t* worker ) {
+    int64_t bottom = worker->bottom.load( std::memory_order_relaxed ) - 1;
+    worker->bottom.store( bottom, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    int64_t top = worker->top.load( std::memory_order_relaxed );
+
+    if ( top > bottom ) {
+        worker->bottom.store( bottom + 1, std::memory_order_relaxed );
+        return NULL;
+    }
+
+    Task_t* task = worker->tasks[ bottom & TASK_DEQUE_MASK ].load( std::memory_order_relaxed );
+
+    if ( top == bottom ) {
+        // The last task: race the thieves for it
+        if ( !worker->top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+            task = NULL;
+        worker->bottom.store( bottom + 1, std::memory_order_relaxed );
+    }
+
+    return task;
+}
+
+static Task_t* DequeSteal( TaskWorker_t* worker ) {
+    int64_t top = worker->top.load( std::memory_order_acquire );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    int64_t bottom = worker->bottom.load( std::memory_order_acquire );
+
+    if ( top >= bottom )
+        return NULL;
+
+    Task_t* task = worker->tasks[ top & TASK_DEQUE_MASK ].load( std::memory_order_relaxed );
+
+    if ( !worker->top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+        return NULL;
+
+    return task;
+}
+
+static Task_t* StealFromOthers( TaskPool_t* pool, size_t worker ) {
+    TaskWorker_t* self = &( pool->workers[ worker ] );
+
+    // xorshift64
+    self->random ^= self->random << 13;
+    self->random ^= self->random >> 7;
+    self->random ^= self->random << 17;
+
+    size_t start = self->random % pool->threads;
+
+    for ( size_t step = 0; step < pool->threads; step++ ) {
+        size_t victim = ( start + step ) % pool->threads;
+        if ( victim == worker )
+            continue;
+
+        Task_t* task = DequeSteal( &( pool->workers[ victim ] ) );
+        if ( task )
+            return task;
+    }
+
+    return NULL;
+}
+
+// Runs tasks until every task of the current run has finished
+static void WorkLoop( TaskPool_t* pool, size_t worker ) {
+    bool searching = false;
+
+    while ( true ) {
+        Task_t* task = DequePop( &( pool->workers[ worker ] ) );
+        if ( !task )
+            task = StealFromOthers( pool, worker );
+
+        if ( task ) {
+            if ( searching ) {
+                pool->searching.fetch_sub( 1, std::memory_order_relaxed );
+                searching = false;
+            }
+
+            task->run( task, worker );
+            pool->pending.fetch_sub( 1, std::memory_order_acq_rel );
+            continue;
+        }
+
+        if ( pool->pending.load( std::memory_order_acquire ) == 0 )
+            break;
+
+        if ( !searching ) {
+            pool->searching.fetch_add( 1, std::memory_order_relaxed );
+            searching = true;
+        }
+
+        sched_yield();
+    }
+
+    if ( searching )
+        pool->searching.fetch_sub( 1, std::memory_order_relaxed );
+}
+
+struct HelperStart_t {
+    TaskPool_t* pool;
+    size_t      worker;
+};
+
+static void* RunHelper( void* argument ) {
+    HelperStart_t start = *( HelperStart_t* ) argument;
+    free( argument );
+
+    TaskPool_t* pool = start.pool;
+    uint64_t    seen = 0;
+
+    while ( true ) {
+        pthread_mutex_lock( &( pool->lock ) );
+        while ( !pool->stopping && pool->generation == seen )
+            pthread_cond_wait( &( pool->wake ), &( pool->lock ) );
+
+        seen = pool->generation;
+        bool stopping = pool->stopping;
+        pthread_mutex_unlock( &( pool->lock ) );
+
+        if ( stopping )
+            break;
+
+        WorkLoop( pool, start.worker );
+
+        pthread_mutex_lock( &( pool->lock ) );
+        if ( --pool->active == 0 )
+            pthread_cond_signal( &( pool->done ) );
+        pthread_mutex_unlock( &( pool->lock ) );
+    }
+
+    return NULL;
+}
+
+TaskPool_t* TaskPoolCtor( size_t threads ) {
+    if ( threads == 0 ) {
+        long online = sysconf( _SC_NPROCESSORS_ONLN );
+        threads = ( online > 0 ) ? ( size_t ) online : 1;
+    }
+    if ( threads > TASK_POOL_MAX_THREADS )
+        threads = TASK_POOL_MAX_THREADS;
+
+    TaskPool_t* pool = ( TaskPool_t* ) calloc ( 1, sizeof( *pool ) );
+    assert( pool && "Memory allocation error" );
+
+    pool->workers = ( TaskWorker_t* ) aligned_alloc( alignof( TaskWorker_t ), threads * sizeof( TaskWorker_t ) );
+    assert( pool->workers && "Memory allocation error" );
+    memset( ( void* ) pool->workers, 0, threads * sizeof( TaskWorker_t ) );
+
+    for ( size_t idx = 0; idx < threads; idx++ )
+        pool->workers[ idx ].random = 0x9E3779B97F4A7C15ull * ( idx + 1 );
+
+    pool->handles = ( pthread_t* ) calloc ( threads, sizeof( pthread_t ) );
+    assert( pool->handles && "Memory allocation error" );
+
+    pthread_mutex_init( &( pool->run_lock ), NULL );
+    pthread_mutex_init( &( pool->lock ), NULL );
+    pthread_cond_init( &( pool->wake ), NULL );
+    pthread_cond_init( &( pool->done ), NULL );
+
+    // Worker 0 is whoever calls TaskPoolRun; a helper that fails to start just leaves a smaller pool
+    pool->threads = 1;
+    for ( size_t idx = 1; idx < threads; idx++ ) {
+        HelperStart_t* start = ( HelperStart_t* ) calloc ( 1, sizeof( *start ) );
+        assert( start && "Memory allocation error" );
+
+        start->pool   = pool;
+        start->worker = idx;
+
+        if ( pthread_create( &( pool->handles[ idx ] ), NULL, RunHelper, start ) != 0 ) {
+            free( start );
+            break;
+        }
+
+        pool->threads++;
+    }
+
+    return pool;
+}
+
+void TaskPoolDtor( TaskPool_t** pool ) {
+    my_assert( pool, "Null pointer on `pool`" );
+
+    if ( !*pool )
+        return;
+
+    TaskPool_t* self = *pool;
+
+    pthread_mutex_lock( &( self->lock ) );
+    self->stopping = true;
+    pthread_cond_broadcast( &( self->wake ) );
+    pthread_mutex_unlock( &( self->lock ) );
+
+    for ( size_t idx = 1; idx < self->threads; idx++ )
+        pthread_join( self->handles[ idx ], NULL );
+
+    pthread_cond_destroy( &( self->done ) );
+    pthread_cond_destroy( &( self->wake ) );
+    pthread_mutex_destroy( &( self->lock ) );
+    pthread_mutex_destroy( &( self->run_lock ) );
+
+    free( self->handles );
+    free( ( void* ) self->workers );
+    free( self );
+
+    *pool = NULL;
+}
+
+static TaskPool_t*    shared_pool      = NULL;
+static pthread_once_t shared_pool_once = PTHREAD_ONCE_INIT;
+
+static void DestroySharedPool() {
+    TaskPoolDtor( &shared_pool );
+}
+
+static void CreateSharedPool() {
+    const char* threads = getenv( "AKINATOR_THREADS" );
+
+    shared_pool = TaskPoolCtor( threads ? strtoul( threads, NULL, 10 ) : 0 );
+    atexit( DestroySharedPool );
+}
+
+TaskPool_t* TaskPoolShared() {
+    pthread_once( &shared_pool_once, CreateSharedPool );
+
+    return shared_pool;
+}
+
+void TaskPoolRun( TaskPool_t* pool, Task_t* task ) {
+    my_assert( pool && task, "Null pointer on argument" );
+
+    pthread_mutex_lock( &( pool->run_lock ) );
+
+    pool->pending.store( 1, std::memory_order_relaxed );
+    DequePush( &( pool->workers[ 0 ] ), task );
+
+    if ( pool->threads > 1 ) {
+        pthread_mutex_lock( &( pool->lock ) );
+        pool->active = pool->threads - 1;
+        pool->generation++;
+        pthread_cond_broadcast( &( pool->wake ) );
+        pthread_mutex_unlock( &( pool->lock ) );
+    }
+
+    WorkLoop( pool, 0 );
+
+    // Helpers may still be polling the deques; the tasks are not to be freed until they stop
+    pthread_mutex_lock( &( pool->lock ) );
+    while ( pool->active > 0 )
+        pthread_cond_wait( &( pool->done ), &( pool->lock ) );
+    pthread_mutex_unlock( &( pool->lock ) );
+
+    pthread_mutex_unlock( &( pool->run_lock ) );
+}
+
+bool TaskPoolSpawn( TaskPool_t* pool, size_t worker, Task_t* task ) {
+    my_assert( pool && task, "Null pointer on argument" );
+
+    pool->pending.fetch_add( 1, std::memory_order_relaxed );
+
+    if ( DequePush( &( pool->workers[ worker ] ), task ) )
+        return true;
+
+    pool->pending.fetch_sub( 1, std::memory_order_relaxed );
+    return false;
+}
+
+bool TaskPoolHungry( TaskPool_t* pool, size_t worker ) {
+    my_assert( pool, "Null pointer on `pool`" );
+
+    if ( pool->searching.load( std::memory_order_relaxed ) == 0 )
+        return false;
+
+    TaskWorker_t* self = &( pool->workers[ worker ] );
+
+    return self->bottom.load( std::memory_order_relaxed ) <= self->top.load( std::memory_order_relaxed );
+}
@@ -5,12 +5,19 @@
 #include <stdint.h>
 #include <assert.h>
 #include <string.h>
-#include <ctype.h>
+#include <errno.h>
 
 #include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "Tree.h"
+#include "TreeParser.h"
+#include "TreeBinary.h"
+#include "TreeWalk.h"
+#include "TreeSvg.h"
 #include "DebugUtils.h"
+#include "Metrics.h"
 #include "UtilsRW.h"
 
 const uint32_t fill_color = 0xb6b4b4;
@@ -19,34 +26,57 @@ Tree_t* TreeCtor() {
     Tree_t* new_tree = ( Tree_t* ) calloc ( 1, sizeof( *new_tree ) );
     assert( new_tree && "Mempry allocation error" );
 
-    #ifdef _DEBUG
-        new_tree->image_number = 0;
-        new_tree->logging.log_path = strdup( "dump" );
+    StringPoolCtor( &( new_tree->strings ) );
+    ObjectIndexCtor( &( new_tree->objects ) );
+    NameIndexCtor( &( new_tree->names ) );
+    CompactTreeCtor( &( new_tree->compact ) );
+    TreeRcuCtor( &( new_tree->rcu ) );
 
-        char buffer[ MAX_LEN_PATH ] = {};
+    return new_tree;
+}
 
-        snprintf( buffer, MAX_LEN_PATH, "%s/images", new_tree->logging.log_path );
-        new_tree->logging.img_log_path = strdup( buffer );
+static void AddSlab( NodeArena_t* arena, size_t capacity ) {
+    NodeSlab_t* slab = ( NodeSlab_t* ) calloc ( 1, sizeof( *slab ) );
+    assert( slab && "Memory allocation error" );
 
-        int mkdir_result = MakeDirectory( new_tree->logging.log_path );
-        assert( !mkdir_result );
-        mkdir_result = MakeDirectory( new_tree->logging.img_log_path );
-        assert( !mkdir_result );
+    slab->nodes = ( Node_t* ) calloc ( capacity, sizeof( *( slab->nodes ) ) );
+    assert( slab->nodes && "Memory allocation error" );
 
-        snprintf( buffer, MAX_LEN_PATH, "%s/index.html", new_tree->logging.log_path );
-        new_tree->logging.log_file = fopen( buffer, "w" );
-        assert( new_tree && "Error opening file" );
-    #endif
-
-    return new_tree;
+    slab->capacity = capacity;
+    slab->next     = arena->slabs;
+    arena->slabs   = slab;
 }
 
-TreeStatus_t TreeDtor( Tree_t **tree, void  ( *clean_function ) ( char* value, Tree_t* tree ) ) {
+TreeStatus_t TreeDtor( Tree_t **tree ) {
     my_assert( tree, "Null pointer on `tree`" );
 
-    NodeDelete( ( *tree )->root, *tree, clean_function );
+    // Values belong to the string pool and the buffer, so nodes are dropped slab by slab
+    NodeSlab_t* slab = ( *tree )->arena.slabs;
+    while ( slab ) {
+        NodeSlab_t* next = slab->next;
+        free( slab->nodes );
+        free( slab );
+        slab = next;
+    }
+
+    StringPoolDtor( &( ( *tree )->strings ) );
+    ObjectIndexDtor( &( ( *tree )->objects ) );
+    NameIndexDtor( &( ( *tree )->names ) );
+    CompactTreeDtor( &( ( *tree )->compact ) );
+    TreeRcuDtor( &( ( *tree )->rcu ) );
+
+    if ( ( *tree )->buffer_is_mapped ) {
+        UnmapFile( ( *tree )->buffer, ( *tree )->buffer_size );
+    }
+    else {
+        free( ( *tree )->buffer );
+    }
+    if ( ( *tree )->render )
+        TreeRenderDtor( &( ( *tree )->render ) );
+
+    if ( ( *tree )->logging.log_file )
+        fclose( ( *tree )->logging.log_file );
 
-    free( ( *tree )->buffer );
     free( ( *tree )->logging.img_log_path );
     free( ( *tree )->logging.log_path );
 
@@ -56,34 +86,407 @@ TreeStatus_t TreeDtor( Tree_t **tree, void  ( *clean_function ) ( char* value, T
     return SUCCESS;
 }
 
-Node_t* NodeCreate( const TreeData_t field, Node_t* parent ) {
-    Node_t* new_node = ( Node_t* ) calloc ( 1, sizeof( *new_node ) );
-    assert( new_node && "Memory allocation error" );
+void TreeReserveNodes( Tree_t* tree, size_t count ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    NodeSlab_t* slab = tree->arena.slabs;
+
+    if ( !slab || slab->capacity - slab->used < count ) {
+        AddSlab( &( tree->arena ), count > NODE_SLAB_SIZE ? count : NODE_SLAB_SIZE );
+    }
+}
+
+Node_t* NodeCreate( Tree_t* tree, const TreeData_t field, Node_t* parent ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    NodeArena_t* arena    = &( tree->arena );
+    Node_t*      new_node = NULL;
+
+    if ( arena->free_list ) {
+        new_node         = arena->free_list;
+        arena->free_list = new_node->right;
+        memset( new_node, 0, sizeof( *new_node ) );
+    }
+    else {
+        if ( !arena->slabs || arena->slabs->used == arena->slabs->capacity ) {
+            AddSlab( arena, NODE_SLAB_SIZE );
+        }
+
+        new_node = &( arena->slabs->nodes[ arena->slabs->used++ ] );
+    }
+
+    arena->live++;
 
     new_node->value  = field;
     new_node->parent = parent;
+    new_node->leaves = 1;
 
     return new_node;
 }
 
-TreeStatus_t NodeDelete( Node_t* node, Tree_t* tree, void ( *clean_function ) ( char* value, Tree_t* tree ) ) {
+// `live` counts reachable nodes only, so it is left to the caller
+static void ReturnToArena( NodeArena_t* arena, Node_t* node ) {
+    memset( node, 0, sizeof( *node ) );
+
+    node->right = arena->free_list;
+    arena->free_list = node;
+}
+
+void NodeFree( Tree_t* tree, Node_t* node ) {
+    my_assert( tree, "Null pointer on `tree`" );
     my_assert( node, "Null pointer on `node`" );
 
-    if ( node->left != NULL ) {
-        NodeDelete( node->left, tree, clean_function );
+    // NodeDelete unlinks children first, so every node of a deleted subtree passes here as a leaf
+    if ( !node->left && !node->right ) {
+        ObjectIndexRemove( &( tree->objects ), node );
+        NameIndexRemove( &( tree->names ), node );
     }
 
-    if ( node->right != NULL ) {
-        NodeDelete( node->right, tree, clean_function );
-    }
+    ReturnToArena( &( tree->arena ), node );
+    tree->arena.live--;
+}
+
+// A node without children is an object itself
+static uint32_t LeavesBelow( const Node_t* node ) {
+    if ( !node->left && !node->right )
+        return 1;
 
-    clean_function( node->value, tree );
+    return ( node->left ? node->left->leaves : 0 ) + ( node->right ? node->right->leaves : 0 );
+}
 
-    free( node );
+TreeStatus_t NodeDelete( Node_t* node, Tree_t* tree ) {
+    my_assert( node, "Null pointer on `node`" );
+
+    // Slots of a removed subtree are not reclaimed in place, the next use lays the tree out anew
+    tree->compact.built = false;
+
+    // Post-order walk over parent links: no recursion, so list-shaped trees of any depth are fine
+    Node_t* subtree_parent = node->parent;
+    Node_t* current        = node;
+
+    while ( current != subtree_parent ) {
+        if ( current->left != NULL ) {
+            current = current->left;
+            continue;
+        }
+
+        if ( current->right != NULL ) {
+            current = current->right;
+            continue;
+        }
+
+        Node_t* parent = ( current == node ) ? subtree_parent : current->parent;
+
+        if ( current != node ) {
+            if ( parent->left == current )
+                parent->left  = NULL;
+            else
+                parent->right = NULL;
+        }
+
+        NodeFree( tree, current );
+
+        current = parent;
+    }
+
+    for ( Node_t* ancestor = subtree_parent; ancestor; ancestor = ancestor->parent )
+        ancestor->leaves = LeavesBelow( ancestor );
 
     return SUCCESS;
 }
 
+// `leaf` is replaced by a new question node whose children are a copy of `leaf` and a new
+// object leaf. Nothing a reader can reach is written but the one link to the question, stored
+// once the three nodes are complete; `leaf` itself is retired unchanged.
+Node_t* TreeSplitLeaf( Tree_t* tree, Node_t* leaf, const char* question, const char* object, bool object_is_left ) {
+    my_assert( tree && leaf, "Null pointer on `tree` or `leaf`" );
+    my_assert( question && object, "Null pointer on new data" );
+
+    TreeRcuWriteBegin( &( tree->rcu ) );
+
+    Node_t* parent        = leaf->parent;
+    Node_t* question_node = NodeCreate( tree, StringPoolIntern( &( tree->strings ), question, strlen( question ) ), parent );
+    Node_t* object_node   = NodeCreate( tree, StringPoolIntern( &( tree->strings ), object,   strlen( object ) ),   question_node );
+    Node_t* copy          = NodeCreate( tree, leaf->value, question_node );
+
+    // Games still inside the old leaf may count into it, those counts stay with it
+    copy->visits  = __atomic_load_n( &( leaf->visits ),  __ATOMIC_RELAXED );
+    copy->guessed = __atomic_load_n( &( leaf->guessed ), __ATOMIC_RELAXED );
+    copy->missed  = __atomic_load_n( &( leaf->missed ),  __ATOMIC_RELAXED );
+
+    if ( object_is_left ) {
+        question_node->left  = object_node;
+        question_node->right = copy;
+    } else {
+        question_node->right = object_node;
+        question_node->left  = copy;
+    }
+
+    // Leaves have no descendants, so these three are the only nodes whose ancestors changed
+    NodeLink( question_node );
+    NodeLink( copy );
+    NodeLink( object_node );
+
+    Node_t** link = !parent              ? &( tree->root )
+                  : parent->left == leaf ? &( parent->left )
+                  :                        &( parent->right );
+
+    __atomic_store_n( link, question_node, __ATOMIC_RELEASE );
+
+    // Only the writer reads the counts, readers never see them change
+    question_node->leaves = 2;
+    for ( Node_t* ancestor = parent; ancestor; ancestor = ancestor->parent )
+        ancestor->leaves++;
+
+    CompactTreeSplitLeaf( &( tree->compact ), leaf, copy );
+
+    ObjectIndexReplace( &( tree->objects ), leaf, copy );
+    NameIndexReplace( &( tree->names ), leaf, copy );
+    ObjectIndexInsert( &( tree->objects ), object_node );
+    NameIndexInsert( &( tree->names ), object_node );
+
+    tree->arena.live--;
+    TreeRcuRetire( &( tree->rcu ), leaf );
+
+    Node_t** reclaimable = NULL;
+    size_t   count       = TreeRcuCollect( &( tree->rcu ), &reclaimable );
+
+    for ( size_t idx = 0; idx < count; idx++ )
+        ReturnToArena( &( tree->arena ), reclaimable[ idx ] );
+
+    TreeRcuWriteEnd( &( tree->rcu ) );
+
+    return question_node;
+}
+
+// Jump pointers after Myers, "An applicative random-access stack": if the jumps of the parent
+// and of its jump cover equal depth ranges, the node jumps over both, otherwise to its parent.
+// Must be called after the parent's.
+void NodeLink( Node_t* node ) {
+    my_assert( node, "Null pointer on `node`" );
+
+    Node_t* parent = node->parent;
+
+    if ( !parent ) {
+        node->depth = 0;
+        node->jump  = node;
+        return;
+    }
+
+    node->depth = parent->depth + 1;
+
+    Node_t* jump = parent->jump;
+    if ( parent->depth - jump->depth == jump->depth - jump->jump->depth )
+        node->jump = jump->jump;
+    else
+        node->jump = parent;
+}
+
+const Node_t* NodeAncestorAtDepth( const Node_t* node, size_t depth ) {
+    my_assert( node, "Null pointer on `node`" );
+    my_assert( depth <= node->depth, "Ancestor below the node" );
+
+    while ( node->depth > depth ) {
+        node = ( node->jump->depth >= depth ) ? node->jump : node->parent;
+    }
+
+    return node;
+}
+
+// Nodes of equal depth have jumps of equal depth: while the jumps differ the common
+// ancestor is above them, so both take the jump; otherwise both step to the parent
+const Node_t* NodeCommonAncestor( const Node_t* first, const Node_t* second ) {
+    my_assert( first && second, "Null pointer on node" );
+
+    if ( first->depth > second->depth )
+        first  = NodeAncestorAtDepth( first, second->depth );
+    else
+        second = NodeAncestorAtDepth( second, first->depth );
+
+    while ( first != second ) {
+        if ( first->jump != second->jump ) {
+            first  = first->jump;
+            second = second->jump;
+        }
+        else {
+            first  = first->parent;
+            second = second->parent;
+        }
+    }
+
+    return first;
+}
+
+// Writes the nodes from `ancestor` down to `node` into `path` (node->depth - ancestor->depth + 1
+// of them), returns their number
+size_t NodePathFrom( const Node_t* ancestor, const Node_t* node, const Node_t** path ) {
+    my_assert( ancestor && node && path, "Null pointer on argument" );
+    my_assert( ancestor->depth <= node->depth, "Ancestor below the node" );
+
+    size_t length = node->depth - ancestor->depth + 1;
+
+    for ( size_t idx = length; idx > 0; idx-- ) {
+        path[ idx - 1 ] = node;
+        node = node->parent;
+    }
+
+    MetricsEvent( COUNTER_PATHS, COUNTER_PATH_NODES, length );
+
+    return length;
+}
+
+Node_t* TreeFirstLeaf( Node_t* node ) {
+    while ( node && ( node->left || node->right ) )
+        node = node->left ? node->left : node->right;
+
+    return node;
+}
+
+// Next leaf of the subtree of `root` in preorder, over the parent links
+Node_t* TreeNextLeaf( Node_t* root, Node_t* leaf ) {
+    my_assert( leaf, "Null pointer on `leaf`" );
+
+    Node_t* node = leaf;
+
+    while ( node != root ) {
+        Node_t* parent = node->parent;
+
+        if ( node == parent->left && parent->right )
+            return TreeFirstLeaf( parent->right );
+
+        node = parent;
+    }
+
+    return NULL;
+}
+
+// Hashing every name costs as much as a binary open itself, so it waits for the first lookup.
+// Threads sharing the tree must have it built before they start.
+const ObjectIndex_t* TreeObjectIndex( Tree_t* tree ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    if ( !tree->objects.built ) {
+        ObjectIndexBuild( &( tree->objects ), tree->root );
+    }
+
+    return &( tree->objects );
+}
+
+// Sorting all names costs more than a whole binary open, so it waits for the first search by name
+NameIndex_t* TreeNameIndex( Tree_t* tree ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    if ( !tree->names.built ) {
+        NameIndexBuild( &( tree->names ), tree->root, tree->root ? tree->root->leaves : 0 );
+    }
+
+    return &( tree->names );
+}
+
+const CompactTree_t* TreeCompactTree( Tree_t* tree ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    if ( !tree->compact.built || CompactTreeNeedsRelayout( &( tree->compact ) ) ) {
+        CompactTreeBuild( &( tree->compact ), tree->root );
+    }
+
+    return &( tree->compact );
+}
+
+struct alignas( 64 ) StatsSlot_t {
+    TreeStats_t stats;
+};
+
+static bool CountNode( TreeWalkCursor_t* cursor, const Node_t* node ) {
+    TreeStats_t* stats = &( ( ( StatsSlot_t* ) cursor->walk->data )[ cursor->worker ].stats );
+
+    stats->nodes++;
+    stats->text_bytes += node->value ? strlen( node->value ) : 0;
+
+    if ( !NodeLeft( node ) && !NodeRight( node ) ) {
+        stats->objects++;
+        stats->object_depth_sum += node->depth;
+
+        if ( node->depth > stats->max_depth )
+            stats->max_depth = node->depth;
+    }
+
+    return true;
+}
+
+void TreeCollectStats( const Tree_t* tree, TreeStats_t* stats ) {
+    my_assert( tree && stats, "Null pointer on argument" );
+
+    TreeWalk_t walk = {};
+    walk.enter = CountNode;
+    walk.pool  = TaskPoolShared();
+    walk.rcu   = &( tree->rcu );
+
+    // One slot per worker, a cache line each, summed at the end
+    StatsSlot_t* slots = ( StatsSlot_t* ) aligned_alloc( alignof( StatsSlot_t ), walk.pool->threads * sizeof( StatsSlot_t ) );
+    assert( slots && "Memory allocation error" );
+    memset( slots, 0, walk.pool->threads * sizeof( StatsSlot_t ) );
+
+    walk.data = slots;
+    TreeWalkRun( &walk, TreeRoot( tree ) );
+    TreeWalkFree( &walk );
+
+    memset( stats, 0, sizeof( *stats ) );
+
+    for ( size_t idx = 0; idx < walk.pool->threads; idx++ ) {
+        stats->nodes            += slots[ idx ].stats.nodes;
+        stats->objects          += slots[ idx ].stats.objects;
+        stats->object_depth_sum += slots[ idx ].stats.object_depth_sum;
+        stats->text_bytes       += slots[ idx ].stats.text_bytes;
+
+        if ( slots[ idx ].stats.max_depth > stats->max_depth )
+            stats->max_depth = slots[ idx ].stats.max_depth;
+    }
+
+    free( slots );
+}
+
+struct FindLeaf_t {
+    bool  ( *match )( const Node_t* leaf, void* argument );
+    void* argument;
+
+    std::atomic<const Node_t*> found;
+};
+
+static bool MatchLeaf( TreeWalkCursor_t* cursor, const Node_t* node ) {
+    if ( NodeLeft( node ) || NodeRight( node ) )
+        return true;
+
+    FindLeaf_t* find = ( FindLeaf_t* ) cursor->walk->data;
+    if ( !find->match( node, find->argument ) )
+        return true;
+
+    const Node_t* expected = NULL;
+    find->found.compare_exchange_strong( expected, node, std::memory_order_relaxed );
+
+    return false;
+}
+
+const Node_t* TreeFindLeaf( const Tree_t* tree, bool ( *match )( const Node_t* leaf, void* argument ), void* argument ) {
+    my_assert( tree && match, "Null pointer on argument" );
+
+    FindLeaf_t find = {};
+    find.match    = match;
+    find.argument = argument;
+    find.found.store( NULL, std::memory_order_relaxed );
+
+    TreeWalk_t walk = {};
+    walk.enter = MatchLeaf;
+    walk.data  = &find;
+    walk.rcu   = &( tree->rcu );
+
+    TreeWalkRun( &walk, TreeRoot( tree ) );
+    TreeWalkFree( &walk );
+
+    return find.found.load( std::memory_order_relaxed );
+}
+
+#ifdef _DEBUG
 static uint32_t my_crc32_ptr( const void *ptr ) {
     uintptr_t val = ( uintptr_t ) ptr;
     uint32_t  crc = 0xFFFFFFFF;
@@ -101,39 +504,30 @@ static uint32_t my_crc32_ptr( const void *ptr ) {
 
     return crc ^ 0xFFFFFFFF;
 }
+#endif
 
-void TreeDump( Tree_t* tree, const char* format_string, ... ) {
-    my_assert( tree, "Null pointer on `tree`" );
+// DOT text goes into the output of a tree walk or straight into a file
+struct DotOutput_t {
+    TreeWalkCursor_t* cursor;
+    FILE*             stream;
+};
 
-    #define PRINT_HTML( format, ... ) fprintf( tree->logging.log_file, format, ##__VA_ARGS__ );
+static void DotPrintf( DotOutput_t* output, const char* format, ... ) __attribute__(( format( printf, 2, 3 ) ));
 
-    PRINT_HTML( "<h3> DUMP" );
+static void DotPrintf( DotOutput_t* output, const char* format, ... ) {
     va_list args = {};
-    va_start( args, format_string );
-    vfprintf( tree->logging.log_file, format_string, args );
-    va_end( args );
-    PRINT_HTML( "</H3>\n" );
-
-    NodeGraphicDump(
-        tree->root, "%s/image%lu.dot",
-        tree->logging.img_log_path, tree->image_number
-    );
+    va_start( args, format );
 
-    PRINT_HTML(
-        "<img src=\"images/image%lu.dot.svg\" height=\"200px\">\n",
-        tree->image_number++
-    );
+    if ( output->cursor )
+        TreeWalkVPrintf( output->cursor, format, args );
+    else
+        vfprintf( output->stream, format, args );
 
-    #undef PRINT_HTML
+    va_end( args );
 }
 
-
-static void NodeDumpRecursively( const Node_t* node, FILE* dot_stream ) {
-    if ( node == NULL ) {
-        return;
-    }
-
-    #define DOT_PRINT( format, ... ) fprintf( dot_stream, format, ##__VA_ARGS__ );
+static void WriteNodeDot( DotOutput_t* output, const Node_t* node ) {
+    #define DOT_PRINT( format, ... ) DotPrintf( output, format, ##__VA_ARGS__ );
 
     #ifdef _DEBUG
         DOT_PRINT( "\tnode_%lX [shape=plaintext; style=filled; color=black; fillcolor=\"#%X\"; label=< \n",
@@ -205,145 +599,628 @@ static void NodeDumpRecursively( const Node_t* node, FILE* dot_stream ) {
     if ( node->left != NULL ) {
         DOT_PRINT( "\tnode_%lX:left:s->node_%lX\n",
                   ( uintptr_t ) node, ( uintptr_t ) node->left );
-        NodeDumpRecursively( node->left, dot_stream );
     }
 
     if ( node->right != NULL ) {
         DOT_PRINT( "\tnode_%lX:right:s->node_%lX\n",
                   ( uintptr_t )node, ( uintptr_t ) node->right );
-        NodeDumpRecursively( node->right, dot_stream );
     }
 
     #undef DOT_PRINT
 }
 
-void NodeGraphicDump( const Node_t* node, const char* image_path_name, ... ) {
+// Boxes and edges come out in preorder, as the old recursive dump wrote them, but through a
+// tree walk: no recursion depth limit, and large trees are formatted in parallel
+static bool DumpNode( TreeWalkCursor_t* cursor, const Node_t* node ) {
+    DotOutput_t output = { cursor, NULL };
+    WriteNodeDot( &output, node );
+
+    return true;
+}
+
+static void WriteToStream( void* stream, const char* data, size_t length ) {
+    fwrite( data, 1, length, ( FILE* ) stream );
+}
+
+static void WalkDot( TreeWalk_t* walk, const Node_t* node ) {
+    walk->enter   = DumpNode;
+    walk->ordered = true;
+
+    TreeWalkRun( walk, node );
+}
+
+static uint64_t Fnv1a( uint64_t hash, const void* data, size_t size ) {
+    for ( size_t idx = 0; idx < size; idx++ ) {
+        hash ^= ( ( const unsigned char* ) data )[ idx ];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+struct alignas( 64 ) HashSlot_t {
+    uint64_t sum;
+};
+
+// Everything DumpNode prints of the node
+static uint64_t NodeHash( const Node_t* node ) {
+    const Node_t* links[] = { node, node->parent, node->left, node->right };
+
+    uint64_t hash = Fnv1a( 14695981039346656037ull, links, sizeof( links ) );
+    if ( node->value )
+        hash = Fnv1a( hash, node->value, strlen( node->value ) );
+
+    return hash;
+}
+
+// The per-node hashes are summed, so the order workers reach nodes in does not matter
+static bool HashNode( TreeWalkCursor_t* cursor, const Node_t* node ) {
+    ( ( HashSlot_t* ) cursor->walk->data )[ cursor->worker ].sum += NodeHash( node );
+
+    return true;
+}
+
+// Equal hashes - the same DOT text, so the same picture; a walk without the formatting
+static uint64_t HashDot( const Node_t* node ) {
+    TreeWalk_t walk = {};
+    walk.enter = HashNode;
+    walk.pool  = TaskPoolShared();
+
+    HashSlot_t* slots = ( HashSlot_t* ) aligned_alloc( alignof( HashSlot_t ), walk.pool->threads * sizeof( HashSlot_t ) );
+    assert( slots && "Memory allocation error" );
+    memset( slots, 0, walk.pool->threads * sizeof( HashSlot_t ) );
+
+    walk.data = slots;
+    TreeWalkRun( &walk, node );
+    TreeWalkFree( &walk );
+
+    uint64_t hash = 0;
+    for ( size_t idx = 0; idx < walk.pool->threads; idx++ )
+        hash += slots[ idx ].sum;
+
+    free( slots );
+
+    return hash;
+}
+
+static FILE* OpenDot( const char* dot_path ) {
+    FILE* dot_stream = fopen( dot_path, "w" );
+    assert(dot_stream && "File opening error");
+
+    fprintf( dot_stream, "digraph {\n\tsplines=line;\n" );
+
+    return dot_stream;
+}
+
+static void CloseDot( FILE* dot_stream ) {
+    fprintf( dot_stream, "}\n" );
+    fclose( dot_stream );
+}
+
+static void RenderDot( TreeRender_t* render, const char* dot_path ) {
+    char svg_path[ MAX_LEN_PATH ] = {};
+    snprintf( svg_path, MAX_LEN_PATH, "%s.svg", dot_path );
+
+    if ( render ) {
+        TreeRenderQueue( render, dot_path, svg_path );
+        return;
+    }
+
+    const char* arguments[] = { "dot", "-Tsvg", dot_path, "-o", svg_path, NULL };
+    pid_t       pid         = SpawnProcess( arguments, -1, -1 );
+
+    if ( pid != -1 )
+        WaitProcess( pid, 0 );
+}
+
+// One node after another in preorder, nothing is kept but the stack
+static void StreamDot( FILE* dot_stream, const Node_t* root ) {
+    DotOutput_t output = { NULL, dot_stream };
+
+    size_t         capacity = 64;
+    size_t         size     = 0;
+    const Node_t** stack    = ( const Node_t** ) calloc ( capacity, sizeof( *stack ) );
+    assert( stack && "Memory allocation error" );
+
+    stack[ size++ ] = root;
+
+    while ( size > 0 ) {
+        const Node_t* node = stack[ --size ];
+
+        WriteNodeDot( &output, node );
+
+        if ( size + 2 > capacity ) {
+            capacity *= 2;
+            stack     = ( const Node_t** ) realloc ( stack, capacity * sizeof( *stack ) );
+            assert( stack && "Memory allocation error" );
+        }
+
+        if ( node->right ) stack[ size++ ] = node->right;
+        if ( node->left )  stack[ size++ ] = node->left;
+    }
+
+    free( stack );
+}
+
+// Every question has both answers, so a subtree has 2 * leaves - 1 nodes
+static void WriteSubtreeDot( FILE* dot_stream, const Node_t* node ) {
+    if ( TaskPoolShared()->threads < 2 || 2 * ( size_t ) node->leaves > TREE_DOT_PARALLEL_MAX_NODES ) {
+        StreamDot( dot_stream, node );
+        return;
+    }
+
+    TreeWalk_t walk = {};
+    WalkDot( &walk, node );
+    TreeWalkDrain( &walk, WriteToStream, dot_stream );
+    TreeWalkFree( &walk );
+}
+
+static void WriteDot( TreeRender_t* render, const Node_t* node, const char* dot_path ) {
+    FILE* dot_stream = OpenDot( dot_path );
+    WriteSubtreeDot( dot_stream, node );
+    CloseDot( dot_stream );
+
+    RenderDot( render, dot_path );
+}
+
+// Under the name the log expects of a picture made from `dot_path`, though no DOT file is written
+static void QueueLayout( TreeRender_t* render, const Node_t* root, const char* dot_path ) {
+    char svg_path[ MAX_LEN_PATH ] = {};
+    snprintf( svg_path, MAX_LEN_PATH, "%s.svg", dot_path );
+
+    TreeRenderQueueLayout( render, TreeSvgLayoutCtor( root ), svg_path );
+}
+
+void NodeGraphicDump( TreeRender_t* render, const Node_t* node, const char* image_path_name, ... ) {
     if ( !node || !image_path_name )
         return;
 
     char dot_path[ MAX_LEN_PATH ] = {};
-    char svg_path[ MAX_LEN_PATH ] = {};
 
     va_list args;
     va_start(  args, image_path_name );
     vsnprintf( dot_path, MAX_LEN_PATH, image_path_name, args );
     va_end( args );
 
-    snprintf( svg_path, MAX_LEN_PATH, "%s.svg", dot_path );
+    WriteDot( render, node, dot_path );
+}
 
-    FILE* dot_stream = fopen( dot_path, "w" );
-    assert(dot_stream && "File opening error");
+void NodeDotWrite( const Node_t* node, const char* dot_path ) {
+    if ( !node || !dot_path )
+        return;
 
-    fprintf( dot_stream, "digraph {\n\tsplines=line;\n" );
-    NodeDumpRecursively( node, dot_stream );
-    fprintf( dot_stream, "}\n" );
+    FILE* dot_stream = OpenDot( dot_path );
+    WriteSubtreeDot( dot_stream, node );
+    CloseDot( dot_stream );
+}
 
-    fclose( dot_stream );
+FILE* TreeLogFile( Tree_t* tree ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    if ( tree->logging.log_file )
+        return tree->logging.log_file;
+
+    tree->logging.log_path = strdup( "dump" );
+
+    char buffer[ MAX_LEN_PATH ] = {};
+
+    snprintf( buffer, MAX_LEN_PATH, "%s/images", tree->logging.log_path );
+    tree->logging.img_log_path = strdup( buffer );
 
-    char cmd[ MAX_LEN_PATH * 2 ] = {};
-    snprintf( cmd, sizeof(cmd), "dot -Tsvg %s -o %s", dot_path, svg_path );
-    system( cmd );
+    int mkdir_result = MakeDirectory( tree->logging.log_path );
+    assert( !mkdir_result );
+    mkdir_result = MakeDirectory( tree->logging.img_log_path );
+    assert( !mkdir_result );
+
+    snprintf( buffer, MAX_LEN_PATH, "%s/index.html", tree->logging.log_path );
+    tree->logging.log_file = fopen( buffer, "w" );
+    assert( tree->logging.log_file && "Error opening file" );
+
+    return tree->logging.log_file;
 }
 
-static void WriteNode( const Node_t* node, FILE* stream ) {
-    if ( !node ) {
-        fprintf( stream, " nil" );
+static void LogDumpTitle( Tree_t* tree, const char* format_string, va_list args ) {
+    TreeLogFile( tree );
+
+    fprintf( tree->logging.log_file, "<h3> DUMP" );
+    vfprintf( tree->logging.log_file, format_string, args );
+    fprintf( tree->logging.log_file, "</H3>\n" );
+}
+
+static bool ImageIsCurrent( const Tree_t* tree, uint64_t hash ) {
+    return tree->has_image && tree->image_hash == hash;
+}
+
+// Starts the renderer on first use
+static void NextImage( Tree_t* tree, char* dot_path ) {
+    if ( !tree->render )
+        tree->render = TreeRenderCtor( 0 );
+
+    snprintf( dot_path, MAX_LEN_PATH, "%s/image%lu.dot", tree->logging.img_log_path, tree->image_number );
+}
+
+static void ImageDone( Tree_t* tree, uint64_t hash, bool has_svg ) {
+    tree->image_hash = hash;
+    tree->last_image = tree->image_number++;
+    tree->has_image  = true;
+    tree->image_svg  = has_svg;
+}
+
+static void LogImage( Tree_t* tree ) {
+    if ( !tree->has_image )
         return;
+
+    if ( tree->image_svg ) {
+        fprintf( tree->logging.log_file, "<img src=\"images/image%lu.dot.svg\" height=\"200px\">\n", tree->last_image );
     }
+    else {
+        fprintf( tree->logging.log_file, "<p>Graphviz не найден, только <a href=\"images/image%lu.dot\">DOT</a></p>\n",
+                 tree->last_image );
+    }
+}
 
-    fprintf( stream, "( \"%s\" ", node->value ? node->value : "" );
+// The picture goes into the log at once and is laid out in the background; a tree that
+// dumps as the last one did gets the last picture again, for one walk without formatting
+void TreeDump( Tree_t* tree, const char* format_string, ... ) {
+    my_assert( tree, "Null pointer on `tree`" );
 
-    WriteNode( node->left,  stream );
-    WriteNode( node->right, stream );
+    uint64_t start = MetricsStart();
 
-    fprintf( stream, " )" );
-}
+    va_list args = {};
+    va_start( args, format_string );
+    LogDumpTitle( tree, format_string, args );
+    va_end( args );
 
-void TreeSaveToFile( const Tree_t* tree, const char* filename ) {
-    my_assert( tree,     "Null pointer on tree" );
-    my_assert( filename, "Null pointer on filename" );
+    const Node_t* root = TreeRoot( tree );
+    uint64_t      hash = root ? HashDot( root ) : 0;
+
+    if ( root && !ImageIsCurrent( tree, hash ) ) {
+        char dot_path[ MAX_LEN_PATH ] = {};
+        NextImage( tree, dot_path );
 
-    FILE* file_with_base = fopen( filename, "w" );
-    my_assert( file_with_base, "Failed to open file for writing" );
+        // Large trees and machines without Graphviz get the built-in layout
+        if ( tree->arena.live >= TREE_SVG_MIN_NODES || !TreeRenderHasDot( tree->render ) ) {
+            QueueLayout( tree->render, root, dot_path );
+        }
+        else {
+            WriteDot( tree->render, root, dot_path );
+        }
 
-    WriteNode( tree->root, file_with_base );
+        ImageDone( tree, hash, true );
+    }
 
-    int result = fclose( file_with_base );
-    assert( !result && "Error while closing file with base" );
+    LogImage( tree );
 
-    fprintf( stdout, "База Акинатора была сохранена в base.txt \n" );
+    MetricsStop( TIMER_DUMP, start );
 }
 
-static void CleanSpace( char** position ) {
-    while ( isspace( **position ) )
-        ( *position )++;
+struct WindowNode_t {
+    const Node_t* node;
+    bool          folded;       // drawn as one box with the subtree's object count
+};
+
+struct Window_t {
+    WindowNode_t* nodes;
+    size_t        count;
+    size_t        capacity;
+};
+
+static void WindowAdd( Window_t* window, const Node_t* node, bool folded ) {
+    if ( window->count == window->capacity ) {
+        window->capacity = window->capacity ? window->capacity * 2 : 64;
+        window->nodes    = ( WindowNode_t* ) realloc ( window->nodes, window->capacity * sizeof( *( window->nodes ) ) );
+        assert( window->nodes && "Memory allocation error" );
+    }
+
+    // A leaf is as small folded as it is whole
+    window->nodes[ window->count++ ] = { node, folded && ( node->left || node->right ) };
 }
 
-static Node_t* NodeRead( Tree_t* tree, bool* error ){
-    CleanSpace( &(tree->current_position ) );
+// The ancestors of `focus` with whatever hangs off the path folded, then the subtree of
+// `focus` down to `levels` below it, folded past that. Nothing outside is touched.
+static void CollectWindow( Window_t* window, const Node_t* focus, size_t levels ) {
+    for ( const Node_t* child = focus, *ancestor = focus->parent; ancestor; child = ancestor, ancestor = ancestor->parent ) {
+        WindowAdd( window, ancestor, false );
 
-    if ( *( tree->current_position ) == '(' ) {
-        tree->current_position++;
+        const Node_t* other = ( ancestor->left == child ) ? ancestor->right : ancestor->left;
+        if ( other )
+            WindowAdd( window, other, true );
+    }
 
-        CleanSpace( &( tree->current_position ) );
+    struct Frame_t {
+        const Node_t* node;
+        size_t        level;
+    };
 
-        char* value_ptr = NULL;
+    size_t   capacity = 64;
+    size_t   size     = 0;
+    Frame_t* stack    = ( Frame_t* ) calloc ( capacity, sizeof( *stack ) );
+    assert( stack && "Memory allocation error" );
 
-        // // TODO: scanf...
-        if ( *( tree->current_position ) == '\"')
-        {
-            tree->current_position++;
-            value_ptr = tree->current_position;
+    stack[ size++ ] = { focus, 0 };
 
-            while (*( tree->current_position ) && *( tree->current_position ) != '\"') {
-                tree->current_position++;
-            }
+    while ( size > 0 ) {
+        Frame_t frame = stack[ --size ];
 
-            *( tree->current_position ) = '\0';
-            tree->current_position++;
+        if ( frame.level > levels ) {
+            WindowAdd( window, frame.node, true );
+            continue;
         }
-        Node_t* node = NodeCreate( value_ptr ? value_ptr : ( char* ) "", NULL );
 
-        // int read_bytes1 = 0;
-        // int read_bytes2 = 0;
-        // int scanf_result = sscanf( tree->current_position, "\"%n%*[^\"]\"%n", &read_bytes1, &read_bytes2 );
-        // if ( scanf_result != 2 ) {
-        //     *error = true;
-        //     return NULL;
-        // }
+        WindowAdd( window, frame.node, false );
 
-        // Node_t* node = NodeCreate( tree->current_position + read_bytes1, NULL );
-        // tree->current_position += read_bytes2;
-        // *( tree->current_position ++ ) = '\0';
+        if ( size + 2 > capacity ) {
+            capacity *= 2;
+            stack     = ( Frame_t* ) realloc ( stack, capacity * sizeof( *stack ) );
+            assert( stack && "Memory allocation error" );
+        }
 
+        if ( frame.node->right ) stack[ size++ ] = { frame.node->right, frame.level + 1 };
+        if ( frame.node->left )  stack[ size++ ] = { frame.node->left,  frame.level + 1 };
+    }
 
-        node->left = NodeRead( tree, error );
-        if (node->left) node->left->parent = node;
+    free( stack );
+}
 
-        node->right = NodeRead( tree, error );
-        if (node->right) node->right->parent = node;
+// Folded boxes change with their object count. Hashed over once more, so a window showing
+// the whole tree is not taken for the full dump's picture.
+static uint64_t HashWindow( const Window_t* window ) {
+    uint64_t sum = 0;
 
-        CleanSpace( &( tree->current_position ) );
+    for ( size_t idx = 0; idx < window->count; idx++ ) {
+        uint64_t hash = NodeHash( window->nodes[ idx ].node );
 
-        if ( *( tree->current_position ) == ')' ) tree->current_position++;
+        if ( window->nodes[ idx ].folded )
+            hash = Fnv1a( hash, &( window->nodes[ idx ].node->leaves ), sizeof( uint32_t ) );
 
-        return node;
+        sum += hash;
     }
 
-    if ( strncmp( tree->current_position, "nil", 3 ) == 0 ) {
-        tree->current_position += 3;
-        return NULL;
+    return Fnv1a( 14695981039346656037ull, &sum, sizeof( sum ) );
+}
+
+// A folded box takes the node's own name, so the edges its parent's box draws lead to it
+static void WriteWindowDot( TreeRender_t* render, const Window_t* window, const char* dot_path ) {
+    FILE*       dot_stream = OpenDot( dot_path );
+    DotOutput_t output     = { NULL, dot_stream };
+
+    for ( size_t idx = 0; idx < window->count; idx++ ) {
+        const Node_t* node = window->nodes[ idx ].node;
+
+        if ( !window->nodes[ idx ].folded ) {
+            WriteNodeDot( &output, node );
+            continue;
+        }
+
+        fprintf( dot_stream, "\tnode_%lX [shape=box; style=\"rounded,dashed,filled\"; fillcolor=\"#e9ecef\"; "
+                             "label=<%s<BR/><I>объектов: %u</I>>];\n",
+                 ( uintptr_t ) node, node->value, node->leaves );
     }
 
-    return NULL;
+    CloseDot( dot_stream );
+
+    RenderDot( render, dot_path );
 }
 
-void TreeReadFromFile( Tree_t* tree ) {
+void TreeDumpAround( Tree_t* tree, const Node_t* focus, size_t levels, const char* format_string, ... ) {
     my_assert( tree, "Null pointer on `tree`" );
 
-    tree->buffer_size = DetermineTheFileSize( "base.txt" );
+    uint64_t start = MetricsStart();
+
+    va_list args = {};
+    va_start( args, format_string );
+    LogDumpTitle( tree, format_string, args );
+    va_end( args );
 
-    FILE* file = fopen( "base.txt",  "r" );
+    if ( !focus )
+        focus = TreeRoot( tree );
+
+    if ( focus ) {
+        Window_t window = {};
+        CollectWindow( &window, focus, levels );
+
+        uint64_t hash = HashWindow( &window );
+
+        if ( !ImageIsCurrent( tree, hash ) ) {
+            char dot_path[ MAX_LEN_PATH ] = {};
+            NextImage( tree, dot_path );
+
+            // A window is small, but TreeSvg lays out whole subtrees only: without Graphviz
+            // the DOT file is all there is
+            WriteWindowDot( tree->render, &window, dot_path );
+            ImageDone( tree, hash, TreeRenderHasDot( tree->render ) );
+        }
+
+        free( window.nodes );
+    }
+
+    LogImage( tree );
+
+    MetricsStop( TIMER_DUMP, start );
+}
+
+const size_t SAVE_BUFFER_SIZE = 1 << 20;
+
+struct SaveBuffer_t {
+    int    fd;
+    char*  data;
+    size_t used;
+    size_t written;
+    bool   failed;
+};
+
+static void SaveBufferFlush( SaveBuffer_t* output ) {
+    if ( !output->failed && output->used > 0 && WriteAll( output->fd, output->data, output->used ) == -1 ) {
+        output->failed = true;
+    }
+
+    output->written += output->used;
+    output->used     = 0;
+}
+
+static void SaveBufferAppend( SaveBuffer_t* output, const char* data, size_t length ) {
+    if ( SAVE_BUFFER_SIZE - output->used < length ) {
+        SaveBufferFlush( output );
+
+        // A value longer than the whole buffer goes straight to the file
+        if ( length > SAVE_BUFFER_SIZE ) {
+            if ( !output->failed && WriteAll( output->fd, data, length ) == -1 )
+                output->failed = true;
+
+            output->written += length;
+            return;
+        }
+    }
+
+    memcpy( output->data + output->used, data, length );
+    output->used += length;
+}
+
+#define APPEND_LITERAL( output, literal ) SaveBufferAppend( output, literal, sizeof( literal ) - 1 )
+
+// Preorder over the parent links, no recursion and no stack: a node is opened on the
+// way down and closed on the way up, a missing child is written as " nil"
+static void WriteTree( SaveBuffer_t* output, const Node_t* root ) {
+    if ( !root ) {
+        APPEND_LITERAL( output, " nil" );
+        return;
+    }
+
+    const Node_t* node = root;
+
+    while ( true ) {
+        const char* value = node->value ? node->value : "";
+
+        APPEND_LITERAL( output, "( \"" );
+        SaveBufferAppend( output, value, strlen( value ) );
+        APPEND_LITERAL( output, "\" " );
+
+        if ( node->left ) {
+            node = node->left;
+            continue;
+        }
+        APPEND_LITERAL( output, " nil" );
+
+        if ( node->right ) {
+            node = node->right;
+            continue;
+        }
+        APPEND_LITERAL( output, " nil" );
+
+        while ( true ) {
+            APPEND_LITERAL( output, " )" );
+
+            if ( node == root )
+                return;
+
+            const Node_t* parent = node->parent;
+
+            if ( node == parent->left ) {
+                if ( parent->right )
+                    break;
+                APPEND_LITERAL( output, " nil" );
+            }
+
+            node = parent;
+        }
+
+        node = node->parent->right;
+    }
+}
+
+// The same text as WriteTree from a parallel walk: a node is opened on entering it, a missing
+// left child is written right away, a missing right one when the node is closed
+static bool SaveEnter( TreeWalkCursor_t* cursor, const Node_t* node ) {
+    const char* value = node->value ? node->value : "";
+
+    TreeWalkEmit( cursor, "( \"", 3 );
+    TreeWalkEmit( cursor, value, strlen( value ) );
+    TreeWalkEmit( cursor, "\" ", 2 );
+
+    if ( !node->left )
+        TreeWalkEmit( cursor, " nil", 4 );
+
+    return true;
+}
+
+static void SaveLeave( TreeWalkCursor_t* cursor, const Node_t* node ) {
+    if ( !node->right )
+        TreeWalkEmit( cursor, " nil", 4 );
+
+    TreeWalkEmit( cursor, " )", 2 );
+}
+
+static void SaveSink( void* output, const char* data, size_t length ) {
+    SaveBufferAppend( ( SaveBuffer_t* ) output, data, length );
+}
+
+static void WriteTreeInParallel( SaveBuffer_t* output, const Node_t* root, TaskPool_t* pool ) {
+    TreeWalk_t walk = {};
+    walk.enter   = SaveEnter;
+    walk.leave   = SaveLeave;
+    walk.ordered = true;
+    walk.pool    = pool;
+
+    TreeWalkRun( &walk, root );
+    TreeWalkDrain( &walk, SaveSink, output );
+    TreeWalkFree( &walk );
+}
+
+#undef APPEND_LITERAL
+
+TreeStatus_t TreeSaveToFile( const Tree_t* tree, const char* filename ) {
+    my_assert( tree,     "Null pointer on tree" );
+    my_assert( filename, "Null pointer on filename" );
+
+    char temporary_name[ MAX_LEN_PATH ] = {};
+
+    uint64_t start = MetricsStart();
+
+    int fd = OpenTemporaryFile( filename, temporary_name, sizeof( temporary_name ) );
+    if ( fd == -1 ) {
+        fprintf( stderr, "Не удалось создать временный файл для %s: %s\n", filename, strerror( errno ) );
+        return FAIL;
+    }
+
+    SaveBuffer_t output = {};
+    output.fd   = fd;
+    output.data = ( char* ) calloc ( SAVE_BUFFER_SIZE, sizeof( char ) );
+    assert( output.data && "Memory allocation error" );
+
+    // The parallel writer holds the whole text in memory until it is drained in order,
+    // so it is only worth it for large trees and more than one thread
+    TaskPool_t* pool = ( tree->root && tree->arena.live >= TREE_PARALLEL_MIN_NODES ) ? TaskPoolShared() : NULL;
+
+    if ( pool && pool->threads > 1 )
+        WriteTreeInParallel( &output, tree->root, pool );
+    else
+        WriteTree( &output, tree->root );
+
+    SaveBufferFlush( &output );
+
+    free( output.data );
+
+    if ( output.failed ) {
+        fprintf( stderr, "Ошибка записи базы в %s: %s\n", temporary_name, strerror( errno ) );
+        DiscardTemporaryFile( fd, temporary_name );
+        return FAIL;
+    }
+
+    if ( CommitTemporaryFile( fd, temporary_name, filename ) == -1 ) {
+        fprintf( stderr, "Не удалось сохранить базу в %s: %s\n", filename, strerror( errno ) );
+        return FAIL;
+    }
+
+    MetricsCount( COUNTER_SAVE_BYTES, output.written );
+    MetricsStop( TIMER_SAVE, start );
+
+    return SUCCESS;
+}
+
+static void ReadBufferFromFile( Tree_t* tree, const char* filename ) {
+    tree->buffer_size = DetermineTheFileSize( filename );
+
+    FILE* file = fopen( filename,  "r" );
     assert( file && "File opening error" );
 
     tree->buffer = ( char* ) calloc ( ( size_t ) ( tree->buffer_size + 1 ), sizeof( *( tree->buffer ) ) );
@@ -357,16 +1234,160 @@ void TreeReadFromFile( Tree_t* tree ) {
     int result_of_fclose = fclose( file );
     assert( !result_of_fclose );
 
-    bool error = false;
-    tree->current_position = tree->buffer;
-    tree->root = NodeRead( tree, &error );
+    tree->buffer_is_mapped = false;
+}
+
+static void MapBufferFromFile( Tree_t* tree, const char* filename ) {
+    tree->buffer = MapFileToMemory( filename, &( tree->buffer_size ) );
+    assert( tree->buffer && "File mapping error" );
 
-    if ( error ) {
-        fprintf( stderr, "Pizdez, не распарсилось\n" );
+    tree->buffer_is_mapped = true;
+}
+
+// One pass over the parent links: a node is linked on the way down, after its parent, and
+// counted on the way up, once both of its subtrees are
+static void LinkTree( Node_t* root ) {
+    if ( !root )
+        return;
+
+    Node_t* node = root;
+    NodeLink( node );
+
+    while ( true ) {
+        while ( node->left || node->right ) {
+            node = node->left ? node->left : node->right;
+            NodeLink( node );
+        }
+
+        node->leaves = 1;
+
+        while ( node != root && ( node == node->parent->right || !node->parent->right ) ) {
+            node = node->parent;
+            node->leaves = LeavesBelow( node );
+        }
+
+        if ( node == root )
+            return;
+
+        node = node->parent->right;
+        NodeLink( node );
     }
-    else {
-        fprintf( stderr, "Все норм, распарсилось\n" );
+}
+
+// Every loader ends here: depths, jumps and leaf counts cover the whole loaded tree, the lookup
+// by name and the compact copy are built again on their next use
+static TreeStatus_t FinishLoad( Tree_t* tree, TreeStatus_t status, size_t bytes, uint64_t start ) {
+    if ( status == SUCCESS ) {
+        LinkTree( tree->root );
+    }
+
+    tree->objects.built = false;
+    tree->compact.built = false;
+
+    MetricsCount( COUNTER_PARSE_BYTES, bytes );
+    MetricsCount( COUNTER_PARSE_NODES, tree->arena.live );
+    MetricsStop( TIMER_LOAD, start );
+
+    return status;
+}
+
+TreeStatus_t TreeReadFromFile( Tree_t* tree, const char* filename, TreeLoadMode_t mode ) {
+    my_assert( tree,     "Null pointer on `tree`" );
+    my_assert( filename, "Null pointer on `filename`" );
+
+    // Pipes, FIFOs and stdin cannot be mapped or sized up front: parse them chunk by chunk
+    if ( strcmp( filename, "-" ) == 0 ) {
+        return TreeReadFromStream( tree, STDIN_FILENO, "<stdin>" );
+    }
+
+    struct stat file_stat = {};
+    if ( stat( filename, &file_stat ) == 0 && !S_ISREG( file_stat.st_mode ) ) {
+        int fd = open( filename, O_RDONLY );
+        if ( fd == -1 ) {
+            fprintf( stderr, "%s: %s\n", filename, strerror( errno ) );
+            return FAIL;
+        }
+
+        TreeStatus_t status = TreeReadFromStream( tree, fd, filename );
+        close( fd );
+
+        return status;
+    }
+
+    uint64_t start = MetricsStart();
+
+    switch ( mode ) {
+        case LOAD_MMAP:
+            MapBufferFromFile( tree, filename );
+            break;
+        case LOAD_READ:
+        default:
+            ReadBufferFromFile( tree, filename );
+            break;
+    }
+
+    if ( BinaryBaseDetect( tree->buffer, tree->buffer_size ) ) {
+        tree->base_format = BASE_BINARY;
+        return FinishLoad( tree, TreeReadFromBinary( tree, filename ), ( size_t ) tree->buffer_size, start );
+    }
+
+    tree->base_format = BASE_TEXT;
+
+    TreeParser_t* parser = TreeParserCtor( tree, filename );
+
+    TreeStatus_t status = TreeParserFeed( parser, tree->buffer, ( size_t ) tree->buffer_size, true );
+    if ( status == SUCCESS ) {
+        status = TreeParserFinish( parser );
     }
 
+    tree->current_position = tree->buffer + parser->consumed;
+
+    TreeParserDtor( &parser );
+
+    return FinishLoad( tree, status, ( size_t ) tree->buffer_size, start );
 }
 
+TreeStatus_t TreeReadFromStream( Tree_t* tree, int fd, const char* source_name ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    char* chunk = ( char* ) calloc ( TREE_PARSER_CHUNK_SIZE, sizeof( *chunk ) );
+    assert( chunk && "Memory allocation error" );
+
+    uint64_t start = MetricsStart();
+    size_t   bytes = 0;
+
+    TreeParser_t* parser = TreeParserCtor( tree, source_name );
+    TreeStatus_t  status = SUCCESS;
+
+    while ( status == SUCCESS ) {
+        ssize_t read_bytes = read( fd, chunk, TREE_PARSER_CHUNK_SIZE );
+
+        if ( read_bytes < 0 ) {
+            if ( errno == EINTR )
+                continue;
+
+            fprintf( stderr, "%s: ошибка чтения: %s\n", parser->source_name, strerror( errno ) );
+            status = FAIL;
+            break;
+        }
+
+        if ( read_bytes == 0 ) {
+            status = TreeParserFinish( parser );
+            break;
+        }
+
+        if ( parser->consumed == 0 && BinaryBaseDetect( chunk, read_bytes ) ) {
+            fprintf( stderr, "%s: бинарную базу можно открыть только из обычного файла\n", parser->source_name );
+            status = FAIL;
+            break;
+        }
+
+        bytes += ( size_t ) read_bytes;
+        status = TreeParserFeed( parser, chunk, ( size_t ) read_bytes, false );
+    }
+
+    TreeParserDtor( &parser );
+    free( chunk );
+
+    return FinishLoad( tree, status, bytes, start );
+}
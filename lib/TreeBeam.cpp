@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+#include "TreeBeam.h"
+#include "TreeTelemetry.h"
+#include "DebugUtils.h"
+
+// Questions are told apart by text: interned values are equal pointers
+static BeamEntry_t MakeEntry( const CompactTree_t* compact, uint32_t slot, bool certain, double weight ) {
+    bool is_question = compact->nodes[ slot ].left != COMPACT_NONE && compact->nodes[ slot ].right != COMPACT_NONE;
+
+    return { slot, certain, is_question ? compact->origin[ slot ]->value : NULL, weight };
+}
+
+// Share of the games through `slot` that went on to "yes", with one imagined game each way
+static double YesPrior( const CompactTree_t* compact, uint32_t slot ) {
+    double yes = __atomic_load_n( &( compact->origin[ compact->nodes[ slot ].left ]->visits ),  __ATOMIC_RELAXED );
+    double no  = __atomic_load_n( &( compact->origin[ compact->nodes[ slot ].right ]->visits ), __ATOMIC_RELAXED );
+
+    return ( yes + 1 ) / ( yes + no + 2 );
+}
+
+static double Entropy( double share ) {
+    if ( share <= 0 || share >= 1 )
+        return 0;
+
+    return -share * log2( share ) - ( 1 - share ) * log2( 1 - share );
+}
+
+static int CompareHeavierFirst( const void* first, const void* second ) {
+    double first_weight  = ( ( const BeamEntry_t* ) first )->weight;
+    double second_weight = ( ( const BeamEntry_t* ) second )->weight;
+
+    return ( first_weight < second_weight ) - ( first_weight > second_weight );
+}
+
+// Back to a total of 1 with the lightest candidates cut off
+static void Normalize( Beam_t* beam ) {
+    double total = 0;
+    for ( size_t idx = 0; idx < beam->size; idx++ )
+        total += beam->entries[ idx ].weight;
+
+    size_t kept = 0;
+    for ( size_t idx = 0; idx < beam->size && total > 0; idx++ ) {
+        if ( beam->entries[ idx ].weight / total >= BEAM_MIN_SHARE )
+            beam->entries[ kept++ ] = beam->entries[ idx ];
+    }
+
+    beam->size = kept;
+
+    if ( beam->size > BEAM_WIDTH ) {
+        qsort( beam->entries, beam->size, sizeof( BeamEntry_t ), CompareHeavierFirst );
+        beam->size = BEAM_WIDTH;
+    }
+
+    total = 0;
+    for ( size_t idx = 0; idx < beam->size; idx++ )
+        total += beam->entries[ idx ].weight;
+
+    for ( size_t idx = 0; idx < beam->size; idx++ )
+        beam->entries[ idx ].weight /= total;
+}
+
+void BeamCtor( Beam_t* beam, const CompactTree_t* compact ) {
+    my_assert( beam && compact, "Null pointer on argument" );
+
+    memset( beam, 0, sizeof( *beam ) );
+    beam->compact  = compact;
+    beam->counting = true;
+
+    // Room for every candidate of a full frontier splitting in two
+    beam->entries = ( BeamEntry_t* ) calloc ( 2 * BEAM_WIDTH, sizeof( BeamEntry_t ) );
+    assert( beam->entries && "Memory allocation error" );
+
+    if ( compact->count > 0 ) {
+        beam->entries[ 0 ] = MakeEntry( compact, 0, true, 1.0 );
+        beam->size = 1;
+    }
+}
+
+void BeamDtor( Beam_t* beam ) {
+    my_assert( beam, "Null pointer on `beam`" );
+
+    free( beam->entries );
+    free( beam->answers );
+
+    memset( beam, 0, sizeof( *beam ) );
+}
+
+// The same frontier and answers in new storage, for looking an answer ahead
+void BeamCopy( Beam_t* copy, const Beam_t* beam ) {
+    my_assert( copy && beam, "Null pointer on argument" );
+
+    BeamCtor( copy, beam->compact );
+    copy->counting = false;
+
+    memcpy( copy->entries, beam->entries, beam->size * sizeof( BeamEntry_t ) );
+    copy->size = beam->size;
+
+    if ( beam->answer_count > 0 ) {
+        copy->answers = ( BeamAnswer_t* ) calloc ( beam->answer_capacity, sizeof( BeamAnswer_t ) );
+        assert( copy->answers && "Memory allocation error" );
+
+        memcpy( copy->answers, beam->answers, beam->answer_count * sizeof( BeamAnswer_t ) );
+        copy->answer_count    = beam->answer_count;
+        copy->answer_capacity = beam->answer_capacity;
+    }
+}
+
+static const BeamAnswer_t* FindAnswer( const Beam_t* beam, const char* question ) {
+    for ( size_t idx = 0; idx < beam->answer_count; idx++ ) {
+        if ( beam->answers[ idx ].question == question )
+            return &( beam->answers[ idx ] );
+    }
+
+    return NULL;
+}
+
+void BeamAnswer( Beam_t* beam, uint32_t question, double yes_share ) {
+    my_assert( beam, "Null pointer on `beam`" );
+
+    const CompactTree_t* compact = beam->compact;
+    const char*          text    = compact->origin[ question ]->value;
+
+    if ( !FindAnswer( beam, text ) ) {
+        if ( beam->answer_count == beam->answer_capacity ) {
+            beam->answer_capacity = beam->answer_capacity ? 2 * beam->answer_capacity : 16;
+            beam->answers = ( BeamAnswer_t* ) realloc ( beam->answers, beam->answer_capacity * sizeof( BeamAnswer_t ) );
+            assert( beam->answers && "Memory allocation error" );
+        }
+
+        beam->answers[ beam->answer_count++ ] = { text, yes_share };
+    }
+
+    bool   firm  = yes_share >= BEAM_YES || yes_share <= BEAM_NO;
+    size_t count = beam->size;
+
+    // The "yes" child takes its parent's entry and the "no" child goes to the end, so a full
+    // frontier at most doubles
+    for ( size_t idx = 0; idx < count; idx++ ) {
+        BeamEntry_t* entry = &( beam->entries[ idx ] );
+
+        if ( entry->question != text ) {
+            // Either answer is as likely for a candidate that does not ask this
+            entry->weight *= 0.5;
+            continue;
+        }
+
+        if ( beam->counting )
+            NodeCountVisit( compact->origin[ entry->slot ] );
+
+        double prior = YesPrior( compact, entry->slot );
+
+        uint32_t slot    = entry->slot;
+        bool     certain = entry->certain && firm;
+        double   weight  = entry->weight;
+
+        *entry                        = MakeEntry( compact, compact->nodes[ slot ].left,  certain, weight * prior * yes_share );
+        beam->entries[ beam->size++ ] = MakeEntry( compact, compact->nodes[ slot ].right, certain, weight * ( 1 - prior ) * ( 1 - yes_share ) );
+    }
+
+    Normalize( beam );
+}
+
+// The question whose candidates weigh the most and split the most evenly; questions
+// answered already are applied on the way without asking
+bool BeamNextQuestion( Beam_t* beam, uint32_t* question ) {
+    my_assert( beam && question, "Null pointer on argument" );
+
+    const CompactTree_t* compact = beam->compact;
+
+    while ( beam->size > 0 ) {
+        // Best first: an object no open candidate outweighs is guessed without asking more
+        size_t guess    = BeamBestGuess( beam );
+        double heaviest = 0;
+        for ( size_t idx = 0; idx < beam->size; idx++ ) {
+            if ( beam->entries[ idx ].question && beam->entries[ idx ].weight > heaviest )
+                heaviest = beam->entries[ idx ].weight;
+        }
+
+        if ( guess < beam->size && beam->entries[ guess ].weight >= heaviest )
+            return false;
+
+        double best_score = 0;
+        size_t best       = beam->size;
+
+        for ( size_t idx = 0; idx < beam->size; idx++ ) {
+            const char* text = beam->entries[ idx ].question;
+            if ( !text )
+                continue;
+
+            // Each text is scored once, at its first candidate
+            bool seen = false;
+            for ( size_t other = 0; other < idx && !seen; other++ )
+                seen = ( beam->entries[ other ].question == text );
+            if ( seen )
+                continue;
+
+            double yes = 0, no = 0;
+            for ( size_t other = idx; other < beam->size; other++ ) {
+                if ( beam->entries[ other ].question != text )
+                    continue;
+
+                double prior = YesPrior( compact, beam->entries[ other ].slot );
+                yes += beam->entries[ other ].weight * prior;
+                no  += beam->entries[ other ].weight * ( 1 - prior );
+            }
+
+            double score = ( yes + no ) * Entropy( yes / ( yes + no ) );
+            if ( score > best_score ) {
+                best_score = score;
+                best       = idx;
+            }
+        }
+
+        if ( best == beam->size )
+            return false;
+
+        const BeamAnswer_t* known = FindAnswer( beam, beam->entries[ best ].question );
+
+        if ( !known ) {
+            *question = beam->entries[ best ].slot;
+            return true;
+        }
+
+        BeamAnswer( beam, beam->entries[ best ].slot, known->yes_share );
+    }
+
+    return false;
+}
+
+// The heaviest candidate that is not a question, beam->size if there is none
+size_t BeamBestGuess( const Beam_t* beam ) {
+    my_assert( beam, "Null pointer on `beam`" );
+
+    size_t best = beam->size;
+
+    for ( size_t idx = 0; idx < beam->size; idx++ ) {
+        if ( beam->entries[ idx ].question )
+            continue;
+
+        if ( best == beam->size || beam->entries[ idx ].weight > beam->entries[ best ].weight )
+            best = idx;
+    }
+
+    return best;
+}
+
+void BeamDrop( Beam_t* beam, size_t entry ) {
+    my_assert( beam && entry < beam->size, "Bad beam entry" );
+
+    beam->entries[ entry ] = beam->entries[ --beam->size ];
+
+    Normalize( beam );
+}
+
+void BeamRefresh( Beam_t* beam ) {
+    my_assert( beam, "Null pointer on `beam`" );
+
+    for ( size_t idx = 0; idx < beam->size; idx++ ) {
+        BeamEntry_t* entry = &( beam->entries[ idx ] );
+
+        *entry = MakeEntry( beam->compact, entry->slot, entry->certain, entry->weight );
+    }
+}
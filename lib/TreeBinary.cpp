@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+
+#include "TreeBinary.h"
+#include "DebugUtils.h"
+#include "Metrics.h"
+#include "UtilsRW.h"
+
+struct PendingNode_t {
+    const Node_t* node;
+    uint32_t      parent_index;
+    bool          is_right;
+};
+
+struct BinaryWriter_t {
+    BinaryBaseNode_t* nodes;
+    size_t            node_count;
+    size_t            node_capacity;
+
+    char*  strings;
+    size_t strings_size;
+    size_t strings_capacity;
+
+    uint32_t* string_slots;     // offset + 1 of an already stored value, 0 - empty
+    size_t    slots_capacity;
+    size_t    slots_used;
+};
+
+bool BinaryBaseDetect( const char* buffer, off_t size ) {
+    return buffer && size >= ( off_t ) sizeof( BinaryBaseHeader_t ) &&
+           memcmp( buffer, BINARY_BASE_MAGIC, sizeof( BINARY_BASE_MAGIC ) ) == 0;
+}
+
+static TreeStatus_t BinaryError( const char* source_name, const char* message ) {
+    fprintf( stderr, "%s: повреждённая бинарная база: %s\n", source_name, message );
+    return FAIL;
+}
+
+static TreeStatus_t CheckHeader( const BinaryBaseHeader_t* header, off_t size, const char* source_name ) {
+    if ( header->version != BINARY_BASE_VERSION )
+        return BinaryError( source_name, "неизвестная версия формата" );
+
+    uint64_t nodes_end = sizeof( *header ) + ( uint64_t ) header->node_count * sizeof( BinaryBaseNode_t );
+
+    if ( header->node_count >= BINARY_NODE_NIL || header->strings_offset != nodes_end ||
+         header->strings_offset + header->strings_size != ( uint64_t ) size )
+        return BinaryError( source_name, "размеры секций не совпадают с файлом" );
+
+    if ( header->node_count > 0 &&
+         ( header->strings_size == 0 || ( ( const char* ) header )[ size - 1 ] != '\0' ) )
+        return BinaryError( source_name, "таблица строк не завершена нулём" );
+
+    return SUCCESS;
+}
+
+static TreeStatus_t LinkChild( Node_t** by_index, uint32_t parent, uint32_t child, uint32_t node_count, bool is_right ) {
+    // Children always follow the parent in preorder, so no index can be reached twice or loop
+    if ( child <= parent || child >= node_count || by_index[ child ]->parent != NULL )
+        return FAIL;
+
+    by_index[ child ]->parent = by_index[ parent ];
+
+    if ( is_right )
+        by_index[ parent ]->right = by_index[ child ];
+    else
+        by_index[ parent ]->left  = by_index[ child ];
+
+    return SUCCESS;
+}
+
+TreeStatus_t TreeReadFromBinary( Tree_t* tree, const char* source_name ) {
+    my_assert( tree, "Null pointer on `tree`" );
+    my_assert( BinaryBaseDetect( tree->buffer, tree->buffer_size ), "Buffer is not a binary base" );
+
+    const BinaryBaseHeader_t* header = ( const BinaryBaseHeader_t* ) ( const void* ) tree->buffer;
+
+    if ( CheckHeader( header, tree->buffer_size, source_name ) != SUCCESS )
+        return FAIL;
+
+    uint32_t node_count = header->node_count;
+    const BinaryBaseNode_t* nodes = ( const BinaryBaseNode_t* ) ( const void* ) ( tree->buffer + sizeof( *header ) );
+    char* strings = tree->buffer + header->strings_offset;
+
+    tree->current_position = NULL;
+
+    if ( node_count == 0 ) {
+        tree->root = NULL;
+        return SUCCESS;
+    }
+
+    Node_t** by_index = ( Node_t** ) calloc ( node_count, sizeof( *by_index ) );
+    assert( by_index && "Memory allocation error" );
+
+    // One slab for the whole base keeps the nodes in preorder, as they lie in the file
+    TreeReserveNodes( tree, node_count );
+
+    // Values stay inside the mapping. The writer stores every text once, so the table goes
+    // to the pool as it is: a value is interned by its offset, nothing is hashed at open.
+    StringPoolShareTable( &( tree->strings ), strings, header->strings_size );
+
+    TreeStatus_t status = SUCCESS;
+
+    for ( uint32_t idx = 0; idx < node_count && status == SUCCESS; idx++ ) {
+        uint32_t offset = nodes[ idx ].value;
+
+        // Only whole strings of the table are interned, a suffix of one would not be
+        if ( offset >= header->strings_size || ( offset > 0 && strings[ offset - 1 ] != '\0' ) ) {
+            status = BinaryError( source_name, "ссылка за пределы таблицы строк" );
+            break;
+        }
+
+        by_index[ idx ] = NodeCreate( tree, strings + offset, NULL );
+    }
+
+    for ( uint32_t idx = 0; idx < node_count && status == SUCCESS; idx++ ) {
+        uint32_t right = nodes[ idx ].right & ~BINARY_NODE_HAS_LEFT;
+
+        if ( ( nodes[ idx ].right & BINARY_NODE_HAS_LEFT ) &&
+             LinkChild( by_index, idx, idx + 1, node_count, false ) != SUCCESS ) {
+            status = BinaryError( source_name, "некорректный левый потомок" );
+        }
+        else if ( right != BINARY_NODE_NIL &&
+                  LinkChild( by_index, idx, right, node_count, true ) != SUCCESS ) {
+            status = BinaryError( source_name, "некорректный правый потомок" );
+        }
+    }
+
+    for ( uint32_t idx = 1; idx < node_count && status == SUCCESS; idx++ ) {
+        if ( by_index[ idx ]->parent == NULL ) {
+            status = BinaryError( source_name, "узел без родителя" );
+        }
+    }
+
+    if ( status == SUCCESS ) {
+        tree->root = by_index[ 0 ];
+    }
+    else {
+        for ( uint32_t idx = 0; idx < node_count && by_index[ idx ]; idx++ ) {
+            NodeFree( tree, by_index[ idx ] );
+        }
+    }
+
+    free( by_index );
+
+    return status;
+}
+
+static void Reserve( void** array, size_t* capacity, size_t needed, size_t element_size ) {
+    if ( needed <= *capacity )
+        return;
+
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while ( new_capacity < needed )
+        new_capacity *= 2;
+
+    void* new_array = realloc( *array, new_capacity * element_size );
+    assert( new_array && "Memory allocation error" );
+
+    *array    = new_array;
+    *capacity = new_capacity;
+}
+
+static uint64_t HashString( const char* string ) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for ( ; *string; string++ ) {
+        hash ^= ( unsigned char ) *string;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static void RehashStrings( BinaryWriter_t* writer ) {
+    size_t    new_capacity = writer->slots_capacity ? writer->slots_capacity * 2 : 1024;
+    uint32_t* new_slots    = ( uint32_t* ) calloc ( new_capacity, sizeof( *new_slots ) );
+    assert( new_slots && "Memory allocation error" );
+
+    for ( size_t idx = 0; idx < writer->slots_capacity; idx++ ) {
+        uint32_t slot = writer->string_slots[ idx ];
+        if ( !slot )
+            continue;
+
+        size_t position = HashString( writer->strings + slot - 1 ) & ( new_capacity - 1 );
+        while ( new_slots[ position ] )
+            position = ( position + 1 ) & ( new_capacity - 1 );
+
+        new_slots[ position ] = slot;
+    }
+
+    free( writer->string_slots );
+    writer->string_slots   = new_slots;
+    writer->slots_capacity = new_capacity;
+}
+
+// Equal values are stored once
+static uint32_t AddString( BinaryWriter_t* writer, const char* value ) {
+    if ( ( writer->slots_used + 1 ) * 2 > writer->slots_capacity ) {
+        RehashStrings( writer );
+    }
+
+    size_t mask     = writer->slots_capacity - 1;
+    size_t position = HashString( value ) & mask;
+
+    while ( writer->string_slots[ position ] ) {
+        uint32_t offset = writer->string_slots[ position ] - 1;
+        if ( strcmp( writer->strings + offset, value ) == 0 )
+            return offset;
+
+        position = ( position + 1 ) & mask;
+    }
+
+    size_t length = strlen( value ) + 1;
+    assert( writer->strings_size + length < UINT32_MAX && "String table is too large" );
+
+    Reserve( ( void** ) &( writer->strings ), &( writer->strings_capacity ),
+             writer->strings_size + length, sizeof( char ) );
+
+    uint32_t offset = ( uint32_t ) writer->strings_size;
+    memcpy( writer->strings + offset, value, length );
+    writer->strings_size += length;
+
+    writer->string_slots[ position ] = offset + 1;
+    writer->slots_used++;
+
+    return offset;
+}
+
+static void CollectNodes( BinaryWriter_t* writer, const Node_t* root ) {
+    PendingNode_t* stack          = NULL;
+    size_t         stack_size     = 0;
+    size_t         stack_capacity = 0;
+
+    if ( root ) {
+        Reserve( ( void** ) &stack, &stack_capacity, 1, sizeof( *stack ) );
+        stack[ stack_size++ ] = { root, BINARY_NODE_NIL, false };
+    }
+
+    while ( stack_size > 0 ) {
+        PendingNode_t pending = stack[ --stack_size ];
+
+        assert( writer->node_count < BINARY_NODE_NIL && "Too many nodes for the binary format" );
+        uint32_t idx = ( uint32_t ) writer->node_count++;
+
+        Reserve( ( void** ) &( writer->nodes ), &( writer->node_capacity ),
+                 writer->node_count, sizeof( *( writer->nodes ) ) );
+
+        writer->nodes[ idx ].value = AddString( writer, pending.node->value ? pending.node->value : "" );
+        writer->nodes[ idx ].right = BINARY_NODE_NIL;
+
+        if ( pending.parent_index != BINARY_NODE_NIL ) {
+            if ( pending.is_right )
+                writer->nodes[ pending.parent_index ].right = ( writer->nodes[ pending.parent_index ].right & BINARY_NODE_HAS_LEFT ) | idx;
+            else
+                writer->nodes[ pending.parent_index ].right |= BINARY_NODE_HAS_LEFT;
+        }
+
+        Reserve( ( void** ) &stack, &stack_capacity, stack_size + 2, sizeof( *stack ) );
+
+        // Right goes first so that the left subtree is written right after its parent
+        if ( pending.node->right )
+            stack[ stack_size++ ] = { pending.node->right, idx, true  };
+        if ( pending.node->left )
+            stack[ stack_size++ ] = { pending.node->left,  idx, false };
+    }
+
+    free( stack );
+}
+
+TreeStatus_t TreeSaveToBinaryFile( const Tree_t* tree, const char* filename ) {
+    my_assert( tree,     "Null pointer on tree" );
+    my_assert( filename, "Null pointer on filename" );
+
+    BinaryWriter_t writer = {};
+
+    CollectNodes( &writer, tree->root );
+
+    BinaryBaseHeader_t header = {};
+    memcpy( header.magic, BINARY_BASE_MAGIC, sizeof( BINARY_BASE_MAGIC ) );
+    header.version        = BINARY_BASE_VERSION;
+    header.node_count     = ( uint32_t ) writer.node_count;
+    header.strings_offset = sizeof( header ) + writer.node_count * sizeof( BinaryBaseNode_t );
+    header.strings_size   = writer.strings_size;
+
+    TreeStatus_t status = SUCCESS;
+    char temporary_name[ MAX_LEN_PATH ] = {};
+
+    uint64_t start = MetricsStart();
+
+    int fd = OpenTemporaryFile( filename, temporary_name, sizeof( temporary_name ) );
+    if ( fd == -1 ) {
+        fprintf( stderr, "Не удалось создать временный файл для %s: %s\n", filename, strerror( errno ) );
+        status = FAIL;
+    }
+    else if ( WriteAll( fd, ( const char* ) &header, sizeof( header ) ) == -1 ||
+              WriteAll( fd, ( const char* ) writer.nodes, writer.node_count * sizeof( *( writer.nodes ) ) ) == -1 ||
+              WriteAll( fd, writer.strings, writer.strings_size ) == -1 ) {
+        fprintf( stderr, "Ошибка записи базы в %s: %s\n", temporary_name, strerror( errno ) );
+        DiscardTemporaryFile( fd, temporary_name );
+        status = FAIL;
+    }
+    else if ( CommitTemporaryFile( fd, temporary_name, filename ) == -1 ) {
+        fprintf( stderr, "Не удалось сохранить базу в %s: %s\n", filename, strerror( errno ) );
+        status = FAIL;
+    }
+
+    free( writer.nodes );
+    free( writer.strings );
+    free( writer.string_slots );
+
+    if ( status == SUCCESS ) {
+        MetricsCount( COUNTER_SAVE_BYTES, header.strings_offset + header.strings_size );
+        MetricsStop( TIMER_SAVE, start );
+    }
+
+    return status;
+}
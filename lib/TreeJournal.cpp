@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "TreeJournal.h"
+#include "TreeBinary.h"
+#include "DebugUtils.h"
+#include "UtilsRW.h"
+
+const size_t RECORD_PREFIX_SIZE = 2 * sizeof( uint32_t );
+
+static uint32_t Crc32( const char* data, size_t length ) {
+    static uint32_t table[ 256 ] = {};
+    static bool     table_ready  = false;
+
+    if ( !table_ready ) {
+        for ( uint32_t idx = 0; idx < 256; idx++ ) {
+            uint32_t crc = idx;
+            for ( int bit = 0; bit < 8; bit++ )
+                crc = ( crc & 1 ) ? ( crc >> 1 ) ^ 0xEDB88320u : crc >> 1;
+            table[ idx ] = crc;
+        }
+        table_ready = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for ( size_t idx = 0; idx < length; idx++ )
+        crc = table[ ( crc ^ ( unsigned char ) data[ idx ] ) & 0xFF ] ^ ( crc >> 8 );
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void FillBaseIdentity( JournalHeader_t* header, const struct stat* base_stat ) {
+    memset( header, 0, sizeof( *header ) );
+
+    memcpy( header->magic, JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) );
+    header->version       = JOURNAL_VERSION;
+    header->base_device   = ( uint64_t ) base_stat->st_dev;
+    header->base_inode    = ( uint64_t ) base_stat->st_ino;
+    header->base_size     = ( uint64_t ) base_stat->st_size;
+    header->base_mtime_ns = ( int64_t ) base_stat->st_mtim.tv_sec * 1000000000 + base_stat->st_mtim.tv_nsec;
+}
+
+static void DropJournal( TreeJournal_t* journal ) {
+    if ( journal->fd != -1 ) {
+        close( journal->fd );
+        journal->fd = -1;
+    }
+
+    unlink( journal->path );
+
+    journal->size          = 0;
+    journal->session_start = 0;
+}
+
+static Node_t* FollowPath( Tree_t* tree, const uint8_t* path, uint32_t depth ) {
+    Node_t* node = tree->root;
+
+    for ( uint32_t idx = 0; idx < depth && node; idx++ ) {
+        node = ( path[ idx / 8 ] >> ( idx % 8 ) & 1 ) ? node->left : node->right;
+    }
+
+    if ( !node || node->left || node->right )
+        return NULL;
+
+    return node;
+}
+
+// Returns the number of bytes of `record` applied, 0 if it is torn, corrupt or does not fit the tree
+static size_t ReplayRecord( Tree_t* tree, const char* record, size_t available ) {
+    if ( available < RECORD_PREFIX_SIZE + sizeof( JournalRecord_t ) )
+        return 0;
+
+    uint32_t payload_size = 0, checksum = 0;
+    memcpy( &payload_size, record,                    sizeof( payload_size ) );
+    memcpy( &checksum,     record + sizeof( uint32_t ), sizeof( checksum ) );
+
+    const char* payload = record + RECORD_PREFIX_SIZE;
+
+    if ( payload_size < sizeof( JournalRecord_t ) || payload_size > available - RECORD_PREFIX_SIZE ||
+         Crc32( payload, payload_size ) != checksum )
+        return 0;
+
+    JournalRecord_t fields = {};
+    memcpy( &fields, payload, sizeof( fields ) );
+
+    uint64_t path_size = ( ( uint64_t ) fields.depth + 7 ) / 8;
+    if ( sizeof( fields ) + path_size + fields.question_length + 1 + fields.object_length + 1 != payload_size )
+        return 0;
+
+    const uint8_t* path     = ( const uint8_t* ) payload + sizeof( fields );
+    const char*    question = ( const char* ) path + path_size;
+    const char*    object   = question + fields.question_length + 1;
+
+    if ( question[ fields.question_length ] != '\0' || object[ fields.object_length ] != '\0' )
+        return 0;
+
+    Node_t* leaf = FollowPath( tree, path, fields.depth );
+    if ( !leaf )
+        return 0;
+
+    TreeSplitLeaf( tree, leaf, question, object, fields.object_is_left != 0 );
+
+    return RECORD_PREFIX_SIZE + payload_size;
+}
+
+static TreeStatus_t Replay( TreeJournal_t* journal, Tree_t* tree ) {
+    struct stat journal_stat = {};
+    if ( fstat( journal->fd, &journal_stat ) == -1 )
+        return FAIL;
+
+    size_t size   = ( size_t ) journal_stat.st_size;
+    char*  buffer = ( char* ) calloc ( size + 1, sizeof( char ) );
+    assert( buffer && "Memory allocation error" );
+
+    size_t read_total = 0;
+    while ( read_total < size ) {
+        ssize_t result = pread( journal->fd, buffer + read_total, size - read_total, ( off_t ) read_total );
+        if ( result <= 0 ) {
+            if ( result == -1 && errno == EINTR )
+                continue;
+            free( buffer );
+            return FAIL;
+        }
+        read_total += ( size_t ) result;
+    }
+
+    JournalHeader_t header = {};
+    if ( size >= sizeof( header ) ) {
+        memcpy( &header, buffer, sizeof( header ) );
+    }
+
+    if ( size < sizeof( header ) || memcmp( header.magic, JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) ) != 0 ||
+         header.version != JOURNAL_VERSION || memcmp( &header, &( journal->base ), sizeof( header ) ) != 0 ) {
+        fprintf( stderr, "%s: журнал относится к другой версии базы и пропущен\n", journal->path );
+        DropJournal( journal );
+        free( buffer );
+        return SUCCESS;
+    }
+
+    size_t offset = sizeof( header );
+    while ( offset < size ) {
+        size_t applied = ReplayRecord( tree, buffer + offset, size - offset );
+        if ( !applied )
+            break;
+
+        offset += applied;
+        journal->replayed++;
+    }
+
+    free( buffer );
+
+    // Whatever follows the last good record is a write torn by a crash
+    if ( offset < size ) {
+        fprintf( stderr, "%s: журнал обрезан после %zu байт\n", journal->path, offset );
+
+        if ( ftruncate( journal->fd, ( off_t ) offset ) == -1 )
+            return FAIL;
+    }
+
+    journal->size          = ( off_t ) offset;
+    journal->session_start = ( off_t ) offset;
+
+    return lseek( journal->fd, journal->size, SEEK_SET ) == -1 ? FAIL : SUCCESS;
+}
+
+TreeStatus_t TreeJournalOpen( TreeJournal_t* journal, Tree_t* tree, const char* base_path ) {
+    my_assert( journal,   "Null pointer on `journal`" );
+    my_assert( tree,      "Null pointer on `tree`" );
+    my_assert( base_path, "Null pointer on `base_path`" );
+
+    memset( journal, 0, sizeof( *journal ) );
+    journal->fd = -1;
+
+    // Nothing to attach the journal to, e.g. a base read from stdin
+    struct stat base_stat = {};
+    if ( stat( base_path, &base_stat ) == -1 || !S_ISREG( base_stat.st_mode ) ) {
+        return SUCCESS;
+    }
+
+    FillBaseIdentity( &( journal->base ), &base_stat );
+
+    size_t path_size = strlen( base_path ) + sizeof( ".journal" );
+    journal->path = ( char* ) calloc ( path_size, sizeof( char ) );
+    assert( journal->path && "Memory allocation error" );
+    snprintf( journal->path, path_size, "%s.journal", base_path );
+
+    journal->fd = open( journal->path, O_RDWR );
+    if ( journal->fd == -1 ) {
+        if ( errno == ENOENT )
+            return SUCCESS;
+
+        fprintf( stderr, "Не удалось открыть журнал %s: %s\n", journal->path, strerror( errno ) );
+        return FAIL;
+    }
+
+    if ( Replay( journal, tree ) != SUCCESS ) {
+        fprintf( stderr, "Ошибка чтения журнала %s: %s\n", journal->path, strerror( errno ) );
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+void TreeJournalClose( TreeJournal_t* journal ) {
+    my_assert( journal, "Null pointer on `journal`" );
+
+    if ( journal->fd != -1 ) {
+        close( journal->fd );
+    }
+
+    free( journal->path );
+
+    memset( journal, 0, sizeof( *journal ) );
+    journal->fd = -1;
+}
+
+static TreeStatus_t CreateJournal( TreeJournal_t* journal ) {
+    journal->fd = open( journal->path, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if ( journal->fd == -1 )
+        return FAIL;
+
+    if ( WriteAll( journal->fd, ( const char* ) &( journal->base ), sizeof( journal->base ) ) == -1 ||
+         fdatasync( journal->fd ) == -1 || SyncDirectoryOf( journal->path ) == -1 ) {
+        DropJournal( journal );
+        return FAIL;
+    }
+
+    journal->size          = sizeof( journal->base );
+    journal->session_start = 0;
+
+    return SUCCESS;
+}
+
+TreeStatus_t TreeJournalAppend( TreeJournal_t* journal, const Node_t* leaf,
+                                const char* question, const char* object, bool object_is_left ) {
+    my_assert( journal, "Null pointer on `journal`" );
+    my_assert( leaf && question && object, "Null pointer on record data" );
+
+    if ( !journal->path )
+        return SUCCESS;
+
+    if ( journal->fd == -1 && CreateJournal( journal ) != SUCCESS )
+        return FAIL;
+
+    uint32_t depth = 0;
+    for ( const Node_t* node = leaf; node->parent; node = node->parent )
+        depth++;
+
+    JournalRecord_t fields = {};
+    fields.depth           = depth;
+    fields.question_length = ( uint32_t ) strlen( question );
+    fields.object_length   = ( uint32_t ) strlen( object );
+    fields.object_is_left  = object_is_left;
+
+    size_t path_size    = ( ( size_t ) depth + 7 ) / 8;
+    size_t payload_size = sizeof( fields ) + path_size + fields.question_length + 1 + fields.object_length + 1;
+    size_t record_size  = RECORD_PREFIX_SIZE + payload_size;
+
+    char* record = ( char* ) calloc ( record_size, sizeof( char ) );
+    assert( record && "Memory allocation error" );
+
+    char*    payload = record + RECORD_PREFIX_SIZE;
+    uint8_t* path    = ( uint8_t* ) payload + sizeof( fields );
+
+    memcpy( payload, &fields, sizeof( fields ) );
+
+    // Bits are filled from the leaf up, the first bit is the answer at the root
+    uint32_t idx = depth;
+    for ( const Node_t* node = leaf; node->parent; node = node->parent ) {
+        idx--;
+        if ( node->parent->left == node )
+            path[ idx / 8 ] |= ( uint8_t ) ( 1u << ( idx % 8 ) );
+    }
+
+    memcpy( ( char* ) path + path_size, question, fields.question_length );
+    memcpy( ( char* ) path + path_size + fields.question_length + 1, object, fields.object_length );
+
+    uint32_t prefix[ 2 ] = { ( uint32_t ) payload_size, Crc32( payload, payload_size ) };
+    memcpy( record, prefix, sizeof( prefix ) );
+
+    TreeStatus_t status = SUCCESS;
+
+    if ( WriteAll( journal->fd, record, record_size ) == -1 || fdatasync( journal->fd ) == -1 ) {
+        // A partial record would be cut off by the next replay anyway, but later appends must not follow it
+        int saved_errno = errno;
+        if ( ftruncate( journal->fd, journal->size ) == 0 ) {
+            lseek( journal->fd, journal->size, SEEK_SET );
+        }
+        errno = saved_errno;
+
+        status = FAIL;
+    }
+    else {
+        journal->size += ( off_t ) record_size;
+    }
+
+    free( record );
+
+    return status;
+}
+
+bool TreeJournalNeedsCompaction( const TreeJournal_t* journal ) {
+    my_assert( journal, "Null pointer on `journal`" );
+
+    off_t threshold = ( off_t ) ( journal->base.base_size / 4 );
+    if ( threshold < JOURNAL_MIN_COMPACT_SIZE )
+        threshold = JOURNAL_MIN_COMPACT_SIZE;
+
+    return journal->fd != -1 && journal->size > threshold;
+}
+
+// The new base is renamed into place before the journal goes away: a crash in between
+// leaves a journal whose header no longer matches the base, and it is dropped on start
+TreeStatus_t TreeJournalCompact( TreeJournal_t* journal, const Tree_t* tree, const char* base_path ) {
+    my_assert( journal,   "Null pointer on `journal`" );
+    my_assert( tree,      "Null pointer on `tree`" );
+    my_assert( base_path, "Null pointer on `base_path`" );
+
+    TreeStatus_t status = ( tree->base_format == BASE_BINARY ) ? TreeSaveToBinaryFile( tree, base_path )
+                                                               : TreeSaveToFile( tree, base_path );
+    if ( status != SUCCESS )
+        return FAIL;
+
+    if ( !journal->path )
+        return SUCCESS;
+
+    DropJournal( journal );
+
+    struct stat base_stat = {};
+    if ( stat( base_path, &base_stat ) == -1 ) {
+        free( journal->path );
+        journal->path = NULL;
+        return SUCCESS;
+    }
+
+    FillBaseIdentity( &( journal->base ), &base_stat );
+
+    return SUCCESS;
+}
+
+// Forgets what this process has learned, as if the game was never saved
+void TreeJournalRollback( TreeJournal_t* journal ) {
+    my_assert( journal, "Null pointer on `journal`" );
+
+    if ( journal->fd == -1 || journal->size == journal->session_start )
+        return;
+
+    if ( journal->session_start == 0 ) {
+        DropJournal( journal );
+        return;
+    }
+
+    if ( ftruncate( journal->fd, journal->session_start ) == -1 || fdatasync( journal->fd ) == -1 ) {
+        fprintf( stderr, "Не удалось откатить журнал %s: %s\n", journal->path, strerror( errno ) );
+        return;
+    }
+
+    journal->size = journal->session_start;
+    lseek( journal->fd, journal->size, SEEK_SET );
+}
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "TreeParser.h"
+#include "TreeTokenizer.h"
+#include "DebugUtils.h"
+
+const size_t SLOT_BITS = 64;
+
+TreeParser_t* TreeParserCtor( Tree_t* tree, const char* source_name ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    TreeParser_t* parser = ( TreeParser_t* ) calloc ( 1, sizeof( *parser ) );
+    assert( parser && "Memory allocation error" );
+
+    parser->tokens = ( uint32_t* ) calloc ( TOKENIZER_WINDOW, sizeof( *( parser->tokens ) ) );
+    assert( parser->tokens && "Memory allocation error" );
+
+    parser->tree        = tree;
+    parser->source_name = source_name ? source_name : "<stream>";
+    parser->state       = PARSE_CHILD;
+    parser->line        = 1;
+
+    return parser;
+}
+
+void TreeParserDtor( TreeParser_t** parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
+
+    free( ( *parser )->tokens );
+    free( ( *parser )->slots );
+    free( ( *parser )->value );
+
+    free( *parser );
+    *parser = NULL;
+}
+
+static void SetError( TreeParser_t* parser, const char* message, char symbol ) {
+    parser->error         = true;
+    parser->error_message = message;
+    parser->error_symbol  = ( unsigned char ) symbol;
+}
+
+static void ReportError( TreeParser_t* parser, const char* message, int symbol ) {
+    parser->error = true;
+
+    if ( symbol == EOF ) {
+        fprintf( stderr, "%s:%zu:%zu: ошибка разбора: %s (конец файла)\n",
+                 parser->source_name, parser->line, parser->column + 1, message );
+    }
+    else {
+        fprintf( stderr, "%s:%zu:%zu: ошибка разбора: %s (встречен '%c')\n",
+                 parser->source_name, parser->line, parser->column + 1, message, symbol );
+    }
+}
+
+// UTF-8 continuation bytes look like 10xxxxxx, everything else starts a character
+static size_t CountCharacters( const char* begin, const char* end ) {
+    const uint64_t high_bits = 0x8080808080808080ULL;
+
+    size_t characters = 0;
+
+    for ( ; end - begin >= 8; begin += 8 ) {
+        uint64_t word = 0;
+        memcpy( &word, begin, sizeof( word ) );
+
+        uint64_t continuation = word & ~( word << 1 ) & high_bits;
+        characters += 8 - ( size_t ) __builtin_popcountll( continuation );
+    }
+
+    for ( ; begin < end; begin++ ) {
+        if ( ( *begin & 0xC0 ) != 0x80 )
+            characters++;
+    }
+
+    return characters;
+}
+
+static void AdvancePosition( TreeParser_t* parser, const char* begin, const char* end ) {
+    parser->consumed += ( size_t ) ( end - begin );
+
+    const char* line_start = begin;
+    const char* new_line   = NULL;
+
+    while ( ( new_line = ( const char* ) memchr( line_start, '\n', ( size_t ) ( end - line_start ) ) ) ) {
+        parser->line++;
+        parser->column = 0;
+        line_start = new_line + 1;
+    }
+
+    parser->column += CountCharacters( line_start, end );
+}
+
+static void PushSlot( TreeParser_t* parser ) {
+    size_t word = parser->depth / SLOT_BITS;
+
+    if ( word >= parser->slots_capacity ) {
+        size_t new_capacity = parser->slots_capacity ? parser->slots_capacity * 2 : 16;
+
+        uint64_t* new_slots = ( uint64_t* ) realloc ( parser->slots, new_capacity * sizeof( *new_slots ) );
+        assert( new_slots && "Memory allocation error" );
+
+        parser->slots          = new_slots;
+        parser->slots_capacity = new_capacity;
+    }
+
+    parser->slots[ word ] &= ~( ( uint64_t ) 1 << ( parser->depth % SLOT_BITS ) );
+    parser->depth++;
+}
+
+static bool TopSlotIsRight( const TreeParser_t* parser ) {
+    size_t level = parser->depth - 1;
+    return ( parser->slots[ level / SLOT_BITS ] >> ( level % SLOT_BITS ) ) & 1;
+}
+
+static void SetTopSlotRight( TreeParser_t* parser ) {
+    size_t level = parser->depth - 1;
+    parser->slots[ level / SLOT_BITS ] |= ( uint64_t ) 1 << ( level % SLOT_BITS );
+}
+
+// Called when a child (a node or nil) of `current` has been read completely
+static void ChildDone( TreeParser_t* parser ) {
+    if ( parser->depth == 0 ) {
+        parser->state = PARSE_END;
+    }
+    else if ( !TopSlotIsRight( parser ) ) {
+        SetTopSlotRight( parser );
+        parser->state = PARSE_CHILD;
+    }
+    else {
+        parser->state = PARSE_CLOSE;
+    }
+}
+
+static void OpenNode( TreeParser_t* parser ) {
+    Node_t* node = NodeCreate( parser->tree, NULL, parser->current );
+
+    if ( parser->depth == 0 ) {
+        parser->root       = node;
+        parser->tree->root = node;
+    }
+    else if ( !TopSlotIsRight( parser ) ) {
+        parser->current->left = node;
+    }
+    else {
+        parser->current->right = node;
+    }
+
+    PushSlot( parser );
+    parser->current = node;
+    parser->state   = PARSE_VALUE_START;
+}
+
+static void CloseNode( TreeParser_t* parser ) {
+    parser->depth--;
+    parser->current = parser->current->parent;
+
+    ChildDone( parser );
+}
+
+static void AppendValue( TreeParser_t* parser, const char* begin, size_t length ) {
+    if ( parser->value_length + length + 1 > parser->value_capacity ) {
+        size_t new_capacity = parser->value_capacity ? parser->value_capacity : 64;
+        while ( parser->value_length + length + 1 > new_capacity )
+            new_capacity *= 2;
+
+        char* new_value = ( char* ) realloc ( parser->value, new_capacity );
+        assert( new_value && "Memory allocation error" );
+
+        parser->value          = new_value;
+        parser->value_capacity = new_capacity;
+    }
+
+    memcpy( parser->value + parser->value_length, begin, length );
+    parser->value_length += length;
+}
+
+static void CloseValue( TreeParser_t* parser, char* chunk, char* quote, bool in_place ) {
+    StringPool_t* pool = &( parser->tree->strings );
+
+    if ( in_place && parser->value_start && parser->value_length == 0 ) {
+        *quote = '\0';
+        parser->current->value = StringPoolInternInPlace( pool, parser->value_start,
+                                                          ( size_t ) ( quote - parser->value_start ) );
+    }
+    else {
+        char* begin = parser->value_start ? parser->value_start : chunk;
+        AppendValue( parser, begin, ( size_t ) ( quote - begin ) );
+
+        parser->current->value = StringPoolIntern( pool, parser->value, parser->value_length );
+    }
+
+    parser->value_start  = NULL;
+    parser->value_length = 0;
+    parser->state        = PARSE_CHILD;
+}
+
+static void TakeToken( TreeParser_t* parser, char* chunk, size_t idx, bool in_place ) {
+    char symbol = chunk[ idx ];
+
+    switch ( parser->state ) {
+        case PARSE_CHILD:
+            if ( symbol == '(' ) {
+                OpenNode( parser );
+            }
+            else if ( symbol == 'n' ) {
+                parser->nil_matched = 1;
+                parser->nil_next    = parser->consumed + idx + 1;
+                parser->state       = PARSE_NIL;
+            }
+            else {
+                SetError( parser, "ожидался узел '(' или nil", symbol );
+            }
+            break;
+
+        case PARSE_NIL:
+            // Spaces never reach the parser, so "n il" has to be caught by the offset
+            if ( parser->consumed + idx == parser->nil_next && symbol == "nil"[ parser->nil_matched ] ) {
+                parser->nil_next++;
+                if ( ++parser->nil_matched == 3 ) {
+                    ChildDone( parser );
+                }
+            }
+            else {
+                SetError( parser, "некорректный nil", symbol );
+            }
+            break;
+
+        case PARSE_VALUE_START:
+            if ( symbol == '\"' ) {
+                parser->value_start = chunk + idx + 1;
+                parser->state       = PARSE_VALUE;
+            }
+            else {
+                // Value may be omitted: `( nil nil )` is an empty node
+                parser->current->value = StringPoolIntern( &( parser->tree->strings ), "", 0 );
+                parser->state = PARSE_CHILD;
+
+                TakeToken( parser, chunk, idx, in_place );
+            }
+            break;
+
+        case PARSE_VALUE:
+            // The tokenizer yields nothing inside a value, so this is the closing quote
+            CloseValue( parser, chunk, chunk + idx, in_place );
+            break;
+
+        case PARSE_CLOSE:
+            if ( symbol == ')' ) {
+                CloseNode( parser );
+            }
+            else {
+                SetError( parser, "ожидалась ')'", symbol );
+            }
+            break;
+
+        case PARSE_END:
+            SetError( parser, "лишние символы после корня базы", symbol );
+            break;
+
+        default:
+            assert( 0 && "Unexpected parser state" );
+            break;
+    }
+}
+
+TreeStatus_t TreeParserFeed( TreeParser_t* parser, char* chunk, size_t length, bool in_place ) {
+    my_assert( parser, "Null pointer on `parser`" );
+    my_assert( chunk || length == 0, "Null pointer on `chunk`" );
+
+    size_t stop = length;
+
+    for ( size_t window = 0; window < length && !parser->error; window += TOKENIZER_WINDOW ) {
+        size_t window_length = length - window < TOKENIZER_WINDOW ? length - window : TOKENIZER_WINDOW;
+
+        size_t count = TokenizeChunk( chunk + window, window_length, parser->tokens, &( parser->in_string ) );
+
+        for ( size_t token = 0; token < count; token++ ) {
+            size_t idx = window + parser->tokens[ token ];
+
+            TakeToken( parser, chunk, idx, in_place );
+
+            if ( parser->error ) {
+                stop = idx;
+                break;
+            }
+        }
+    }
+
+    // The chunk will not outlive this call, so an unfinished value has to be copied
+    if ( !parser->error && parser->state == PARSE_VALUE ) {
+        char* begin = parser->value_start ? parser->value_start : chunk;
+        AppendValue( parser, begin, ( size_t ) ( chunk + length - begin ) );
+        parser->value_start = NULL;
+    }
+
+    // Position is only needed for messages, so it is brought up to date once per chunk
+    AdvancePosition( parser, chunk, chunk + stop );
+
+    if ( parser->error ) {
+        ReportError( parser, parser->error_message, parser->error_symbol );
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+TreeStatus_t TreeParserFinish( TreeParser_t* parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
+
+    if ( parser->error ) {
+        return FAIL;
+    }
+
+    switch ( parser->state ) {
+        case PARSE_END:
+            return SUCCESS;
+        case PARSE_VALUE:
+            ReportError( parser, "незакрытая строка", EOF );
+            break;
+        case PARSE_CHILD:
+        case PARSE_NIL:
+        case PARSE_VALUE_START:
+        case PARSE_CLOSE:
+        default:
+            ReportError( parser, "база оборвалась", EOF );
+            break;
+    }
+
+    return FAIL;
+}
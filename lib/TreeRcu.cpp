@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "TreeRcu.h"
+#include "DebugUtils.h"
+
+const size_t RCU_RETIRED_INITIAL_SIZE = 64;
+
+void TreeRcuCtor( TreeRcu_t* rcu ) {
+    my_assert( rcu, "Null pointer on `rcu`" );
+
+    memset( rcu, 0, sizeof( *rcu ) );
+
+    // 0 marks a reader outside any section
+    rcu->epoch = 1;
+
+    rcu->readers = ( RcuReader_t* ) aligned_alloc ( alignof( RcuReader_t ), RCU_MAX_READERS * sizeof( RcuReader_t ) );
+    assert( rcu->readers && "Memory allocation error" );
+    memset( ( void* ) rcu->readers, 0, RCU_MAX_READERS * sizeof( RcuReader_t ) );
+
+    pthread_mutex_init( &( rcu->writer ), NULL );
+}
+
+void TreeRcuDtor( TreeRcu_t* rcu ) {
+    my_assert( rcu, "Null pointer on `rcu`" );
+
+    // Retired nodes live in the tree's slabs and go with them
+    for ( size_t idx = 0; idx < RCU_EPOCHS; idx++ )
+        free( rcu->retired[ idx ].nodes );
+
+    free( rcu->readers );
+    pthread_mutex_destroy( &( rcu->writer ) );
+
+    memset( rcu, 0, sizeof( *rcu ) );
+}
+
+size_t TreeRcuRegisterReader( const TreeRcu_t* rcu ) {
+    my_assert( rcu, "Null pointer on `rcu`" );
+
+    for ( size_t idx = 0; idx < RCU_MAX_READERS; idx++ ) {
+        uint32_t expected = 0;
+
+        if ( __atomic_compare_exchange_n( &( rcu->readers[ idx ].claimed ), &expected, 1u, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) )
+            return idx;
+    }
+
+    assert( 0 && "Too many RCU readers" );
+    return 0;
+}
+
+void TreeRcuUnregisterReader( const TreeRcu_t* rcu, size_t reader ) {
+    my_assert( rcu && reader < RCU_MAX_READERS, "Bad RCU reader" );
+
+    __atomic_store_n( &( rcu->readers[ reader ].epoch ),   0, __ATOMIC_RELEASE );
+    __atomic_store_n( &( rcu->readers[ reader ].claimed ), 0, __ATOMIC_RELEASE );
+}
+
+void TreeRcuWriteBegin( TreeRcu_t* rcu ) {
+    my_assert( rcu, "Null pointer on `rcu`" );
+
+    pthread_mutex_lock( &( rcu->writer ) );
+}
+
+void TreeRcuWriteEnd( TreeRcu_t* rcu ) {
+    my_assert( rcu, "Null pointer on `rcu`" );
+
+    pthread_mutex_unlock( &( rcu->writer ) );
+}
+
+void TreeRcuRetire( TreeRcu_t* rcu, Node_t* node ) {
+    my_assert( rcu && node, "Null pointer on argument" );
+
+    RcuRetired_t* retired = &( rcu->retired[ rcu->epoch % RCU_EPOCHS ] );
+
+    if ( retired->count == retired->capacity ) {
+        retired->capacity = retired->capacity ? 2 * retired->capacity : RCU_RETIRED_INITIAL_SIZE;
+        retired->nodes = ( Node_t** ) realloc ( retired->nodes, retired->capacity * sizeof( Node_t* ) );
+        assert( retired->nodes && "Memory allocation error" );
+    }
+
+    retired->nodes[ retired->count++ ] = node;
+}
+
+size_t TreeRcuCollect( TreeRcu_t* rcu, Node_t*** reclaimable ) {
+    my_assert( rcu && reclaimable, "Null pointer on argument" );
+
+    // Pairs with the fence of TreeRcuReadBegin: a reader this scan misses has not read the
+    // links unlinked before it
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+    // Free slots read 0 like readers outside a section
+    for ( size_t idx = 0; idx < RCU_MAX_READERS; idx++ ) {
+        uint64_t seen = __atomic_load_n( &( rcu->readers[ idx ].epoch ), __ATOMIC_ACQUIRE );
+        if ( seen != 0 && seen != rcu->epoch )
+            return 0;
+    }
+
+    __atomic_store_n( &( rcu->epoch ), rcu->epoch + 1, __ATOMIC_RELEASE );
+
+    // Retired two epochs ago, the bucket the next epoch will fill
+    RcuRetired_t* safe  = &( rcu->retired[ ( rcu->epoch + 1 ) % RCU_EPOCHS ] );
+    size_t        count = safe->count;
+
+    *reclaimable = safe->nodes;
+    safe->count  = 0;
+
+    return count;
+}
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "TreeRender.h"
+#include "TreeSvg.h"
+#include "DebugUtils.h"
+#include "Metrics.h"
+#include "UtilsRW.h"
+
+const size_t TREE_RENDER_INITIAL_QUEUE = 16;
+
+static void GrowQueue( TreeRender_t* render ) {
+    size_t           capacity = render->queue_capacity ? render->queue_capacity * 2 : TREE_RENDER_INITIAL_QUEUE;
+    TreeRenderJob_t* queue    = ( TreeRenderJob_t* ) calloc ( capacity, sizeof( *queue ) );
+    assert( queue && "Memory allocation error" );
+
+    for ( size_t idx = 0; idx < render->queue_size; idx++ )
+        queue[ idx ] = render->queue[ ( render->queue_start + idx ) % render->queue_capacity ];
+
+    free( render->queue );
+
+    render->queue          = queue;
+    render->queue_start    = 0;
+    render->queue_capacity = capacity;
+}
+
+// Takes ownership of the paths and of the layout
+static void PushJob( TreeRender_t* render, char* dot_path, TreeSvgLayout_t* layout, char* svg_path, bool open ) {
+    if ( render->queue_size == render->queue_capacity )
+        GrowQueue( render );
+
+    TreeRenderJob_t* job = &( render->queue[ ( render->queue_start + render->queue_size ) % render->queue_capacity ] );
+
+    job->dot_path = dot_path;
+    job->layout   = layout;
+    job->svg_path = svg_path;
+    job->open     = open;
+
+    render->queue_size++;
+}
+
+static TreeRenderJob_t PopJob( TreeRender_t* render ) {
+    TreeRenderJob_t job = render->queue[ render->queue_start ];
+
+    render->queue_start = ( render->queue_start + 1 ) % render->queue_capacity;
+    render->queue_size--;
+
+    return job;
+}
+
+static void FreeJob( TreeRenderJob_t* job ) {
+    free( job->dot_path );
+    free( job->svg_path );
+
+    if ( job->layout )
+        TreeSvgLayoutDtor( &( job->layout ) );
+
+    job->dot_path = NULL;
+    job->svg_path = NULL;
+}
+
+// Keeps the rest of the queue in order
+static void DropDotJobs( TreeRender_t* render ) {
+    size_t kept = 0;
+
+    for ( size_t idx = 0; idx < render->queue_size; idx++ ) {
+        TreeRenderJob_t* job = &( render->queue[ ( render->queue_start + idx ) % render->queue_capacity ] );
+
+        if ( job->dot_path ) {
+            FreeJob( job );
+            continue;
+        }
+
+        render->queue[ ( render->queue_start + kept++ ) % render->queue_capacity ] = *job;
+    }
+
+    render->queue_size = kept;
+}
+
+static void MakeDotMissing( TreeRender_t* render ) {
+    if ( !render->dot_missing )
+        fprintf( stderr, "Graphviz (dot) не найден: деревья раскладываются без него\n" );
+
+    render->dot_missing = true;
+    DropDotJobs( render );
+}
+
+// Spawning is what finds out for sure, this only spares the first dump
+static bool IsInPath( const char* program ) {
+    const char* path = getenv( "PATH" );
+    if ( !path )
+        return false;
+
+    char candidate[ PATH_MAX ] = {};
+
+    while ( *path ) {
+        size_t length = strcspn( path, ":" );
+
+        snprintf( candidate, sizeof( candidate ), "%.*s/%s", ( int ) length, path, program );
+        if ( length > 0 && access( candidate, X_OK ) == 0 )
+            return true;
+
+        path += length;
+        if ( *path == ':' )
+            path++;
+    }
+
+    return false;
+}
+
+// Workers leave signals to the game's thread
+static void BlockSignals() {
+    sigset_t signals = {};
+    sigfillset( &signals );
+    pthread_sigmask( SIG_BLOCK, &signals, NULL );
+}
+
+static bool RenderSvg( const char* dot_path, const char* svg_path, bool* missing ) {
+    const char* arguments[] = { "dot", "-Tsvg", dot_path, "-o", svg_path, NULL };
+    pid_t       pid         = SpawnProcess( arguments, -1, -1 );
+
+    if ( pid == -1 ) {
+        *missing = true;
+        return false;
+    }
+
+    return WaitProcess( pid, 0 ) == 0;
+}
+
+static void OpenInViewer( const char* svg_path ) {
+    if ( access( svg_path, R_OK ) == -1 )
+        return;
+
+    const char* arguments[] = { "xdg-open", svg_path, NULL };
+    pid_t       pid         = SpawnProcess( arguments, -1, -1 );
+
+    if ( pid != -1 )
+        WaitProcess( pid, 0 );
+}
+
+static bool RunJob( const TreeRenderJob_t* job, bool* missing ) {
+    if ( !job->layout && !job->dot_path )
+        return true;
+
+    uint64_t start = MetricsStart();
+    bool     done  = job->layout ? TreeSvgWrite( job->layout, job->svg_path ) == SUCCESS
+                                 : RenderSvg( job->dot_path, job->svg_path, missing );
+
+    MetricsStop( TIMER_RENDER, start );
+
+    return done;
+}
+
+static void* RunWorker( void* argument ) {
+    TreeRender_t* render = ( TreeRender_t* ) argument;
+
+    BlockSignals();
+
+    pthread_mutex_lock( &( render->lock ) );
+
+    while ( true ) {
+        while ( !render->stopping && render->queue_size == 0 )
+            pthread_cond_wait( &( render->changed ), &( render->lock ) );
+
+        // Stopping: what is queued is rendered first
+        if ( render->queue_size == 0 )
+            break;
+
+        // At most worker_count jobs run, so a place is always free
+        TreeRenderJob_t* running = render->running;
+        while ( running->svg_path )
+            running++;
+
+        *running = PopJob( render );
+        TreeRenderJob_t job = *running;
+
+        pthread_mutex_unlock( &( render->lock ) );
+
+        bool missing = false;
+        bool done    = RunJob( &job, &missing );
+
+        pthread_mutex_lock( &( render->lock ) );
+
+        if ( missing )
+            MakeDotMissing( render );
+
+        // TreeRenderOpen may have asked for the picture while it was being rendered
+        bool open = done && running->open;
+
+        running->dot_path = NULL;
+        running->layout   = NULL;
+        running->svg_path = NULL;
+        running->open     = false;
+
+        pthread_cond_broadcast( &( render->changed ) );
+
+        if ( open ) {
+            pthread_mutex_unlock( &( render->lock ) );
+            OpenInViewer( job.svg_path );
+            pthread_mutex_lock( &( render->lock ) );
+        }
+
+        FreeJob( &job );
+    }
+
+    pthread_mutex_unlock( &( render->lock ) );
+
+    return NULL;
+}
+
+static size_t DefaultWorkers() {
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+
+    if ( cpus < 1 )
+        return 1;
+
+    return ( ( size_t ) cpus < TREE_RENDER_MAX_WORKERS ) ? ( size_t ) cpus : TREE_RENDER_MAX_WORKERS;
+}
+
+TreeRender_t* TreeRenderCtor( size_t workers ) {
+    TreeRender_t* render = ( TreeRender_t* ) calloc ( 1, sizeof( *render ) );
+    assert( render && "Memory allocation error" );
+
+    pthread_mutex_init( &( render->lock ), NULL );
+    pthread_cond_init( &( render->changed ), NULL );
+
+    if ( workers == 0 )
+        workers = DefaultWorkers();
+
+    render->workers = ( pthread_t* ) calloc ( workers, sizeof( pthread_t ) );
+    assert( render->workers && "Memory allocation error" );
+
+    render->running = ( TreeRenderJob_t* ) calloc ( workers, sizeof( TreeRenderJob_t ) );
+    assert( render->running && "Memory allocation error" );
+
+    for ( size_t idx = 0; idx < workers; idx++ ) {
+        if ( pthread_create( &( render->workers[ render->worker_count ] ), NULL, RunWorker, render ) == 0 )
+            render->worker_count++;
+    }
+
+    if ( !IsInPath( "dot" ) )
+        MakeDotMissing( render );
+
+    return render;
+}
+
+void TreeRenderDtor( TreeRender_t** render ) {
+    my_assert( render && *render, "Null pointer on `render`" );
+
+    TreeRender_t* self = *render;
+
+    pthread_mutex_lock( &( self->lock ) );
+    self->stopping = true;
+    pthread_cond_broadcast( &( self->changed ) );
+    pthread_mutex_unlock( &( self->lock ) );
+
+    for ( size_t idx = 0; idx < self->worker_count; idx++ )
+        pthread_join( self->workers[ idx ], NULL );
+
+    free( self->queue );
+    free( self->running );
+    free( self->workers );
+
+    pthread_cond_destroy( &( self->changed ) );
+    pthread_mutex_destroy( &( self->lock ) );
+
+    free( self );
+    *render = NULL;
+}
+
+// Without workers the job runs here and now
+static void Submit( TreeRender_t* render, char* dot_path, TreeSvgLayout_t* layout, char* svg_path, bool open ) {
+    if ( render->worker_count > 0 ) {
+        PushJob( render, dot_path, layout, svg_path, open );
+        pthread_cond_broadcast( &( render->changed ) );
+        return;
+    }
+
+    TreeRenderJob_t job = { dot_path, layout, svg_path, open };
+
+    bool missing = false;
+    bool done    = RunJob( &job, &missing );
+
+    if ( missing )
+        MakeDotMissing( render );
+
+    if ( done && open )
+        OpenInViewer( svg_path );
+
+    FreeJob( &job );
+}
+
+void TreeRenderQueue( TreeRender_t* render, const char* dot_path, const char* svg_path ) {
+    my_assert( render && dot_path && svg_path, "Null pointer on argument" );
+
+    pthread_mutex_lock( &( render->lock ) );
+
+    if ( !render->dot_missing ) {
+        char* dot_copy = strdup( dot_path );
+        char* svg_copy = strdup( svg_path );
+        assert( dot_copy && svg_copy && "Memory allocation error" );
+
+        Submit( render, dot_copy, NULL, svg_copy, false );
+    }
+
+    pthread_mutex_unlock( &( render->lock ) );
+}
+
+void TreeRenderQueueLayout( TreeRender_t* render, TreeSvgLayout_t* layout, const char* svg_path ) {
+    my_assert( render && layout && svg_path, "Null pointer on argument" );
+
+    char* svg_copy = strdup( svg_path );
+    assert( svg_copy && "Memory allocation error" );
+
+    pthread_mutex_lock( &( render->lock ) );
+    Submit( render, NULL, layout, svg_copy, false );
+    pthread_mutex_unlock( &( render->lock ) );
+}
+
+bool TreeRenderHasDot( TreeRender_t* render ) {
+    my_assert( render, "Null pointer on `render`" );
+
+    pthread_mutex_lock( &( render->lock ) );
+    bool has_dot = !render->dot_missing;
+    pthread_mutex_unlock( &( render->lock ) );
+
+    return has_dot;
+}
+
+static TreeRenderJob_t* FindJob( TreeRender_t* render, const char* svg_path ) {
+    for ( size_t idx = 0; idx < render->queue_size; idx++ ) {
+        TreeRenderJob_t* job = &( render->queue[ ( render->queue_start + idx ) % render->queue_capacity ] );
+
+        if ( strcmp( job->svg_path, svg_path ) == 0 )
+            return job;
+    }
+
+    for ( size_t idx = 0; idx < render->worker_count; idx++ ) {
+        TreeRenderJob_t* job = &( render->running[ idx ] );
+
+        if ( job->svg_path && strcmp( job->svg_path, svg_path ) == 0 )
+            return job;
+    }
+
+    return NULL;
+}
+
+bool TreeRenderOpen( TreeRender_t* render, const char* svg_path ) {
+    my_assert( render && svg_path, "Null pointer on argument" );
+
+    pthread_mutex_lock( &( render->lock ) );
+
+    TreeRenderJob_t* job    = FindJob( render, svg_path );
+    bool             coming = job || access( svg_path, R_OK ) == 0;
+
+    if ( job ) {
+        job->open = true;
+    }
+    else if ( coming ) {
+        char* svg_copy = strdup( svg_path );
+        assert( svg_copy && "Memory allocation error" );
+
+        // Rendered already: a worker opens it, the viewer may take its time to start
+        Submit( render, NULL, NULL, svg_copy, true );
+    }
+
+    pthread_mutex_unlock( &( render->lock ) );
+
+    return coming;
+}
+
+static bool IsIdle( const TreeRender_t* render ) {
+    if ( render->queue_size > 0 )
+        return false;
+
+    for ( size_t idx = 0; idx < render->worker_count; idx++ ) {
+        if ( render->running[ idx ].svg_path )
+            return false;
+    }
+
+    return true;
+}
+
+void TreeRenderWait( TreeRender_t* render ) {
+    my_assert( render, "Null pointer on `render`" );
+
+    pthread_mutex_lock( &( render->lock ) );
+
+    while ( !IsIdle( render ) )
+        pthread_cond_wait( &( render->changed ), &( render->lock ) );
+
+    pthread_mutex_unlock( &( render->lock ) );
+}
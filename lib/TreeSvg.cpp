@@ -0,0 +1,415 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "TreeSvg.h"
+#include "DebugUtils.h"
+
+const size_t TREE_SVG_INITIAL_NODES = 1024;
+const size_t TREE_SVG_OUTPUT_BUFFER = 1 << 20;
+
+static void ReserveNodes( TreeSvgLayout_t* layout, size_t count ) {
+    if ( count <= layout->capacity )
+        return;
+
+    size_t capacity = layout->capacity ? layout->capacity * 2 : TREE_SVG_INITIAL_NODES;
+    while ( capacity < count )
+        capacity *= 2;
+
+    layout->left  = ( int32_t* )  realloc ( layout->left,  capacity * sizeof( *( layout->left ) ) );
+    layout->right = ( int32_t* )  realloc ( layout->right, capacity * sizeof( *( layout->right ) ) );
+    layout->depth = ( uint32_t* ) realloc ( layout->depth, capacity * sizeof( *( layout->depth ) ) );
+    layout->width = ( int64_t* )  realloc ( layout->width, capacity * sizeof( *( layout->width ) ) );
+    layout->x     = ( int64_t* )  realloc ( layout->x,     capacity * sizeof( *( layout->x ) ) );
+    layout->label = ( size_t* )   realloc ( layout->label, capacity * sizeof( *( layout->label ) ) );
+    assert( layout->left && layout->right && layout->depth && layout->width && layout->x && layout->label &&
+            "Memory allocation error" );
+
+    layout->capacity = capacity;
+}
+
+// Code points, not bytes: a Cyrillic letter is as wide as a Latin one
+static int64_t LabelWidth( const char* value ) {
+    int64_t letters = 0;
+
+    for ( const char* symbol = value; *symbol; symbol++ ) {
+        if ( ( ( unsigned char ) *symbol & 0xC0 ) != 0x80 )
+            letters++;
+    }
+
+    int64_t width = letters * TREE_SVG_CHAR_WIDTH + 2 * TREE_SVG_CHAR_WIDTH;
+    if ( width < TREE_SVG_MIN_WIDTH )
+        width = TREE_SVG_MIN_WIDTH;
+
+    return width + ( width & 1 );
+}
+
+static size_t AddNode( TreeSvgLayout_t* layout, const Node_t* node, uint32_t depth ) {
+    size_t index = layout->count++;
+    ReserveNodes( layout, layout->count );
+
+    const char* value  = node->value ? node->value : "";
+    size_t      length = strlen( value ) + 1;
+
+    if ( layout->text_size + length > layout->text_capacity ) {
+        size_t capacity = layout->text_capacity ? layout->text_capacity * 2 : TREE_SVG_INITIAL_NODES * 16;
+        while ( capacity < layout->text_size + length )
+            capacity *= 2;
+
+        layout->text = ( char* ) realloc ( layout->text, capacity );
+        assert( layout->text && "Memory allocation error" );
+
+        layout->text_capacity = capacity;
+    }
+
+    memcpy( layout->text + layout->text_size, value, length );
+
+    layout->label[ index ] = layout->text_size;
+    layout->text_size     += length;
+
+    layout->left[ index ]  = -1;
+    layout->right[ index ] = -1;
+    layout->depth[ index ] = depth;
+    layout->width[ index ] = LabelWidth( value );
+    layout->x[ index ]     = 0;
+
+    return index;
+}
+
+struct FlattenFrame_t {
+    const Node_t* node;
+    int32_t       parent;
+    bool          is_left;
+};
+
+// Preorder with the "yes" child first, on an explicit stack
+static void Flatten( TreeSvgLayout_t* layout, const Node_t* root ) {
+    size_t          capacity = TREE_SVG_INITIAL_NODES;
+    size_t          size     = 0;
+    FlattenFrame_t* stack    = ( FlattenFrame_t* ) calloc ( capacity, sizeof( *stack ) );
+    assert( stack && "Memory allocation error" );
+
+    stack[ size++ ] = { root, -1, false };
+
+    while ( size > 0 ) {
+        FlattenFrame_t frame = stack[ --size ];
+
+        uint32_t depth = ( frame.parent == -1 ) ? 0 : layout->depth[ frame.parent ] + 1;
+        int32_t  index = ( int32_t ) AddNode( layout, frame.node, depth );
+
+        if ( frame.parent != -1 ) {
+            if ( frame.is_left ) layout->left[ frame.parent ]  = index;
+            else                 layout->right[ frame.parent ] = index;
+        }
+
+        if ( size + 2 > capacity ) {
+            capacity *= 2;
+            stack     = ( FlattenFrame_t* ) realloc ( stack, capacity * sizeof( *stack ) );
+            assert( stack && "Memory allocation error" );
+        }
+
+        const Node_t* left  = NodeLeft( frame.node );
+        const Node_t* right = NodeRight( frame.node );
+
+        if ( right ) stack[ size++ ] = { right, index, false };
+        if ( left )  stack[ size++ ] = { left,  index, true };
+    }
+
+    free( stack );
+}
+
+// Per-node state of the layout pass, x offsets are relative
+struct Contour_t {
+    int64_t shift;              // from the parent's centre
+    int32_t thread;             // next node of a contour below a leaf, -1 - none
+    int64_t thread_shift;       // from this node to `thread`
+
+    int32_t  leftmost;          // deepest level of the subtree: its leftmost and rightmost node
+    int32_t  rightmost;
+    int64_t  leftmost_x;        // from the subtree's root
+    int64_t  rightmost_x;
+    uint32_t deepest;
+};
+
+static int32_t NextOnLeft( const TreeSvgLayout_t* layout, const Contour_t* contours, int32_t node, int64_t* x ) {
+    int32_t next = ( layout->left[ node ] != -1 ) ? layout->left[ node ] : layout->right[ node ];
+
+    if ( next != -1 ) {
+        *x += contours[ next ].shift;
+        return next;
+    }
+
+    *x += contours[ node ].thread_shift;
+    return contours[ node ].thread;
+}
+
+static int32_t NextOnRight( const TreeSvgLayout_t* layout, const Contour_t* contours, int32_t node, int64_t* x ) {
+    int32_t next = ( layout->right[ node ] != -1 ) ? layout->right[ node ] : layout->left[ node ];
+
+    if ( next != -1 ) {
+        *x += contours[ next ].shift;
+        return next;
+    }
+
+    *x += contours[ node ].thread_shift;
+    return contours[ node ].thread;
+}
+
+// Children are placed around their parent as close as the facing contours allow; the walk
+// stops at the bottom of the shallower subtree, which is what keeps the whole pass linear
+static void PlaceChildren( const TreeSvgLayout_t* layout, Contour_t* contours, int32_t node ) {
+    Contour_t* self  = &( contours[ node ] );
+    int32_t    left  = layout->left[ node ];
+    int32_t    right = layout->right[ node ];
+
+    if ( left == -1 && right == -1 ) {
+        self->leftmost    = node;
+        self->rightmost   = node;
+        self->leftmost_x  = 0;
+        self->rightmost_x = 0;
+        self->deepest     = layout->depth[ node ];
+        return;
+    }
+
+    if ( left == -1 || right == -1 ) {
+        int32_t          child = ( left != -1 ) ? left : right;
+        const Contour_t* below = &( contours[ child ] );
+
+        contours[ child ].shift = 0;
+
+        self->leftmost    = below->leftmost;
+        self->rightmost   = below->rightmost;
+        self->leftmost_x  = below->leftmost_x;
+        self->rightmost_x = below->rightmost_x;
+        self->deepest     = below->deepest;
+        return;
+    }
+
+    // Right contour of the "yes" subtree against the left contour of the "no" one
+    int32_t inner_left    = left;
+    int32_t inner_right   = right;
+    int64_t inner_left_x  = 0;
+    int64_t inner_right_x = 0;
+    int64_t distance      = 0;
+
+    while ( true ) {
+        int64_t needed = inner_left_x - inner_right_x + TREE_SVG_GAP +
+                         ( layout->width[ inner_left ] + layout->width[ inner_right ] ) / 2;
+        if ( needed > distance )
+            distance = needed;
+
+        int64_t next_left_x  = inner_left_x;
+        int64_t next_right_x = inner_right_x;
+        int32_t next_left    = NextOnRight( layout, contours, inner_left,  &next_left_x );
+        int32_t next_right   = NextOnLeft(  layout, contours, inner_right, &next_right_x );
+
+        if ( next_left == -1 || next_right == -1 ) {
+            distance += distance & 1;
+
+            contours[ left ].shift  = -distance / 2;
+            contours[ right ].shift =  distance / 2;
+
+            // The contour of the shallower side goes on along the deeper one
+            if ( next_left == -1 && next_right != -1 ) {
+                Contour_t* bottom = &( contours[ contours[ left ].leftmost ] );
+
+                bottom->thread       = next_right;
+                bottom->thread_shift = ( next_right_x + distance / 2 ) - ( contours[ left ].leftmost_x - distance / 2 );
+            }
+            else if ( next_right == -1 && next_left != -1 ) {
+                Contour_t* bottom = &( contours[ contours[ right ].rightmost ] );
+
+                bottom->thread       = next_left;
+                bottom->thread_shift = ( next_left_x - distance / 2 ) - ( contours[ right ].rightmost_x + distance / 2 );
+            }
+
+            break;
+        }
+
+        inner_left    = next_left;
+        inner_right   = next_right;
+        inner_left_x  = next_left_x;
+        inner_right_x = next_right_x;
+    }
+
+    const Contour_t* yes = &( contours[ left ] );
+    const Contour_t* no  = &( contours[ right ] );
+
+    if ( yes->deepest >= no->deepest ) {
+        self->leftmost   = yes->leftmost;
+        self->leftmost_x = yes->leftmost_x + yes->shift;
+    }
+    else {
+        self->leftmost   = no->leftmost;
+        self->leftmost_x = no->leftmost_x + no->shift;
+    }
+
+    if ( no->deepest >= yes->deepest ) {
+        self->rightmost   = no->rightmost;
+        self->rightmost_x = no->rightmost_x + no->shift;
+    }
+    else {
+        self->rightmost   = yes->rightmost;
+        self->rightmost_x = yes->rightmost_x + yes->shift;
+    }
+
+    self->deepest = ( yes->deepest > no->deepest ) ? yes->deepest : no->deepest;
+}
+
+static void Place( TreeSvgLayout_t* layout ) {
+    Contour_t* contours = ( Contour_t* ) calloc ( layout->count, sizeof( *contours ) );
+    assert( contours && "Memory allocation error" );
+
+    for ( size_t idx = 0; idx < layout->count; idx++ )
+        contours[ idx ].thread = -1;
+
+    // Children follow their parent in preorder: backwards, every subtree is placed before its root
+    for ( size_t idx = layout->count; idx-- > 0; )
+        PlaceChildren( layout, contours, ( int32_t ) idx );
+
+    int64_t min_x = 0;
+    int64_t max_x = 0;
+
+    for ( size_t idx = 0; idx < layout->count; idx++ ) {
+        int32_t children[] = { layout->left[ idx ], layout->right[ idx ] };
+
+        for ( size_t child = 0; child < 2; child++ ) {
+            if ( children[ child ] != -1 )
+                layout->x[ children[ child ] ] = layout->x[ idx ] + contours[ children[ child ] ].shift;
+        }
+
+        int64_t half = layout->width[ idx ] / 2;
+
+        if ( layout->x[ idx ] - half < min_x ) min_x = layout->x[ idx ] - half;
+        if ( layout->x[ idx ] + half > max_x ) max_x = layout->x[ idx ] + half;
+    }
+
+    uint32_t deepest = 0;
+
+    for ( size_t idx = 0; idx < layout->count; idx++ ) {
+        layout->x[ idx ] += TREE_SVG_MARGIN - min_x;
+
+        if ( layout->depth[ idx ] > deepest )
+            deepest = layout->depth[ idx ];
+    }
+
+    layout->image_width  = max_x - min_x + 2 * TREE_SVG_MARGIN;
+    layout->image_height = ( int64_t ) deepest * TREE_SVG_LEVEL_HEIGHT + TREE_SVG_HEADER + TREE_SVG_ROW + 2 * TREE_SVG_MARGIN;
+
+    free( contours );
+}
+
+TreeSvgLayout_t* TreeSvgLayoutCtor( const Node_t* root ) {
+    my_assert( root, "Null pointer on `root`" );
+
+    TreeSvgLayout_t* layout = ( TreeSvgLayout_t* ) calloc ( 1, sizeof( *layout ) );
+    assert( layout && "Memory allocation error" );
+
+    Flatten( layout, root );
+    Place( layout );
+
+    return layout;
+}
+
+void TreeSvgLayoutDtor( TreeSvgLayout_t** layout ) {
+    my_assert( layout && *layout, "Null pointer on `layout`" );
+
+    free( ( *layout )->left );
+    free( ( *layout )->right );
+    free( ( *layout )->depth );
+    free( ( *layout )->width );
+    free( ( *layout )->x );
+    free( ( *layout )->label );
+    free( ( *layout )->text );
+
+    free( *layout );
+    *layout = NULL;
+}
+
+static void WriteEscaped( FILE* stream, const char* text ) {
+    const char* start = text;
+
+    for ( ; *text; text++ ) {
+        const char* entity = NULL;
+
+        switch ( *text ) {
+            case '&': entity = "&amp;";  break;
+            case '<': entity = "&lt;";   break;
+            case '>': entity = "&gt;";   break;
+            case '"': entity = "&quot;"; break;
+            default:                     break;
+        }
+
+        if ( entity ) {
+            fwrite( start, 1, ( size_t ) ( text - start ), stream );
+            fputs( entity, stream );
+            start = text + 1;
+        }
+    }
+
+    fwrite( start, 1, ( size_t ) ( text - start ), stream );
+}
+
+static int64_t Top( const TreeSvgLayout_t* layout, size_t node ) {
+    return TREE_SVG_MARGIN + ( int64_t ) layout->depth[ node ] * TREE_SVG_LEVEL_HEIGHT;
+}
+
+TreeStatus_t TreeSvgWrite( const TreeSvgLayout_t* layout, const char* svg_path ) {
+    my_assert( layout && svg_path, "Null pointer on argument" );
+
+    FILE* stream = fopen( svg_path, "w" );
+    if ( !stream )
+        return FAIL;
+
+    setvbuf( stream, NULL, _IOFBF, TREE_SVG_OUTPUT_BUFFER );
+
+    // The colours of the DOT dump's boxes, declared once instead of on every node
+    fprintf( stream,
+             "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+             "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%ld\" height=\"%ld\" viewBox=\"0 0 %ld %ld\" "
+             "font-family=\"Helvetica,Arial,sans-serif\" font-size=\"12\">\n"
+             "<style>rect{stroke:#343a40}.v{fill:#4c6ef5}.y{fill:#d8f5a2}.n{fill:#f5a8a8}"
+             "text{font-weight:bold;text-anchor:middle}.w{fill:white}path{stroke:black;fill:none}</style>\n"
+             "<rect width=\"100%%\" height=\"100%%\" style=\"fill:#f8f9fa;stroke:none\"/>\n",
+             layout->image_width, layout->image_height, layout->image_width, layout->image_height );
+
+    for ( size_t idx = 0; idx < layout->count; idx++ ) {
+        int64_t width = layout->width[ idx ];
+        int64_t left  = layout->x[ idx ] - width / 2;
+        int64_t top   = Top( layout, idx );
+
+        fprintf( stream,
+                 "<g transform=\"translate(%ld,%ld)\"><rect class=\"v\" width=\"%ld\" height=\"%ld\"/>"
+                 "<text class=\"w\" x=\"%ld\" y=\"14\">",
+                 left, top, width, TREE_SVG_HEADER, width / 2 );
+
+        WriteEscaped( stream, layout->text + layout->label[ idx ] );
+
+        fprintf( stream,
+                 "</text><rect class=\"y\" y=\"%ld\" width=\"%ld\" height=\"%ld\"/>"
+                 "<rect class=\"n\" x=\"%ld\" y=\"%ld\" width=\"%ld\" height=\"%ld\"/>"
+                 "<text x=\"%ld\" y=\"%ld\">Да</text><text x=\"%ld\" y=\"%ld\">Нет</text></g>\n",
+                 TREE_SVG_HEADER, width / 2, TREE_SVG_ROW,
+                 width / 2, TREE_SVG_HEADER, width / 2, TREE_SVG_ROW,
+                 width / 4, TREE_SVG_HEADER + 13, 3 * width / 4, TREE_SVG_HEADER + 13 );
+
+        // "Да" leads to the left child, "Нет" to the right one, each from its own cell
+        int64_t bottom      = top + TREE_SVG_HEADER + TREE_SVG_ROW;
+        int32_t children[]  = { layout->left[ idx ], layout->right[ idx ] };
+        int64_t from_x[]    = { left + width / 4, left + 3 * width / 4 };
+
+        for ( size_t child = 0; child < 2; child++ ) {
+            if ( children[ child ] == -1 )
+                continue;
+
+            fprintf( stream, "<path d=\"M%ld %ldL%ld %ld\"/>\n",
+                     from_x[ child ], bottom, layout->x[ children[ child ] ], Top( layout, ( size_t ) children[ child ] ) );
+        }
+    }
+
+    fprintf( stream, "</svg>\n" );
+
+    return ( fclose( stream ) == 0 ) ? SUCCESS : FAIL;
+}
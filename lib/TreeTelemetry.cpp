@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TreeTelemetry.h"
+#include "DebugUtils.h"
+#include "UtilsRW.h"
+
+const size_t TELEMETRY_WRITE_CHUNK = 4096;     // records per write
+
+// The most counted nodes seen so far, largest first
+struct TelemetryTop_t {
+    const Node_t* nodes[ TELEMETRY_TOP_SIZE ];
+    uint32_t      counts[ TELEMETRY_TOP_SIZE ];
+    size_t        size;
+};
+
+static char* TelemetryPath( const char* base_path ) {
+    size_t path_size = strlen( base_path ) + sizeof( ".stats" );
+
+    char* path = ( char* ) calloc ( path_size, sizeof( char ) );
+    assert( path && "Memory allocation error" );
+    snprintf( path, path_size, "%s.stats", base_path );
+
+    return path;
+}
+
+static void FillBaseIdentity( TelemetryHeader_t* header, const struct stat* base_stat ) {
+    header->base_device   = ( uint64_t ) base_stat->st_dev;
+    header->base_inode    = ( uint64_t ) base_stat->st_ino;
+    header->base_size     = ( uint64_t ) base_stat->st_size;
+    header->base_mtime_ns = ( int64_t ) base_stat->st_mtim.tv_sec * 1000000000 + base_stat->st_mtim.tv_nsec;
+}
+
+// Preorder over the parent links, left first, as the base writers go
+static Node_t* NextInPreorder( const Node_t* root, Node_t* node ) {
+    if ( node->left )
+        return node->left;
+    if ( node->right )
+        return node->right;
+
+    while ( node != root && ( node == node->parent->right || !node->parent->right ) )
+        node = node->parent;
+
+    return ( node == root ) ? NULL : node->parent->right;
+}
+
+static uint32_t LoadCounter( const uint32_t* counter ) {
+    return __atomic_load_n( counter, __ATOMIC_RELAXED );
+}
+
+static uint32_t EndedHere( const Node_t* node ) {
+    return LoadCounter( &( node->guessed ) ) + LoadCounter( &( node->missed ) );
+}
+
+bool TreeTelemetryLoad( Tree_t* tree, const char* base_path ) {
+    my_assert( tree,      "Null pointer on `tree`" );
+    my_assert( base_path, "Null pointer on `base_path`" );
+
+    struct stat base_stat = {};
+    if ( stat( base_path, &base_stat ) == -1 || !S_ISREG( base_stat.st_mode ) )
+        return false;
+
+    char* path = TelemetryPath( base_path );
+
+    off_t size   = 0;
+    char* buffer = MapFileToMemory( path, &size );
+    if ( !buffer ) {
+        if ( errno != ENOENT )
+            fprintf( stderr, "Не удалось открыть статистику игр %s: %s\n", path, strerror( errno ) );
+
+        free( path );
+        return false;
+    }
+
+    TelemetryHeader_t header   = {};
+    TelemetryHeader_t expected = {};
+    FillBaseIdentity( &expected, &base_stat );
+
+    if ( ( size_t ) size >= sizeof( header ) ) {
+        memcpy( &header, buffer, sizeof( header ) );
+    }
+
+    bool fits = ( size_t ) size >= sizeof( header ) &&
+                memcmp( header.magic, TELEMETRY_MAGIC, sizeof( TELEMETRY_MAGIC ) ) == 0 &&
+                header.version       == TELEMETRY_VERSION &&
+                header.base_device   == expected.base_device   && header.base_inode == expected.base_inode &&
+                header.base_size     == expected.base_size     && header.base_mtime_ns == expected.base_mtime_ns &&
+                header.node_count    == tree->arena.live &&
+                ( uint64_t ) size    == sizeof( header ) + header.node_count * sizeof( TelemetryRecord_t );
+
+    if ( !fits ) {
+        fprintf( stderr, "%s: статистика игр относится к другой версии базы и пропущена\n", path );
+    }
+    else {
+        const char* record = buffer + sizeof( header );
+
+        // The base is loaded in the order it was written, so the n-th record is the n-th node
+        for ( Node_t* node = tree->root; node; node = NextInPreorder( tree->root, node ) ) {
+            TelemetryRecord_t counters = {};
+            memcpy( &counters, record, sizeof( counters ) );
+            record += sizeof( counters );
+
+            node->visits  = counters.visits;
+            node->guessed = counters.guessed;
+            node->missed  = counters.missed;
+        }
+    }
+
+    UnmapFile( buffer, size );
+    free( path );
+
+    return fits;
+}
+
+TreeStatus_t TreeTelemetrySave( const Tree_t* tree, const char* base_path ) {
+    my_assert( tree,      "Null pointer on `tree`" );
+    my_assert( base_path, "Null pointer on `base_path`" );
+
+    struct stat base_stat = {};
+    if ( stat( base_path, &base_stat ) == -1 || !S_ISREG( base_stat.st_mode ) )
+        return SUCCESS;
+
+    TelemetryHeader_t header = {};
+    memcpy( header.magic, TELEMETRY_MAGIC, sizeof( TELEMETRY_MAGIC ) );
+    header.version    = TELEMETRY_VERSION;
+    header.node_count = tree->arena.live;
+    FillBaseIdentity( &header, &base_stat );
+
+    char* path = TelemetryPath( base_path );
+    char  temporary_name[ MAX_LEN_PATH ] = {};
+
+    int fd = OpenTemporaryFile( path, temporary_name, sizeof( temporary_name ) );
+    if ( fd == -1 ) {
+        fprintf( stderr, "Не удалось создать временный файл для %s: %s\n", path, strerror( errno ) );
+        free( path );
+        return FAIL;
+    }
+
+    TelemetryRecord_t* chunk = ( TelemetryRecord_t* ) calloc ( TELEMETRY_WRITE_CHUNK, sizeof( *chunk ) );
+    assert( chunk && "Memory allocation error" );
+
+    bool written = WriteAll( fd, ( const char* ) &header, sizeof( header ) ) != -1;
+
+    Node_t* node = tree->root;
+    while ( node && written ) {
+        size_t filled = 0;
+
+        for ( ; node && filled < TELEMETRY_WRITE_CHUNK; node = NextInPreorder( tree->root, node ), filled++ ) {
+            chunk[ filled ].visits  = LoadCounter( &( node->visits ) );
+            chunk[ filled ].guessed = LoadCounter( &( node->guessed ) );
+            chunk[ filled ].missed  = LoadCounter( &( node->missed ) );
+        }
+
+        written = WriteAll( fd, ( const char* ) chunk, filled * sizeof( *chunk ) ) != -1;
+    }
+
+    free( chunk );
+
+    TreeStatus_t status = SUCCESS;
+
+    if ( !written ) {
+        fprintf( stderr, "Ошибка записи статистики игр в %s: %s\n", temporary_name, strerror( errno ) );
+        DiscardTemporaryFile( fd, temporary_name );
+        status = FAIL;
+    }
+    else if ( CommitTemporaryFile( fd, temporary_name, path ) == -1 ) {
+        fprintf( stderr, "Не удалось сохранить статистику игр в %s: %s\n", path, strerror( errno ) );
+        status = FAIL;
+    }
+
+    free( path );
+
+    return status;
+}
+
+static void TopInsert( TelemetryTop_t* top, const Node_t* node, uint32_t count ) {
+    if ( count == 0 || ( top->size == TELEMETRY_TOP_SIZE && count <= top->counts[ top->size - 1 ] ) )
+        return;
+
+    size_t idx = ( top->size < TELEMETRY_TOP_SIZE ) ? top->size++ : top->size - 1;
+
+    for ( ; idx > 0 && top->counts[ idx - 1 ] < count; idx-- ) {
+        top->nodes[ idx ]  = top->nodes[ idx - 1 ];
+        top->counts[ idx ] = top->counts[ idx - 1 ];
+    }
+
+    top->nodes[ idx ]  = node;
+    top->counts[ idx ] = count;
+}
+
+// "Вопрос? да → Вопрос? нет → ..." from the root down to `node`
+static void PrintPath( FILE* stream, const Tree_t* tree, const Node_t* node, const Node_t** path ) {
+    size_t length = NodePathFrom( tree->root, node, path );
+    size_t shown  = ( length - 1 > TELEMETRY_PATH_SHOWN ) ? TELEMETRY_PATH_SHOWN : length - 1;
+
+    for ( size_t idx = 1; idx <= shown; idx++ ) {
+        fprintf( stream, "%s%s? %s", idx > 1 ? " → " : "", path[ idx - 1 ]->value,
+                 path[ idx - 1 ]->left == path[ idx ] ? "да" : "нет" );
+    }
+
+    if ( shown < length - 1 ) {
+        fprintf( stream, " → ... ещё вопросов: %zu", length - 1 - shown );
+    }
+
+    fprintf( stream, "\n" );
+}
+
+void TreeTelemetryReport( const Tree_t* tree, FILE* stream ) {
+    my_assert( tree && stream, "Null pointer on argument" );
+
+    if ( !tree->root ) {
+        fprintf( stream, "База пуста\n" );
+        return;
+    }
+
+    TreeStats_t stats = {};
+    TreeCollectStats( tree, &stats );
+
+    size_t  bucket  = stats.max_depth / TELEMETRY_HISTOGRAM_ROWS + 1;
+    size_t  rows    = stats.max_depth / bucket + 1;
+    size_t* objects = ( size_t* ) calloc ( rows, sizeof( size_t ) );
+    size_t* endings = ( size_t* ) calloc ( rows, sizeof( size_t ) );
+    assert( objects && endings && "Memory allocation error" );
+
+    uint64_t games = 0, guessed = 0, questions = 0, ending_depth_sum = 0;
+
+    TelemetryTop_t hottest = {};
+    TelemetryTop_t missed  = {};
+
+    for ( Node_t* node = tree->root; node; node = NextInPreorder( tree->root, node ) ) {
+        uint32_t ended = EndedHere( node );
+
+        games            += ended;
+        guessed          += LoadCounter( &( node->guessed ) );
+        ending_depth_sum += ( uint64_t ) ended * node->depth;
+
+        // A node with both answers is a question every time a game passes it
+        if ( node->left && node->right ) {
+            questions += LoadCounter( &( node->visits ) );
+            continue;
+        }
+
+        if ( !node->left && !node->right ) {
+            objects[ node->depth / bucket ]++;
+            endings[ node->depth / bucket ] += ended;
+        }
+
+        TopInsert( &hottest, node, ended );
+        TopInsert( &missed,  node, LoadCounter( &( node->missed ) ) );
+    }
+
+    fprintf( stream, "Сыграно игр: %llu, угадано: %llu, промахов: %llu\n",
+             ( unsigned long long ) games, ( unsigned long long ) guessed, ( unsigned long long ) ( games - guessed ) );
+
+    if ( games > 0 ) {
+        fprintf( stream, "Вопросов за игру: %.2f в сыгранных играх, %.2f для тех же ответов на нынешнем дереве\n",
+                 ( double ) questions / ( double ) games, ( double ) ending_depth_sum / ( double ) games );
+    }
+
+    // Padded by hand: printf widths count bytes, not Cyrillic letters
+    fprintf( stream, "\nГлубина     Объектов        Игр\n" );
+    for ( size_t row = 0; row < rows; row++ ) {
+        char depth[ 32 ] = {};
+        if ( bucket == 1 )
+            snprintf( depth, sizeof( depth ), "%zu", row );
+        else
+            snprintf( depth, sizeof( depth ), "%zu-%zu", row * bucket, row * bucket + bucket - 1 );
+
+        fprintf( stream, "%-9s %10zu %10zu\n", depth, objects[ row ], endings[ row ] );
+    }
+
+    const Node_t** path = ( const Node_t** ) calloc ( stats.max_depth + 1, sizeof( *path ) );
+    assert( path && "Memory allocation error" );
+
+    if ( hottest.size > 0 )
+        fprintf( stream, "\nЧаще всего загадывали:\n" );
+    for ( size_t idx = 0; idx < hottest.size; idx++ ) {
+        fprintf( stream, "  игр: %u, угадано %.0f%% - %s: ", hottest.counts[ idx ],
+                 100.0 * LoadCounter( &( hottest.nodes[ idx ]->guessed ) ) / hottest.counts[ idx ], hottest.nodes[ idx ]->value );
+        PrintPath( stream, tree, hottest.nodes[ idx ], path );
+    }
+
+    if ( missed.size > 0 )
+        fprintf( stream, "\nЧаще всего ошибались:\n" );
+    for ( size_t idx = 0; idx < missed.size; idx++ ) {
+        fprintf( stream, "  промахов: %u из %u - %s: ", missed.counts[ idx ], EndedHere( missed.nodes[ idx ] ), missed.nodes[ idx ]->value );
+        PrintPath( stream, tree, missed.nodes[ idx ], path );
+    }
+
+    free( path );
+    free( endings );
+    free( objects );
+}
@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#endif
+
+#include "TreeTokenizer.h"
+#include "DebugUtils.h"
+#include "UtilsRW.h"
+
+typedef size_t ( *TokenizeFunction_t ) ( const char* chunk, size_t length, uint32_t* tokens, bool* in_string );
+
+const size_t BLOCK_SIZE = 64;
+
+static size_t TokenizeScalar( const char* chunk, size_t length, uint32_t* tokens, bool* in_string ) {
+    size_t count  = 0;
+    bool   inside = *in_string;
+
+    for ( size_t idx = 0; idx < length; idx++ ) {
+        char symbol = chunk[ idx ];
+
+        if ( symbol == '\"' ) {
+            tokens[ count++ ] = ( uint32_t ) idx;
+            inside = !inside;
+        }
+        else if ( !inside && symbol != ' ' && !( '\t' <= symbol && symbol <= '\r' ) ) {
+            tokens[ count++ ] = ( uint32_t ) idx;
+        }
+    }
+
+    *in_string = inside;
+
+    return count;
+}
+
+#if defined( __x86_64__ )
+
+// Bit i becomes the xor of bits 0..i: ones from an opening quote up to the closing one
+static uint64_t PrefixXor( uint64_t bits ) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+
+    return bits;
+}
+
+static size_t EmitBlock( uint64_t quotes, uint64_t spaces, uint64_t valid, uint64_t* carry,
+                         uint32_t base, uint32_t* tokens ) {
+    uint64_t inside = PrefixXor( quotes ) ^ *carry;
+    *carry = ( inside >> 63 ) ? ~( uint64_t ) 0 : 0;
+
+    uint64_t structural = ( ( ~spaces & ~inside ) | quotes ) & valid;
+
+    size_t count = 0;
+    while ( structural ) {
+        tokens[ count++ ] = base + ( uint32_t ) __builtin_ctzll( structural );
+        structural &= structural - 1;
+    }
+
+    return count;
+}
+
+static void ScanBlockSse2( const char* block, uint64_t* quotes, uint64_t* spaces ) {
+    const __m128i quote = _mm_set1_epi8( '\"' );
+    const __m128i space = _mm_set1_epi8( ' ' );
+    const __m128i tab   = _mm_set1_epi8( '\t' );
+    const __m128i four  = _mm_set1_epi8( '\r' - '\t' );
+
+    *quotes = 0;
+    *spaces = 0;
+
+    for ( size_t part = 0; part < BLOCK_SIZE / 16; part++ ) {
+        __m128i bytes = _mm_loadu_si128( ( const __m128i* ) ( const void* ) ( block + part * 16 ) );
+
+        // '\t'..'\r' as one unsigned range check: bytes - '\t' <= 4
+        __m128i shifted = _mm_sub_epi8( bytes, tab );
+        __m128i control = _mm_cmpeq_epi8( _mm_min_epu8( shifted, four ), shifted );
+        __m128i blank   = _mm_or_si128( _mm_cmpeq_epi8( bytes, space ), control );
+
+        *quotes |= ( uint64_t ) ( uint32_t ) _mm_movemask_epi8( _mm_cmpeq_epi8( bytes, quote ) ) << ( part * 16 );
+        *spaces |= ( uint64_t ) ( uint32_t ) _mm_movemask_epi8( blank ) << ( part * 16 );
+    }
+}
+
+__attribute__(( target( "avx2" ) ))
+static void ScanBlockAvx2( const char* block, uint64_t* quotes, uint64_t* spaces ) {
+    const __m256i quote = _mm256_set1_epi8( '\"' );
+    const __m256i space = _mm256_set1_epi8( ' ' );
+    const __m256i tab   = _mm256_set1_epi8( '\t' );
+    const __m256i four  = _mm256_set1_epi8( '\r' - '\t' );
+
+    *quotes = 0;
+    *spaces = 0;
+
+    for ( size_t part = 0; part < BLOCK_SIZE / 32; part++ ) {
+        __m256i bytes = _mm256_loadu_si256( ( const __m256i* ) ( const void* ) ( block + part * 32 ) );
+
+        __m256i shifted = _mm256_sub_epi8( bytes, tab );
+        __m256i control = _mm256_cmpeq_epi8( _mm256_min_epu8( shifted, four ), shifted );
+        __m256i blank   = _mm256_or_si256( _mm256_cmpeq_epi8( bytes, space ), control );
+
+        *quotes |= ( uint64_t ) ( uint32_t ) _mm256_movemask_epi8( _mm256_cmpeq_epi8( bytes, quote ) ) << ( part * 32 );
+        *spaces |= ( uint64_t ) ( uint32_t ) _mm256_movemask_epi8( blank ) << ( part * 32 );
+    }
+}
+
+// Full blocks are scanned in place, the tail goes through a zero-padded copy
+#define TOKENIZE_BLOCKS( scan_block )                                                           \
+    size_t   count = 0;                                                                         \
+    uint64_t carry = *in_string ? ~( uint64_t ) 0 : 0;                                          \
+    size_t   idx   = 0;                                                                         \
+                                                                                                \
+    for ( ; idx + BLOCK_SIZE <= length; idx += BLOCK_SIZE ) {                                   \
+        uint64_t quotes = 0, spaces = 0;                                                        \
+        scan_block( chunk + idx, &quotes, &spaces );                                            \
+        count += EmitBlock( quotes, spaces, ~( uint64_t ) 0, &carry,                            \
+                            ( uint32_t ) idx, tokens + count );                                 \
+    }                                                                                           \
+                                                                                                \
+    if ( idx < length ) {                                                                       \
+        char tail[ BLOCK_SIZE ] = {};                                                           \
+        memcpy( tail, chunk + idx, length - idx );                                              \
+                                                                                                \
+        uint64_t quotes = 0, spaces = 0;                                                        \
+        scan_block( tail, &quotes, &spaces );                                                   \
+        count += EmitBlock( quotes, spaces, ( ( uint64_t ) 1 << ( length - idx ) ) - 1, &carry, \
+                            ( uint32_t ) idx, tokens + count );                                 \
+    }                                                                                           \
+                                                                                                \
+    *in_string = carry != 0;                                                                    \
+                                                                                                \
+    return count;
+
+static size_t TokenizeSse2( const char* chunk, size_t length, uint32_t* tokens, bool* in_string ) {
+    TOKENIZE_BLOCKS( ScanBlockSse2 )
+}
+
+__attribute__(( target( "avx2" ) ))
+static size_t TokenizeAvx2( const char* chunk, size_t length, uint32_t* tokens, bool* in_string ) {
+    TOKENIZE_BLOCKS( ScanBlockAvx2 )
+}
+
+#undef TOKENIZE_BLOCKS
+
+#endif
+
+static TokenizeFunction_t tokenize_function = NULL;
+static const char*        tokenize_name     = NULL;
+
+void TokenizerSelect( TokenizerKind_t kind ) {
+    tokenize_function = TokenizeScalar;
+    tokenize_name     = "scalar";
+
+    #if defined( __x86_64__ )
+        __builtin_cpu_init();
+
+        bool has_avx2 = __builtin_cpu_supports( "avx2" );
+
+        if ( kind == TOKENIZER_AVX2 && !has_avx2 ) {
+            fprintf( stderr, "AVX2 недоступен, используется SSE2\n" );
+            kind = TOKENIZER_SSE2;
+        }
+
+        switch ( kind ) {
+            case TOKENIZER_AUTO:
+                if ( has_avx2 ) {
+                    tokenize_function = TokenizeAvx2;
+                    tokenize_name     = "avx2";
+                }
+                else {
+                    tokenize_function = TokenizeSse2;
+                    tokenize_name     = "sse2";
+                }
+                break;
+            case TOKENIZER_AVX2:
+                tokenize_function = TokenizeAvx2;
+                tokenize_name     = "avx2";
+                break;
+            case TOKENIZER_SSE2:
+                tokenize_function = TokenizeSse2;
+                tokenize_name     = "sse2";
+                break;
+            case TOKENIZER_SCALAR:
+            default:
+                break;
+        }
+    #else
+        ( void ) kind;
+    #endif
+}
+
+const char* TokenizerName() {
+    if ( !tokenize_function ) {
+        TokenizerSelect( TOKENIZER_AUTO );
+    }
+
+    return tokenize_name;
+}
+
+size_t TokenizeChunk( const char* chunk, size_t length, uint32_t* tokens, bool* in_string ) {
+    my_assert( chunk && tokens && in_string, "Null pointer in tokenizer arguments" );
+    my_assert( length <= TOKENIZER_WINDOW, "Chunk is larger than the tokenizer window" );
+
+    if ( !tokenize_function ) {
+        TokenizerSelect( TOKENIZER_AUTO );
+    }
+
+    return tokenize_function( chunk, length, tokens, in_string );
+}
+
+// Self-check of the vector tokenizers against the scalar one, run by --check-tokenizer
+const size_t   CHECK_FUZZ_CASES      = 20000;
+const size_t   CHECK_FUZZ_MAX_LENGTH = 3 * BLOCK_SIZE + 17;
+const uint64_t CHECK_SEED            = 0x9e3779b97f4a7c15ull;
+
+struct TokenizerCheck_t {
+    TokenizeFunction_t function;
+    const char*        name;
+
+    uint32_t* expected;
+    uint32_t* actual;
+
+    size_t cases;
+    size_t mismatches;
+};
+
+static uint64_t CheckRandom( uint64_t* state ) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+// Both quote states in, count, offsets and quote state out must match the scalar tokenizer
+static void CheckChunk( TokenizerCheck_t* check, const char* chunk, size_t length, const char* what ) {
+    for ( int state = 0; state < 2; state++ ) {
+        bool expected_in_string = ( state == 1 );
+        bool actual_in_string   = ( state == 1 );
+
+        size_t expected_count = TokenizeScalar( chunk, length, check->expected, &expected_in_string );
+        size_t actual_count   = check->function( chunk, length, check->actual, &actual_in_string );
+
+        check->cases++;
+
+        if ( expected_count == actual_count && expected_in_string == actual_in_string &&
+             memcmp( check->expected, check->actual, actual_count * sizeof( *check->actual ) ) == 0 )
+            continue;
+
+        if ( check->mismatches++ < 10 ) {
+            fprintf( stderr, "%s: расхождение со скалярным (%s, длина %zu, внутри строки %d): "
+                             "токенов %zu вместо %zu\n",
+                     check->name, what, length, state, actual_count, expected_count );
+        }
+    }
+}
+
+// Bytes the scanners could get wrong: the blanks, their neighbours \b and \x0e, quotes and
+// brackets, UTF-8 and other high bytes that are negative as signed chars, and zero
+static const char CHECK_ALPHABET[] = {
+    ' ', '\t', '\n', '\v', '\f', '\r', '\b', '\x0e', '\x1f', '!', '\"', '#', '(', ')', 'n', 'i', 'l',
+    '\xd0', '\xb0', '\xd1', '\x80', '\xff', '\x7f', '\0'
+};
+
+static void CheckEdgeCases( TokenizerCheck_t* check, char* buffer ) {
+    // A lone quote or bracket at every offset around the block boundaries
+    for ( size_t length = 0; length <= 2 * BLOCK_SIZE + 1; length++ ) {
+        for ( size_t position = 0; position < length; position++ ) {
+            memset( buffer, ' ', length );
+            buffer[ position ] = '\"';
+            CheckChunk( check, buffer, length, "одна кавычка" );
+
+            buffer[ position ] = '(';
+            CheckChunk( check, buffer, length, "одна скобка" );
+        }
+    }
+
+    // Every byte value at both ends of a full block and of the tail
+    for ( int value = 0; value < 256; value++ ) {
+        memset( buffer, 'a', BLOCK_SIZE + 1 );
+        buffer[ 0 ]              = ( char ) value;
+        buffer[ BLOCK_SIZE - 1 ] = ( char ) value;
+        buffer[ BLOCK_SIZE ]     = ( char ) value;
+        CheckChunk( check, buffer, BLOCK_SIZE + 1, "значение байта" );
+    }
+
+    // A window full of random bytes, the largest chunk the parser hands over
+    uint64_t state = CHECK_SEED;
+    for ( size_t idx = 0; idx < TOKENIZER_WINDOW; idx++ )
+        buffer[ idx ] = ( char ) CheckRandom( &state );
+
+    CheckChunk( check, buffer, TOKENIZER_WINDOW, "случайное окно" );
+
+    // Short random chunks over the alphabet above
+    for ( size_t test = 0; test < CHECK_FUZZ_CASES; test++ ) {
+        size_t length = CheckRandom( &state ) % ( CHECK_FUZZ_MAX_LENGTH + 1 );
+
+        for ( size_t idx = 0; idx < length; idx++ )
+            buffer[ idx ] = CHECK_ALPHABET[ CheckRandom( &state ) % sizeof( CHECK_ALPHABET ) ];
+
+        CheckChunk( check, buffer, length, "случайный фрагмент" );
+    }
+}
+
+// The base cut into windows as the parser cuts it, the quote state carried between them
+static void CheckBase( TokenizerCheck_t* check, const char* base, size_t size ) {
+    bool expected_in_string = false;
+    bool actual_in_string   = false;
+
+    for ( size_t offset = 0; offset < size; offset += TOKENIZER_WINDOW ) {
+        size_t length = ( size - offset < TOKENIZER_WINDOW ) ? size - offset : TOKENIZER_WINDOW;
+
+        size_t expected_count = TokenizeScalar( base + offset, length, check->expected, &expected_in_string );
+        size_t actual_count   = check->function( base + offset, length, check->actual, &actual_in_string );
+
+        check->cases++;
+
+        if ( expected_count != actual_count || expected_in_string != actual_in_string ||
+             memcmp( check->expected, check->actual, actual_count * sizeof( *check->actual ) ) != 0 ) {
+            if ( check->mismatches++ < 10 )
+                fprintf( stderr, "%s: расхождение со скалярным в базе со смещения %zu\n", check->name, offset );
+
+            expected_in_string = actual_in_string;
+        }
+    }
+}
+
+int TokenizerSelfCheck( const char* base_path ) {
+    char* base      = NULL;
+    off_t base_size = 0;
+
+    if ( base_path ) {
+        base = MapFileToMemory( base_path, &base_size );
+
+        if ( !base ) {
+            fprintf( stderr, "Не удалось открыть базу \"%s\"\n", base_path );
+            return 1;
+        }
+    }
+
+    char*     buffer   = ( char* )     calloc ( TOKENIZER_WINDOW, sizeof( char ) );
+    uint32_t* expected = ( uint32_t* ) calloc ( TOKENIZER_WINDOW, sizeof( uint32_t ) );
+    uint32_t* actual   = ( uint32_t* ) calloc ( TOKENIZER_WINDOW, sizeof( uint32_t ) );
+    assert( buffer && expected && actual && "Memory allocation error" );
+
+    TokenizerCheck_t checks[ 2 ] = {};
+    size_t           check_count = 0;
+
+    #if defined( __x86_64__ )
+        __builtin_cpu_init();
+
+        checks[ check_count++ ] = { TokenizeSse2, "sse2", expected, actual, 0, 0 };
+
+        if ( __builtin_cpu_supports( "avx2" ) )
+            checks[ check_count++ ] = { TokenizeAvx2, "avx2", expected, actual, 0, 0 };
+        else
+            printf( "avx2: недоступен на этом процессоре, пропущен\n" );
+    #endif
+
+    if ( check_count == 0 )
+        printf( "Векторных токенизаторов на этой платформе нет, сравнивать не с чем\n" );
+
+    size_t mismatches = 0;
+
+    for ( size_t idx = 0; idx < check_count; idx++ ) {
+        CheckEdgeCases( &checks[ idx ], buffer );
+
+        if ( base )
+            CheckBase( &checks[ idx ], base, ( size_t ) base_size );
+
+        printf( "%s: %zu фрагментов, расхождений со скалярным: %zu\n",
+                checks[ idx ].name, checks[ idx ].cases, checks[ idx ].mismatches );
+
+        mismatches += checks[ idx ].mismatches;
+    }
+
+    free( buffer );
+    free( expected );
+    free( actual );
+
+    if ( base )
+        UnmapFile( base, base_size );
+
+    return mismatches ? 1 : 0;
+}
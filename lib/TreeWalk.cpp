@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <string.h>
+
+#include "TreeWalk.h"
+#include "DebugUtils.h"
+
+const size_t WALK_STACK_INITIAL_SIZE = 64;
+const size_t WALK_PIECE_SIZE         = 64 * 1024;
+
+// Stack entries are node or task pointers with the kind in the low bits
+const uintptr_t ENTRY_ENTER = 0;
+const uintptr_t ENTRY_LEAVE = 1;
+const uintptr_t ENTRY_HOLE  = 2;        // a subtree given to another task
+const uintptr_t ENTRY_KIND  = 3;
+
+// Text of a task in fixed-size pieces, never moved once written;
+// `hole` - the output of another task goes after `data`
+struct TreeWalkPiece_t {
+    TreeWalkPiece_t* next;
+    TreeWalkTask_t*  hole;
+
+    char*  data;
+    size_t size;
+    size_t capacity;
+};
+
+struct TreeWalkTask_t {
+    Task_t task;
+
+    TreeWalk_t*     walk;
+    const Node_t*   root;
+    TreeWalkTask_t* next;
+
+    TreeWalkPiece_t* first;
+    TreeWalkPiece_t* last;
+};
+
+struct WalkStack_t {
+    uintptr_t* entries;
+    size_t     size;
+    size_t     capacity;
+    size_t     spawn_from;      // entries below are leave markers or holes, never given away
+};
+
+static void RunWalkTask( Task_t* base, size_t worker );
+
+static TreeWalkTask_t* NewTask( TreeWalk_t* walk, const Node_t* root ) {
+    TreeWalkTask_t* task = ( TreeWalkTask_t* ) calloc ( 1, sizeof( *task ) );
+    assert( task && "Memory allocation error" );
+
+    task->task.run = RunWalkTask;
+    task->walk     = walk;
+    task->root     = root;
+
+    task->next = walk->tasks.load( std::memory_order_relaxed );
+    while ( !walk->tasks.compare_exchange_weak( task->next, task, std::memory_order_release, std::memory_order_relaxed ) )
+        ;
+
+    return task;
+}
+
+static void StackPush( WalkStack_t* stack, uintptr_t entry ) {
+    if ( stack->size == stack->capacity ) {
+        stack->capacity = stack->capacity ? 2 * stack->capacity : WALK_STACK_INITIAL_SIZE;
+        stack->entries  = ( uintptr_t* ) realloc ( stack->entries, stack->capacity * sizeof( uintptr_t ) );
+        assert( stack->entries && "Memory allocation error" );
+    }
+
+    stack->entries[ stack->size++ ] = entry;
+}
+
+// Gives the lowest pending subtree of the stack - the one the walk would reach last,
+// usually the largest - to a new task, leaving a hole in its place
+static void GiveAwaySubtree( TreeWalkCursor_t* cursor, WalkStack_t* stack ) {
+    while ( stack->spawn_from < stack->size && ( stack->entries[ stack->spawn_from ] & ENTRY_KIND ) != ENTRY_ENTER )
+        stack->spawn_from++;
+
+    // The top entry is the next one to walk here, keep it
+    if ( stack->spawn_from + 1 >= stack->size )
+        return;
+
+    const Node_t*   node = ( const Node_t* ) stack->entries[ stack->spawn_from ];
+    TreeWalkTask_t* task = NewTask( cursor->walk, node );
+
+    if ( TaskPoolSpawn( cursor->walk->pool, cursor->worker, &( task->task ) ) )
+        stack->entries[ stack->spawn_from ] = ( uintptr_t ) task | ENTRY_HOLE;
+
+    // A task that did not fit the deque stays on the list, empty, until TreeWalkFree
+}
+
+// The last piece of the task if it has room for `length` more bytes and no hole yet
+static TreeWalkPiece_t* PieceWithRoom( TreeWalkTask_t* task, size_t length ) {
+    TreeWalkPiece_t* last = task->last;
+
+    if ( last && !last->hole && last->capacity - last->size >= length )
+        return last;
+
+    TreeWalkPiece_t* piece = ( TreeWalkPiece_t* ) calloc ( 1, sizeof( *piece ) );
+    assert( piece && "Memory allocation error" );
+
+    piece->capacity = ( length > WALK_PIECE_SIZE ) ? length : WALK_PIECE_SIZE;
+    piece->data     = ( char* ) calloc ( piece->capacity, sizeof( char ) );
+    assert( piece->data && "Memory allocation error" );
+
+    if ( last )
+        last->next = piece;
+    else
+        task->first = piece;
+
+    task->last = piece;
+
+    return piece;
+}
+
+static void RunWalkTask( Task_t* base, size_t worker ) {
+    TreeWalkTask_t* task = ( TreeWalkTask_t* ) base;
+    TreeWalk_t*     walk = task->walk;
+
+    TreeWalkCursor_t cursor = {};
+    cursor.walk   = walk;
+    cursor.worker = worker;
+    cursor.task   = task;
+
+    WalkStack_t stack = {};
+    StackPush( &stack, ( uintptr_t ) task->root );
+
+    size_t budget = TREE_WALK_CUTOFF;
+
+    while ( stack.size > 0 ) {
+        if ( --budget == 0 ) {
+            budget = TREE_WALK_CUTOFF;
+
+            if ( walk->stopped.load( std::memory_order_relaxed ) )
+                break;
+
+            if ( TaskPoolHungry( walk->pool, worker ) )
+                GiveAwaySubtree( &cursor, &stack );
+        }
+
+        uintptr_t     entry = stack.entries[ --stack.size ];
+        const Node_t* node  = ( const Node_t* ) ( entry & ~ENTRY_KIND );
+
+        if ( stack.spawn_from > stack.size )
+            stack.spawn_from = stack.size;
+
+        if ( ( entry & ENTRY_KIND ) == ENTRY_HOLE ) {
+            if ( walk->ordered )
+                PieceWithRoom( task, 0 )->hole = ( TreeWalkTask_t* ) ( entry & ~ENTRY_KIND );
+            continue;
+        }
+
+        if ( ( entry & ENTRY_KIND ) == ENTRY_LEAVE ) {
+            walk->leave( &cursor, node );
+            continue;
+        }
+
+        if ( !walk->enter( &cursor, node ) ) {
+            walk->stopped.store( true, std::memory_order_relaxed );
+            break;
+        }
+
+        if ( walk->leave )
+            StackPush( &stack, ( uintptr_t ) node | ENTRY_LEAVE );
+        const Node_t* right = NodeRight( node );
+        const Node_t* left  = NodeLeft( node );
+
+        if ( right )
+            StackPush( &stack, ( uintptr_t ) right );
+        if ( left )
+            StackPush( &stack, ( uintptr_t ) left );
+    }
+
+    free( stack.entries );
+}
+
+void TreeWalkRun( TreeWalk_t* walk, const Node_t* root ) {
+    my_assert( walk && walk->enter, "Null pointer on walk" );
+
+    if ( !walk->pool )
+        walk->pool = TaskPoolShared();
+
+    walk->stopped.store( false, std::memory_order_relaxed );
+    walk->tasks.store( NULL, std::memory_order_relaxed );
+    walk->root_task = NULL;
+
+    if ( !root )
+        return;
+
+    walk->root_task = NewTask( walk, root );
+
+    // TaskPoolRun returns once every task is done, so one section covers the workers too
+    size_t reader = 0;
+    if ( walk->rcu ) {
+        reader = TreeRcuRegisterReader( walk->rcu );
+        TreeRcuReadBegin( walk->rcu, reader );
+    }
+
+    TaskPoolRun( walk->pool, &( walk->root_task->task ) );
+
+    if ( walk->rcu ) {
+        TreeRcuReadEnd( walk->rcu, reader );
+        TreeRcuUnregisterReader( walk->rcu, reader );
+    }
+}
+
+void TreeWalkEmit( TreeWalkCursor_t* cursor, const char* data, size_t length ) {
+    my_assert( cursor && data, "Null pointer on argument" );
+
+    TreeWalkPiece_t* piece = PieceWithRoom( cursor->task, length );
+
+    memcpy( piece->data + piece->size, data, length );
+    piece->size += length;
+}
+
+void TreeWalkVPrintf( TreeWalkCursor_t* cursor, const char* format, va_list args ) {
+    my_assert( cursor && format, "Null pointer on argument" );
+
+    TreeWalkPiece_t* piece = PieceWithRoom( cursor->task, 1 );
+
+    va_list retry = {};
+    va_copy( retry, args );
+
+    int length = vsnprintf( piece->data + piece->size, piece->capacity - piece->size, format, args );
+
+    // Did not fit: the partial text past `size` is simply overwritten elsewhere
+    if ( length >= 0 && ( size_t ) length >= piece->capacity - piece->size ) {
+        piece = PieceWithRoom( cursor->task, ( size_t ) length + 1 );
+        vsnprintf( piece->data + piece->size, piece->capacity - piece->size, format, retry );
+    }
+
+    va_end( retry );
+
+    if ( length > 0 )
+        piece->size += ( size_t ) length;
+}
+
+void TreeWalkPrintf( TreeWalkCursor_t* cursor, const char* format, ... ) {
+    va_list args = {};
+    va_start( args, format );
+    TreeWalkVPrintf( cursor, format, args );
+    va_end( args );
+}
+
+// Pieces in preorder: a hole is expanded in place, the rest of its piece list waits on a stack
+void TreeWalkDrain( const TreeWalk_t* walk, TreeWalkSink_t sink, void* argument ) {
+    my_assert( walk && sink, "Null pointer on argument" );
+
+    if ( !walk->root_task )
+        return;
+
+    const TreeWalkPiece_t** resume   = NULL;
+    size_t                  size     = 0;
+    size_t                  capacity = 0;
+
+    const TreeWalkPiece_t* piece = walk->root_task->first;
+
+    while ( true ) {
+        while ( piece ) {
+            if ( piece->size > 0 )
+                sink( argument, piece->data, piece->size );
+
+            if ( !piece->hole ) {
+                piece = piece->next;
+                continue;
+            }
+
+            if ( size == capacity ) {
+                capacity = capacity ? 2 * capacity : WALK_STACK_INITIAL_SIZE;
+                resume   = ( const TreeWalkPiece_t** ) realloc ( resume, capacity * sizeof( *resume ) );
+                assert( resume && "Memory allocation error" );
+            }
+
+            resume[ size++ ] = piece->next;
+            piece = piece->hole->first;
+        }
+
+        if ( size == 0 )
+            break;
+
+        piece = resume[ --size ];
+    }
+
+    free( resume );
+}
+
+void TreeWalkFree( TreeWalk_t* walk ) {
+    my_assert( walk, "Null pointer on `walk`" );
+
+    TreeWalkTask_t* task = walk->tasks.load( std::memory_order_acquire );
+
+    while ( task ) {
+        TreeWalkPiece_t* piece = task->first;
+        while ( piece ) {
+            TreeWalkPiece_t* next = piece->next;
+            free( piece->data );
+            free( piece );
+            piece = next;
+        }
+
+        TreeWalkTask_t* next = task->next;
+        free( task );
+        task = next;
+    }
+
+    walk->tasks.store( NULL, std::memory_order_relaxed );
+    walk->root_task = NULL;
+}
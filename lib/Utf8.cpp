@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Utf8.h"
+
+static uint32_t FoldCodePoint( uint32_t code ) {
+    if ( code >= 'A' && code <= 'Z' )
+        return code + 0x20;
+
+    // À..Þ without the multiplication sign
+    if ( code >= 0xC0 && code <= 0xDE && code != 0xD7 )
+        return code + 0x20;
+
+    // Ѐ..Џ (Ё among them) and А..Я
+    if ( code >= 0x400 && code <= 0x40F )
+        return code + 0x50;
+    if ( code >= 0x410 && code <= 0x42F )
+        return code + 0x20;
+
+    return code;
+}
+
+uint32_t Utf8NextFolded( const char** text ) {
+    const unsigned char* bytes = ( const unsigned char* ) *text;
+
+    if ( bytes[0] == 0 )
+        return 0;
+
+    size_t   length = 0;
+    uint32_t code   = 0;
+
+    if ( bytes[0] < 0x80 ) {
+        *text += 1;
+        return FoldCodePoint( bytes[0] );
+    }
+    else if ( ( bytes[0] & 0xE0 ) == 0xC0 ) { length = 2; code = bytes[0] & 0x1F; }
+    else if ( ( bytes[0] & 0xF0 ) == 0xE0 ) { length = 3; code = bytes[0] & 0x0F; }
+    else if ( ( bytes[0] & 0xF8 ) == 0xF0 ) { length = 4; code = bytes[0] & 0x07; }
+
+    for ( size_t idx = 1; idx < length; idx++ ) {
+        // Also stops at the terminating '\0' of a truncated sequence
+        if ( ( bytes[ idx ] & 0xC0 ) != 0x80 ) {
+            length = 0;
+            break;
+        }
+        code = ( code << 6 ) | ( bytes[ idx ] & 0x3F );
+    }
+
+    if ( length == 0 ) {
+        *text += 1;
+        return bytes[0];
+    }
+
+    *text += length;
+    return FoldCodePoint( code );
+}
+
+bool Utf8Fold( const char* text, char* folded ) {
+    bool changed = false;
+
+    while ( *text ) {
+        const char* start  = text;
+        uint32_t    code   = Utf8NextFolded( &text );
+        size_t      length = ( size_t ) ( text - start );
+
+        // Every folded pair lies within one encoding length: only one and two byte sequences change
+        if ( length == 1 && code < 0x80 ) {
+            folded[0] = ( char ) code;
+        }
+        else if ( length == 2 ) {
+            folded[0] = ( char ) ( 0xC0 | ( code >> 6 ) );
+            folded[1] = ( char ) ( 0x80 | ( code & 0x3F ) );
+        }
+        else {
+            memcpy( folded, start, length );
+        }
+
+        changed = changed || memcmp( folded, start, length ) != 0;
+        folded += length;
+    }
+
+    *folded = '\0';
+
+    return changed;
+}
+
+uint32_t Utf8FoldedHash( const char* text ) {
+    uint32_t hash = 2166136261u;
+
+    for ( uint32_t code = Utf8NextFolded( &text ); code != 0; code = Utf8NextFolded( &text ) ) {
+        hash ^= code;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+bool Utf8FoldedEqual( const char* first, const char* second ) {
+    while ( true ) {
+        uint32_t first_code  = Utf8NextFolded( &first );
+        uint32_t second_code = Utf8NextFolded( &second );
+
+        if ( first_code != second_code )
+            return false;
+        if ( first_code == 0 )
+            return true;
+    }
+}
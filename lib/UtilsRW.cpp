@@ -1,5 +1,15 @@
 #include <errno.h>
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "UtilsRW.h"
 
@@ -22,3 +32,283 @@ off_t DetermineTheFileSize( const char* file_name ) {
     return file_stat.st_size;
 }
 
+void AppendBytes( OutputBuffer_t* output, const char* data, size_t length ) {
+    if ( output->size + length > output->capacity ) {
+        size_t capacity = output->capacity ? output->capacity : OUTPUT_BUFFER_INITIAL_SIZE;
+        while ( capacity < output->size + length )
+            capacity *= 2;
+
+        output->data = ( char* ) realloc ( output->data, capacity );
+        assert( output->data && "Memory allocation error" );
+        output->capacity = capacity;
+    }
+
+    memcpy( output->data + output->size, data, length );
+    output->size += length;
+}
+
+void AppendText( OutputBuffer_t* output, const char* text ) {
+    AppendBytes( output, text, strlen( text ) );
+}
+
+void AppendJsonString( OutputBuffer_t* output, const char* text ) {
+    AppendBytes( output, "\"", 1 );
+
+    const char* run = text;
+    for ( ; *text; text++ ) {
+        unsigned char symbol = ( unsigned char ) *text;
+        if ( symbol >= 0x20 && symbol != '"' && symbol != '\\' )
+            continue;
+
+        AppendBytes( output, run, ( size_t ) ( text - run ) );
+        run = text + 1;
+
+        char escaped[ 8 ] = {};
+        if ( symbol == '"' || symbol == '\\' )
+            snprintf( escaped, sizeof( escaped ), "\\%c", symbol );
+        else
+            snprintf( escaped, sizeof( escaped ), "\\u%04x", symbol );
+
+        AppendText( output, escaped );
+    }
+
+    AppendBytes( output, run, ( size_t ) ( text - run ) );
+    AppendBytes( output, "\"", 1 );
+}
+
+size_t SplitFields( char* line, char** fields, size_t max_fields ) {
+    size_t count = 0;
+
+    while ( count < max_fields ) {
+        fields[ count++ ] = line;
+
+        line = strchr( line, '\t' );
+        if ( !line )
+            return count;
+
+        *line++ = '\0';
+    }
+
+    return count + 1;   // more fields than the caller takes
+}
+
+static size_t MappedLength( off_t file_size ) {
+    size_t page_size = ( size_t ) sysconf( _SC_PAGESIZE );
+
+    // +1 guarantees at least one zero byte after the data, like the '\0' of a calloc'd buffer
+    return ( ( size_t ) file_size + 1 + page_size - 1 ) / page_size * page_size;
+}
+
+char* MapFileToMemory( const char* file_name, off_t* file_size ) {
+    assert( file_name && file_size );
+
+    int fd = open( file_name, O_RDONLY );
+    if ( fd == -1 ) {
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if ( fstat( fd, &file_stat ) == -1 ) {
+        close( fd );
+        return NULL;
+    }
+
+    *file_size = file_stat.st_size;
+    size_t length = MappedLength( *file_size );
+
+    // Anonymous zero pages first, then the file on top of them: the tail stays zeroed
+    // even when the file size is a multiple of the page size.
+    char* buffer = ( char* ) mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( buffer == MAP_FAILED ) {
+        close( fd );
+        return NULL;
+    }
+
+    if ( *file_size > 0 ) {
+        void* file_map = mmap( buffer, ( size_t ) *file_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_FIXED, fd, 0 );
+        if ( file_map == MAP_FAILED ) {
+            munmap( buffer, length );
+            close( fd );
+            return NULL;
+        }
+
+        madvise( buffer, ( size_t ) *file_size, MADV_SEQUENTIAL );
+    }
+
+    close( fd );
+
+    return buffer;
+}
+
+void UnmapFile( char* buffer, off_t file_size ) {
+    if ( buffer ) {
+        munmap( buffer, MappedLength( file_size ) );
+    }
+}
+
+int WriteAll( int fd, const char* data, size_t size ) {
+    while ( size > 0 ) {
+        ssize_t written = write( fd, data, size );
+
+        if ( written < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            return -1;
+        }
+
+        data += written;
+        size -= ( size_t ) written;
+    }
+
+    return 0;
+}
+
+// Read from /proc: umask() can only be read by setting it, which races with threads creating
+// files meanwhile
+static mode_t CurrentUmask() {
+    FILE* status = fopen( "/proc/self/status", "r" );
+
+    if ( status ) {
+        char   line[ 128 ] = {};
+        mode_t mask        = 0;
+
+        while ( fgets( line, sizeof( line ), status ) ) {
+            if ( sscanf( line, "Umask: %o", &mask ) == 1 ) {
+                fclose( status );
+                return mask;
+            }
+        }
+
+        fclose( status );
+    }
+
+    mode_t mask = umask( 0 );
+    umask( mask );
+
+    return mask;
+}
+
+// mkstemp creates the file 0600: it gets the mode of the file it replaces, or the one a new
+// file would get, before it is renamed over `file_name`
+int OpenTemporaryFile( const char* file_name, char* temporary_name, size_t size ) {
+    assert( file_name && temporary_name );
+
+    int length = snprintf( temporary_name, size, "%s.tmp.XXXXXX", file_name );
+    if ( length < 0 || ( size_t ) length >= size ) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    int fd = mkstemp( temporary_name );
+    if ( fd == -1 ) {
+        return -1;
+    }
+
+    struct stat file_stat = {};
+    mode_t      mode      = ( stat( file_name, &file_stat ) == 0 ) ? ( file_stat.st_mode & 07777 )
+                                                                   : ( 0666 & ~CurrentUmask() );
+
+    if ( fchmod( fd, mode ) == -1 ) {
+        DiscardTemporaryFile( fd, temporary_name );
+        return -1;
+    }
+
+    return fd;
+}
+
+int SyncDirectoryOf( const char* file_name ) {
+    const char* slash = strrchr( file_name, '/' );
+
+    char directory[ PATH_MAX ] = ".";
+    if ( slash ) {
+        size_t length = ( slash == file_name ) ? 1 : ( size_t ) ( slash - file_name );
+        if ( length >= sizeof( directory ) ) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+
+        memcpy( directory, file_name, length );
+        directory[ length ] = '\0';
+    }
+
+    int directory_fd = open( directory, O_RDONLY | O_DIRECTORY );
+    if ( directory_fd == -1 ) {
+        return -1;
+    }
+
+    int result = fsync( directory_fd );
+    close( directory_fd );
+
+    return result;
+}
+
+// Data reaches the disk before the name does, so `file_name` is always either the old
+// or the new complete file. A mapping of the old file stays valid: its inode lives on.
+int CommitTemporaryFile( int fd, const char* temporary_name, const char* file_name ) {
+    assert( temporary_name && file_name );
+
+    if ( fsync( fd ) == -1 ) {
+        DiscardTemporaryFile( fd, temporary_name );
+        return -1;
+    }
+
+    if ( close( fd ) == -1 || rename( temporary_name, file_name ) == -1 ) {
+        int saved_errno = errno;
+        unlink( temporary_name );
+        errno = saved_errno;
+        return -1;
+    }
+
+    return SyncDirectoryOf( file_name );
+}
+
+void DiscardTemporaryFile( int fd, const char* temporary_name ) {
+    int saved_errno = errno;
+
+    close( fd );
+    unlink( temporary_name );
+
+    errno = saved_errno;
+}
+
+pid_t SpawnProcess( const char* const* arguments, int input, int output ) {
+    posix_spawn_file_actions_t actions = {};
+    posix_spawn_file_actions_init( &actions );
+
+    if ( input != -1 ) posix_spawn_file_actions_adddup2( &actions, input, STDIN_FILENO );
+    else               posix_spawn_file_actions_addopen( &actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0 );
+
+    if ( output != -1 ) posix_spawn_file_actions_adddup2( &actions, output, STDOUT_FILENO );
+    else                posix_spawn_file_actions_addopen( &actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0 );
+
+    posix_spawn_file_actions_addopen( &actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0 );
+
+    // Helper threads block every signal, the child must not inherit that: it may be stopped
+    // with SIGTERM
+    posix_spawnattr_t attributes = {};
+    posix_spawnattr_init( &attributes );
+
+    sigset_t signals = {};
+    sigemptyset( &signals );
+    posix_spawnattr_setsigmask( &attributes, &signals );
+    posix_spawnattr_setflags( &attributes, POSIX_SPAWN_SETSIGMASK );
+
+    // posix_spawnp only takes non-const strings, it does not write to them
+    pid_t pid    = 0;
+    int   result = posix_spawnp( &pid, arguments[0], &actions, &attributes, const_cast<char* const*>( arguments ), environ );
+
+    posix_spawnattr_destroy( &attributes );
+    posix_spawn_file_actions_destroy( &actions );
+
+    return ( result == 0 ) ? pid : -1;
+}
+
+int WaitProcess( pid_t pid, int options ) {
+    siginfo_t info = {};
+
+    while ( waitid( P_PID, ( id_t ) pid, &info, WEXITED | options ) == -1 && errno == EINTR )
+        ;
+
+    return ( info.si_code == CLD_EXITED ) ? info.si_status : -1;
+}
@@ -0,0 +1,8 @@
+#!/bin/sh
+
+# The same sources as mk-akinator-debug.sh, optimized, without sanitizers and without _DEBUG:
+# my_assert evaluates its condition and nothing more, the game writes no HTML dumps and a tree
+# opens its log on the first dump instead of in TreeCtor, as in a release build.
+REVISION=$(git describe --always --dirty 2>/dev/null || echo unknown)
+
+g++ ./src/main.cpp ./src/Akinator.cpp ./src/AkinatorBatch.cpp ./src/AkinatorServer.cpp ./src/AkinatorLoadTest.cpp ./src/AkinatorBench.cpp ./src/AkinatorStress.cpp ./lib/Tree.cpp ./lib/TreeParser.cpp ./lib/TreeTokenizer.cpp ./lib/TreeBinary.cpp ./lib/TreeJournal.cpp ./lib/StringPool.cpp ./lib/ObjectIndex.cpp ./lib/NameIndex.cpp ./lib/Utf8.cpp ./lib/UtilsRW.cpp ./lib/TaskPool.cpp ./lib/TreeWalk.cpp ./lib/CompactTree.cpp ./lib/TreeTelemetry.cpp ./lib/TreeBeam.cpp ./lib/TreeRcu.cpp ./lib/Speech.cpp ./lib/TreeRender.cpp ./lib/TreeSvg.cpp ./lib/Metrics.cpp -o akinator-bench -I./include -pthread -D_LINUX -DAKINATOR_REVISION="\"$REVISION\"" -std=c++17 -Wall -Wextra -O2 -g
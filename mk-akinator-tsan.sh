@@ -0,0 +1,7 @@
+#!/bin/sh
+
+# The same sources as mk-akinator-debug.sh under ThreadSanitizer, for --stress-rcu, --serve and
+# --batch. TSan does not mix with ASan, hence a build of its own. It does not model the fences
+# of TreeRcu_t; what it checks is that a node is freed only after the release store that ends
+# every section which could hold it.
+g++ ./src/main.cpp ./src/Akinator.cpp ./src/AkinatorBatch.cpp ./src/AkinatorServer.cpp ./src/AkinatorLoadTest.cpp ./src/AkinatorBench.cpp ./src/AkinatorStress.cpp ./lib/Tree.cpp ./lib/TreeParser.cpp ./lib/TreeTokenizer.cpp ./lib/TreeBinary.cpp ./lib/TreeJournal.cpp ./lib/StringPool.cpp ./lib/ObjectIndex.cpp ./lib/NameIndex.cpp ./lib/Utf8.cpp ./lib/UtilsRW.cpp ./lib/TaskPool.cpp ./lib/TreeWalk.cpp ./lib/CompactTree.cpp ./lib/TreeTelemetry.cpp ./lib/TreeBeam.cpp ./lib/TreeRcu.cpp ./lib/Speech.cpp ./lib/TreeRender.cpp ./lib/TreeSvg.cpp ./lib/Metrics.cpp -o akinator-tsan -I./include -pthread -D_LINUX -D_DEBUG -std=c++17 -Wall -Wextra -O1 -g -fno-omit-frame-pointer -fsanitize=thread -Wno-tsan
@@ -0,0 +1,27 @@
+#!/bin/sh
+
+# Usage: ./run-akinator-bench.sh [RESULTS] [MAX_NODES] [SEED]
+# Builds akinator-bench, generates balanced, random and list-shaped bases from 1k nodes up to
+# MAX_NODES (10M at most) and appends the timings of every base to RESULTS as JSON lines.
+# Bases are kept in $BENCH_DIR between runs: the same seed gives the same files.
+RESULTS=${1:-bench-results.jsonl}
+MAX_NODES=${2:-1000000}
+SEED=${3:-1}
+BENCH_DIR=${BENCH_DIR:-${TMPDIR:-/tmp}/akinator-bench}
+
+./mk-akinator-bench.sh || exit 1
+mkdir -p "$BENCH_DIR" || exit 1
+
+for NODES in 1000 10000 100000 1000000 10000000; do
+    [ "$NODES" -gt "$MAX_NODES" ] && break
+
+    for SHAPE in balanced random chain; do
+        BASE="$BENCH_DIR/$SHAPE-$NODES-$SEED.txt"
+
+        if [ ! -f "$BASE" ]; then
+            ./akinator-bench --generate "$SHAPE" "$NODES" "$SEED" "$BASE" > /dev/null || exit 1
+        fi
+
+        ./akinator-bench --bench "$BASE" "$RESULTS" || exit 1
+    done
+done
@@ -4,11 +4,23 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <string.h>
+#include <errno.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <atomic>
 
 #include "Akinator.h"
 #include "Colors.h"
 #include "DebugUtils.h"
+#include "Metrics.h"
+#include "Speech.h"
 #include "Tree.h"
+#include "TreeBeam.h"
+#include "TreeBinary.h"
+#include "TreeSvg.h"
+#include "TreeTelemetry.h"
 #include "UtilsRW.h"
 
 
@@ -18,30 +30,46 @@ enum GameMode {
     Compare2Definitions = 3,
     QuitSave            = 4,
     QuitNotSave         = 5,
+    GameStats           = 6,
     ShowTree            = 0
 };
 
 enum Answer_t {
-    YES = 1,
-    NO  = 0
+    YES          = 1,
+    NO           = 0,
+    PROBABLY     = 2,
+    PROBABLY_NOT = 3,
+    DONT_KNOW    = 4
 };
 
 const size_t MAX_LEN = 256;
 
- 
-static void     ShowMenu();
-static void     PlayRound( Tree_t* tree );
-static Node_t*  AskQuestion( Node_t* current );
-static void     PrintQuestion( const char* question );
-static void     HandleIncorrectGuess( Tree_t* tree, Node_t* leaf ); 
-static Node_t*  AddQuestion( Tree_t* tree, Node_t* leaf, const char* new_question, char* new_object, Answer_t answer_for_new_object );
-static Answer_t YesOrNoAnswer();
+const char* const GUESS_CHECK = "Я угадал?";
 
-static void    PrintObjectTraits( const Tree_t* tree );
-static Node_t* SearchObject(const Tree_t* tree, const char* name_of_object );
+const size_t MAX_SUGGESTIONS = 5;
+const size_t MAX_COMPLETIONS = 20;
 
-static void PrintTwoObjectDifference(const Tree_t* tree);
-static size_t BuildPath(const Node_t* root, const Node_t* target, const Node_t* path[], size_t depth);
+// Levels below the node a debug dump is about; the rest of the tree is folded
+const size_t DUMP_WINDOW_LEVELS = 3;
+
+ 
+static void     ShowMenu();
+static void     PlayRound( Akinator_t* akinator );
+static double   AskQuestion( Akinator_t* akinator, const CompactTree_t* compact, uint32_t current );
+static void     PrintQuestion( Akinator_t* akinator, const char* question );
+static void     PrefetchBranches( Akinator_t* akinator, const Beam_t* beam, uint32_t question );
+static void     FormatGuess( char* buffer, size_t size, const char* object );
+static void     HandleIncorrectGuess( Akinator_t* akinator, Node_t* leaf ); 
+static Answer_t YesOrNoAnswer( Akinator_t* akinator );
+static Answer_t QuestionAnswer( Akinator_t* akinator );
+
+static void    PrintObjectTraits( Tree_t* tree );
+static Node_t* SearchObject( Tree_t* tree, const char* name_of_object );
+static void    SuggestObjects( Tree_t* tree, const char* name_of_object );
+static void    PrintCompletions( Tree_t* tree, const char* prefix );
+
+static void PrintTwoObjectDifference(Tree_t* tree);
+static void PrintPathTraits( const Node_t** path, size_t length );
 
 static void ShowGraphicTree( Tree_t* tree );
 
@@ -50,7 +78,8 @@ static void ClearBuffer();
 ON_DEBUG( static void AkinatorDump( const Akinator_t* akinator, const Node_t* current_element, 
                                                                 const char* format_string, ... ); )
 
-static void Speak( const char* text );
+static void Speak( Akinator_t* akinator, const char* text );
+static void StopSpeaking( Akinator_t* akinator );
 
 Akinator_t* AkinatorCtor() {
     Akinator_t* akinator = ( Akinator_t* ) calloc ( 1, sizeof( *akinator ) );
@@ -62,23 +91,46 @@ Akinator_t* AkinatorCtor() {
     assert( !mkdir_result );
 
     akinator->base_path = strdup( "base.txt" );
+    akinator->journal.fd = -1;
 
-    TreeReadFromFile( akinator->tree );
-    AkinatorDump( akinator, akinator->tree->root, "After full reading the data base" );
+    if ( TreeReadFromFile( akinator->tree, akinator->base_path, LOAD_MMAP ) != SUCCESS ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось загрузить базу \"%s\"\n" COLOR_RESET, akinator->base_path );
+        AkinatorDtor( &akinator );
+        return NULL;
+    }
 
-    return akinator;
-}
+    // Counters are matched to the nodes of the base as saved, before the journal adds any
+    TreeTelemetryLoad( akinator->tree, akinator->base_path );
+
+    if ( TreeJournalOpen( &( akinator->journal ), akinator->tree, akinator->base_path ) != SUCCESS ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось загрузить базу \"%s\"\n" COLOR_RESET, akinator->base_path );
+        AkinatorDtor( &akinator );
+        return NULL;
+    }
+
+    if ( akinator->journal.replayed > 0 ) {
+        fprintf( stdout, "Из журнала восстановлено изменений: %zu\n", akinator->journal.replayed );
+    }
 
-static void TreeCleanFunction( char* stream, Tree_t* tree ) {
-    if ( !( tree->buffer <= stream && stream < tree->buffer + tree->buffer_size ) ) {
-        free( stream );
+    if ( TreeJournalNeedsCompaction( &( akinator->journal ) ) ) {
+        AkinatorSaveBase( akinator );
     }
+
+    ON_DEBUG( AkinatorDump( akinator, akinator->tree->root, "After full reading the data base" ); )
+
+    return akinator;
 }
 
 void AkinatorDtor( Akinator_t** akinator ) {
     my_assert( akinator, "Null pointer on `akinator`" );
 
-    TreeDtor( &( ( *akinator )->tree), TreeCleanFunction );
+    TreeDtor( &( ( *akinator )->tree ) );
+
+    TreeJournalClose( &( ( *akinator )->journal ) );
+
+    if ( ( *akinator )->speech ) {
+        SpeechDtor( &( ( *akinator )->speech ) );
+    }
 
     free( ( *akinator )->base_path );
 
@@ -86,9 +138,246 @@ void AkinatorDtor( Akinator_t** akinator ) {
     *akinator = NULL;
 }
 
+int AkinatorConvertBase( const char* source_path, const char* target_path, BaseFormat_t target_format ) {
+    my_assert( source_path && target_path, "Null pointer on base path" );
+
+    Tree_t* tree = TreeCtor();
+
+    // Learned objects not yet folded into the source base go into the converted one too
+    TreeJournal_t journal = {};
+
+    if ( TreeReadFromFile( tree, source_path, LOAD_MMAP ) != SUCCESS ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось загрузить базу \"%s\"\n" COLOR_RESET, source_path );
+        TreeDtor( &tree );
+        return 1;
+    }
+
+    // Play statistics follow the nodes into the converted base; a base without them gets none
+    bool has_stats = TreeTelemetryLoad( tree, source_path );
+
+    if ( TreeJournalOpen( &journal, tree, source_path ) != SUCCESS ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось загрузить базу \"%s\"\n" COLOR_RESET, source_path );
+        TreeJournalClose( &journal );
+        TreeDtor( &tree );
+        return 1;
+    }
+
+    TreeJournalClose( &journal );
+
+    TreeStatus_t status = ( target_format == BASE_BINARY ) ? TreeSaveToBinaryFile( tree, target_path )
+                                                           : TreeSaveToFile( tree, target_path );
+
+    if ( status == SUCCESS ) {
+        fprintf( stdout, "База Акинатора была сохранена в %s \n", target_path );
+    }
+
+    if ( status == SUCCESS && has_stats ) {
+        TreeTelemetrySave( tree, target_path );
+    }
+
+    TreeDtor( &tree );
+
+    return status == SUCCESS ? 0 : 1;
+}
+
+int AkinatorRenderBase( const char* source_path, const char* svg_path, bool use_dot ) {
+    my_assert( source_path && svg_path, "Null pointer on path" );
+
+    Tree_t* tree = TreeCtor();
+
+    if ( TreeReadFromFile( tree, source_path, LOAD_MMAP ) != SUCCESS || !tree->root ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось загрузить базу \"%s\"\n" COLOR_RESET, source_path );
+        TreeDtor( &tree );
+        return 1;
+    }
+
+    uint64_t     timer  = MetricsStart();
+    double       start  = MonotonicSeconds();
+    double       laid   = start;
+    TreeStatus_t status = SUCCESS;
+
+    if ( use_dot ) {
+        // `dot` names its picture after the DOT file, "<svg_path>.dot.svg"
+        NodeGraphicDump( NULL, tree->root, "%s.dot", svg_path );
+
+        char rendered[ MAX_LEN_PATH ] = {};
+        snprintf( rendered, sizeof( rendered ), "%s.dot.svg", svg_path );
+
+        status = ( rename( rendered, svg_path ) == 0 ) ? SUCCESS : FAIL;
+        laid   = MonotonicSeconds();
+    }
+    else {
+        TreeSvgLayout_t* layout = TreeSvgLayoutCtor( tree->root );
+        laid = MonotonicSeconds();
+
+        status = TreeSvgWrite( layout, svg_path );
+        TreeSvgLayoutDtor( &layout );
+    }
+
+    double end = MonotonicSeconds();
+    MetricsStop( TIMER_RENDER, timer );
+
+    if ( status != SUCCESS ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось нарисовать дерево в \"%s\"%s\n" COLOR_RESET, svg_path,
+                 use_dot ? ": нет Graphviz (dot)?" : "" );
+        TreeDtor( &tree );
+        return 1;
+    }
+
+    struct stat picture = {};
+    stat( svg_path, &picture );
+
+    fprintf( stdout, "Узлов: %zu, раскладка: %.1f мс, запись: %.1f мс, всего: %.1f мс, SVG: %lld байт\n",
+             tree->arena.live, ( laid - start ) * 1e3, ( end - laid ) * 1e3, ( end - start ) * 1e3,
+             ( long long ) picture.st_size );
+
+    TreeDtor( &tree );
+
+    return 0;
+}
+
+// The base with the journal folded in, and the play statistics bound to the new file
+TreeStatus_t AkinatorSaveBase( Akinator_t* akinator ) {
+    my_assert( akinator, "Null pointer on `akinator`" );
+
+    if ( TreeJournalCompact( &( akinator->journal ), akinator->tree, akinator->base_path ) != SUCCESS )
+        return FAIL;
+
+    fprintf( stdout, "База Акинатора была сохранена в %s \n", akinator->base_path );
+
+    // Losing the counters is no reason to keep the game going unsaved
+    TreeTelemetrySave( akinator->tree, akinator->base_path );
+
+    return SUCCESS;
+}
+
+struct WarmUp_t {
+    Speech_t* speech;
+    char**    texts;
+    size_t    count;
+
+    std::atomic<size_t> next;
+    std::atomic<size_t> rendered;
+};
+
+static void* RunWarmUp( void* argument ) {
+    WarmUp_t* warm_up = ( WarmUp_t* ) argument;
+
+    for ( size_t idx = warm_up->next.fetch_add( 1, std::memory_order_relaxed ); idx < warm_up->count;
+          idx = warm_up->next.fetch_add( 1, std::memory_order_relaxed ) ) {
+        if ( SpeechRender( warm_up->speech, warm_up->texts[ idx ] ) )
+            warm_up->rendered.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    return NULL;
+}
+
+// What the game says at the top `levels` levels: the questions, and the guess at each object
+static size_t CollectTopTexts( const Tree_t* tree, size_t levels, char*** texts ) {
+    size_t  capacity = 64;
+    size_t  count    = 0;
+    char**  result   = ( char** ) calloc ( capacity, sizeof( char* ) );
+    assert( result && "Memory allocation error" );
+
+    size_t         stack_capacity = 64;
+    size_t         stack_size     = 0;
+    const Node_t** stack          = ( const Node_t** ) calloc ( stack_capacity, sizeof( *stack ) );
+    assert( stack && "Memory allocation error" );
+
+    if ( tree->root && levels > 0 )
+        stack[ stack_size++ ] = tree->root;
+
+    while ( stack_size > 0 ) {
+        const Node_t* node = stack[ --stack_size ];
+
+        if ( count == capacity ) {
+            capacity *= 2;
+            result = ( char** ) realloc ( result, capacity * sizeof( char* ) );
+            assert( result && "Memory allocation error" );
+        }
+
+        char buffer[ MAX_LEN ] = {};
+
+        if ( node->left && node->right ) {
+            result[ count++ ] = strdup( node->value );
+        } else {
+            FormatGuess( buffer, MAX_LEN, node->value );
+            result[ count++ ] = strdup( buffer );
+        }
+        assert( result[ count - 1 ] && "Memory allocation error" );
+
+        if ( !node->left || !node->right || node->depth + 1 >= levels )
+            continue;
+
+        if ( stack_size + 2 > stack_capacity ) {
+            stack_capacity *= 2;
+            stack = ( const Node_t** ) realloc ( stack, stack_capacity * sizeof( *stack ) );
+            assert( stack && "Memory allocation error" );
+        }
+
+        stack[ stack_size++ ] = node->right;
+        stack[ stack_size++ ] = node->left;
+    }
+
+    free( stack );
+
+    *texts = result;
+    return count;
+}
+
+// Renders into the speech cache all the game can say at the top `levels` levels, one espeak
+// per CPU at a time; the texts already there only get their time of use moved on
+int AkinatorWarmUpSpeech( Akinator_t* akinator, size_t levels ) {
+    my_assert( akinator, "Null pointer on `akinator`" );
+
+    WarmUp_t warm_up = {};
+    warm_up.speech = SpeechCtor( SPEECH_CACHE_DIRECTORY );
+    warm_up.count  = CollectTopTexts( akinator->tree, levels, &( warm_up.texts ) );
+
+    long   online  = sysconf( _SC_NPROCESSORS_ONLN );
+    size_t threads = ( online > 0 ) ? ( size_t ) online : 1;
+
+    pthread_t* handles = ( pthread_t* ) calloc ( threads, sizeof( *handles ) );
+    assert( handles && "Memory allocation error" );
+
+    double start = MonotonicSeconds();
+
+    SpeechRender( warm_up.speech, GUESS_CHECK );
+
+    // The calling thread renders too
+    size_t started = 1;
+    for ( size_t idx = 1; idx < threads; idx++ ) {
+        if ( pthread_create( &( handles[ started ] ), NULL, RunWarmUp, &warm_up ) == 0 )
+            started++;
+    }
+
+    RunWarmUp( &warm_up );
+
+    for ( size_t idx = 1; idx < started; idx++ )
+        pthread_join( handles[ idx ], NULL );
+
+    double elapsed  = MonotonicSeconds() - start;
+    size_t rendered = warm_up.rendered.load( std::memory_order_relaxed );
+
+    fprintf( stdout, "Озвучено фраз: %zu из %zu за %.2f с, кэш \"%s\": %.1f МиБ\n", rendered, warm_up.count,
+             elapsed, SPEECH_CACHE_DIRECTORY, ( double ) warm_up.speech->cache_size / ( 1024.0 * 1024.0 ) );
+
+    for ( size_t idx = 0; idx < warm_up.count; idx++ )
+        free( warm_up.texts[ idx ] );
+
+    free( warm_up.texts );
+    free( handles );
+
+    SpeechDtor( &( warm_up.speech ) );
+
+    return ( rendered == warm_up.count ) ? 0 : 1;
+}
+
 void AkinatorGame( Akinator_t* akinator ) {
     my_assert( akinator, "Null pointer on `akinator`" );
 
+    akinator->speech = SpeechCtor( SPEECH_CACHE_DIRECTORY );
+
     while (1) {
         ShowMenu();
 
@@ -107,7 +396,7 @@ void AkinatorGame( Akinator_t* akinator ) {
 
         switch ( choice ) {
             case PlayGame:
-                PlayRound( akinator->tree );
+                PlayRound( akinator );
                 break;
             case GiveDefinition:
                 PrintObjectTraits( akinator->tree );
@@ -116,12 +405,21 @@ void AkinatorGame( Akinator_t* akinator ) {
                 PrintTwoObjectDifference( akinator->tree );
                 break;
             case QuitSave:
-                TreeSaveToFile( akinator->tree, akinator->base_path );
+                // The old base is untouched, so the game goes on and the save can be retried
+                if ( AkinatorSaveBase( akinator ) != SUCCESS ) {
+                    fprintf( stdout, COLOR_BRIGHT_RED "База не сохранена!\n" COLOR_RESET );
+                    break;
+                }
+
                 fprintf( stdout, "Выход." );
                 return;
             case QuitNotSave:
+                TreeJournalRollback( &( akinator->journal ) );
                 fprintf( stdout, "Выход." );
                 return;
+            case GameStats:
+                TreeTelemetryReport( akinator->tree, stdout );
+                break;
             case ShowTree:
                 ShowGraphicTree( akinator->tree );
                 break;
@@ -141,53 +439,96 @@ static void ShowMenu() {
     fprintf( stdout, "│ 3. Сравнить два объекта (в разработке) │\n" );
     fprintf( stdout, "│ 4. Выход c сохранением базы данных     │\n" );
     fprintf( stdout, "│ 5. Выход без сохранения базы данных    │\n" );
+    fprintf( stdout, "│ 6. Статистика игр                      │\n" );
     fprintf( stdout, "│                                        │\n" );
     fprintf( stdout, "│ 0. Выдать базу                         │\n" );
     fprintf( stdout, "└────────────────────────────────────────┘\n" );
-    fprintf( stdout, "Выберите вариант[1, 2, 3, 4, 5, 0]: ");
+    fprintf( stdout, "Выберите вариант[1, 2, 3, 4, 5, 6, 0]: ");
 }
 
-static void PlayRound( Tree_t* tree ) {
-    my_assert( tree, "Null pointer on `tree`" );
+static void PlayRound( Akinator_t* akinator ) {
+    my_assert( akinator, "Null pointer on `akinator`" );
 
-    Node_t* current = tree->root;
-    while ( current && current->left && current->right ) {
-        current = AskQuestion( current );
-    }
+    // The descent reads the compact copy; the leaf it ends on is changed through the pointer tree
+    const CompactTree_t* compact = TreeCompactTree( akinator->tree );
 
-    if ( !current ) {
+    if ( compact->count == 0 ) {
         fprintf( stderr, COLOR_BRIGHT_RED "Ошибка: NULL-узел\n" );
         return;
     }
 
-    char buffer[ MAX_LEN ] = {};
-    snprintf( buffer, MAX_LEN, "Я думаю, это %s", current->value );
-    fprintf( stdout, COLOR_BRIGHT_GREEN "%s\n" COLOR_RESET, buffer );
-    Speak( buffer );
+    // With firm answers only the frontier is the one node of the plain descent
+    Beam_t beam = {};
+    BeamCtor( &beam, compact );
 
-    snprintf( buffer, MAX_LEN, "Я угадал?" );
-    fprintf( stdout, "%s [Y/N]: ", buffer );
-    Speak( buffer );
-    Answer_t answer = YesOrNoAnswer();
+    Node_t* missed_leaf    = NULL;
+    bool    missed_certain = false;
+
+    for ( size_t guesses = 0; guesses < BEAM_MAX_GUESSES && beam.size > 0; guesses++ ) {
+        uint32_t question = 0;
+        while ( BeamNextQuestion( &beam, &question ) ) {
+            PrefetchBranches( akinator, &beam, question );
+            ON_DEBUG( AkinatorDump( akinator, compact->origin[ question ], "Question" ); )
+            BeamAnswer( &beam, question, AskQuestion( akinator, compact, question ) );
+        }
+
+        size_t guess = BeamBestGuess( &beam );
+        if ( guess == beam.size )
+            break;
+
+        Node_t* current = compact->origin[ beam.entries[ guess ].slot ];
+        NodeCountVisit( current );
+        ON_DEBUG( AkinatorDump( akinator, current, "Guess" ); )
+
+        char buffer[ MAX_LEN ] = {};
+        FormatGuess( buffer, MAX_LEN, current->value );
+        fprintf( stdout, COLOR_BRIGHT_GREEN "%s\n" COLOR_RESET, buffer );
+        Speak( akinator, buffer );
+
+        snprintf( buffer, MAX_LEN, "%s", GUESS_CHECK );
+        fprintf( stdout, "%s [Y/N]: ", buffer );
+        Speak( akinator, buffer );
+        Answer_t answer = YesOrNoAnswer( akinator );
+
+        NodeCountGuess( current, answer == YES );
+
+        if ( answer == YES ) {
+            BeamDtor( &beam );
+            return;
+        }
+
+        missed_leaf    = current;
+        missed_certain = beam.entries[ guess ].certain;
+
+        BeamDrop( &beam, guess );
+    }
+
+    BeamDtor( &beam );
 
-    if ( answer == YES ) {
+    if ( !missed_leaf ) {
+        fprintf( stdout, "Не нашлось подходящего объекта.\n" );
         return;
     }
-    else {
-        HandleIncorrectGuess( tree, current );
+
+    // After "don't know" the path to the leaf is a guess, and an object put there could be wrong
+    if ( !missed_certain ) {
+        fprintf( stdout, "Сдаюсь! Ответы были неуверенными, поэтому новый объект в базу не добавлен.\n" );
+        return;
     }
+
+    HandleIncorrectGuess( akinator, missed_leaf );
 }
 
-static void HandleIncorrectGuess( Tree_t* tree, Node_t* leaf ) {
-    my_assert( tree, "Null pointer on `tree`" );
+static void HandleIncorrectGuess( Akinator_t* akinator, Node_t* leaf ) {
+    my_assert( akinator, "Null pointer on `akinator`" );
     my_assert( leaf, "Null pointer on `leaf`" );
 
     char buffer[ MAX_LEN * 3 ] = {};
 
     snprintf( buffer, MAX_LEN, "Хотите добавить новый объект?" );
     fprintf( stdout, "%s [Y/N] ", buffer );
-    Speak( buffer );
-    Answer_t answer = YesOrNoAnswer();
+    Speak( akinator, buffer );
+    Answer_t answer = YesOrNoAnswer( akinator );
     if ( answer == NO ) {
         return;
     }
@@ -196,25 +537,29 @@ static void HandleIncorrectGuess( Tree_t* tree, Node_t* leaf ) {
     char new_question[ MAX_LEN ] = {};
 
     fprintf( stdout, "Кто это был? " );
-    Speak( "Кто это был?" );
+    Speak( akinator, "Кто это был?" );
     scanf( " %127[^\n]", new_object );
     ClearBuffer();
+    StopSpeaking( akinator );
 
     snprintf( buffer, MAX_LEN * 3, "Чем \"%s\" отличается от \"%s\"", leaf->value, new_object );
     fprintf( stdout, "%s: он ", buffer );
-    Speak( buffer );
+    Speak( akinator, buffer );
     scanf( " %127[^\n]", new_question );
     ClearBuffer();
+    StopSpeaking( akinator );
 
     snprintf( buffer, MAX_LEN * 3, "Для \"%s\" ответ на вопрос будет 'Да' или 'Нет'?", new_object );
     fprintf( stdout, "%s [Y/N]: ", buffer );
-    Speak( buffer );
-    Answer_t ans_for_new_obj = YesOrNoAnswer();
+    Speak( akinator, buffer );
+    Answer_t ans_for_new_obj = YesOrNoAnswer( akinator );
 
-    AddQuestion( tree, leaf, new_question, new_object, ans_for_new_obj );
+    Node_t* question = AkinatorAddObject( akinator, leaf, new_question, new_object, ans_for_new_obj == YES );
+    ON_DEBUG( AkinatorDump( akinator, question, "Added \"%s\"", new_object ); )
+    ( void ) question;
 }
 
-static Answer_t YesOrNoAnswer() {
+static Answer_t YesOrNoAnswer( Akinator_t* akinator ) {
     char answer[4] = {};
     int result = 0;
 
@@ -224,6 +569,9 @@ static Answer_t YesOrNoAnswer() {
         
         if ( result != 1 ) continue;
 
+        // Whatever was typed, the prompt has been heard out
+        StopSpeaking( akinator );
+
         if ( strncmp( answer, "Y", 1 ) == 0 || strncmp( answer, "y", 1 ) == 0  ) {
             return YES;
         }
@@ -236,85 +584,120 @@ static Answer_t YesOrNoAnswer() {
     }
 }
 
-static Node_t* AddQuestion( Tree_t* tree, Node_t* leaf, const char* new_question, char* new_object, Answer_t answer_for_new_object ) {
-    my_assert( leaf && tree, "Null pointer on `leaf` or `tree`" );
-    my_assert( new_question && new_object, "Null pointer on new data" );
-
-    Node_t* question_node = ( Node_t* ) calloc ( 1, sizeof( *question_node ) );
-    assert( question_node && "Memory allocation error" );
+// Y and N, or Y? / N? for "probably" and ? for "don't know"
+static Answer_t QuestionAnswer( Akinator_t* akinator ) {
+    char answer[4] = {};
 
-    question_node->value = strdup( new_question );
+    while (1) {
+        int result = scanf( "%3s", answer );
+        ClearBuffer();
 
-    // question_node->value = ( TreeData_t ) calloc ( strlen( new_question ) + 1, 1 );
-    // assert( question_node->value && "Memory allocation error" );
-    // memcpy( question_node->value, new_question, strlen( new_question ) );
+        if ( result != 1 ) continue;
 
-    question_node->value[0] = ( char ) toupper( question_node->value[0] );
+        StopSpeaking( akinator );
 
-    Node_t* object_node = NodeCreate( new_object, question_node );
+        char first  = ( char ) toupper( answer[0] );
+        bool unsure = ( answer[1] == '?' );
 
-    if ( answer_for_new_object == YES ) {
-        question_node->left  = object_node;
-        question_node->right = leaf;
-    } else {
-        question_node->right = object_node;
-        question_node->left  = leaf;
+        if ( first == '?' && answer[1] == '\0' ) {
+            return DONT_KNOW;
+        }
+        else if ( first == 'Y' && ( answer[1] == '\0' || ( unsure && answer[2] == '\0' ) ) ) {
+            return unsure ? PROBABLY : YES;
+        }
+        else if ( first == 'N' && ( answer[1] == '\0' || ( unsure && answer[2] == '\0' ) ) ) {
+            return unsure ? PROBABLY_NOT : NO;
+        }
+        else {
+            fprintf( stdout, "Некорректный ответ, попробуйте ещё раз. \n [Y/N, Y?, N?, ?]: " );
+        }
     }
+}
+
+Node_t* AkinatorAddObject( Akinator_t* akinator, Node_t* leaf, const char* new_question, const char* new_object, bool object_is_left ) {
+    my_assert( leaf && akinator, "Null pointer on `leaf` or `akinator`" );
+    my_assert( new_question && new_object, "Null pointer on new data" );
 
-    question_node->parent = leaf->parent;
-    leaf->parent = question_node;
+    // Interned values are shared, so the question is capitalized before it gets into the pool
+    char question[ MAX_LEN ] = {};
+    snprintf( question, MAX_LEN, "%s", new_question );
+    question[0] = ( char ) toupper( question[0] );
 
-    if ( question_node->parent ) {
-        if ( question_node->parent->left == leaf )
-            question_node->parent->left = question_node;
-        else
-            question_node->parent->right = question_node;
-    } else {
-        tree->root = question_node;
+    // The record goes first: the leaf's path is only known before the split
+    if ( TreeJournalAppend( &( akinator->journal ), leaf, question, new_object, object_is_left ) != SUCCESS ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось записать изменение в журнал: %s\n" COLOR_RESET, strerror( errno ) );
     }
 
-    return question_node;
+    return TreeSplitLeaf( akinator->tree, leaf, question, new_object, object_is_left );
 }
 
-static Node_t* AskQuestion( Node_t* current ) {
-    my_assert( current, "Null pointer on `current`" );
+// The answer as the share of the "yes" branch, see BEAM_YES ... BEAM_NO
+static double AskQuestion( Akinator_t* akinator, const CompactTree_t* compact, uint32_t current ) {
+    my_assert( compact, "Null pointer on `compact`" );
 
-    if ( !current->left && !current->right ) {
-        fprintf( stderr, COLOR_BRIGHT_YELLOW "Лист достигнут — здесь нет подветок.\n" );
-        return NULL;
-    }
-
-    PrintQuestion(current->value);
-
-    Node_t* next = NULL;
+    PrintQuestion( akinator, CompactTreeValue( compact, current ) );
 
-    Answer_t answer = YesOrNoAnswer();
-    if ( answer == YES ) {
-        next = current->left;
+    switch ( QuestionAnswer( akinator ) ) {
+        case YES:          return BEAM_YES;
+        case PROBABLY:     return BEAM_PROBABLY;
+        case DONT_KNOW:    return BEAM_DONT_KNOW;
+        case PROBABLY_NOT: return BEAM_PROBABLY_NOT;
+        case NO:           return BEAM_NO;
+        default:           return BEAM_DONT_KNOW;
     }
-    else {
-        next = current->right;
-    }
-    
-    return next;
 }
 
-static void PrintQuestion( const char* question ) {
+static void PrintQuestion( Akinator_t* akinator, const char* question ) {
     my_assert( question, "Null pointer on `question`" );
 
     fprintf(stdout, COLOR_BRIGHT_YELLOW "[ВОПРОС]\n" COLOR_RESET);
     fprintf(stdout, "%s?\n", question);
     fprintf(stdout, "---------------------------------------------\n");
-    fprintf(stdout, "Ответ [Y/N]: ");
+    fprintf(stdout, "Ответ [Y/N, Y? - скорее да, N? - скорее нет, ? - не знаю]: ");
 
-    Speak( question );
+    Speak( akinator, question );
+}
+
+static void FormatGuess( char* buffer, size_t size, const char* object ) {
+    snprintf( buffer, size, "Я думаю, это %s", object );
+}
+
+// Whatever the game says after "yes" and after "no" to `question` is synthesized while the
+// player thinks; "probably" and "don't know" lead to one of the two far more often than not
+static void PrefetchBranches( Akinator_t* akinator, const Beam_t* beam, uint32_t question ) {
+    my_assert( akinator && beam, "Null pointer on argument" );
+
+    if ( !akinator->speech )
+        return;
+
+    const double shares[] = { BEAM_YES, BEAM_NO };
+
+    for ( size_t idx = 0; idx < sizeof( shares ) / sizeof( shares[0] ); idx++ ) {
+        Beam_t ahead = {};
+        BeamCopy( &ahead, beam );
+        BeamAnswer( &ahead, question, shares[ idx ] );
+
+        uint32_t next  = 0;
+        size_t   guess = 0;
+
+        if ( BeamNextQuestion( &ahead, &next ) ) {
+            SpeechPrefetch( akinator->speech, CompactTreeValue( ahead.compact, next ) );
+        }
+        else if ( ( guess = BeamBestGuess( &ahead ) ) < ahead.size ) {
+            char buffer[ MAX_LEN ] = {};
+            FormatGuess( buffer, MAX_LEN, ahead.compact->origin[ ahead.entries[ guess ].slot ]->value );
+            SpeechPrefetch( akinator->speech, buffer );
+        }
+
+        BeamDtor( &ahead );
+    }
 }
 
 
-static void PrintObjectTraits( const Tree_t* tree ) {
+static void PrintObjectTraits( Tree_t* tree ) {
     my_assert( tree, "Null pointer on `tree`" );
 
-    fprintf( stderr, "Введите имя искомого объекта: " );
+    fprintf( stderr, "Введите имя искомого объекта (начало имени и * - подсказка): " );
 
     char name_of_object[ MAX_LEN ] = {};
 
@@ -324,162 +707,105 @@ static void PrintObjectTraits( const Tree_t* tree ) {
         fprintf( stderr, "Неправильный ввод. Повторите еще раз. " );
     }
 
+    size_t name_length = strlen( name_of_object );
+    if ( name_length > 0 && name_of_object[ name_length - 1 ] == '*' ) {
+        name_of_object[ name_length - 1 ] = '\0';
+        PrintCompletions( tree, name_of_object );
+        return;
+    }
+
     const Node_t* current = SearchObject( tree, name_of_object );
     
     if ( current == NULL ) {
         fprintf( stderr, "Объекта с именем \"%s\" не существует. \n", name_of_object );
+        SuggestObjects( tree, name_of_object );
         return;
     }
 
-    const Node_t* path[ MAX_LEN ] = {};
-    size_t depth = 0;
-    while ( current != NULL ) {
-        path[ depth++ ] = current;
-        current = current->parent;
-    }
+    const Node_t** path = ( const Node_t** ) calloc ( current->depth + 1, sizeof( *path ) );
+    assert( path && "Memory allocation error" );
+
+    size_t length = NodePathFrom( tree->root, current, path );
 
     fprintf( stdout, "\n\nОбъект \"%s\" имеет следующие признаки:\n", name_of_object );
     fprintf( stdout, "──────────────────────────────────────\n" );
 
-    for ( size_t idx = depth - 1; idx > 0; idx-- ) {
-        const Node_t* parent = path[ idx ];
-        const Node_t* node   = path[ idx - 1 ];
+    PrintPathTraits( path, length );
 
-        if ( parent->left == node) {
-            fprintf( stdout, "✔ %s\n", parent->value );
-            
-        } else if ( parent->right == node ) {
-            fprintf( stdout, "✖ не %s\n", parent->value );
-        }
-    }
+    free( path );
 
     fprintf( stderr, "──────────────────────────────────────\n\n" );
 }
 
-static Node_t* SearchObjectRecursively( Node_t* node, const char* name_of_object, size_t length ) {
-    if ( node == NULL ) return NULL;
-
-    if ( node->left == NULL && node->right == NULL && 
-            strncasecmp( node->value, name_of_object, length ) == 0 )
-        return node;
-
-    Node_t* found = SearchObjectRecursively( node->left, name_of_object, length );
-    if ( found != NULL )
-        return found;
-
-    return SearchObjectRecursively( node->right, name_of_object, length );
-}
-
-static Node_t* SearchObject( const Tree_t* tree, const char* name_of_object ) {
+// Exact name up to case (UTF-8 aware), O(1) through the tree's object index
+static Node_t* SearchObject( Tree_t* tree, const char* name_of_object ) {
     my_assert( tree,           "Null pointer on `tree`" );
     my_assert( name_of_object, "Null pointer on `name_of_object`" );
 
-    char lower_name[ MAX_LEN ] = "";
-
-    for ( size_t idx = 0; name_of_object[ idx ] != '\0'; idx++ )
-        lower_name[ idx ] = ( char ) tolower( name_of_object[ idx ] );
-
-    return SearchObjectRecursively(
-        tree->root, 
-        lower_name, strlen( lower_name ) 
-    );
+    return ObjectIndexFind( TreeObjectIndex( tree ), name_of_object );
 }
 
+static size_t AddSuggestion( NameMatch_t* matches, size_t found, const NameMatch_t* match ) {
+    for ( size_t idx = 0; idx < found; idx++ ) {
+        if ( matches[ idx ].leaf == match->leaf )
+            return found;
+    }
 
-
-static size_t BuildPath(const Node_t* root, const Node_t* target, const Node_t* path[], size_t depth) {
-    if (!root) return 0;
-
-    path[depth] = root;
-
-    if (root == target)
-        return depth + 1;
-
-    size_t left  = BuildPath(root->left,  target, path, depth + 1);
-    if (left) return left;
-
-    size_t right = BuildPath(root->right, target, path, depth + 1);
-    if (right) return right;
-
-    return 0;
+    matches[ found ] = *match;
+    return found + 1;
 }
 
-// static void PrintTwoObjectDifference( const Tree_t* tree ) {
-//     my_assert(tree, "Null pointer on tree");
-
-//     char obj1[ MAX_LEN ] = {};
-//     char obj2[ MAX_LEN ] = {};
-
-//     fprintf( stdout, "Введите имя первого объекта: " );
-//     scanf( " %127[^\n]", obj1 );
-//     ClearBuffer();
-
-//     fprintf( stdout, "Введите имя второго объекта: " );
-//     scanf( " %127[^\n]", obj2 );
-//     ClearBuffer();
-
-//     const Node_t* n1 = SearchObject( tree, obj1 );
-//     const Node_t* n2 = SearchObject( tree, obj2 );
+// Names that start with what was typed go first, then the closest ones by spelling
+static void SuggestObjects( Tree_t* tree, const char* name_of_object ) {
+    my_assert( tree,           "Null pointer on `tree`" );
+    my_assert( name_of_object, "Null pointer on `name_of_object`" );
 
-//     if ( !n1 || !n2 ) {
-//         fprintf( stderr, COLOR_BRIGHT_RED "Одного из объектов нет в базе.\n" COLOR_RESET );
-//         return;
-//     }
+    NameIndex_t* names = TreeNameIndex( tree );
 
-//     const Node_t* path1[ MAX_LEN ] = {};
-//     const Node_t* path2[ MAX_LEN ] = {};
+    NameMatch_t matches[ MAX_SUGGESTIONS ]   = {};
+    NameMatch_t candidates[ MAX_SUGGESTIONS ] = {};
 
-//     size_t len1 = BuildPath( tree->root, n1, path1, 0 );
-//     size_t len2 = BuildPath( tree->root, n2, path2, 0 );
+    size_t found = NameIndexComplete( names, name_of_object, matches, MAX_SUGGESTIONS );
 
-//     size_t diverge = 0;
-//     while ( diverge < len1 && diverge < len2 && path1[ diverge ] == path2[ diverge ] ) diverge++;
+    if ( found < MAX_SUGGESTIONS ) {
+        // One typo in a short name, two in a longer one
+        uint32_t max_distance = ( strlen( name_of_object ) <= 6 ) ? 1 : 2;
+        size_t   close        = NameIndexFuzzy( names, name_of_object, max_distance, candidates, MAX_SUGGESTIONS );
 
-//     fprintf( stdout, "\n────────────────────────────────────────────\n" );
-//     fprintf( stdout, COLOR_BRIGHT_GREEN "Сравнение \"%s\" и \"%s\":\n" COLOR_RESET, obj1, obj2 );
-//     fprintf( stdout, "────────────────────────────────────────────\n" );
+        for ( size_t idx = 0; idx < close && found < MAX_SUGGESTIONS; idx++ )
+            found = AddSuggestion( matches, found, &( candidates[ idx ] ) );
+    }
 
-//     // Общие признаки
-//     fprintf( stdout, COLOR_BRIGHT_YELLOW "\nОбщие признаки:\n" COLOR_RESET );
-//     for ( size_t idx = 1; idx < diverge; idx++ ) {
-//         const Node_t* parent = path1[ idx - 1 ];
-//         const Node_t* node   = path1[ idx ];
+    if ( found == 0 )
+        return;
 
-//         if ( parent->left == node )
-//             fprintf( stdout, "✔ %s\n", parent->value );
-//         else
-//             fprintf( stdout, "✖ не %s\n", parent->value );
-//     }
+    fprintf( stderr, "Возможно, вы имели в виду:" );
+    for ( size_t idx = 0; idx < found; idx++ )
+        fprintf( stderr, "%s \"%s\"", idx ? "," : "", matches[ idx ].leaf->value );
+    fprintf( stderr, "\n" );
+}
 
-//     // Отличия
-//     fprintf( stdout, COLOR_BRIGHT_RED "\nОтличия:\n" COLOR_RESET );
+static void PrintCompletions( Tree_t* tree, const char* prefix ) {
+    my_assert( tree,   "Null pointer on `tree`" );
+    my_assert( prefix, "Null pointer on `prefix`" );
 
-//     size_t start_idx = ( diverge == 0 ? 0 : diverge - 1 );
+    NameMatch_t matches[ MAX_COMPLETIONS ] = {};
+    size_t found = NameIndexComplete( TreeNameIndex( tree ), prefix, matches, MAX_COMPLETIONS );
 
-//     fprintf( stderr, "\n%s:\n", obj1 );
-//     for ( size_t idx = start_idx; idx < len1 - 1; idx++ ) {
-//         const Node_t* parent = path1[ idx ];
-//         const Node_t* node   = path1[ idx + 1 ];
+    if ( found == 0 ) {
+        fprintf( stderr, "Объектов, начинающихся с \"%s\", нет. \n", prefix );
+        return;
+    }
 
-//         if ( parent->left == node )
-//             fprintf( stdout, "✔ %s\n", parent->value );
-//         else
-//             fprintf( stdout, "✖ не %s\n", parent->value );
-//     }
+    fprintf( stdout, "Объекты, начинающиеся с \"%s\":\n", prefix );
+    for ( size_t idx = 0; idx < found; idx++ )
+        fprintf( stdout, "  %s\n", matches[ idx ].leaf->value );
 
-//     fprintf( stdout, "\n%s:\n", obj2 );
-//     for ( size_t idx = start_idx; idx < len2 - 1; idx++ ) {
-//         const Node_t* parent = path2[ idx ];
-//         const Node_t* node   = path2[ idx + 1 ];
+    if ( found == MAX_COMPLETIONS )
+        fprintf( stdout, "  ...\n" );
+}
 
-//         if ( parent->left == node )
-//             fprintf( stdout, "✔ %s\n", parent->value );
-//         else
-//             fprintf( stdout, "✖ не %s\n", parent->value );
-//     }
 
-//     fprintf( stdout, "────────────────────────────────────────────\n\n" );
-// }
 
 static int ReadTwoObjects( char* obj1, char* obj2 ) {
     fprintf(stdout, "Введите имя первого объекта: ");
@@ -493,21 +819,23 @@ static int ReadTwoObjects( char* obj1, char* obj2 ) {
     return 1;
 }
 
-static int FindTwoNodes( const Tree_t* tree, const char* obj1, const char* obj2, const Node_t** n1, const Node_t** n2 ) {
+static int FindTwoNodes( Tree_t* tree, const char* obj1, const char* obj2, const Node_t** n1, const Node_t** n2 ) {
     *n1 = SearchObject( tree, obj1 );
     *n2 = SearchObject( tree, obj2 );
 
     if ( !*n1 || !*n2 ) {
         fprintf( stderr, COLOR_BRIGHT_RED "Одного из объектов нет в базе.\n" COLOR_RESET );
+
+        if ( !*n1 ) SuggestObjects( tree, obj1 );
+        if ( !*n2 ) SuggestObjects( tree, obj2 );
         return 0;
     }
     return 1;
 }
 
-static void PrintCommonTraits( const Node_t** path, size_t diverge ) {
-    fprintf( stdout, COLOR_BRIGHT_YELLOW "\nОбщие признаки:\n" COLOR_RESET );
-
-    for ( size_t idx = 1; idx < diverge; idx++ ) {
+// One line per edge of `path`: the question answered "Да" or "Нет" on the way down
+static void PrintPathTraits( const Node_t** path, size_t length ) {
+    for ( size_t idx = 1; idx < length; idx++ ) {
         const Node_t* parent = path[ idx - 1 ];
         const Node_t* node   = path[ idx ];
 
@@ -518,24 +846,9 @@ static void PrintCommonTraits( const Node_t** path, size_t diverge ) {
     }
 }
 
-static void PrintDifferences( const char* obj, const Node_t** path, size_t len, size_t diverge )
-{
-    fprintf( stdout, "\n%s:\n", obj );
-
-    size_t start = ( diverge == 0 ? 0 : diverge - 1 );
-
-    for ( size_t idx = start; idx < len - 1; idx++ ) {
-        const Node_t* parent = path[ idx ];
-        const Node_t* node   = path[ idx + 1 ];
-
-        if ( parent->left == node )
-            fprintf( stdout, "✔ %s\n", parent->value );
-        else
-            fprintf( stdout, "✖ не %s\n", parent->value );
-    }
-}
-
-static void PrintTwoObjectDifference( const Tree_t* tree ) {
+// Traits split at the common ancestor, found through the jump pointers in O(log depth);
+// the paths are then read off the parent links, so the cost is independent of the base size
+static void PrintTwoObjectDifference( Tree_t* tree ) {
     my_assert(tree, "Null pointer on tree");
 
     char obj1[ MAX_LEN ] = {};
@@ -548,26 +861,29 @@ static void PrintTwoObjectDifference( const Tree_t* tree ) {
 
     if ( !FindTwoNodes( tree, obj1, obj2, &n1, &n2 ) ) return;
 
-    const Node_t* path1[ MAX_LEN ] = {};
-    const Node_t* path2[ MAX_LEN ] = {};
+    const Node_t* fork = NodeCommonAncestor( n1, n2 );
 
-    size_t len1 = BuildPath( tree->root, n1, path1, 0 );
-    size_t len2 = BuildPath( tree->root, n2, path2, 0 );
+    size_t max_depth = ( n1->depth > n2->depth ) ? n1->depth : n2->depth;
 
-    size_t diverge = 0;
-    while (diverge < len1 && diverge < len2 && path1[diverge] == path2[diverge])
-        diverge++;
+    const Node_t** path = ( const Node_t** ) calloc ( max_depth + 1, sizeof( *path ) );
+    assert( path && "Memory allocation error" );
 
     fprintf( stdout, "\n────────────────────────────────────────────\n" );
     fprintf( stdout, COLOR_BRIGHT_GREEN "Сравнение \"%s\" и \"%s\":\n" COLOR_RESET, obj1, obj2 );
     fprintf( stdout, "────────────────────────────────────────────\n" );
 
-    PrintCommonTraits( path1, diverge);
+    fprintf( stdout, COLOR_BRIGHT_YELLOW "\nОбщие признаки:\n" COLOR_RESET );
+    PrintPathTraits( path, NodePathFrom( tree->root, fork, path ) );
 
     fprintf( stdout, COLOR_BRIGHT_RED "\nОтличия:\n" COLOR_RESET );
 
-    PrintDifferences( obj1, path1, len1, diverge );
-    PrintDifferences( obj2, path2, len2, diverge );
+    fprintf( stdout, "\n%s:\n", obj1 );
+    PrintPathTraits( path, NodePathFrom( fork, n1, path ) );
+
+    fprintf( stdout, "\n%s:\n", obj2 );
+    PrintPathTraits( path, NodePathFrom( fork, n2, path ) );
+
+    free( path );
 
     fprintf( stdout, "────────────────────────────────────────────\n\n" );
 }
@@ -587,18 +903,20 @@ static void AkinatorDump( const Akinator_t* akinator, const Node_t* current_elem
         current_element = akinator->tree->root;
     }
 
-    #define PRINT_HTML( format, ... ) fprintf( akinator->tree->logging.log_file, format, ##__VA_ARGS__ );
+    FILE* log_file = TreeLogFile( akinator->tree );
+
+    #define PRINT_HTML( format, ... ) fprintf( log_file, format, ##__VA_ARGS__ );
 
     PRINT_HTML( "<h1>")
 
     va_list args = {};
     va_start( args, format_string );
-    vfprintf( akinator->tree->logging.log_file, format_string, args );
+    vfprintf( log_file, format_string, args );
     va_end( args );
 
     PRINT_HTML( "</h1>\n" );
 
-    if ( *( akinator->tree->current_position ) != '\0' ) {
+    if ( akinator->tree->current_position && *( akinator->tree->current_position ) != '\0' ) {
         PRINT_HTML( "<h2>Текст в буфере с текущей позиции</h2>\n"
                     "<pre style=\"background:#f0f0f0; padding:10px;\">\n" );
         PRINT_HTML( "%s\n", akinator->tree->current_position );
@@ -608,51 +926,51 @@ static void AkinatorDump( const Akinator_t* akinator, const Node_t* current_elem
     PRINT_HTML("<h2>Графическое дерево</h2>\n"
                "<div style=\"border:1px solid #999; padding:10px; background:white;\">\n");
 
-    TreeDump( akinator->tree, "" );
+    TreeDumpAround( akinator->tree, current_element, DUMP_WINDOW_LEVELS, "" );
 
     PRINT_HTML("</div>\n<hr>\n");
 
 
 
-    fflush( akinator->tree->logging.log_file );
+    fflush( log_file );
 }
 #endif
 
-static void Speak( const char* text ) {
-    if ( !text || text[0] == '\0' ) return;
+// Returns at once, the speech goes on while the player types
+static void Speak( Akinator_t* akinator, const char* text ) {
+    if ( !akinator->speech || !text || text[0] == '\0' ) return;
 
-    char cmd[ MAX_LEN ] = {};
-    snprintf( cmd, sizeof(cmd), "espeak -v ru -s 100 \"%s\" 2>/dev/null", text );
-
-    system( cmd );
+    SpeechSay( akinator->speech, text );
 }
 
-static void OpenImage(const char* path) {
-    if ( !path ) return;
-
-    char cmd[ MAX_LEN ] = {};
-    snprintf( cmd, sizeof(cmd), "xdg-open \"%s\" >/dev/null 2>&1 &", path );
-    system( cmd );
+static void StopSpeaking( Akinator_t* akinator ) {
+    if ( akinator->speech )
+        SpeechCancel( akinator->speech );
 }
 
 static void ShowGraphicTree( Tree_t* tree ) {
     my_assert( tree, "Null pointer on `tree`" );
 
-    fprintf( stdout, "Генерация графического дерева...\n" );
+    TreeStats_t stats = {};
+    TreeCollectStats( tree, &stats );
+
+    fprintf( stdout, "Объектов: %zu, вопросов: %zu, наибольшая глубина: %zu, в среднем вопросов до ответа: %.2f\n",
+             stats.objects, stats.nodes - stats.objects, stats.max_depth,
+             stats.objects ? ( double ) stats.object_depth_sum / ( double ) stats.objects : 0.0 );
 
     TreeDump( tree, "" );
 
-    char svg_path[256] = {};
-    snprintf(
-        svg_path,
-        sizeof(svg_path),
-        "%s/image%lu.dot.svg",
-        tree->logging.img_log_path,
-        tree->image_number - 1
-    );
+    if ( !tree->has_image || !tree->render ) {
+        fprintf( stdout, "Дерево пустое, рисовать нечего\n" );
+        return;
+    }
 
-    fprintf( stdout, "Готово! SVG сохранён: %s\n", svg_path );
-    fprintf( stdout, "Открываю изображение...\n" );
+    char svg_path[ MAX_LEN_PATH ] = {};
+    snprintf( svg_path, sizeof( svg_path ), "%s/image%lu.dot.svg", tree->logging.img_log_path, tree->last_image );
 
-    OpenImage(svg_path);
+    // Layout of a large tree takes a while: the game goes on, the picture opens when ready
+    if ( TreeRenderOpen( tree->render, svg_path ) )
+        fprintf( stdout, "SVG строится в фоне: %s, откроется, когда будет готов\n", svg_path );
+    else
+        fprintf( stdout, "SVG не построить: Graphviz (dot) не найден\n" );
 }
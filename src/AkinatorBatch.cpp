@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "AkinatorBatch.h"
+#include "Colors.h"
+#include "DebugUtils.h"
+#include "Metrics.h"
+#include "Tree.h"
+#include "TreeJournal.h"
+#include "UtilsRW.h"
+
+const size_t BATCH_MAX_FIELDS = 3;
+
+struct BatchChunk_t {
+    OutputBuffer_t output;
+    size_t         queries;
+    size_t         failed;
+};
+
+struct BatchJob_t {
+    const Tree_t*        tree;
+    const CompactTree_t* compact;   // built before the workers start, descents read only this
+    const ObjectIndex_t* objects;   // the same for lookups by name
+
+    char** lines;               // NUL-terminated in the mapped query file, line number = index + 1
+    size_t line_count;
+
+    BatchChunk_t* chunks;
+    size_t        chunk_count;
+
+    std::atomic<size_t> next_chunk;
+};
+
+struct BatchWorker_t {
+    BatchJob_t* job;
+
+    const Node_t** path;        // scratch for root-to-node paths, grown to the deepest one seen
+    size_t         path_capacity;
+};
+
+static void AppendNumber( OutputBuffer_t* output, size_t number ) {
+    char digits[ 32 ] = {};
+    int  length = snprintf( digits, sizeof( digits ), "%zu", number );
+
+    AppendBytes( output, digits, ( size_t ) length );
+}
+
+// ,"key":[{"question":"...","answer":true},...] for every edge of `path`
+static void AppendTraits( OutputBuffer_t* output, const char* key, const Node_t** path, size_t length ) {
+    AppendText( output, ",\"" );
+    AppendText( output, key );
+    AppendText( output, "\":[" );
+
+    for ( size_t idx = 1; idx < length; idx++ ) {
+        const Node_t* parent = path[ idx - 1 ];
+
+        AppendText( output, idx > 1 ? ",{\"question\":" : "{\"question\":" );
+        AppendJsonString( output, parent->value );
+        AppendText( output, parent->left == path[ idx ] ? ",\"answer\":true}" : ",\"answer\":false}" );
+    }
+
+    AppendText( output, "]" );
+}
+
+static void ReservePath( BatchWorker_t* worker, size_t depth ) {
+    if ( depth + 1 <= worker->path_capacity )
+        return;
+
+    worker->path_capacity = 2 * ( depth + 1 );
+    worker->path = ( const Node_t** ) realloc ( worker->path, worker->path_capacity * sizeof( *( worker->path ) ) );
+    assert( worker->path && "Memory allocation error" );
+}
+
+static bool FailQuery( OutputBuffer_t* output, const char* error ) {
+    AppendText( output, ",\"error\":" );
+    AppendJsonString( output, error );
+
+    return false;
+}
+
+static bool RunDefine( BatchWorker_t* worker, OutputBuffer_t* output, char** fields, size_t count ) {
+    AppendText( output, ",\"define\":" );
+    AppendJsonString( output, count > 1 ? fields[1] : "" );
+
+    if ( count != 2 )
+        return FailQuery( output, "expected: define <TAB> object" );
+
+    const Tree_t* tree = worker->job->tree;
+    const Node_t* node = ObjectIndexFind( worker->job->objects, fields[1] );
+    if ( !node )
+        return FailQuery( output, "unknown object" );
+
+    ReservePath( worker, node->depth );
+
+    AppendText( output, ",\"object\":" );
+    AppendJsonString( output, node->value );
+    AppendTraits( output, "traits", worker->path, NodePathFrom( tree->root, node, worker->path ) );
+
+    return true;
+}
+
+static bool RunCompare( BatchWorker_t* worker, OutputBuffer_t* output, char** fields, size_t count ) {
+    AppendText( output, ",\"compare\":[" );
+    AppendJsonString( output, count > 1 ? fields[1] : "" );
+    AppendText( output, "," );
+    AppendJsonString( output, count > 2 ? fields[2] : "" );
+    AppendText( output, "]" );
+
+    if ( count != 3 )
+        return FailQuery( output, "expected: compare <TAB> object <TAB> object" );
+
+    const Tree_t* tree   = worker->job->tree;
+    const Node_t* first  = ObjectIndexFind( worker->job->objects, fields[1] );
+    const Node_t* second = ObjectIndexFind( worker->job->objects, fields[2] );
+    if ( !first || !second )
+        return FailQuery( output, "unknown object" );
+
+    const Node_t* fork = NodeCommonAncestor( first, second );
+
+    ReservePath( worker, ( first->depth > second->depth ) ? first->depth : second->depth );
+
+    AppendTraits( output, "common", worker->path, NodePathFrom( tree->root, fork, worker->path ) );
+    AppendTraits( output, "first",  worker->path, NodePathFrom( fork, first,  worker->path ) );
+    AppendTraits( output, "second", worker->path, NodePathFrom( fork, second, worker->path ) );
+
+    return true;
+}
+
+// Follows the answers from the root: ends on an object, or on the question to ask next
+static bool RunClassify( BatchWorker_t* worker, OutputBuffer_t* output, char** fields, size_t count ) {
+    AppendText( output, ",\"classify\":" );
+    AppendJsonString( output, count > 1 ? fields[1] : "" );
+
+    if ( count != 2 )
+        return FailQuery( output, "expected: classify <TAB> answers" );
+
+    const CompactTree_t* compact = worker->job->compact;
+    if ( compact->count == 0 )
+        return FailQuery( output, "empty base" );
+
+    uint32_t slot = 0;
+
+    for ( const char* answer = fields[1]; *answer; answer++ ) {
+        if ( CompactTreeIsLeaf( compact, slot ) )
+            return FailQuery( output, "too many answers" );
+
+        switch ( *answer ) {
+            case 'y': case 'Y': slot = compact->nodes[ slot ].left;  break;
+            case 'n': case 'N': slot = compact->nodes[ slot ].right; break;
+            default:            return FailQuery( output, "answers must be 'y' or 'n'" );
+        }
+
+        if ( slot == COMPACT_NONE )
+            return FailQuery( output, "no such branch" );
+    }
+
+    AppendText( output, CompactTreeIsLeaf( compact, slot ) ? ",\"object\":" : ",\"question\":" );
+    AppendJsonString( output, CompactTreeValue( compact, slot ) );
+
+    return true;
+}
+
+// Returns false for lines that are not queries
+static bool RunQuery( BatchWorker_t* worker, BatchChunk_t* chunk, char* line, size_t line_number ) {
+    if ( line[0] == '\0' || line[0] == '#' )
+        return false;
+
+    OutputBuffer_t* output = &( chunk->output );
+
+    char*  fields[ BATCH_MAX_FIELDS ] = {};
+    size_t count = SplitFields( line, fields, BATCH_MAX_FIELDS );
+
+    AppendText( output, "{\"line\":" );
+    AppendNumber( output, line_number );
+
+    bool success = false;
+
+    if      ( strcmp( fields[0], "define" )   == 0 ) success = RunDefine( worker, output, fields, count );
+    else if ( strcmp( fields[0], "compare" )  == 0 ) success = RunCompare( worker, output, fields, count );
+    else if ( strcmp( fields[0], "classify" ) == 0 ) success = RunClassify( worker, output, fields, count );
+    else {
+        AppendText( output, ",\"query\":" );
+        AppendJsonString( output, fields[0] );
+        FailQuery( output, "unknown query" );
+    }
+
+    AppendText( output, "}\n" );
+
+    chunk->queries++;
+    if ( !success )
+        chunk->failed++;
+
+    return true;
+}
+
+static void* RunWorker( void* argument ) {
+    BatchWorker_t* worker = ( BatchWorker_t* ) argument;
+    BatchJob_t*    job    = worker->job;
+
+    while ( true ) {
+        size_t chunk_idx = job->next_chunk.fetch_add( 1, std::memory_order_relaxed );
+        if ( chunk_idx >= job->chunk_count )
+            break;
+
+        size_t first = chunk_idx * BATCH_CHUNK_LINES;
+        size_t last  = first + BATCH_CHUNK_LINES;
+        if ( last > job->line_count )
+            last = job->line_count;
+
+        // Filled locally and stored once: neighbouring chunks share cache lines
+        BatchChunk_t chunk = {};
+        for ( size_t idx = first; idx < last; idx++ )
+            RunQuery( worker, &chunk, job->lines[ idx ], idx + 1 );
+
+        job->chunks[ chunk_idx ] = chunk;
+    }
+
+    return NULL;
+}
+
+// Terminates every line in place, dropping '\r' before '\n'
+static size_t SplitLines( char* text, size_t size, char*** lines ) {
+    size_t count = 0;
+    for ( const char* cursor = text; ( cursor = ( const char* ) memchr( cursor, '\n', size - ( size_t ) ( cursor - text ) ) ); cursor++ )
+        count++;
+
+    if ( size > 0 && text[ size - 1 ] != '\n' )
+        count++;
+
+    *lines = ( char** ) calloc ( count + 1, sizeof( char* ) );
+    assert( *lines && "Memory allocation error" );
+
+    char* line = text;
+    for ( size_t idx = 0; idx < count; idx++ ) {
+        ( *lines )[ idx ] = line;
+
+        char* end = ( char* ) memchr( line, '\n', size - ( size_t ) ( line - text ) );
+        if ( !end )
+            break;  // the last line, already followed by the zeroed tail of the mapping
+
+        *end = '\0';
+        if ( end > line && end[ -1 ] == '\r' )
+            end[ -1 ] = '\0';
+
+        line = end + 1;
+    }
+
+    return count;
+}
+
+static TreeStatus_t WriteResults( const BatchJob_t* job, const char* results_path ) {
+    if ( strcmp( results_path, "-" ) == 0 ) {
+        for ( size_t idx = 0; idx < job->chunk_count; idx++ ) {
+            if ( WriteAll( STDOUT_FILENO, job->chunks[ idx ].output.data, job->chunks[ idx ].output.size ) == -1 )
+                return FAIL;
+        }
+        return SUCCESS;
+    }
+
+    char temporary_name[ MAX_LEN_PATH ] = {};
+
+    int fd = OpenTemporaryFile( results_path, temporary_name, sizeof( temporary_name ) );
+    if ( fd == -1 ) {
+        fprintf( stderr, "Не удалось создать временный файл для %s: %s\n", results_path, strerror( errno ) );
+        return FAIL;
+    }
+
+    for ( size_t idx = 0; idx < job->chunk_count; idx++ ) {
+        if ( WriteAll( fd, job->chunks[ idx ].output.data, job->chunks[ idx ].output.size ) == -1 ) {
+            fprintf( stderr, "Ошибка записи результатов в %s: %s\n", temporary_name, strerror( errno ) );
+            DiscardTemporaryFile( fd, temporary_name );
+            return FAIL;
+        }
+    }
+
+    if ( CommitTemporaryFile( fd, temporary_name, results_path ) == -1 ) {
+        fprintf( stderr, "Не удалось сохранить результаты в %s: %s\n", results_path, strerror( errno ) );
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+static size_t RunJob( BatchJob_t* job, size_t threads ) {
+    BatchWorker_t* workers = ( BatchWorker_t* ) calloc ( threads, sizeof( *workers ) );
+    assert( workers && "Memory allocation error" );
+
+    pthread_t* handles = ( pthread_t* ) calloc ( threads, sizeof( *handles ) );
+    assert( handles && "Memory allocation error" );
+
+    // The calling thread is worker 0, so a single thread runs without spawning
+    size_t started = 1;
+    for ( size_t idx = 0; idx < threads; idx++ ) {
+        workers[ idx ].job = job;
+
+        if ( idx > 0 && pthread_create( &( handles[ idx ] ), NULL, RunWorker, &( workers[ idx ] ) ) == 0 )
+            started++;
+    }
+
+    RunWorker( &( workers[ 0 ] ) );
+
+    for ( size_t idx = 1; idx < started; idx++ )
+        pthread_join( handles[ idx ], NULL );
+
+    for ( size_t idx = 0; idx < threads; idx++ )
+        free( workers[ idx ].path );
+
+    free( handles );
+    free( workers );
+
+    return started;
+}
+
+int AkinatorBatch( const char* base_path, const char* queries_path, const char* results_path, size_t threads ) {
+    my_assert( base_path && queries_path && results_path, "Null pointer on path" );
+
+    Tree_t* tree = TreeCtor();
+
+    // Objects learned since the last save answer queries too
+    TreeJournal_t journal = {};
+
+    if ( TreeReadFromFile( tree, base_path, LOAD_MMAP ) != SUCCESS ||
+         TreeJournalOpen( &journal, tree, base_path ) != SUCCESS ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось загрузить базу \"%s\"\n" COLOR_RESET, base_path );
+        TreeJournalClose( &journal );
+        TreeDtor( &tree );
+        return 1;
+    }
+
+    TreeJournalClose( &journal );
+
+    off_t queries_size = 0;
+    char* queries = MapFileToMemory( queries_path, &queries_size );
+    if ( !queries ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось открыть файл запросов \"%s\": %s\n" COLOR_RESET,
+                 queries_path, strerror( errno ) );
+        TreeDtor( &tree );
+        return 1;
+    }
+
+    BatchJob_t job = {};
+    job.tree        = tree;
+    job.compact     = TreeCompactTree( tree );
+    job.objects     = TreeObjectIndex( tree );
+    job.line_count  = SplitLines( queries, ( size_t ) queries_size, &( job.lines ) );
+    job.chunk_count = ( job.line_count + BATCH_CHUNK_LINES - 1 ) / BATCH_CHUNK_LINES;
+    job.chunks      = ( BatchChunk_t* ) calloc ( job.chunk_count + 1, sizeof( BatchChunk_t ) );
+    assert( job.chunks && "Memory allocation error" );
+
+    if ( threads == 0 ) {
+        long online = sysconf( _SC_NPROCESSORS_ONLN );
+        threads = ( online > 0 ) ? ( size_t ) online : 1;
+    }
+    if ( threads > BATCH_MAX_THREADS ) threads = BATCH_MAX_THREADS;
+    if ( threads > job.chunk_count )   threads = job.chunk_count;
+    if ( threads == 0 )                threads = 1;
+
+    double start   = MonotonicSeconds();
+    size_t started = RunJob( &job, threads );
+    double elapsed = MonotonicSeconds() - start;
+
+    size_t queries_run = 0;
+    size_t failed      = 0;
+    for ( size_t idx = 0; idx < job.chunk_count; idx++ ) {
+        queries_run += job.chunks[ idx ].queries;
+        failed      += job.chunks[ idx ].failed;
+    }
+
+    TreeStatus_t status = WriteResults( &job, results_path );
+
+    fprintf( stderr, "Запросов: %zu, с ошибкой: %zu, потоков: %zu, %.3f с (%.0f запросов/с)\n",
+             queries_run, failed, started, elapsed, elapsed > 0 ? ( double ) queries_run / elapsed : 0.0 );
+
+    for ( size_t idx = 0; idx < job.chunk_count; idx++ )
+        free( job.chunks[ idx ].output.data );
+
+    free( job.chunks );
+    free( job.lines );
+    UnmapFile( queries, queries_size );
+    TreeDtor( &tree );
+
+    return status == SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,754 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+
+#include "AkinatorBench.h"
+#include "Colors.h"
+#include "DebugUtils.h"
+#include "Metrics.h"
+#include "Tree.h"
+#include "UtilsRW.h"
+#include "Utf8.h"
+
+const size_t BENCH_WRITE_BUFFER  = 1 << 20;
+const size_t BENCH_INITIAL_STACK = 1024;
+
+// Comparisons read paths off parent links, so on a list-shaped base one costs its depth:
+// the count is cut to keep a repeat within this many path steps
+const size_t BENCH_PATH_BUDGET = 1 << 26;
+
+const uint64_t BENCH_QUERY_SEED = 1;
+
+// Suggestions cost up to a millisecond each on large bases, so fewer of them are timed
+const size_t BENCH_NAME_QUERIES = 1000;
+const size_t BENCH_SUGGESTIONS  = 5;
+
+// Questions as players type them: a trait and when it holds
+static const char* const QUESTION_TRAITS[] = {
+    "Умеет летать",    "Живёт в воде",      "Больше кошки",      "Ведёт матан",
+    "Носит очки",      "Работает в МФТИ",   "Есть хвост",        "Любит шоколад",
+    "Играет на гитаре", "Боится темноты",   "Знает английский",  "Ходит в походы",
+    "Пишет на C++",    "Спит днём",         "Ест траву",         "Умеет плавать",
+    "Сдал сессию",     "Живёт в общежитии", "Ездит на метро",    "Рисует комиксы",
+    "Громко поёт",     "Читает Толстого",   "Водит машину",      "Держит кота",
+    "Пьёт кофе",       "Бегает по утрам",   "Собирает марки",    "Смотрит аниме",
+    "Решает задачи",   "Опаздывает на пары", "Варит борщ",       "Строит мосты"
+};
+
+static const char* const QUESTION_TIMES[] = {
+    "по утрам",  "зимой",        "летом",      "в детстве",
+    "иногда",    "на выходных",  "после пар",  "по ночам",
+    "в отпуске", "каждый день",  "с друзьями", "в одиночку",
+    "весной",    "перед сессией", "дома",      "на работе"
+};
+
+static const char* const NAME_HEADS[] = {
+    "Ва", "Ле", "Ми", "Ра", "То", "Ша", "Ко", "Ни", "Да", "Ю", "Ро", "Се", "Ли", "На", "Гу", "Бо"
+};
+
+static const char* const NAME_SYLLABLES[] = {
+    "ва", "ле", "ми", "ра", "то", "ша", "ко", "ни", "да", "ю", "ро", "се", "ли", "на", "гу", "бо"
+};
+
+static const char* const SURNAME_ENDINGS[] = {
+    "ов", "ин", "ский", "енко", "ев", "ук", "ман", "ова"
+};
+
+#define COUNT_OF( array ) ( sizeof( array ) / sizeof( ( array )[0] ) )
+
+// splitmix64: the same sequence on every libc, unlike rand()
+struct BenchRandom_t {
+    uint64_t state;
+};
+
+static uint64_t NextRandom( BenchRandom_t* random ) {
+    uint64_t value = ( random->state += 0x9E3779B97F4A7C15ull );
+
+    value = ( value ^ ( value >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+    value = ( value ^ ( value >> 27 ) ) * 0x94D049BB133111EBull;
+
+    return value ^ ( value >> 31 );
+}
+
+static size_t RandomBelow( BenchRandom_t* random, size_t bound ) {
+    return NextRandom( random ) % bound;
+}
+
+static const char* RandomWord( BenchRandom_t* random, const char* const* words, size_t count ) {
+    return words[ RandomBelow( random, count ) ];
+}
+
+// The number keeps every value unique, as names of objects in the base have to be
+static void WriteQuestion( FILE* base, BenchRandom_t* random, size_t number ) {
+    fprintf( base, "( \"%s %s №%zu\" ",
+             RandomWord( random, QUESTION_TRAITS, COUNT_OF( QUESTION_TRAITS ) ),
+             RandomWord( random, QUESTION_TIMES,  COUNT_OF( QUESTION_TIMES ) ), number );
+}
+
+static void WriteName( FILE* base, BenchRandom_t* random, size_t syllables ) {
+    fputs( RandomWord( random, NAME_HEADS, COUNT_OF( NAME_HEADS ) ), base );
+
+    for ( size_t idx = 1; idx < syllables; idx++ )
+        fputs( RandomWord( random, NAME_SYLLABLES, COUNT_OF( NAME_SYLLABLES ) ), base );
+}
+
+static void WriteObject( FILE* base, BenchRandom_t* random, size_t number ) {
+    fprintf( base, "( \"" );
+
+    WriteName( base, random, 2 + RandomBelow( random, 2 ) );
+    fputc( ' ', base );
+    WriteName( base, random, 1 + RandomBelow( random, 3 ) );
+    fputs( RandomWord( random, SURNAME_ENDINGS, COUNT_OF( SURNAME_ENDINGS ) ), base );
+
+    fprintf( base, " №%zu\" nil nil )\n", number );
+}
+
+// Nodes on the "Да" side of a question over a subtree of `nodes` nodes, odd and at least 3
+static size_t SplitNodes( BenchRandom_t* random, BenchShape_t shape, size_t nodes ) {
+    switch ( shape ) {
+        case BENCH_BALANCED: return ( ( nodes - 1 ) / 2 ) | 1;
+        case BENCH_RANDOM:   return 2 * RandomBelow( random, ( nodes - 1 ) / 2 ) + 1;
+        case BENCH_CHAIN:    return 1;
+        default:             return 1;
+    }
+}
+
+int AkinatorGenerateBase( const char* base_path, BenchShape_t shape, size_t nodes, uint64_t seed ) {
+    my_assert( base_path, "Null pointer on `base_path`" );
+
+    if ( nodes % 2 == 0 )
+        nodes++;
+
+    FILE* base = fopen( base_path, "w" );
+    if ( !base ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось открыть \"%s\": %s\n" COLOR_RESET, base_path, strerror( errno ) );
+        return 1;
+    }
+
+    setvbuf( base, NULL, _IOFBF, BENCH_WRITE_BUFFER );
+
+    BenchRandom_t random = { seed };
+
+    // Subtrees still to write, by node count; 0 - the ')' closing a question. A list-shaped
+    // base is as deep as it is large, so there is no recursion.
+    size_t  capacity = BENCH_INITIAL_STACK;
+    size_t  size     = 0;
+    size_t* stack    = ( size_t* ) calloc ( capacity, sizeof( *stack ) );
+    assert( stack && "Memory allocation error" );
+
+    stack[ size++ ] = nodes;
+
+    size_t number = 0;
+
+    while ( size > 0 ) {
+        size_t subtree = stack[ --size ];
+
+        if ( subtree == 0 ) {
+            fputs( ")\n", base );
+            continue;
+        }
+
+        number++;
+
+        if ( subtree == 1 ) {
+            WriteObject( base, &random, number );
+            continue;
+        }
+
+        WriteQuestion( base, &random, number );
+
+        if ( size + 3 > capacity ) {
+            capacity *= 2;
+            stack     = ( size_t* ) realloc ( stack, capacity * sizeof( *stack ) );
+            assert( stack && "Memory allocation error" );
+        }
+
+        size_t left = SplitNodes( &random, shape, subtree );
+
+        stack[ size++ ] = 0;
+        stack[ size++ ] = subtree - 1 - left;
+        stack[ size++ ] = left;
+    }
+
+    free( stack );
+
+    bool failed = ferror( base ) != 0;
+    failed = ( fclose( base ) != 0 ) || failed;
+
+    if ( failed ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Ошибка записи в \"%s\"\n" COLOR_RESET, base_path );
+        return 1;
+    }
+
+    fprintf( stdout, "Узлов: %zu, объектов: %zu\n", nodes, ( nodes + 1 ) / 2 );
+
+    return 0;
+}
+
+struct BenchRun_t {
+    const char* base_path;
+    FILE*       results;
+    bool        table;
+
+    size_t nodes;
+    off_t  bytes;
+
+    size_t  repeats;
+    double* seconds;            // one per repeat of the operation being timed
+
+    OutputBuffer_t identity;    // "revision":...,"base":... that opens every result line, escaped once
+};
+
+static int CompareSeconds( const void* first, const void* second ) {
+    double a = *( const double* ) first;
+    double b = *( const double* ) second;
+
+    return ( a > b ) - ( a < b );
+}
+
+// `operations` - what one repeat does: nodes loaded, lookups made and so on
+static void Report( BenchRun_t* run, const char* operation, size_t operations ) {
+    qsort( run->seconds, run->repeats, sizeof( double ), CompareSeconds );
+
+    double min    = run->seconds[ 0 ];
+    double median = ( run->seconds[ ( run->repeats - 1 ) / 2 ] + run->seconds[ run->repeats / 2 ] ) / 2;
+    double max    = run->seconds[ run->repeats - 1 ];
+    double per_op = operations ? median * 1e9 / ( double ) operations : 0.0;
+
+    fprintf( run->results, "{%.*s,\"nodes\":%zu,\"bytes\":%lld,\"operation\":\"%s\",\"repeats\":%zu,\"operations\":%zu,"
+                           "\"min_s\":%.9f,\"median_s\":%.9f,\"max_s\":%.9f,\"ns_per_operation\":%.2f}\n",
+             ( int ) run->identity.size, run->identity.data, run->nodes, ( long long ) run->bytes, operation,
+             run->repeats, operations, min, median, max, per_op );
+
+    if ( run->table ) {
+        fprintf( stdout, "%-12s медиана %10.3f мс, мин. %10.3f мс, макс. %10.3f мс, %10.1f нс/оп. (%zu оп.)\n",
+                 operation, median * 1e3, min * 1e3, max * 1e3, per_op, operations );
+    }
+}
+
+// One line per query type besides the per-repeat one: a slow query is lost in a mean over
+// a thousand fast ones, so the tail of single queries over all repeats is reported as well
+static void ReportQueries( BenchRun_t* run, const char* operation, double* latencies, size_t count ) {
+    qsort( latencies, count, sizeof( double ), CompareSeconds );
+
+    double median = latencies[ ( count - 1 ) / 2 ];
+    double p99    = latencies[ ( count - 1 ) * 99 / 100 ];
+    double max    = latencies[ count - 1 ];
+
+    fprintf( run->results, "{%.*s,\"nodes\":%zu,\"bytes\":%lld,\"operation\":\"%s_query\",\"queries\":%zu,"
+                           "\"median_s\":%.9f,\"p99_s\":%.9f,\"max_s\":%.9f}\n",
+             ( int ) run->identity.size, run->identity.data, run->nodes, ( long long ) run->bytes, operation,
+             count, median, p99, max );
+
+    if ( run->table ) {
+        fprintf( stdout, "%-12s запрос: медиана %10.3f мс, p99 %10.3f мс, макс. %10.3f мс (%zu запр.)\n",
+                 operation, median * 1e3, p99 * 1e3, max * 1e3, count );
+    }
+}
+
+static Tree_t* LoadBase( const BenchRun_t* run, TreeLoadMode_t mode, double* seconds ) {
+    Tree_t* tree = TreeCtor();
+
+    double start = MonotonicSeconds();
+    TreeStatus_t status = TreeReadFromFile( tree, run->base_path, mode );
+    *seconds = MonotonicSeconds() - start;
+
+    if ( status != SUCCESS || !tree->root ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось загрузить базу \"%s\"\n" COLOR_RESET, run->base_path );
+        TreeDtor( &tree );
+        return NULL;
+    }
+
+    return tree;
+}
+
+// Teardown is timed on the trees the loads build, so no base is read only for it
+static TreeStatus_t BenchLoad( BenchRun_t* run, TreeLoadMode_t mode, const char* operation ) {
+    double* teardown = ( double* ) calloc ( run->repeats, sizeof( double ) );
+    assert( teardown && "Memory allocation error" );
+
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        Tree_t* tree = LoadBase( run, mode, &( run->seconds[ repeat ] ) );
+        if ( !tree ) {
+            free( teardown );
+            return FAIL;
+        }
+
+        run->nodes = tree->arena.live;
+
+        double start = MonotonicSeconds();
+        TreeDtor( &tree );
+        teardown[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    Report( run, operation, run->nodes );
+
+    if ( mode == LOAD_MMAP ) {
+        memcpy( run->seconds, teardown, run->repeats * sizeof( double ) );
+        Report( run, "dtor", run->nodes );
+    }
+
+    free( teardown );
+
+    return SUCCESS;
+}
+
+static TreeStatus_t BenchSave( BenchRun_t* run, const Tree_t* tree ) {
+    char save_path[ MAX_LEN_PATH ] = {};
+    snprintf( save_path, sizeof( save_path ), "%s.bench", run->base_path );
+
+    TreeStatus_t status = SUCCESS;
+
+    for ( size_t repeat = 0; repeat < run->repeats && status == SUCCESS; repeat++ ) {
+        double start = MonotonicSeconds();
+        status = TreeSaveToFile( tree, save_path );
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    if ( status != SUCCESS ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось сохранить базу в \"%s\"\n" COLOR_RESET, save_path );
+        return FAIL;
+    }
+
+    unlink( save_path );
+
+    Report( run, "save", run->nodes );
+
+    return SUCCESS;
+}
+
+// Objects drawn with repetition, the same ones for every run on the same base
+static const Node_t** SampleObjects( Tree_t* tree, size_t count ) {
+    size_t   capacity = BENCH_INITIAL_STACK;
+    size_t   objects  = 0;
+    Node_t** leaves   = ( Node_t** ) calloc ( capacity, sizeof( *leaves ) );
+    assert( leaves && "Memory allocation error" );
+
+    for ( Node_t* leaf = TreeFirstLeaf( tree->root ); leaf; leaf = TreeNextLeaf( tree->root, leaf ) ) {
+        if ( objects == capacity ) {
+            capacity *= 2;
+            leaves    = ( Node_t** ) realloc ( leaves, capacity * sizeof( *leaves ) );
+            assert( leaves && "Memory allocation error" );
+        }
+
+        leaves[ objects++ ] = leaf;
+    }
+
+    const Node_t** sample = ( const Node_t** ) calloc ( count, sizeof( *sample ) );
+    assert( sample && "Memory allocation error" );
+
+    BenchRandom_t random = { BENCH_QUERY_SEED };
+
+    for ( size_t idx = 0; idx < count; idx++ )
+        sample[ idx ] = leaves[ RandomBelow( &random, objects ) ];
+
+    free( leaves );
+
+    return sample;
+}
+
+// Loads leave the index to the first lookup, so building it is an operation of its own
+static void BenchIndex( BenchRun_t* run, Tree_t* tree ) {
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+        ObjectIndexBuild( &( tree->objects ), tree->root );
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    Report( run, "index_build", tree->objects.count );
+}
+
+static void BenchSearch( BenchRun_t* run, const ObjectIndex_t* objects, const Node_t** sample, size_t count ) {
+    size_t found = 0;
+
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+
+        for ( size_t idx = 0; idx < count; idx++ )
+            found += ( ObjectIndexFind( objects, sample[ idx ]->value ) == sample[ idx ] );
+
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    if ( found != count * run->repeats )
+        fprintf( stderr, COLOR_BRIGHT_RED "Найдены не все объекты: %zu из %zu\n" COLOR_RESET, found, count * run->repeats );
+
+    Report( run, "search_hit", count );
+
+    // The same objects typed in small letters, as players do: the folded comparison decides
+    size_t folded_size = 0;
+    for ( size_t idx = 0; idx < count; idx++ )
+        folded_size += strlen( sample[ idx ]->value ) + 1;
+
+    char*  folded_names = ( char* )  calloc ( folded_size, sizeof( char ) );
+    char** folded       = ( char** ) calloc ( count, sizeof( char* ) );
+    assert( folded_names && folded && "Memory allocation error" );
+
+    char* next_folded = folded_names;
+    for ( size_t idx = 0; idx < count; idx++ ) {
+        folded[ idx ] = next_folded;
+        Utf8Fold( sample[ idx ]->value, next_folded );
+        next_folded += strlen( next_folded ) + 1;
+    }
+
+    found = 0;
+
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+
+        for ( size_t idx = 0; idx < count; idx++ )
+            found += ( ObjectIndexFind( objects, folded[ idx ] ) == sample[ idx ] );
+
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    if ( found != count * run->repeats )
+        fprintf( stderr, COLOR_BRIGHT_RED "Найдены не все объекты в малых буквах: %zu из %zu\n" COLOR_RESET,
+                 found, count * run->repeats );
+
+    Report( run, "search_folded", count );
+
+    free( folded );
+    free( folded_names );
+
+    // Names one character longer than objects of the base: the whole probe sequence is walked
+    size_t names_size = 0;
+    for ( size_t idx = 0; idx < count; idx++ )
+        names_size += strlen( sample[ idx ]->value ) + 2;
+
+    char*  names  = ( char* )  calloc ( names_size, sizeof( char ) );
+    char** misses = ( char** ) calloc ( count, sizeof( char* ) );
+    assert( names && misses && "Memory allocation error" );
+
+    char* next = names;
+    for ( size_t idx = 0; idx < count; idx++ ) {
+        misses[ idx ] = next;
+        next += sprintf( next, "%s?", sample[ idx ]->value ) + 1;
+    }
+
+    found = 0;
+
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+
+        for ( size_t idx = 0; idx < count; idx++ )
+            found += ( ObjectIndexFind( objects, misses[ idx ] ) != NULL );
+
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    if ( found != 0 )
+        fprintf( stderr, COLOR_BRIGHT_RED "Найдены несуществующие объекты: %zu\n" COLOR_RESET, found );
+
+    Report( run, "search_miss", count );
+
+    free( misses );
+    free( names );
+}
+
+static size_t CodePointStart( const char* text, size_t position ) {
+    while ( position > 0 && ( ( unsigned char ) text[ position ] & 0xC0 ) == 0x80 )
+        position--;
+
+    return position;
+}
+
+static void BenchSuggest( BenchRun_t* run, NameIndex_t* names, char* const* queries, size_t count,
+                          uint32_t max_distance, const char* operation ) {
+    NameMatch_t matches[ BENCH_SUGGESTIONS ] = {};
+    size_t      empty = 0;
+
+    double* latencies = ( double* ) calloc ( run->repeats * count, sizeof( double ) );
+    assert( latencies && "Memory allocation error" );
+
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+        double query = start;
+
+        for ( size_t idx = 0; idx < count; idx++ ) {
+            size_t found = max_distance ? NameIndexFuzzy( names, queries[ idx ], max_distance, matches, BENCH_SUGGESTIONS )
+                                        : NameIndexComplete( names, queries[ idx ], matches, BENCH_SUGGESTIONS );
+            empty += ( found == 0 );
+
+            double done = MonotonicSeconds();
+            latencies[ repeat * count + idx ] = done - query;
+            query = done;
+        }
+
+        run->seconds[ repeat ] = query - start;
+    }
+
+    // The object a query was made from always matches it
+    if ( empty != 0 )
+        fprintf( stderr, COLOR_BRIGHT_RED "%s: запросов без подсказок: %zu\n" COLOR_RESET, operation, empty );
+
+    Report( run, operation, count );
+    ReportQueries( run, operation, latencies, run->repeats * count );
+
+    free( latencies );
+}
+
+// What "define" and "compare" do with a name that is not in the base: completions of its
+// first half, then names within one or two edits of it with one letter dropped
+static void BenchNames( BenchRun_t* run, Tree_t* tree, const Node_t** sample, size_t count ) {
+    if ( count > BENCH_NAME_QUERIES )
+        count = BENCH_NAME_QUERIES;
+
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+        NameIndexBuild( &( tree->names ), tree->root, tree->root->leaves );
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    Report( run, "names_build", tree->names.count );
+
+    size_t texts_size = 0;
+    for ( size_t idx = 0; idx < count; idx++ )
+        texts_size += 2 * ( strlen( sample[ idx ]->value ) + 1 );
+
+    char*  texts    = ( char* )  calloc ( texts_size, sizeof( char ) );
+    char** prefixes = ( char** ) calloc ( count, sizeof( char* ) );
+    char** typos    = ( char** ) calloc ( count, sizeof( char* ) );
+    assert( texts && prefixes && typos && "Memory allocation error" );
+
+    char* next = texts;
+    for ( size_t idx = 0; idx < count; idx++ ) {
+        const char* name   = sample[ idx ]->value;
+        size_t      length = strlen( name );
+        size_t      half   = CodePointStart( name, length / 2 );
+
+        prefixes[ idx ] = next;
+        memcpy( next, name, half );
+        next += half + 1;
+
+        size_t after = half + 1;
+        while ( after < length && ( ( unsigned char ) name[ after ] & 0xC0 ) == 0x80 )
+            after++;
+
+        typos[ idx ] = next;
+        memcpy( next, name, half );
+        memcpy( next + half, name + after, length - after );
+        next += half + length - after + 1;
+    }
+
+    NameIndex_t* names = TreeNameIndex( tree );
+
+    BenchSuggest( run, names, prefixes, count, 0, "complete" );
+    BenchSuggest( run, names, typos,    count, 1, "fuzzy_1" );
+    BenchSuggest( run, names, typos,    count, 2, "fuzzy_2" );
+
+    free( typos );
+    free( prefixes );
+    free( texts );
+}
+
+// Parent links only, one level at a time: what the jump pointers are checked against
+static const Node_t* ClimbToCommonAncestor( const Node_t* first, const Node_t* second ) {
+    while ( first->depth > second->depth ) first  = first->parent;
+    while ( second->depth > first->depth ) second = second->parent;
+
+    while ( first != second ) {
+        first  = first->parent;
+        second = second->parent;
+    }
+
+    return first;
+}
+
+// The fork of two objects alone, checked against climbing the parent links first. Climbing
+// costs the depth, so on deep bases only as many pairs are checked as the path budget allows.
+static void BenchCommonAncestor( BenchRun_t* run, const Node_t** sample, size_t count ) {
+    size_t max_depth = 0;
+    for ( size_t idx = 0; idx < count; idx++ )
+        max_depth = ( sample[ idx ]->depth > max_depth ) ? sample[ idx ]->depth : max_depth;
+
+    size_t checked = BENCH_PATH_BUDGET / ( max_depth + 1 );
+    if ( checked > count )
+        checked = count;
+
+    size_t wrong = 0;
+
+    for ( size_t idx = 0; idx < checked; idx++ ) {
+        const Node_t* first  = sample[ idx ];
+        const Node_t* second = sample[ ( idx + 1 ) % count ];
+
+        wrong += ( NodeCommonAncestor( first, second ) != ClimbToCommonAncestor( first, second ) );
+    }
+
+    if ( wrong != 0 )
+        fprintf( stderr, COLOR_BRIGHT_RED "Неверных общих предков: %zu из %zu\n" COLOR_RESET, wrong, checked );
+
+    size_t depths = 0;
+
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+
+        for ( size_t idx = 0; idx < count; idx++ )
+            depths += NodeCommonAncestor( sample[ idx ], sample[ ( idx + 1 ) % count ] )->depth;
+
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    // Keeps the loop from being optimized away
+    if ( depths == SIZE_MAX )
+        fprintf( stderr, "Предки слишком глубоки\n" );
+
+    Report( run, "common_ancestor", count );
+}
+
+// What comparing two objects in the game costs: their fork and the three paths around it
+static void BenchCompare( BenchRun_t* run, const Tree_t* tree, const Node_t** sample, size_t count ) {
+    TreeStats_t stats = {};
+    TreeCollectStats( tree, &stats );
+
+    size_t budget = BENCH_PATH_BUDGET / ( stats.max_depth + 1 );
+    if ( count > budget )
+        count = budget ? budget : 1;
+
+    const Node_t** path = ( const Node_t** ) calloc ( stats.max_depth + 1, sizeof( *path ) );
+    assert( path && "Memory allocation error" );
+
+    size_t steps = 0;
+
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+
+        for ( size_t idx = 0; idx < count; idx++ ) {
+            const Node_t* first  = sample[ idx ];
+            const Node_t* second = sample[ ( idx + 1 ) % count ];
+            const Node_t* fork   = NodeCommonAncestor( first, second );
+
+            steps += NodePathFrom( tree->root, fork, path );
+            steps += NodePathFrom( fork, first, path );
+            steps += NodePathFrom( fork, second, path );
+        }
+
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    free( path );
+
+    // Keeps the paths from being optimized away
+    if ( steps == 0 )
+        fprintf( stderr, "Пути пусты\n" );
+
+    Report( run, "compare", count );
+}
+
+static void BenchDot( BenchRun_t* run, const Tree_t* tree ) {
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double start = MonotonicSeconds();
+        NodeDotWrite( tree->root, "/dev/null" );
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+    }
+
+    Report( run, "dot", run->nodes );
+}
+
+// A fresh tree every repeat, its loading not timed
+static TreeStatus_t BenchDelete( BenchRun_t* run ) {
+    for ( size_t repeat = 0; repeat < run->repeats; repeat++ ) {
+        double  loading = 0;
+        Tree_t* tree    = LoadBase( run, LOAD_MMAP, &loading );
+        if ( !tree )
+            return FAIL;
+
+        double start = MonotonicSeconds();
+        NodeDelete( tree->root, tree );
+        run->seconds[ repeat ] = MonotonicSeconds() - start;
+
+        tree->root = NULL;
+        TreeDtor( &tree );
+    }
+
+    Report( run, "node_delete", run->nodes );
+
+    return SUCCESS;
+}
+
+static TreeStatus_t RunBench( BenchRun_t* run ) {
+    if ( BenchLoad( run, LOAD_MMAP, "read_mmap" ) != SUCCESS ) return FAIL;
+    if ( BenchLoad( run, LOAD_READ, "read" )      != SUCCESS ) return FAIL;
+
+    double  loading = 0;
+    Tree_t* tree    = LoadBase( run, LOAD_MMAP, &loading );
+    if ( !tree )
+        return FAIL;
+
+    TreeStatus_t status = BenchSave( run, tree );
+
+    if ( status == SUCCESS ) {
+        const Node_t** sample = SampleObjects( tree, BENCH_QUERIES );
+
+        BenchIndex( run, tree );
+        BenchSearch( run, TreeObjectIndex( tree ), sample, BENCH_QUERIES );
+        BenchNames( run, tree, sample, BENCH_QUERIES );
+        BenchCommonAncestor( run, sample, BENCH_QUERIES );
+        BenchCompare( run, tree, sample, BENCH_QUERIES );
+
+        free( sample );
+
+        BenchDot( run, tree );
+    }
+
+    TreeDtor( &tree );
+
+    if ( status == SUCCESS )
+        status = BenchDelete( run );
+
+    return status;
+}
+
+int AkinatorBench( const char* base_path, const char* results_path, size_t repeats ) {
+    my_assert( base_path && results_path, "Null pointer on path" );
+
+    BenchRun_t run = {};
+    run.base_path = base_path;
+    run.bytes     = DetermineTheFileSize( base_path );
+    run.repeats   = repeats ? repeats : BENCH_DEFAULT_REPEATS;
+
+    if ( run.bytes < 0 ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось открыть базу \"%s\"\n" COLOR_RESET, base_path );
+        return 1;
+    }
+
+    // Appended: one file collects the runs of many commits
+    if ( strcmp( results_path, "-" ) == 0 ) {
+        run.results = stdout;
+    }
+    else {
+        run.results = fopen( results_path, "a" );
+        run.table   = true;
+
+        if ( !run.results ) {
+            fprintf( stderr, COLOR_BRIGHT_RED "Не удалось открыть \"%s\": %s\n" COLOR_RESET, results_path, strerror( errno ) );
+            return 1;
+        }
+    }
+
+    run.seconds = ( double* ) calloc ( run.repeats, sizeof( double ) );
+    assert( run.seconds && "Memory allocation error" );
+
+    AppendText( &( run.identity ), "\"revision\":" );
+    AppendJsonString( &( run.identity ), AKINATOR_REVISION );
+    AppendText( &( run.identity ), ",\"base\":" );
+    AppendJsonString( &( run.identity ), base_path );
+
+    if ( run.table )
+        fprintf( stdout, "База \"%s\": %lld байт, версия %s\n", base_path, ( long long ) run.bytes, AKINATOR_REVISION );
+
+    TreeStatus_t status = RunBench( &run );
+
+    free( run.seconds );
+    free( run.identity.data );
+
+    if ( run.results != stdout && fclose( run.results ) != 0 )
+        status = FAIL;
+
+    return status == SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "AkinatorServer.h"
+#include "Colors.h"
+#include "DebugUtils.h"
+#include "Metrics.h"
+#include "UtilsRW.h"
+
+const size_t LOAD_TEST_INITIAL_LATENCIES = 1024;
+
+// A session ends after this many lines at the latest, whatever the server sends
+const size_t LOAD_TEST_MAX_LINES = 4096;
+
+struct LoadJob_t {
+    struct sockaddr_storage address;
+    size_t                  address_length;
+
+    size_t              sessions;
+    std::atomic<size_t> next_session;
+};
+
+struct LoadWorker_t {
+    LoadJob_t* job;
+    unsigned   seed;
+
+    char   buffer[ SERVER_MAX_LINE ];
+    size_t buffer_size;
+    size_t buffer_start;
+
+    double* latencies;          // seconds from an answer to the server's next line
+    size_t  latency_count;
+    size_t  latency_capacity;
+
+    size_t sessions;
+    size_t answers;
+    size_t failed;
+};
+
+static void AddLatency( LoadWorker_t* worker, double latency ) {
+    if ( worker->latency_count == worker->latency_capacity ) {
+        worker->latency_capacity = worker->latency_capacity ? 2 * worker->latency_capacity : LOAD_TEST_INITIAL_LATENCIES;
+        worker->latencies = ( double* ) realloc ( worker->latencies, worker->latency_capacity * sizeof( double ) );
+        assert( worker->latencies && "Memory allocation error" );
+    }
+
+    worker->latencies[ worker->latency_count++ ] = latency;
+}
+
+// The next line without its '\n', NULL on a closed connection or a line that does not fit
+static char* ReadLine( LoadWorker_t* worker, int fd ) {
+    while ( true ) {
+        char* line = worker->buffer + worker->buffer_start;
+        char* end  = ( char* ) memchr( line, '\n', worker->buffer_size - worker->buffer_start );
+
+        if ( end ) {
+            *end = '\0';
+            worker->buffer_start = ( size_t ) ( end - worker->buffer ) + 1;
+            return line;
+        }
+
+        memmove( worker->buffer, line, worker->buffer_size - worker->buffer_start );
+        worker->buffer_size -= worker->buffer_start;
+        worker->buffer_start = 0;
+
+        if ( worker->buffer_size == sizeof( worker->buffer ) )
+            return NULL;
+
+        ssize_t received = recv( fd, worker->buffer + worker->buffer_size, sizeof( worker->buffer ) - worker->buffer_size, 0 );
+        if ( received == -1 && errno == EINTR )
+            continue;
+        if ( received <= 0 )
+            return NULL;
+
+        worker->buffer_size += ( size_t ) received;
+    }
+}
+
+static bool SendText( int fd, const char* text ) {
+    return WriteAll( fd, text, strlen( text ) ) != -1;
+}
+
+static bool StartsWith( const char* line, const char* keyword ) {
+    return strncmp( line, keyword, strlen( keyword ) ) == 0;
+}
+
+// A player who mostly answers firmly, says "don't know" and "probably" now and then, and
+// confirms one guess in four
+static const char* PickAnswer( LoadWorker_t* worker, bool guess ) {
+    int roll = rand_r( &( worker->seed ) ) % 20;
+
+    if ( guess )
+        return ( roll < 5 ) ? "Y\n" : "N\n";
+
+    switch ( roll ) {
+        case 0:  return "?\n";
+        case 1:  return "Y?\n";
+        case 2:  return "N?\n";
+        default: return ( roll % 2 ) ? "Y\n" : "N\n";
+    }
+}
+
+// Connects, plays one round and quits; returns false on anything but the expected replies
+static bool PlaySession( LoadWorker_t* worker ) {
+    LoadJob_t* job = worker->job;
+
+    int fd = socket( job->address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    if ( fd == -1 )
+        return false;
+
+    if ( connect( fd, ( const struct sockaddr* ) &( job->address ), ( socklen_t ) job->address_length ) == -1 ) {
+        close( fd );
+        return false;
+    }
+
+    if ( job->address.ss_family == AF_INET ) {
+        int enable = 1;
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof( enable ) );
+    }
+
+    worker->buffer_size  = 0;
+    worker->buffer_start = 0;
+
+    char* line = ReadLine( worker, fd );
+    bool  fine = line && strcmp( line, "READY" ) == 0 && SendText( fd, "PLAY\n" );
+
+    double asked = 0;       // when the last answer went out, 0 if the line read is no reply to one
+
+    for ( size_t lines = 0; fine && lines < LOAD_TEST_MAX_LINES; lines++ ) {
+        line = ReadLine( worker, fd );
+        if ( !line ) {
+            fine = false;
+            break;
+        }
+
+        if ( asked > 0 ) {
+            AddLatency( worker, MonotonicSeconds() - asked );
+            asked = 0;
+        }
+
+        const char* reply = NULL;
+
+        if      ( StartsWith( line, "QUESTION\t" ) ) reply = PickAnswer( worker, false );
+        else if ( StartsWith( line, "GUESS\t" ) )    reply = PickAnswer( worker, true );
+        else if ( StartsWith( line, "TEACH\t" ) )    reply = "SKIP\n";
+        else if ( strcmp( line, "READY" ) == 0 )     break;
+        else if ( strcmp( line, "WON" ) != 0 && !StartsWith( line, "LOST\t" ) ) {
+            fine = false;
+            break;
+        }
+
+        if ( !reply )
+            continue;
+
+        asked = MonotonicSeconds();
+        fine  = SendText( fd, reply );
+        worker->answers++;
+    }
+
+    fine = fine && SendText( fd, "QUIT\n" ) && ( line = ReadLine( worker, fd ) ) && strcmp( line, "BYE" ) == 0;
+
+    close( fd );
+
+    return fine;
+}
+
+static void* RunLoadWorker( void* argument ) {
+    LoadWorker_t* worker = ( LoadWorker_t* ) argument;
+    LoadJob_t*    job    = worker->job;
+
+    while ( job->next_session.fetch_add( 1, std::memory_order_relaxed ) < job->sessions ) {
+        if ( PlaySession( worker ) )
+            worker->sessions++;
+        else
+            worker->failed++;
+    }
+
+    return NULL;
+}
+
+static int CompareLatencies( const void* first, const void* second ) {
+    double first_latency  = *( const double* ) first;
+    double second_latency = *( const double* ) second;
+
+    return ( first_latency > second_latency ) - ( first_latency < second_latency );
+}
+
+static double Percentile( const double* sorted, size_t count, size_t per_mille ) {
+    if ( count == 0 )
+        return 0;
+
+    size_t idx = count * per_mille / 1000;
+
+    return sorted[ ( idx < count ) ? idx : count - 1 ];
+}
+
+int AkinatorLoadTest( const char* address, size_t sessions, size_t connections ) {
+    my_assert( address, "Null pointer on `address`" );
+
+    LoadJob_t job = {};
+    job.address_length = ServerParseAddress( address, &( job.address ) );
+    job.sessions       = sessions;
+
+    if ( job.address_length == 0 ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Неверный адрес \"%s\": нужен порт или путь к сокету\n" COLOR_RESET, address );
+        return 1;
+    }
+
+    if ( connections > LOAD_TEST_MAX_CONNECTIONS ) connections = LOAD_TEST_MAX_CONNECTIONS;
+    if ( connections > sessions )                  connections = sessions;
+    if ( connections == 0 )                        connections = 1;
+
+    LoadWorker_t* workers = ( LoadWorker_t* ) calloc ( connections, sizeof( *workers ) );
+    assert( workers && "Memory allocation error" );
+
+    pthread_t* handles = ( pthread_t* ) calloc ( connections, sizeof( *handles ) );
+    assert( handles && "Memory allocation error" );
+
+    double start = MonotonicSeconds();
+
+    // The calling thread plays too, as in the batch mode
+    size_t started = 1;
+    for ( size_t idx = 0; idx < connections; idx++ ) {
+        workers[ idx ].job  = &job;
+        workers[ idx ].seed = ( unsigned ) idx + 1;
+
+        if ( idx > 0 && pthread_create( &( handles[ started ] ), NULL, RunLoadWorker, &( workers[ idx ] ) ) == 0 )
+            started++;
+    }
+
+    RunLoadWorker( &( workers[ 0 ] ) );
+
+    for ( size_t idx = 1; idx < started; idx++ )
+        pthread_join( handles[ idx ], NULL );
+
+    double elapsed = MonotonicSeconds() - start;
+
+    size_t played = 0, answers = 0, failed = 0, latency_count = 0;
+    for ( size_t idx = 0; idx < connections; idx++ ) {
+        played        += workers[ idx ].sessions;
+        answers       += workers[ idx ].answers;
+        failed        += workers[ idx ].failed;
+        latency_count += workers[ idx ].latency_count;
+    }
+
+    double* latencies = ( double* ) calloc ( latency_count + 1, sizeof( double ) );
+    assert( latencies && "Memory allocation error" );
+
+    size_t filled = 0;
+    for ( size_t idx = 0; idx < connections; idx++ ) {
+        if ( workers[ idx ].latency_count > 0 )
+            memcpy( latencies + filled, workers[ idx ].latencies, workers[ idx ].latency_count * sizeof( double ) );
+
+        filled += workers[ idx ].latency_count;
+        free( workers[ idx ].latencies );
+    }
+
+    qsort( latencies, latency_count, sizeof( double ), CompareLatencies );
+
+    fprintf( stdout, "Сессий: %zu, с ошибкой: %zu, соединений: %zu, %.3f с (%.0f сессий/с)\n",
+             played, failed, started, elapsed, elapsed > 0 ? ( double ) played / elapsed : 0.0 );
+    fprintf( stdout, "Ответов: %zu (%.0f в секунду), задержка ответа: p50 %.1f мкс, p99 %.1f мкс, p99.9 %.1f мкс, max %.1f мкс\n",
+             answers, elapsed > 0 ? ( double ) answers / elapsed : 0.0,
+             Percentile( latencies, latency_count, 500 ) * 1e6, Percentile( latencies, latency_count, 990 ) * 1e6,
+             Percentile( latencies, latency_count, 999 ) * 1e6, latency_count ? latencies[ latency_count - 1 ] * 1e6 : 0.0 );
+
+    free( latencies );
+    free( handles );
+    free( workers );
+
+    return failed == 0 ? 0 : 1;
+}
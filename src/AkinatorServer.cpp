@@ -0,0 +1,804 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <ctype.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Akinator.h"
+#include "AkinatorServer.h"
+#include "Colors.h"
+#include "DebugUtils.h"
+#include "Tree.h"
+#include "TreeBeam.h"
+#include "TreeTelemetry.h"
+#include "UtilsRW.h"
+
+const size_t SERVER_MAX_FIELDS = 4;
+
+// Unsent output past this stops reading the session until the client catches up
+const size_t SERVER_OUTPUT_LIMIT = 64 * 1024;
+
+// The game reads names and questions with "%127[^\n]"
+const size_t SERVER_MAX_VALUE = 127;
+
+enum SessionState_t {
+    SESSION_MENU     = 0,
+    SESSION_QUESTION = 1,
+    SESSION_GUESS    = 2,
+    SESSION_TEACH    = 3,
+    SESSION_CLOSING  = 4       // BYE is queued, the session closes once it is sent
+};
+
+struct Session_t {
+    int            fd;
+    SessionState_t state;
+    uint32_t       events;          // registered with epoll
+
+    char   input[ SERVER_MAX_LINE ];
+    size_t input_size;
+
+    OutputBuffer_t output;
+    size_t         sent;            // bytes of `output` sent so far
+
+    // The round in progress, as in PlayRound
+    Beam_t   beam;
+    bool     in_round;
+    size_t   guesses;
+    uint32_t question;              // slot of the question asked
+    size_t   guess;                 // beam entry of the object guessed
+    Node_t*  guessed;
+    Node_t*  missed_leaf;
+    bool     missed_certain;
+};
+
+struct Server_t {
+    Akinator_t* akinator;
+
+    int epoll_fd;
+    int listen_fd;
+    int signal_fd;
+
+    Session_t** sessions;           // by descriptor
+    size_t      session_capacity;
+    size_t      session_count;
+
+    size_t rounds_open;             // rounds whose beams hold compact slots
+
+    const Node_t** path;            // scratch for root-to-node paths
+    size_t         path_capacity;
+
+    size_t sessions_served;
+    size_t rounds_played;
+};
+
+size_t ServerParseAddress( const char* address, struct sockaddr_storage* socket_address ) {
+    my_assert( address && socket_address, "Null pointer on argument" );
+
+    memset( socket_address, 0, sizeof( *socket_address ) );
+
+    size_t length = strlen( address );
+    if ( length == 0 )
+        return 0;
+
+    if ( strspn( address, "0123456789" ) == length ) {
+        unsigned long port = strtoul( address, NULL, 10 );
+        if ( length > 5 || port == 0 || port > 65535 )
+            return 0;
+
+        struct sockaddr_in* inet = ( struct sockaddr_in* ) socket_address;
+        inet->sin_family      = AF_INET;
+        inet->sin_port        = htons( ( uint16_t ) port );
+        inet->sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+        return sizeof( *inet );
+    }
+
+    struct sockaddr_un* local = ( struct sockaddr_un* ) socket_address;
+    if ( length >= sizeof( local->sun_path ) )
+        return 0;
+
+    local->sun_family = AF_UNIX;
+    memcpy( local->sun_path, address, length + 1 );
+
+    return sizeof( *local );
+}
+
+// "KEYWORD\ttext\n", or "KEYWORD\n" without the text
+static void SendLine( Session_t* session, const char* keyword, const char* text ) {
+    AppendText( &( session->output ), keyword );
+
+    if ( text ) {
+        AppendBytes( &( session->output ), "\t", 1 );
+        AppendText( &( session->output ), text );
+    }
+
+    AppendBytes( &( session->output ), "\n", 1 );
+}
+
+static void SendReady( Session_t* session ) {
+    session->state = SESSION_MENU;
+    SendLine( session, "READY", NULL );
+}
+
+// Tab, then "+question" or "-question" for every edge of `path`
+static void AppendTraits( OutputBuffer_t* output, const Node_t** path, size_t length ) {
+    for ( size_t idx = 1; idx < length; idx++ ) {
+        const Node_t* parent = path[ idx - 1 ];
+
+        AppendText( output, ( parent->left == path[ idx ] ) ? "\t+" : "\t-" );
+        AppendText( output, parent->value );
+    }
+}
+
+static void ReservePath( Server_t* server, size_t depth ) {
+    if ( depth + 1 <= server->path_capacity )
+        return;
+
+    server->path_capacity = 2 * ( depth + 1 );
+    server->path = ( const Node_t** ) realloc ( server->path, server->path_capacity * sizeof( *( server->path ) ) );
+    assert( server->path && "Memory allocation error" );
+}
+
+// Relayout renumbers every slot, so it waits until no round holds slots in its beam;
+// until then appended slots only make descents a little longer
+static const CompactTree_t* RoundCompactTree( Server_t* server ) {
+    Tree_t* tree = server->akinator->tree;
+
+    if ( server->rounds_open > 0 && tree->compact.built )
+        return &( tree->compact );
+
+    return TreeCompactTree( tree );
+}
+
+static void EndRound( Server_t* server, Session_t* session ) {
+    if ( !session->in_round )
+        return;
+
+    BeamDtor( &( session->beam ) );
+
+    session->in_round = false;
+    server->rounds_open--;
+}
+
+// Next question or guess of the round, as in PlayRound; ends the round when there is neither
+static void ContinueRound( Server_t* server, Session_t* session ) {
+    Beam_t* beam = &( session->beam );
+
+    if ( session->guesses < BEAM_MAX_GUESSES && beam->size > 0 ) {
+        if ( BeamNextQuestion( beam, &( session->question ) ) ) {
+            session->state = SESSION_QUESTION;
+            SendLine( session, "QUESTION", CompactTreeValue( beam->compact, session->question ) );
+            return;
+        }
+
+        size_t guess = BeamBestGuess( beam );
+        if ( guess < beam->size ) {
+            session->guess   = guess;
+            session->guessed = beam->compact->origin[ beam->entries[ guess ].slot ];
+            NodeCountVisit( session->guessed );
+
+            session->state = SESSION_GUESS;
+            SendLine( session, "GUESS", session->guessed->value );
+            return;
+        }
+    }
+
+    EndRound( server, session );
+
+    if ( !session->missed_leaf ) {
+        SendLine( session, "LOST", "no object fits the answers" );
+        SendReady( session );
+    }
+    else if ( !session->missed_certain ) {
+        // After "don't know" the path to the leaf is a guess, see PlayRound
+        SendLine( session, "LOST", "the answers were not certain, nothing to learn" );
+        SendReady( session );
+    }
+    else {
+        session->state = SESSION_TEACH;
+        SendLine( session, "TEACH", session->missed_leaf->value );
+    }
+}
+
+static void StartRound( Server_t* server, Session_t* session ) {
+    const CompactTree_t* compact = RoundCompactTree( server );
+
+    if ( compact->count == 0 ) {
+        SendLine( session, "ERROR", "empty base" );
+        return;
+    }
+
+    BeamCtor( &( session->beam ), compact );
+
+    session->in_round       = true;
+    session->guesses        = 0;
+    session->guessed        = NULL;
+    session->missed_leaf    = NULL;
+    session->missed_certain = false;
+
+    server->rounds_open++;
+    server->rounds_played++;
+
+    ContinueRound( server, session );
+}
+
+static void Define( Server_t* server, Session_t* session, const char* name ) {
+    Tree_t*       tree = server->akinator->tree;
+    const Node_t* node = ObjectIndexFind( TreeObjectIndex( tree ), name );
+
+    if ( !node ) {
+        SendLine( session, "ERROR", "unknown object" );
+        return;
+    }
+
+    ReservePath( server, node->depth );
+
+    AppendText( &( session->output ), "TRAITS\t" );
+    AppendText( &( session->output ), node->value );
+    AppendTraits( &( session->output ), server->path, NodePathFrom( tree->root, node, server->path ) );
+    AppendText( &( session->output ), "\n" );
+
+    SendReady( session );
+}
+
+static void Compare( Server_t* server, Session_t* session, const char* first_name, const char* second_name ) {
+    Tree_t*       tree   = server->akinator->tree;
+    const Node_t* first  = ObjectIndexFind( TreeObjectIndex( tree ), first_name );
+    const Node_t* second = ObjectIndexFind( TreeObjectIndex( tree ), second_name );
+
+    if ( !first || !second ) {
+        SendLine( session, "ERROR", "unknown object" );
+        return;
+    }
+
+    const Node_t* fork = NodeCommonAncestor( first, second );
+
+    ReservePath( server, ( first->depth > second->depth ) ? first->depth : second->depth );
+
+    OutputBuffer_t* output = &( session->output );
+
+    AppendText( output, "COMMON" );
+    AppendTraits( output, server->path, NodePathFrom( tree->root, fork, server->path ) );
+
+    AppendText( output, "\nFIRST\t" );
+    AppendText( output, first->value );
+    AppendTraits( output, server->path, NodePathFrom( fork, first, server->path ) );
+
+    AppendText( output, "\nSECOND\t" );
+    AppendText( output, second->value );
+    AppendTraits( output, server->path, NodePathFrom( fork, second, server->path ) );
+
+    AppendText( output, "\n" );
+
+    SendReady( session );
+}
+
+static void Teach( Server_t* server, Session_t* session, char** fields, size_t count ) {
+    bool valid = count == 4 &&
+                 fields[1][0] != '\0' && strlen( fields[1] ) <= SERVER_MAX_VALUE &&
+                 fields[2][0] != '\0' && strlen( fields[2] ) <= SERVER_MAX_VALUE &&
+                 ( strcmp( fields[3], "Y" ) == 0 || strcmp( fields[3], "N" ) == 0 );
+
+    if ( !valid ) {
+        SendLine( session, "ERROR", "expected: TEACH <TAB> object <TAB> question <TAB> Y|N, or SKIP" );
+        return;
+    }
+
+    Akinator_t* akinator = server->akinator;
+
+    // Another session may have taught it meanwhile
+    if ( ObjectIndexFind( TreeObjectIndex( akinator->tree ), fields[1] ) ) {
+        SendLine( session, "ERROR", "the object is already known" );
+        return;
+    }
+
+    Node_t* leaf     = session->missed_leaf;
+    Node_t* question = AkinatorAddObject( akinator, leaf, fields[2], fields[1], fields[3][0] == 'Y' );
+    Node_t* copy     = ( fields[3][0] == 'Y' ) ? question->right : question->left;
+
+    // The split leaf keeps its slot for the new question, and other rounds may have it as a
+    // candidate; the leaf itself is retired, so sessions holding it move to its copy
+    for ( size_t fd = 0; fd < server->session_capacity; fd++ ) {
+        Session_t* other = server->sessions[ fd ];
+        if ( !other )
+            continue;
+
+        if ( other->in_round )
+            BeamRefresh( &( other->beam ) );
+
+        if ( other->guessed == leaf )
+            other->guessed = copy;
+        if ( other->missed_leaf == leaf )
+            other->missed_leaf = copy;
+    }
+
+    // A long-running server grows the journal without restarts to fold it in
+    if ( TreeJournalNeedsCompaction( &( akinator->journal ) ) )
+        AkinatorSaveBase( akinator );
+
+    SendLine( session, "LEARNED", NULL );
+    SendReady( session );
+}
+
+// Y, N, Y?, N? or ? as the share of the "yes" branch; -1 for anything else
+static double ParseAnswer( const char* answer ) {
+    char first  = ( char ) toupper( answer[0] );
+    bool unsure = ( answer[1] == '?' );
+
+    if ( first == '?' && answer[1] == '\0' )
+        return BEAM_DONT_KNOW;
+
+    if ( ( first == 'Y' || first == 'N' ) && ( answer[1] == '\0' || ( unsure && answer[2] == '\0' ) ) ) {
+        if ( first == 'Y' )
+            return unsure ? BEAM_PROBABLY : BEAM_YES;
+        else
+            return unsure ? BEAM_PROBABLY_NOT : BEAM_NO;
+    }
+
+    return -1;
+}
+
+static void HandleMenu( Server_t* server, Session_t* session, char* line ) {
+    char*  fields[ SERVER_MAX_FIELDS ] = {};
+    size_t count = SplitFields( line, fields, SERVER_MAX_FIELDS );
+
+    if ( strcmp( fields[0], "PLAY" ) == 0 && count == 1 ) {
+        StartRound( server, session );
+    }
+    else if ( strcmp( fields[0], "DEFINE" ) == 0 && count == 2 ) {
+        Define( server, session, fields[1] );
+    }
+    else if ( strcmp( fields[0], "COMPARE" ) == 0 && count == 3 ) {
+        Compare( server, session, fields[1], fields[2] );
+    }
+    else if ( strcmp( fields[0], "QUIT" ) == 0 && count == 1 ) {
+        session->state = SESSION_CLOSING;
+        SendLine( session, "BYE", NULL );
+    }
+    else {
+        SendLine( session, "ERROR", "expected: PLAY, DEFINE <TAB> object, COMPARE <TAB> object <TAB> object or QUIT" );
+    }
+}
+
+static void HandleLine( Server_t* server, Session_t* session, char* line ) {
+    switch ( session->state ) {
+        case SESSION_MENU:
+            HandleMenu( server, session, line );
+            break;
+
+        case SESSION_QUESTION: {
+            double share = ParseAnswer( line );
+            if ( share < 0 ) {
+                SendLine( session, "ERROR", "expected Y, N, Y?, N? or ?" );
+                break;
+            }
+
+            BeamAnswer( &( session->beam ), session->question, share );
+            ContinueRound( server, session );
+            break;
+        }
+
+        case SESSION_GUESS: {
+            bool yes = ( toupper( line[0] ) == 'Y' );
+            if ( ( !yes && toupper( line[0] ) != 'N' ) || line[1] != '\0' ) {
+                SendLine( session, "ERROR", "expected Y or N" );
+                break;
+            }
+
+            NodeCountGuess( session->guessed, yes );
+
+            if ( yes ) {
+                EndRound( server, session );
+                SendLine( session, "WON", NULL );
+                SendReady( session );
+                break;
+            }
+
+            session->missed_leaf    = session->guessed;
+            session->missed_certain = session->beam.entries[ session->guess ].certain;
+            session->guesses++;
+
+            BeamDrop( &( session->beam ), session->guess );
+            ContinueRound( server, session );
+            break;
+        }
+
+        case SESSION_TEACH: {
+            if ( strcmp( line, "SKIP" ) == 0 ) {
+                SendReady( session );
+                break;
+            }
+
+            char*  fields[ SERVER_MAX_FIELDS ] = {};
+            size_t count = SplitFields( line, fields, SERVER_MAX_FIELDS );
+
+            if ( strcmp( fields[0], "TEACH" ) == 0 ) {
+                Teach( server, session, fields, count );
+            }
+            else {
+                SendLine( session, "ERROR", "expected: TEACH <TAB> object <TAB> question <TAB> Y|N, or SKIP" );
+            }
+            break;
+        }
+
+        case SESSION_CLOSING:
+            break;
+
+        default:
+            assert( 0 && "Unknown session state" );
+    }
+}
+
+static void CloseSession( Server_t* server, Session_t* session ) {
+    EndRound( server, session );
+
+    epoll_ctl( server->epoll_fd, EPOLL_CTL_DEL, session->fd, NULL );
+    close( session->fd );
+
+    server->sessions[ session->fd ] = NULL;
+    server->session_count--;
+
+    free( session->output.data );
+    free( session );
+}
+
+static size_t PendingOutput( const Session_t* session ) {
+    return session->output.size - session->sent;
+}
+
+// Runs every complete line in the input, as long as the client reads the answers
+static void HandleInput( Server_t* server, Session_t* session ) {
+    size_t start = 0;
+
+    while ( PendingOutput( session ) < SERVER_OUTPUT_LIMIT ) {
+        char* line = session->input + start;
+        char* end  = ( char* ) memchr( line, '\n', session->input_size - start );
+        if ( !end )
+            break;
+
+        *end = '\0';
+        if ( end > line && end[ -1 ] == '\r' )
+            end[ -1 ] = '\0';
+
+        start = ( size_t ) ( end - session->input ) + 1;
+
+        HandleLine( server, session, line );
+    }
+
+    session->input_size -= start;
+    memmove( session->input, session->input + start, session->input_size );
+}
+
+// Returns false once the session is to be closed
+static bool ReadInput( Server_t* server, Session_t* session ) {
+    if ( session->input_size < SERVER_MAX_LINE ) {
+        ssize_t received = recv( session->fd, session->input + session->input_size,
+                                 SERVER_MAX_LINE - session->input_size, 0 );
+
+        if ( received == 0 )
+            return false;
+
+        if ( received == -1 )
+            return errno == EAGAIN || errno == EINTR;
+
+        session->input_size += ( size_t ) received;
+    }
+
+    HandleInput( server, session );
+
+    // A full buffer without an end of line will never make a line
+    return session->input_size < SERVER_MAX_LINE || memchr( session->input, '\n', session->input_size );
+}
+
+// Returns false once the session is to be closed
+static bool WriteOutput( Session_t* session ) {
+    OutputBuffer_t* output = &( session->output );
+
+    while ( session->sent < output->size ) {
+        ssize_t sent = send( session->fd, output->data + session->sent, output->size - session->sent, MSG_NOSIGNAL );
+
+        if ( sent == -1 ) {
+            if ( errno == EINTR )
+                continue;
+
+            return errno == EAGAIN;
+        }
+
+        session->sent += ( size_t ) sent;
+    }
+
+    output->size  = 0;
+    session->sent = 0;
+
+    return session->state != SESSION_CLOSING;
+}
+
+// Reading stops while the client does not take its answers, writing is watched only while
+// there is something left to send
+static bool UpdateEvents( Server_t* server, Session_t* session ) {
+    uint32_t events = 0;
+
+    if ( PendingOutput( session ) < SERVER_OUTPUT_LIMIT && session->state != SESSION_CLOSING )
+        events |= EPOLLIN;
+    if ( PendingOutput( session ) > 0 )
+        events |= EPOLLOUT;
+
+    if ( events == session->events )
+        return true;
+
+    struct epoll_event event = {};
+    event.events  = events;
+    event.data.fd = session->fd;
+
+    if ( epoll_ctl( server->epoll_fd, EPOLL_CTL_MOD, session->fd, &event ) == -1 )
+        return false;
+
+    session->events = events;
+    return true;
+}
+
+static void ServeSession( Server_t* server, Session_t* session, uint32_t events ) {
+    bool open = true;
+
+    if ( events & EPOLLIN )
+        open = ReadInput( server, session );
+
+    if ( open && ( events & EPOLLOUT ) && PendingOutput( session ) == 0 )
+        HandleInput( server, session );     // lines held back while the output was full
+
+    if ( open && ( events & ( EPOLLERR | EPOLLHUP ) ) && !( events & EPOLLIN ) )
+        open = false;
+
+    if ( open )
+        open = WriteOutput( session ) && UpdateEvents( server, session );
+
+    if ( !open )
+        CloseSession( server, session );
+}
+
+static void OpenSession( Server_t* server, int fd ) {
+    if ( ( size_t ) fd >= server->session_capacity ) {
+        size_t capacity = server->session_capacity ? server->session_capacity : 64;
+        while ( capacity <= ( size_t ) fd )
+            capacity *= 2;
+
+        server->sessions = ( Session_t** ) realloc ( server->sessions, capacity * sizeof( Session_t* ) );
+        assert( server->sessions && "Memory allocation error" );
+
+        memset( server->sessions + server->session_capacity, 0, ( capacity - server->session_capacity ) * sizeof( Session_t* ) );
+        server->session_capacity = capacity;
+    }
+
+    Session_t* session = ( Session_t* ) calloc ( 1, sizeof( *session ) );
+    assert( session && "Memory allocation error" );
+
+    session->fd     = fd;
+    session->events = EPOLLIN;
+
+    struct epoll_event event = {};
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
+
+    if ( epoll_ctl( server->epoll_fd, EPOLL_CTL_ADD, fd, &event ) == -1 ) {
+        fprintf( stderr, "Не удалось добавить соединение в epoll: %s\n", strerror( errno ) );
+        close( fd );
+        free( session );
+        return;
+    }
+
+    server->sessions[ fd ] = session;
+    server->session_count++;
+    server->sessions_served++;
+
+    SendReady( session );
+
+    if ( !WriteOutput( session ) || !UpdateEvents( server, session ) )
+        CloseSession( server, session );
+}
+
+static void AcceptSessions( Server_t* server ) {
+    while ( true ) {
+        int fd = accept4( server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+
+        if ( fd == -1 ) {
+            if ( errno == EINTR || errno == ECONNABORTED )
+                continue;
+
+            if ( errno != EAGAIN )
+                fprintf( stderr, "Не удалось принять соединение: %s\n", strerror( errno ) );
+            return;
+        }
+
+        // Answers are single short lines, each waited for
+        int enable = 1;
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof( enable ) );
+
+        OpenSession( server, fd );
+    }
+}
+
+// A socket left by a server that did not exit cleanly refuses connections and is removed.
+// One a server still listens on, and anything that is not a socket, stay: the bind fails.
+static bool RemoveStaleSocket( const char* path, const struct sockaddr_storage* socket_address, size_t length ) {
+    struct stat path_stat = {};
+    if ( stat( path, &path_stat ) != 0 || !S_ISSOCK( path_stat.st_mode ) )
+        return true;
+
+    // Non-blocking: a live server with a full backlog answers EAGAIN instead of stalling us
+    int probe = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( probe == -1 ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось создать сокет: %s\n" COLOR_RESET, strerror( errno ) );
+        return false;
+    }
+
+    int result = connect( probe, ( const struct sockaddr* ) socket_address, ( socklen_t ) length );
+    int error  = errno;
+    close( probe );
+
+    if ( result == 0 ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "На %s уже работает сервер\n" COLOR_RESET, path );
+        return false;
+    }
+
+    if ( error == ECONNREFUSED )
+        unlink( path );
+
+    return true;
+}
+
+static int OpenListener( const char* address ) {
+    struct sockaddr_storage socket_address = {};
+    size_t length = ServerParseAddress( address, &socket_address );
+
+    if ( length == 0 ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Неверный адрес \"%s\": нужен порт или путь к сокету\n" COLOR_RESET, address );
+        return -1;
+    }
+
+    int fd = socket( socket_address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( fd == -1 ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось создать сокет: %s\n" COLOR_RESET, strerror( errno ) );
+        return -1;
+    }
+
+    if ( socket_address.ss_family == AF_INET ) {
+        int enable = 1;
+        setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof( enable ) );
+    }
+    else if ( !RemoveStaleSocket( address, &socket_address, length ) ) {
+        close( fd );
+        return -1;
+    }
+
+    if ( bind( fd, ( const struct sockaddr* ) &socket_address, ( socklen_t ) length ) == -1 ||
+         listen( fd, SERVER_LISTEN_BACKLOG ) == -1 ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось открыть %s: %s\n" COLOR_RESET, address, strerror( errno ) );
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+// SIGINT and SIGTERM are read from a descriptor in the loop, so the base is saved between events
+static int OpenSignals() {
+    sigset_t signals = {};
+    sigemptyset( &signals );
+    sigaddset( &signals, SIGINT );
+    sigaddset( &signals, SIGTERM );
+
+    if ( sigprocmask( SIG_BLOCK, &signals, NULL ) == -1 )
+        return -1;
+
+    return signalfd( -1, &signals, SFD_NONBLOCK | SFD_CLOEXEC );
+}
+
+static bool AddToEpoll( int epoll_fd, int fd ) {
+    struct epoll_event event = {};
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
+
+    return epoll_ctl( epoll_fd, EPOLL_CTL_ADD, fd, &event ) == 0;
+}
+
+static void RunServer( Server_t* server ) {
+    struct epoll_event events[ SERVER_MAX_EVENTS ] = {};
+
+    while ( true ) {
+        int ready = epoll_wait( server->epoll_fd, events, SERVER_MAX_EVENTS, -1 );
+
+        if ( ready == -1 ) {
+            if ( errno == EINTR )
+                continue;
+
+            fprintf( stderr, "Ошибка epoll: %s\n", strerror( errno ) );
+            return;
+        }
+
+        for ( int idx = 0; idx < ready; idx++ ) {
+            int fd = events[ idx ].data.fd;
+
+            if ( fd == server->signal_fd )
+                return;
+
+            if ( fd == server->listen_fd ) {
+                AcceptSessions( server );
+                continue;
+            }
+
+            // Closed by an earlier event of this batch
+            if ( ( size_t ) fd >= server->session_capacity || !server->sessions[ fd ] )
+                continue;
+
+            ServeSession( server, server->sessions[ fd ], events[ idx ].events );
+        }
+    }
+}
+
+int AkinatorServe( const char* address ) {
+    my_assert( address, "Null pointer on `address`" );
+
+    Server_t server = {};
+    server.epoll_fd  = -1;
+    server.signal_fd = -1;
+
+    server.listen_fd = OpenListener( address );
+    if ( server.listen_fd == -1 )
+        return 1;
+
+    server.akinator = AkinatorCtor();
+    server.epoll_fd  = epoll_create1( EPOLL_CLOEXEC );
+    server.signal_fd = OpenSignals();
+
+    int status = 1;
+
+    if ( !server.akinator ) {
+        // AkinatorCtor has said why
+    }
+    else if ( server.epoll_fd == -1 || server.signal_fd == -1 ||
+              !AddToEpoll( server.epoll_fd, server.listen_fd ) || !AddToEpoll( server.epoll_fd, server.signal_fd ) ) {
+        fprintf( stderr, COLOR_BRIGHT_RED "Не удалось запустить сервер: %s\n" COLOR_RESET, strerror( errno ) );
+    }
+    else {
+        fprintf( stderr, "Сервер ждёт игроков на %s\n", address );
+
+        RunServer( &server );
+
+        for ( size_t fd = 0; fd < server.session_capacity; fd++ ) {
+            if ( server.sessions[ fd ] )
+                CloseSession( &server, server.sessions[ fd ] );
+        }
+
+        fprintf( stderr, "Сервер остановлен. Сессий: %zu, раундов: %zu\n", server.sessions_served, server.rounds_played );
+
+        status = ( AkinatorSaveBase( server.akinator ) == SUCCESS ) ? 0 : 1;
+    }
+
+    if ( server.akinator )
+        AkinatorDtor( &( server.akinator ) );
+
+    close( server.listen_fd );
+    if ( server.epoll_fd  != -1 ) close( server.epoll_fd );
+    if ( server.signal_fd != -1 ) close( server.signal_fd );
+
+    struct sockaddr_storage socket_address = {};
+    if ( ServerParseAddress( address, &socket_address ) != 0 && socket_address.ss_family == AF_UNIX )
+        unlink( address );
+
+    free( server.sessions );
+    free( server.path );
+
+    return status;
+}
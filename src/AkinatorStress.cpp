@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <atomic>
+
+#include "AkinatorBench.h"
+#include "Colors.h"
+#include "DebugUtils.h"
+#include "Metrics.h"
+#include "Tree.h"
+
+const size_t STRESS_MAX_VALUE = 64;
+
+static const char STRESS_OBJECT[] = "Объект №";
+
+struct StressJob_t {
+    Tree_t*           tree;
+    std::atomic<bool> done;
+};
+
+struct StressReader_t {
+    StressJob_t* job;
+    uint64_t     seed;
+
+    size_t descents;
+    size_t bad;
+};
+
+struct StressWalker_t {
+    StressJob_t* job;
+
+    size_t walks;
+    size_t bad;
+};
+
+static uint64_t NextRandom( uint64_t* state ) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+// A leaf as TreeSplitLeaf publishes it: both links empty, an object's value, its depth set
+static bool IsWholeLeaf( const Node_t* leaf, size_t depth ) {
+    return leaf->value && strncmp( leaf->value, STRESS_OBJECT, sizeof( STRESS_OBJECT ) - 1 ) == 0 &&
+           leaf->depth == depth;
+}
+
+// Random descents from the root, each in a section of its own, until the writer is done
+static void* RunReader( void* argument ) {
+    StressReader_t* reader = ( StressReader_t* ) argument;
+    const Tree_t*   tree   = reader->job->tree;
+    size_t          slot   = TreeRcuRegisterReader( &( tree->rcu ) );
+
+    while ( !reader->job->done.load( std::memory_order_acquire ) ) {
+        TreeRcuReadBegin( &( tree->rcu ), slot );
+
+        const Node_t* node  = TreeRoot( tree );
+        size_t        depth = 0;
+
+        while ( true ) {
+            const Node_t* left  = NodeLeft( node );
+            const Node_t* right = NodeRight( node );
+
+            if ( !left && !right )
+                break;
+
+            // Every question has both answers from the moment it is seen
+            if ( !left || !right ) {
+                reader->bad++;
+                break;
+            }
+
+            node = ( NextRandom( &( reader->seed ) ) & 1 ) ? left : right;
+            depth++;
+        }
+
+        if ( !IsWholeLeaf( node, depth ) )
+            reader->bad++;
+
+        TreeRcuReadEnd( &( tree->rcu ), slot );
+
+        reader->descents++;
+    }
+
+    TreeRcuUnregisterReader( &( tree->rcu ), slot );
+
+    return NULL;
+}
+
+static bool CountLeaf( const Node_t* leaf, void* argument ) {
+    std::atomic<size_t>* bad = ( std::atomic<size_t>* ) argument;
+
+    if ( !leaf->value || strncmp( leaf->value, STRESS_OBJECT, sizeof( STRESS_OBJECT ) - 1 ) != 0 )
+        bad->fetch_add( 1, std::memory_order_relaxed );
+
+    return false;
+}
+
+// Whole-tree walks on the task pool, the way statistics are gathered while games go on
+static void* RunWalker( void* argument ) {
+    StressWalker_t* walker = ( StressWalker_t* ) argument;
+
+    while ( !walker->job->done.load( std::memory_order_acquire ) ) {
+        std::atomic<size_t> bad( 0 );
+
+        TreeFindLeaf( walker->job->tree, CountLeaf, &bad );
+
+        walker->bad += bad.load( std::memory_order_relaxed );
+        walker->walks++;
+    }
+
+    return NULL;
+}
+
+int AkinatorRcuStress( size_t readers, size_t inserts ) {
+    my_assert( readers > 0 && readers <= STRESS_MAX_READERS, "Bad number of readers" );
+
+    Tree_t* tree = TreeCtor();
+
+    char question[ STRESS_MAX_VALUE ] = {};
+    char object[ STRESS_MAX_VALUE ]   = {};
+
+    snprintf( object, sizeof( object ), "%s0", STRESS_OBJECT );
+    tree->root = NodeCreate( tree, StringPoolIntern( &( tree->strings ), object, strlen( object ) ), NULL );
+    NodeLink( tree->root );
+
+    // Leaves the writer may split, only it reads them
+    Node_t** leaves = ( Node_t** ) calloc ( inserts + 1, sizeof( *leaves ) );
+    assert( leaves && "Memory allocation error" );
+
+    size_t leaf_count = 0;
+    leaves[ leaf_count++ ] = tree->root;
+
+    StressJob_t job;
+    job.tree = tree;
+    job.done.store( false, std::memory_order_relaxed );
+
+    StressReader_t* reader_states = ( StressReader_t* ) calloc ( readers, sizeof( *reader_states ) );
+    pthread_t*      handles       = ( pthread_t* )      calloc ( readers + 1, sizeof( *handles ) );
+    assert( reader_states && handles && "Memory allocation error" );
+
+    StressWalker_t walker = {};
+    walker.job = &job;
+
+    size_t started = 0;
+
+    for ( size_t idx = 0; idx < readers; idx++ ) {
+        reader_states[ idx ].job  = &job;
+        reader_states[ idx ].seed = 0x9E3779B97F4A7C15ull * ( idx + 1 );
+
+        if ( pthread_create( &( handles[ started ] ), NULL, RunReader, &( reader_states[ idx ] ) ) == 0 )
+            started++;
+    }
+
+    bool walker_started = pthread_create( &( handles[ started ] ), NULL, RunWalker, &walker ) == 0;
+
+    double   start = MonotonicSeconds();
+    uint64_t seed  = 1;
+
+    for ( size_t number = 1; number <= inserts; number++ ) {
+        size_t  idx  = NextRandom( &seed ) % leaf_count;
+        Node_t* leaf = leaves[ idx ];
+
+        snprintf( question, sizeof( question ), "Вопрос №%zu", number );
+        snprintf( object,   sizeof( object ),   "%s%zu", STRESS_OBJECT, number );
+
+        bool    object_is_left = NextRandom( &seed ) & 1;
+        Node_t* split          = TreeSplitLeaf( tree, leaf, question, object, object_is_left );
+
+        leaves[ idx ]          = split->left;
+        leaves[ leaf_count++ ] = split->right;
+    }
+
+    double elapsed = MonotonicSeconds() - start;
+
+    job.done.store( true, std::memory_order_release );
+
+    for ( size_t idx = 0; idx < started + walker_started; idx++ )
+        pthread_join( handles[ idx ], NULL );
+
+    size_t descents = 0;
+    size_t bad      = walker.bad;
+
+    for ( size_t idx = 0; idx < started; idx++ ) {
+        descents += reader_states[ idx ].descents;
+        bad      += reader_states[ idx ].bad;
+    }
+
+    size_t expected_nodes = 2 * inserts + 1;
+
+    fprintf( stdout, "Читателей: %zu, вставок: %zu за %.3f с, спусков: %zu, обходов: %zu\n",
+             started, inserts, elapsed, descents, walker.walks );
+    fprintf( stdout, "Недостроенных или чужих листьев: %zu, узлов в дереве: %zu из %zu\n",
+             bad, tree->arena.live, expected_nodes );
+
+    bool failed = bad != 0 || tree->arena.live != expected_nodes || started != readers || !walker_started;
+
+    if ( failed )
+        fprintf( stderr, COLOR_BRIGHT_RED "Проверка не пройдена\n" COLOR_RESET );
+
+    free( handles );
+    free( reader_states );
+    free( leaves );
+
+    TreeDtor( &tree );
+
+    return failed ? 1 : 0;
+}
@@ -1,9 +1,238 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
 #include "Akinator.h"
+#include "AkinatorBench.h"
+#include "AkinatorBatch.h"
+#include "AkinatorServer.h"
+#include "Metrics.h"
+#include "TreeTokenizer.h"
+
+static MetricsFormat_t stats_format = METRICS_OFF;
+
+static void ShowUsage( const char* program ) {
+    fprintf( stderr, "Использование:\n"
+                     "  %s                        игра с базой base.txt\n"
+                     "  %s --to-binary IN OUT     перевести базу в бинарный формат\n"
+                     "  %s --to-text   IN OUT     перевести базу в текстовый формат\n"
+                     "  %s --batch QUERIES OUT [THREADS]\n"
+                     "                                 ответить на запросы из файла (OUT \"-\" - stdout),\n"
+                     "                                 по умолчанию потоков столько, сколько ядер\n"
+                     "  %s --serve ADDRESS            сервер для многих игроков сразу: ADDRESS - порт\n"
+                     "                                 на 127.0.0.1 или путь к Unix-сокету\n"
+                     "  %s --load-test ADDRESS SESSIONS [CONNECTIONS]\n"
+                     "                                 нагрузочный тест сервера, по умолчанию\n"
+                     "                                 соединений столько, сколько ядер\n"
+                     "  %s --speech-warm-up LEVELS   озвучить заранее вопросы и догадки верхних\n"
+                     "                                 LEVELS уровней дерева в кэш \"%s\"\n"
+                     "  %s --render BASE SVG [dot]   нарисовать всю базу встроенной раскладкой\n"
+                     "                                 или через Graphviz, с замером времени\n"
+                     "  %s --generate SHAPE NODES SEED OUT\n"
+                     "                                 создать базу из NODES узлов: SHAPE - balanced,\n"
+                     "                                 random или chain; с тем же SEED - та же база\n"
+                     "  %s --bench BASE RESULTS [REPEATS]\n"
+                     "                                 замерить операции на базе, по строке JSON на\n"
+                     "                                 операцию в конец RESULTS (\"-\" - stdout)\n"
+                     "  %s --check-tokenizer [BASE]  сверить векторные токенизаторы со скалярным на\n"
+                     "                                 крайних случаях и, если указана, на базе BASE\n"
+                     "  %s --stress-rcu READERS INSERTS\n"
+                     "                                 READERS потоков спускаются по дереву, пока в него\n"
+                     "                                 вставляется INSERTS объектов (для сборки с TSan)\n"
+                     "Перед любым из режимов можно указать --stats или --stats=json: при выходе в stderr\n"
+                     "будет выведено, сколько разобрано и сохранено, поиски, пути и время операций\n",
+                     program, program, program, program, program, program, program, SPEECH_CACHE_DIRECTORY, program,
+                     program, program, program, program );
+}
+
+static void PrintStats() {
+    MetricsReport( stderr, stats_format );
+}
+
+// Taken off the arguments, so every mode below sees them as without it; the report goes to
+// stderr, out of the way of results written to stdout
+static void TakeStatsFlag( int* argc, char* argv[] ) {
+    if ( *argc < 2 )
+        return;
+
+    if ( strcmp( argv[1], "--stats" ) == 0 )
+        stats_format = METRICS_TEXT;
+    else if ( strcmp( argv[1], "--stats=json" ) == 0 )
+        stats_format = METRICS_JSON;
+    else
+        return;
+
+    // argv[ argc ] is NULL and moves down too
+    for ( int idx = 1; idx < *argc; idx++ )
+        argv[ idx ] = argv[ idx + 1 ];
+
+    ( *argc )--;
+
+    atexit( PrintStats );
+}
+
+static bool ParseShape( const char* name, BenchShape_t* shape ) {
+    if      ( strcmp( name, "balanced" ) == 0 ) *shape = BENCH_BALANCED;
+    else if ( strcmp( name, "random" )   == 0 ) *shape = BENCH_RANDOM;
+    else if ( strcmp( name, "chain" )    == 0 ) *shape = BENCH_CHAIN;
+    else                                        return false;
+
+    return true;
+}
+
+int main( int argc, char* argv[] ) {
+    TakeStatsFlag( &argc, argv );
+
+    if ( argc == 4 && strcmp( argv[1], "--to-binary" ) == 0 ) {
+        return AkinatorConvertBase( argv[2], argv[3], BASE_BINARY );
+    }
+
+    if ( argc == 4 && strcmp( argv[1], "--to-text" ) == 0 ) {
+        return AkinatorConvertBase( argv[2], argv[3], BASE_TEXT );
+    }
+
+    if ( ( argc == 4 || argc == 5 ) && strcmp( argv[1], "--batch" ) == 0 ) {
+        size_t threads = 0;
+
+        if ( argc == 5 ) {
+            char* end = NULL;
+            threads = strtoul( argv[4], &end, 10 );
+
+            if ( *end != '\0' || threads == 0 ) {
+                ShowUsage( argv[0] );
+                return 1;
+            }
+        }
+
+        return AkinatorBatch( "base.txt", argv[2], argv[3], threads );
+    }
+
+    if ( argc == 3 && strcmp( argv[1], "--serve" ) == 0 ) {
+        return AkinatorServe( argv[2] );
+    }
+
+    if ( ( argc == 4 || argc == 5 ) && strcmp( argv[1], "--load-test" ) == 0 ) {
+        char*  end      = NULL;
+        size_t sessions = strtoul( argv[3], &end, 10 );
+
+        if ( *end != '\0' || sessions == 0 ) {
+            ShowUsage( argv[0] );
+            return 1;
+        }
+
+        long   online      = sysconf( _SC_NPROCESSORS_ONLN );
+        size_t connections = ( online > 0 ) ? ( size_t ) online : 1;
+
+        if ( argc == 5 ) {
+            connections = strtoul( argv[4], &end, 10 );
+
+            if ( *end != '\0' || connections == 0 ) {
+                ShowUsage( argv[0] );
+                return 1;
+            }
+        }
+
+        return AkinatorLoadTest( argv[2], sessions, connections );
+    }
+
+    if ( argc == 3 && strcmp( argv[1], "--speech-warm-up" ) == 0 ) {
+        char*  end    = NULL;
+        size_t levels = strtoul( argv[2], &end, 10 );
+
+        if ( *end != '\0' || levels == 0 ) {
+            ShowUsage( argv[0] );
+            return 1;
+        }
+
+        Akinator_t* akinator = AkinatorCtor();
+        if ( !akinator ) {
+            return 1;
+        }
+
+        int result = AkinatorWarmUpSpeech( akinator, levels );
+
+        AkinatorDtor( &akinator );
+
+        return result;
+    }
+
+    if ( ( argc == 4 || argc == 5 ) && strcmp( argv[1], "--render" ) == 0 ) {
+        if ( argc == 5 && strcmp( argv[4], "dot" ) != 0 ) {
+            ShowUsage( argv[0] );
+            return 1;
+        }
+
+        return AkinatorRenderBase( argv[2], argv[3], argc == 5 );
+    }
+
+    if ( argc == 6 && strcmp( argv[1], "--generate" ) == 0 ) {
+        BenchShape_t shape = BENCH_BALANCED;
+        char*        end   = NULL;
+        size_t       nodes = strtoul( argv[3], &end, 10 );
+
+        if ( !ParseShape( argv[2], &shape ) || *end != '\0' || nodes == 0 ) {
+            ShowUsage( argv[0] );
+            return 1;
+        }
+
+        uint64_t seed = strtoull( argv[4], &end, 10 );
+
+        if ( *end != '\0' ) {
+            ShowUsage( argv[0] );
+            return 1;
+        }
+
+        return AkinatorGenerateBase( argv[5], shape, nodes, seed );
+    }
+
+    if ( ( argc == 4 || argc == 5 ) && strcmp( argv[1], "--bench" ) == 0 ) {
+        size_t repeats = BENCH_DEFAULT_REPEATS;
+
+        if ( argc == 5 ) {
+            char* end = NULL;
+            repeats = strtoul( argv[4], &end, 10 );
+
+            if ( *end != '\0' || repeats == 0 || repeats > BENCH_MAX_REPEATS ) {
+                ShowUsage( argv[0] );
+                return 1;
+            }
+        }
+
+        return AkinatorBench( argv[2], argv[3], repeats );
+    }
+
+    if ( ( argc == 2 || argc == 3 ) && strcmp( argv[1], "--check-tokenizer" ) == 0 ) {
+        return TokenizerSelfCheck( ( argc == 3 ) ? argv[2] : NULL );
+    }
+
+    if ( argc == 4 && strcmp( argv[1], "--stress-rcu" ) == 0 ) {
+        char*  end     = NULL;
+        size_t readers = strtoul( argv[2], &end, 10 );
+        bool   valid   = *end == '\0' && readers > 0 && readers <= STRESS_MAX_READERS;
+
+        size_t inserts = strtoul( argv[3], &end, 10 );
+        valid = valid && *end == '\0' && inserts > 0;
+
+        if ( !valid ) {
+            ShowUsage( argv[0] );
+            return 1;
+        }
+
+        return AkinatorRcuStress( readers, inserts );
+    }
+
+    if ( argc != 1 ) {
+        ShowUsage( argv[0] );
+        return 1;
+    }
 
-int main() {
     Akinator_t* akinator = AkinatorCtor();
+    if ( !akinator ) {
+        return 1;
+    }
 
     AkinatorGame( akinator );
 
     AkinatorDtor( &akinator );
-}
\ No newline at end of file
+}